@@ -0,0 +1,900 @@
+/*
+ * bitmap-convert.c
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+ * NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Scanline converters used by LockBits and UnlockBits to move pixels between the bitmap data and
+ * the locked buffer. A converter is picked once for the pair of formats and then run on each row,
+ * instead of streaming (and re-checking the format of) every single pixel.
+ *
+ * Pixels are handled as they are laid out in memory on little endian hosts (BGRA, or BGR for the
+ * packed 24bpp buffers handed out by LockBits). Big endian hosts keep using the pixel streams.
+ *
+ * The 16 bits per channel formats use the whole 0-65535 range (GDI+ uses 0-8192 with a linear
+ * gamma instead). They are converted directly between each other to keep their precision and go
+ * through 32bpp ARGB when converted to or from any other format, as do the 16bpp formats.
+ */
+
+#include "bitmap-private.h"
+#include "general-private.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_SSSE3_CONVERTERS 1
+#endif
+
+/* how the pixels of a buffer are stored, as bits per pixel */
+static int
+gdip_row_storage_bits (const ActiveBitmapData *data)
+{
+	switch (data->pixel_format) {
+	case PixelFormat1bppIndexed:
+		return 1;
+	case PixelFormat4bppIndexed:
+		return 4;
+	case PixelFormat8bppIndexed:
+		return 8;
+	case PixelFormat24bppRGB:
+		/* bitmaps store 24bpp like cairo, using 4 bytes, only locked buffers are packed */
+		return (data->reserved & GBD_TRUE24BPP) ? 24 : 32;
+	case PixelFormat32bppRGB:
+	case PixelFormat32bppARGB:
+	case PixelFormat32bppPARGB:
+		return 32;
+	case PixelFormat16bppRGB555:
+	case PixelFormat16bppRGB565:
+	case PixelFormat16bppARGB1555:
+		return 16;
+	case PixelFormat48bppRGB:
+		return 48;
+	case PixelFormat64bppARGB:
+	case PixelFormat64bppPARGB:
+		return 64;
+	default:
+		return 0;
+	}
+}
+
+/* formats converted through 32bpp ARGB */
+static BOOL
+gdip_row_format_is_native (PixelFormat format)
+{
+	switch (format) {
+	case PixelFormat16bppRGB555:
+	case PixelFormat16bppRGB565:
+	case PixelFormat16bppARGB1555:
+	case PixelFormat48bppRGB:
+	case PixelFormat64bppARGB:
+	case PixelFormat64bppPARGB:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+/* indexed pixels are packed starting with the most significant bits of each byte */
+static inline BYTE
+get_index (const BYTE *scan, int x, int bits)
+{
+	switch (bits) {
+	case 1:
+		return (scan[x >> 3] >> (7 - (x & 7))) & 0x01;
+	case 4:
+		return (x & 1) ? (scan[x >> 1] & 0x0F) : (scan[x >> 1] >> 4);
+	default:
+		return scan[x];
+	}
+}
+
+static void
+convert_copy_indexed (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	int bits = converter->bits;
+	int per_byte = 8 / bits;
+	BYTE mask = (1 << bits) - 1;
+	int i = 0;
+
+	if (bits == 8) {
+		memcpy (dest + dest_x, src + src_x, count);
+		return;
+	}
+
+	/* whole bytes can be copied when both rows start on a byte boundary */
+	if ((src_x % per_byte) == 0 && (dest_x % per_byte) == 0) {
+		i = (count / per_byte) * per_byte;
+		memcpy (dest + dest_x / per_byte, src + src_x / per_byte, count / per_byte);
+	}
+
+	/* the pixels around the row must be preserved in the bytes at either end */
+	for (; i < count; i++) {
+		int dx = dest_x + i;
+		int shift = 8 - bits * ((dx % per_byte) + 1);
+		BYTE *d = dest + dx / per_byte;
+
+		*d = (*d & ~(mask << shift)) | (get_index (src, src_x + i, bits) << shift);
+	}
+}
+
+static void
+convert_indexed_to_32 (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	const ARGB *palette = converter->palette;
+	ARGB *d = (ARGB *) dest + dest_x;
+	int i;
+
+	switch (converter->bits) {
+	case 8:
+		src += src_x;
+		for (i = 0; i < count; i++)
+			d[i] = palette[src[i]];
+		break;
+	case 4:
+		i = 0;
+		if ((src_x & 1) && count > 0)
+			d[i++] = palette[src[src_x >> 1] & 0x0F];
+		for (; i + 2 <= count; i += 2) {
+			BYTE b = src[(src_x + i) >> 1];
+			d[i] = palette[b >> 4];
+			d[i + 1] = palette[b & 0x0F];
+		}
+		if (i < count)
+			d[i] = palette[src[(src_x + i) >> 1] >> 4];
+		break;
+	default:
+		for (i = 0; i < count; i++)
+			d[i] = palette[get_index (src, src_x + i, converter->bits)];
+		break;
+	}
+}
+
+static void
+convert_indexed_to_24 (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	BYTE *d = dest + dest_x * 3;
+	int i;
+
+	for (i = 0; i < count; i++, d += 3) {
+		ARGB pixel = converter->palette[get_index (src, src_x + i, converter->bits)];
+		d[0] = pixel;
+		d[1] = pixel >> 8;
+		d[2] = pixel >> 16;
+	}
+}
+
+static void
+convert_copy_24 (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	memcpy (dest + dest_x * 3, src + src_x * 3, count * 3);
+}
+
+static void
+convert_copy_32 (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	memcpy (dest + dest_x * 4, src + src_x * 4, count * 4);
+}
+
+static void
+convert_24_to_32_scalar (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	const BYTE *s = src + src_x * 3;
+	ARGB *d = (ARGB *) dest + dest_x;
+	int i;
+
+	for (i = 0; i < count; i++, s += 3)
+		d[i] = s[0] | (s[1] << 8) | (s[2] << 16) | ALPHA_MASK;
+}
+
+static void
+convert_32_to_24_scalar (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	const BYTE *s = src + src_x * 4;
+	BYTE *d = dest + dest_x * 3;
+	int i;
+
+	for (i = 0; i < count; i++, s += 4, d += 3) {
+		d[0] = s[0];
+		d[1] = s[1];
+		d[2] = s[2];
+	}
+}
+
+static void
+convert_set_alpha_scalar (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	const ARGB *s = (const ARGB *) src + src_x;
+	ARGB *d = (ARGB *) dest + dest_x;
+	int i;
+
+	for (i = 0; i < count; i++)
+		d[i] = s[i] | ALPHA_MASK;
+}
+
+static void
+convert_premultiply (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	gdip_premultiply_argb_row ((const ARGB *) src + src_x, (ARGB *) dest + dest_x, count);
+}
+
+static void
+convert_unpremultiply (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	gdip_unpremultiply_argb_row ((const ARGB *) src + src_x, (ARGB *) dest + dest_x, count);
+}
+
+#if defined(__SSE2__)
+static void
+convert_set_alpha_sse2 (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	const ARGB *s = (const ARGB *) src + src_x;
+	ARGB *d = (ARGB *) dest + dest_x;
+	const __m128i alpha = _mm_set1_epi32 ((int) ALPHA_MASK);
+	int i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128i pixels = _mm_loadu_si128 ((const __m128i *) (s + i));
+		_mm_storeu_si128 ((__m128i *) (d + i), _mm_or_si128 (pixels, alpha));
+	}
+
+	convert_set_alpha_scalar (converter, (const BYTE *) (s + i), 0, (BYTE *) (d + i), 0, count - i);
+}
+#endif
+
+#if defined(HAVE_SSSE3_CONVERTERS)
+__attribute__((target ("ssse3"))) static void
+convert_24_to_32_ssse3 (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	const BYTE *s = src + src_x * 3;
+	ARGB *d = (ARGB *) dest + dest_x;
+	const __m128i expand = _mm_setr_epi8 (0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m128i alpha = _mm_set1_epi32 ((int) ALPHA_MASK);
+	int i = 0;
+
+	/* each load reads 16 bytes but only uses the first 12, stay within the row */
+	for (; i + 6 <= count; i += 4, s += 12) {
+		__m128i pixels = _mm_loadu_si128 ((const __m128i *) s);
+		_mm_storeu_si128 ((__m128i *) (d + i), _mm_or_si128 (_mm_shuffle_epi8 (pixels, expand), alpha));
+	}
+
+	convert_24_to_32_scalar (converter, s, 0, (BYTE *) (d + i), 0, count - i);
+}
+
+__attribute__((target ("ssse3"))) static void
+convert_32_to_24_ssse3 (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	const ARGB *s = (const ARGB *) src + src_x;
+	BYTE *d = dest + dest_x * 3;
+	const __m128i pack = _mm_setr_epi8 (0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+	int i = 0;
+
+	for (; i + 4 <= count; i += 4, d += 12) {
+		__m128i pixels = _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i *) (s + i)), pack);
+		int last = _mm_cvtsi128_si32 (_mm_srli_si128 (pixels, 8));
+
+		_mm_storel_epi64 ((__m128i *) d, pixels);
+		memcpy (d + 8, &last, 4);
+	}
+
+	convert_32_to_24_scalar (converter, (const BYTE *) (s + i), 0, d, 0, count - i);
+}
+#endif
+
+/* 16bpp: channels are widened by repeating their top bits, 0x1F becomes 0xFF */
+
+static inline ARGB
+expand_555 (WORD pixel)
+{
+	ARGB b = pixel & 0x1F, g = (pixel >> 5) & 0x1F, r = (pixel >> 10) & 0x1F;
+
+	return ALPHA_MASK | (((r << 3) | (r >> 2)) << 16) | (((g << 3) | (g >> 2)) << 8) | ((b << 3) | (b >> 2));
+}
+
+static inline ARGB
+expand_565 (WORD pixel)
+{
+	ARGB b = pixel & 0x1F, g = (pixel >> 5) & 0x3F, r = (pixel >> 11) & 0x1F;
+
+	return ALPHA_MASK | (((r << 3) | (r >> 2)) << 16) | (((g << 2) | (g >> 4)) << 8) | ((b << 3) | (b >> 2));
+}
+
+static void
+convert_16_to_argb_scalar (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	const WORD *s = (const WORD *) src + src_x;
+	ARGB *d = (ARGB *) dest + dest_x;
+	int i;
+
+	switch (converter->src_format) {
+	case PixelFormat16bppRGB565:
+		for (i = 0; i < count; i++)
+			d[i] = expand_565 (s[i]);
+		break;
+	case PixelFormat16bppARGB1555:
+		for (i = 0; i < count; i++)
+			d[i] = (s[i] & 0x8000) ? expand_555 (s[i]) : expand_555 (s[i]) & ~ALPHA_MASK;
+		break;
+	default:
+		for (i = 0; i < count; i++)
+			d[i] = expand_555 (s[i]);
+		break;
+	}
+}
+
+static void
+convert_argb_to_16_scalar (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	const ARGB *s = (const ARGB *) src + src_x;
+	WORD *d = (WORD *) dest + dest_x;
+	int i;
+
+	switch (converter->dest_format) {
+	case PixelFormat16bppRGB565:
+		for (i = 0; i < count; i++)
+			d[i] = ((s[i] >> 8) & 0xF800) | ((s[i] >> 5) & 0x07E0) | ((s[i] >> 3) & 0x001F);
+		break;
+	case PixelFormat16bppARGB1555:
+		/* alpha is rounded to the nearest of transparent and opaque */
+		for (i = 0; i < count; i++)
+			d[i] = ((s[i] >> 16) & 0x8000) | ((s[i] >> 9) & 0x7C00) | ((s[i] >> 6) & 0x03E0) | ((s[i] >> 3) & 0x001F);
+		break;
+	default:
+		for (i = 0; i < count; i++)
+			d[i] = ((s[i] >> 9) & 0x7C00) | ((s[i] >> 6) & 0x03E0) | ((s[i] >> 3) & 0x001F);
+		break;
+	}
+}
+
+#if defined(__SSE2__)
+/* widen 5 bit channels held in the low bits of each 16 bit lane to 8 bits */
+static inline __m128i
+expand_5_sse2 (__m128i channel)
+{
+	return _mm_or_si128 (_mm_slli_epi16 (channel, 3), _mm_srli_epi16 (channel, 2));
+}
+
+static void
+convert_16_to_argb_sse2 (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	const WORD *s = (const WORD *) src + src_x;
+	ARGB *d = (ARGB *) dest + dest_x;
+	const __m128i mask5 = _mm_set1_epi16 (0x1F);
+	const __m128i mask6 = _mm_set1_epi16 (0x3F);
+	const __m128i opaque = _mm_set1_epi16 (0xFF);
+	int i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128i pixels = _mm_loadu_si128 ((const __m128i *) (s + i));
+		__m128i b, g, r, a, bg, ra;
+
+		b = expand_5_sse2 (_mm_and_si128 (pixels, mask5));
+		if (converter->src_format == PixelFormat16bppRGB565) {
+			g = _mm_and_si128 (_mm_srli_epi16 (pixels, 5), mask6);
+			g = _mm_or_si128 (_mm_slli_epi16 (g, 2), _mm_srli_epi16 (g, 4));
+			r = expand_5_sse2 (_mm_srli_epi16 (pixels, 11));
+			a = opaque;
+		} else {
+			g = expand_5_sse2 (_mm_and_si128 (_mm_srli_epi16 (pixels, 5), mask5));
+			r = expand_5_sse2 (_mm_and_si128 (_mm_srli_epi16 (pixels, 10), mask5));
+			if (converter->src_format == PixelFormat16bppARGB1555)
+				a = _mm_srli_epi16 (_mm_srai_epi16 (pixels, 15), 8);
+			else
+				a = opaque;
+		}
+
+		/* interleave into B G R A bytes */
+		bg = _mm_or_si128 (b, _mm_slli_epi16 (g, 8));
+		ra = _mm_or_si128 (r, _mm_slli_epi16 (a, 8));
+		_mm_storeu_si128 ((__m128i *) (d + i), _mm_unpacklo_epi16 (bg, ra));
+		_mm_storeu_si128 ((__m128i *) (d + i + 4), _mm_unpackhi_epi16 (bg, ra));
+	}
+
+	convert_16_to_argb_scalar (converter, (const BYTE *) (s + i), 0, (BYTE *) (d + i), 0, count - i);
+}
+#endif
+
+/* 16 bits per channel: 8 bit values are widened as c * 257, narrowing rounds to nearest */
+
+static inline BYTE
+narrow_channel (WORD c)
+{
+	return ((((guint32) c * 0xFF01) >> 16) + 128) >> 8;
+}
+
+static inline WORD
+premultiply_channel_16 (WORD c, WORD a)
+{
+	guint32 t = (guint32) c * a + 0x8000;
+	return (t + (t >> 16)) >> 16;
+}
+
+static inline WORD
+unpremultiply_channel_16 (WORD c, WORD a)
+{
+	if (a == 0)
+		return 0;
+	if (c >= a)
+		return 0xFFFF;
+	return ((guint32) c * 0xFFFF + a / 2) / a;
+}
+
+static void
+convert_48_to_argb (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	const WORD *s = (const WORD *) src + src_x * 3;
+	ARGB *d = (ARGB *) dest + dest_x;
+	int i;
+
+	for (i = 0; i < count; i++, s += 3)
+		d[i] = ALPHA_MASK | (narrow_channel (s[2]) << 16) | (narrow_channel (s[1]) << 8) | narrow_channel (s[0]);
+}
+
+static void
+convert_64_to_32_scalar (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	const WORD *s = (const WORD *) src + src_x * 4;
+	ARGB *d = (ARGB *) dest + dest_x;
+	int i;
+
+	for (i = 0; i < count; i++, s += 4)
+		d[i] = ((ARGB) narrow_channel (s[3]) << 24) | (narrow_channel (s[2]) << 16) | (narrow_channel (s[1]) << 8) | narrow_channel (s[0]);
+}
+
+static void
+convert_64pargb_to_argb (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	const WORD *s = (const WORD *) src + src_x * 4;
+	ARGB *d = (ARGB *) dest + dest_x;
+	int i;
+
+	for (i = 0; i < count; i++, s += 4) {
+		WORD a = s[3];
+		if (a == 0xFFFF) {
+			d[i] = ALPHA_MASK | (narrow_channel (s[2]) << 16) | (narrow_channel (s[1]) << 8) | narrow_channel (s[0]);
+		} else {
+			d[i] = ((ARGB) narrow_channel (a) << 24) |
+				(narrow_channel (unpremultiply_channel_16 (s[2], a)) << 16) |
+				(narrow_channel (unpremultiply_channel_16 (s[1], a)) << 8) |
+				narrow_channel (unpremultiply_channel_16 (s[0], a));
+		}
+	}
+}
+
+static void
+convert_argb_to_48 (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	const BYTE *s = src + src_x * 4;
+	WORD *d = (WORD *) dest + dest_x * 3;
+	int i;
+
+	for (i = 0; i < count; i++, s += 4, d += 3) {
+		d[0] = s[0] * 257;
+		d[1] = s[1] * 257;
+		d[2] = s[2] * 257;
+	}
+}
+
+static void
+convert_32_to_64_scalar (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	const BYTE *s = src + src_x * 4;
+	WORD *d = (WORD *) dest + dest_x * 4;
+	int i;
+
+	for (i = 0; i < count * 4; i++)
+		d[i] = s[i] * 257;
+}
+
+static void
+convert_argb_to_64pargb (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	const BYTE *s = src + src_x * 4;
+	WORD *d = (WORD *) dest + dest_x * 4;
+	int i;
+
+	for (i = 0; i < count; i++, s += 4, d += 4) {
+		WORD a = s[3] * 257;
+		d[0] = premultiply_channel_16 (s[0] * 257, a);
+		d[1] = premultiply_channel_16 (s[1] * 257, a);
+		d[2] = premultiply_channel_16 (s[2] * 257, a);
+		d[3] = a;
+	}
+}
+
+#if defined(__SSE2__)
+static void
+convert_64_to_32_sse2 (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	const WORD *s = (const WORD *) src + src_x * 4;
+	ARGB *d = (ARGB *) dest + dest_x;
+	const __m128i scale = _mm_set1_epi16 ((short) 0xFF01);
+	const __m128i half = _mm_set1_epi16 (128);
+	int i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128i lo = _mm_loadu_si128 ((const __m128i *) (s + i * 4));
+		__m128i hi = _mm_loadu_si128 ((const __m128i *) (s + i * 4 + 8));
+
+		lo = _mm_srli_epi16 (_mm_add_epi16 (_mm_mulhi_epu16 (lo, scale), half), 8);
+		hi = _mm_srli_epi16 (_mm_add_epi16 (_mm_mulhi_epu16 (hi, scale), half), 8);
+		_mm_storeu_si128 ((__m128i *) (d + i), _mm_packus_epi16 (lo, hi));
+	}
+
+	convert_64_to_32_scalar (converter, (const BYTE *) (s + i * 4), 0, (BYTE *) (d + i), 0, count - i);
+}
+
+static void
+convert_32_to_64_sse2 (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	const ARGB *s = (const ARGB *) src + src_x;
+	WORD *d = (WORD *) dest + dest_x * 4;
+	int i = 0;
+
+	/* interleaving a byte with itself gives c * 257 */
+	for (; i + 4 <= count; i += 4) {
+		__m128i pixels = _mm_loadu_si128 ((const __m128i *) (s + i));
+		_mm_storeu_si128 ((__m128i *) (d + i * 4), _mm_unpacklo_epi8 (pixels, pixels));
+		_mm_storeu_si128 ((__m128i *) (d + i * 4 + 8), _mm_unpackhi_epi8 (pixels, pixels));
+	}
+
+	convert_32_to_64_scalar (converter, (const BYTE *) (s + i), 0, (BYTE *) (d + i * 4), 0, count - i);
+}
+#endif
+
+/* conversions between the 16 bits per channel formats, keeping their precision */
+
+static void
+convert_copy_wide (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	int bytes = converter->bits / 8;
+
+	memcpy (dest + dest_x * bytes, src + src_x * bytes, count * bytes);
+}
+
+static void
+convert_48_to_64 (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	const WORD *s = (const WORD *) src + src_x * 3;
+	WORD *d = (WORD *) dest + dest_x * 4;
+	int i;
+
+	for (i = 0; i < count; i++, s += 3, d += 4) {
+		d[0] = s[0];
+		d[1] = s[1];
+		d[2] = s[2];
+		d[3] = 0xFFFF;
+	}
+}
+
+static void
+convert_64_to_48 (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	const WORD *s = (const WORD *) src + src_x * 4;
+	WORD *d = (WORD *) dest + dest_x * 3;
+	BOOL premultiplied = converter->src_format == PixelFormat64bppPARGB;
+	int i;
+
+	for (i = 0; i < count; i++, s += 4, d += 3) {
+		if (premultiplied && s[3] != 0xFFFF) {
+			d[0] = unpremultiply_channel_16 (s[0], s[3]);
+			d[1] = unpremultiply_channel_16 (s[1], s[3]);
+			d[2] = unpremultiply_channel_16 (s[2], s[3]);
+		} else {
+			d[0] = s[0];
+			d[1] = s[1];
+			d[2] = s[2];
+		}
+	}
+}
+
+static void
+convert_64_premultiply (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	const WORD *s = (const WORD *) src + src_x * 4;
+	WORD *d = (WORD *) dest + dest_x * 4;
+	int i;
+
+	for (i = 0; i < count; i++, s += 4, d += 4) {
+		WORD a = s[3];
+		d[0] = premultiply_channel_16 (s[0], a);
+		d[1] = premultiply_channel_16 (s[1], a);
+		d[2] = premultiply_channel_16 (s[2], a);
+		d[3] = a;
+	}
+}
+
+static void
+convert_64_unpremultiply (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	const WORD *s = (const WORD *) src + src_x * 4;
+	WORD *d = (WORD *) dest + dest_x * 4;
+	int i;
+
+	for (i = 0; i < count; i++, s += 4, d += 4) {
+		WORD a = s[3];
+		d[0] = unpremultiply_channel_16 (s[0], a);
+		d[1] = unpremultiply_channel_16 (s[1], a);
+		d[2] = unpremultiply_channel_16 (s[2], a);
+		d[3] = a;
+	}
+}
+
+/* everything else goes through 32bpp ARGB, a chunk at a time */
+static void
+convert_through_argb (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count)
+{
+	ARGB line[256];
+	int i, n;
+
+	for (i = 0; i < count; i += n) {
+		n = min (count - i, 256);
+		converter->to_argb (converter, src, src_x + i, (BYTE *) line, 0, n);
+		converter->from_argb (converter, (const BYTE *) line, 0, dest, dest_x + i, n);
+	}
+}
+
+static GdipRowConvertFunc
+gdip_select_24_to_32 (void)
+{
+#if defined(HAVE_SSSE3_CONVERTERS)
+	if (__builtin_cpu_supports ("ssse3"))
+		return convert_24_to_32_ssse3;
+#endif
+	return convert_24_to_32_scalar;
+}
+
+static GdipRowConvertFunc
+gdip_select_32_to_24 (void)
+{
+#if defined(HAVE_SSSE3_CONVERTERS)
+	if (__builtin_cpu_supports ("ssse3"))
+		return convert_32_to_24_ssse3;
+#endif
+	return convert_32_to_24_scalar;
+}
+
+static GdipRowConvertFunc
+gdip_select_set_alpha (void)
+{
+#if defined(__SSE2__)
+	return convert_set_alpha_sse2;
+#else
+	return convert_set_alpha_scalar;
+#endif
+}
+
+static GdipRowConvertFunc
+gdip_select_16_to_argb (void)
+{
+#if defined(__SSE2__)
+	return convert_16_to_argb_sse2;
+#else
+	return convert_16_to_argb_scalar;
+#endif
+}
+
+static GdipRowConvertFunc
+gdip_select_64_to_32 (void)
+{
+#if defined(__SSE2__)
+	return convert_64_to_32_sse2;
+#else
+	return convert_64_to_32_scalar;
+#endif
+}
+
+static GdipRowConvertFunc
+gdip_select_32_to_64 (void)
+{
+#if defined(__SSE2__)
+	return convert_32_to_64_sse2;
+#else
+	return convert_32_to_64_scalar;
+#endif
+}
+
+/* converters from a 16bpp or 16 bits per channel format into ARGB */
+static GdipRowConvertFunc
+gdip_select_native_to_argb (PixelFormat format)
+{
+	switch (format) {
+	case PixelFormat48bppRGB:
+		return convert_48_to_argb;
+	case PixelFormat64bppARGB:
+		return gdip_select_64_to_32 ();
+	case PixelFormat64bppPARGB:
+		return convert_64pargb_to_argb;
+	default:
+		return gdip_select_16_to_argb ();
+	}
+}
+
+static GdipRowConvertFunc
+gdip_select_argb_to_native (PixelFormat format)
+{
+	switch (format) {
+	case PixelFormat48bppRGB:
+		return convert_argb_to_48;
+	case PixelFormat64bppARGB:
+		return gdip_select_32_to_64 ();
+	case PixelFormat64bppPARGB:
+		return convert_argb_to_64pargb;
+	default:
+		return convert_argb_to_16_scalar;
+	}
+}
+
+/* direct conversions involving the 16 bits per channel formats */
+static GdipRowConvertFunc
+gdip_select_wide (PixelFormat src, PixelFormat dest)
+{
+	if (src == dest)
+		return convert_copy_wide;
+
+	switch (src) {
+	case PixelFormat48bppRGB:
+		if (dest == PixelFormat64bppARGB || dest == PixelFormat64bppPARGB)
+			return convert_48_to_64;
+		break;
+	case PixelFormat64bppARGB:
+		if (dest == PixelFormat48bppRGB)
+			return convert_64_to_48;
+		if (dest == PixelFormat64bppPARGB)
+			return convert_64_premultiply;
+		if (dest == PixelFormat32bppARGB)
+			return gdip_select_64_to_32 ();
+		break;
+	case PixelFormat64bppPARGB:
+		if (dest == PixelFormat48bppRGB)
+			return convert_64_to_48;
+		if (dest == PixelFormat64bppARGB)
+			return convert_64_unpremultiply;
+		/* the premultiplied formats only differ by their precision */
+		if (dest == PixelFormat32bppPARGB)
+			return gdip_select_64_to_32 ();
+		break;
+	case PixelFormat32bppARGB:
+		if (dest == PixelFormat64bppARGB)
+			return gdip_select_32_to_64 ();
+		break;
+	case PixelFormat32bppPARGB:
+		if (dest == PixelFormat64bppPARGB)
+			return gdip_select_32_to_64 ();
+		break;
+	default:
+		break;
+	}
+
+	return NULL;
+}
+
+/* converters between the indexed, 24bpp and 32bpp formats */
+static GdipRowConvertFunc
+gdip_select_row_converter (GdipRowConverter *converter, const ActiveBitmapData *src, int src_bits, PixelFormat dest_format, int dest_bits)
+{
+	/* 32bppRGB must always be opaque for cairo */
+	ARGB alpha = (dest_format == PixelFormat32bppRGB) ? ALPHA_MASK : 0;
+
+	if (src_bits <= 8) {
+		int i, count;
+
+		if (dest_bits <= 8)
+			return (src->pixel_format == dest_format) ? convert_copy_indexed : NULL;
+
+		if (!src->palette)
+			return NULL;
+
+		/* indices not covered by the palette come out as transparent black (or opaque for 32bppRGB) */
+		count = min (src->palette->Count, 1 << src_bits);
+		for (i = 0; i < count; i++)
+			converter->palette[i] = src->palette->Entries[i] | alpha;
+		for (; i < (1 << src_bits); i++)
+			converter->palette[i] = alpha;
+
+		return (dest_bits == 24) ? convert_indexed_to_24 : convert_indexed_to_32;
+	}
+
+	if (dest_bits <= 8)
+		return NULL;
+
+	if (src_bits == 24)
+		return (dest_bits == 24) ? convert_copy_24 : gdip_select_24_to_32 ();
+	if (dest_bits == 24)
+		return gdip_select_32_to_24 ();
+	if (src->pixel_format == PixelFormat32bppARGB && dest_format == PixelFormat32bppPARGB)
+		return convert_premultiply;
+	if (src->pixel_format == PixelFormat32bppPARGB && dest_format == PixelFormat32bppARGB)
+		return convert_unpremultiply;
+
+	return alpha ? gdip_select_set_alpha () : convert_copy_32;
+}
+
+/*
+ * Pick the row converter from src to dest. Returns FALSE if there isn't one for these formats,
+ * in which case the caller has to fall back to the pixel streams.
+ */
+BOOL
+gdip_row_converter_init (GdipRowConverter *converter, const ActiveBitmapData *src, const ActiveBitmapData *dest)
+{
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+	int src_bits = gdip_row_storage_bits (src);
+	int dest_bits = gdip_row_storage_bits (dest);
+	BOOL src_native = gdip_row_format_is_native (src->pixel_format);
+	BOOL dest_native = gdip_row_format_is_native (dest->pixel_format);
+
+	converter->convert = NULL;
+	converter->to_argb = NULL;
+	converter->from_argb = NULL;
+	converter->bits = src_bits;
+	converter->src_format = src->pixel_format;
+	converter->dest_format = dest->pixel_format;
+
+	if (src_bits == 0 || dest_bits == 0)
+		return FALSE;
+
+	if (!src_native && !dest_native) {
+		converter->convert = gdip_select_row_converter (converter, src, src_bits, dest->pixel_format, dest_bits);
+		return converter->convert != NULL;
+	}
+
+	if ((src_bits >= 32 && dest_bits >= 32) || src->pixel_format == dest->pixel_format) {
+		converter->convert = gdip_select_wide (src->pixel_format, dest->pixel_format);
+		if (converter->convert)
+			return TRUE;
+	}
+
+	if (src_native)
+		converter->to_argb = gdip_select_native_to_argb (src->pixel_format);
+	else
+		converter->to_argb = gdip_select_row_converter (converter, src, src_bits, PixelFormat32bppARGB, 32);
+
+	if (dest_native) {
+		converter->from_argb = gdip_select_argb_to_native (dest->pixel_format);
+	} else {
+		ActiveBitmapData argb;
+
+		argb.pixel_format = PixelFormat32bppARGB;
+		argb.palette = NULL;
+		converter->from_argb = gdip_select_row_converter (converter, &argb, 32, dest->pixel_format, dest_bits);
+	}
+
+	/* convert_through_argb needs both halves */
+	if (!converter->to_argb || !converter->from_argb)
+		return FALSE;
+
+	converter->convert = convert_through_argb;
+	return TRUE;
+#else
+	converter->bits = 32;
+	converter->src_format = src->pixel_format;
+	converter->dest_format = dest->pixel_format;
+
+	/* the premultiplication kernels work on ARGB values, keep the bitmap surfaces working */
+	if (src->pixel_format == PixelFormat32bppARGB && dest->pixel_format == PixelFormat32bppPARGB) {
+		converter->convert = convert_premultiply;
+		return TRUE;
+	}
+	if (src->pixel_format == PixelFormat32bppPARGB && dest->pixel_format == PixelFormat32bppARGB) {
+		converter->convert = convert_unpremultiply;
+		return TRUE;
+	}
+
+	return FALSE;
+#endif
+}
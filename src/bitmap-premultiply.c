@@ -0,0 +1,318 @@
+/*
+ * bitmap-premultiply.c
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+ * NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Scanline kernels converting between straight (ARGB) and premultiplied (PARGB) alpha.
+ *
+ * Premultiplication computes c * a / 255 rounded to nearest, i.e. with t = c * a + 128 the result
+ * is (t + (t >> 8)) >> 8. This is exactly what pre_multiplied_table holds, so the vector versions
+ * produce the same bytes as the table.
+ *
+ * pre_multiplied_table_reverse can't be reproduced with integer arithmetic, so the vector
+ * unpremultiply kernels only skip over pixels whose alpha is 0 or 255 (which are left unchanged)
+ * and use the table for everything else.
+ *
+ * The kernel is picked at runtime. Setting GDIPLUS_PREMULTIPLY to "table", "sse2", "avx2" or "neon"
+ * forces a given implementation (if supported), which is useful for benchmarking.
+ */
+
+#include "bitmap-private.h"
+#include "general-private.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_AVX2_KERNELS 1
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+typedef void (*GpPremultiplyRowFunc) (const ARGB *src, ARGB *dest, int count);
+
+static GpPremultiplyRowFunc premultiply_row;
+static GpPremultiplyRowFunc unpremultiply_row;
+
+static inline ARGB
+premultiply_pixel (ARGB pixel)
+{
+	BYTE r, g, b, a;
+
+	get_pixel_bgra (pixel, b, g, r, a);
+	if (a == 0xff)
+		return pixel;
+
+	b = pre_multiplied_table [b][a];
+	g = pre_multiplied_table [g][a];
+	r = pre_multiplied_table [r][a];
+	return ((guint32)a << 24) | (r << 16) | (g << 8) | b;
+}
+
+static inline ARGB
+unpremultiply_pixel (ARGB pixel)
+{
+	BYTE r, g, b, a;
+
+	get_pixel_bgra (pixel, b, g, r, a);
+	if (a == 0xff)
+		return pixel;
+
+	b = pre_multiplied_table_reverse [b][a];
+	g = pre_multiplied_table_reverse [g][a];
+	r = pre_multiplied_table_reverse [r][a];
+	return ((guint32)a << 24) | (r << 16) | (g << 8) | b;
+}
+
+static void
+premultiply_row_table (const ARGB *src, ARGB *dest, int count)
+{
+	int x;
+
+	for (x = 0; x < count; x++)
+		dest[x] = premultiply_pixel (src[x]);
+}
+
+static void
+unpremultiply_row_table (const ARGB *src, ARGB *dest, int count)
+{
+	int x;
+
+	for (x = 0; x < count; x++)
+		dest[x] = unpremultiply_pixel (src[x]);
+}
+
+#if defined(__SSE2__)
+/* multiply 2 unpacked pixels (8 x 16 bits) by their own alpha, leaving alpha itself untouched */
+static inline __m128i
+premultiply_unpacked_sse2 (__m128i pixels)
+{
+	const __m128i alpha_mask = _mm_set_epi16 (0, -1, -1, -1, 0, -1, -1, -1);
+	const __m128i alpha_one = _mm_set_epi16 (255, 0, 0, 0, 255, 0, 0, 0);
+	__m128i alpha, t;
+
+	alpha = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (pixels, _MM_SHUFFLE (3, 3, 3, 3)), _MM_SHUFFLE (3, 3, 3, 3));
+	alpha = _mm_or_si128 (_mm_and_si128 (alpha, alpha_mask), alpha_one);
+
+	t = _mm_add_epi16 (_mm_mullo_epi16 (pixels, alpha), _mm_set1_epi16 (128));
+	return _mm_srli_epi16 (_mm_add_epi16 (t, _mm_srli_epi16 (t, 8)), 8);
+}
+
+static void
+premultiply_row_sse2 (const ARGB *src, ARGB *dest, int count)
+{
+	const __m128i zero = _mm_setzero_si128 ();
+	int x = 0;
+
+	for (; x + 4 <= count; x += 4) {
+		__m128i pixels = _mm_loadu_si128 ((const __m128i *) (src + x));
+		__m128i lo = premultiply_unpacked_sse2 (_mm_unpacklo_epi8 (pixels, zero));
+		__m128i hi = premultiply_unpacked_sse2 (_mm_unpackhi_epi8 (pixels, zero));
+		_mm_storeu_si128 ((__m128i *) (dest + x), _mm_packus_epi16 (lo, hi));
+	}
+
+	premultiply_row_table (src + x, dest + x, count - x);
+}
+
+static void
+unpremultiply_row_sse2 (const ARGB *src, ARGB *dest, int count)
+{
+	const __m128i alpha_bits = _mm_set1_epi32 ((int) ALPHA_MASK);
+	const __m128i zero = _mm_setzero_si128 ();
+	int x = 0;
+
+	while (x + 4 <= count) {
+		__m128i pixels = _mm_loadu_si128 ((const __m128i *) (src + x));
+		__m128i alpha = _mm_and_si128 (pixels, alpha_bits);
+		__m128i unchanged = _mm_or_si128 (_mm_cmpeq_epi32 (alpha, alpha_bits), _mm_cmpeq_epi32 (alpha, zero));
+
+		if (_mm_movemask_epi8 (unchanged) == 0xffff) {
+			if (src != dest)
+				_mm_storeu_si128 ((__m128i *) (dest + x), pixels);
+		} else {
+			unpremultiply_row_table (src + x, dest + x, 4);
+		}
+		x += 4;
+	}
+
+	unpremultiply_row_table (src + x, dest + x, count - x);
+}
+#endif
+
+#if defined(HAVE_AVX2_KERNELS)
+__attribute__((target ("avx2"))) static inline __m256i
+premultiply_unpacked_avx2 (__m256i pixels)
+{
+	const __m256i alpha_mask = _mm256_set_epi16 (0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1);
+	const __m256i alpha_one = _mm256_set_epi16 (255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0);
+	__m256i alpha, t;
+
+	alpha = _mm256_shufflehi_epi16 (_mm256_shufflelo_epi16 (pixels, _MM_SHUFFLE (3, 3, 3, 3)), _MM_SHUFFLE (3, 3, 3, 3));
+	alpha = _mm256_or_si256 (_mm256_and_si256 (alpha, alpha_mask), alpha_one);
+
+	t = _mm256_add_epi16 (_mm256_mullo_epi16 (pixels, alpha), _mm256_set1_epi16 (128));
+	return _mm256_srli_epi16 (_mm256_add_epi16 (t, _mm256_srli_epi16 (t, 8)), 8);
+}
+
+__attribute__((target ("avx2"))) static void
+premultiply_row_avx2 (const ARGB *src, ARGB *dest, int count)
+{
+	const __m256i zero = _mm256_setzero_si256 ();
+	int x = 0;
+
+	/* unpack and pack work within 128 bits lanes, so the pixel order is preserved */
+	for (; x + 8 <= count; x += 8) {
+		__m256i pixels = _mm256_loadu_si256 ((const __m256i *) (src + x));
+		__m256i lo = premultiply_unpacked_avx2 (_mm256_unpacklo_epi8 (pixels, zero));
+		__m256i hi = premultiply_unpacked_avx2 (_mm256_unpackhi_epi8 (pixels, zero));
+		_mm256_storeu_si256 ((__m256i *) (dest + x), _mm256_packus_epi16 (lo, hi));
+	}
+
+	premultiply_row_table (src + x, dest + x, count - x);
+}
+
+__attribute__((target ("avx2"))) static void
+unpremultiply_row_avx2 (const ARGB *src, ARGB *dest, int count)
+{
+	const __m256i alpha_bits = _mm256_set1_epi32 ((int) ALPHA_MASK);
+	const __m256i zero = _mm256_setzero_si256 ();
+	int x = 0;
+
+	while (x + 8 <= count) {
+		__m256i pixels = _mm256_loadu_si256 ((const __m256i *) (src + x));
+		__m256i alpha = _mm256_and_si256 (pixels, alpha_bits);
+		__m256i unchanged = _mm256_or_si256 (_mm256_cmpeq_epi32 (alpha, alpha_bits), _mm256_cmpeq_epi32 (alpha, zero));
+
+		if (_mm256_movemask_epi8 (unchanged) == -1) {
+			if (src != dest)
+				_mm256_storeu_si256 ((__m256i *) (dest + x), pixels);
+		} else {
+			unpremultiply_row_table (src + x, dest + x, 8);
+		}
+		x += 8;
+	}
+
+	unpremultiply_row_table (src + x, dest + x, count - x);
+}
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+/* (x + ((x + 128) >> 8) + 128) >> 8 is the same rounding as the table */
+static inline uint8x8_t
+premultiply_channel_neon (uint8x8_t channel, uint8x8_t alpha)
+{
+	uint16x8_t x = vmull_u8 (channel, alpha);
+	return vraddhn_u16 (x, vrshrq_n_u16 (x, 8));
+}
+
+static void
+premultiply_row_neon (const ARGB *src, ARGB *dest, int count)
+{
+	int x = 0;
+
+	/* little endian BGRA: val[0] is blue and val[3] alpha */
+	for (; x + 8 <= count; x += 8) {
+		uint8x8x4_t pixels = vld4_u8 ((const uint8_t *) (src + x));
+		pixels.val[0] = premultiply_channel_neon (pixels.val[0], pixels.val[3]);
+		pixels.val[1] = premultiply_channel_neon (pixels.val[1], pixels.val[3]);
+		pixels.val[2] = premultiply_channel_neon (pixels.val[2], pixels.val[3]);
+		vst4_u8 ((uint8_t *) (dest + x), pixels);
+	}
+
+	premultiply_row_table (src + x, dest + x, count - x);
+}
+
+static void
+unpremultiply_row_neon (const ARGB *src, ARGB *dest, int count)
+{
+	int x = 0;
+
+	while (x + 8 <= count) {
+		uint8x8x4_t pixels = vld4_u8 ((const uint8_t *) (src + x));
+		uint8x8_t unchanged = vorr_u8 (vceq_u8 (pixels.val[3], vdup_n_u8 (0xff)), vceq_u8 (pixels.val[3], vdup_n_u8 (0)));
+
+		if (vget_lane_u64 (vreinterpret_u64_u8 (unchanged), 0) == ~(uint64_t) 0) {
+			if (src != dest)
+				vst4_u8 ((uint8_t *) (dest + x), pixels);
+		} else {
+			unpremultiply_row_table (src + x, dest + x, 8);
+		}
+		x += 8;
+	}
+
+	unpremultiply_row_table (src + x, dest + x, count - x);
+}
+#endif
+
+static void
+gdip_premultiply_select_kernels (void)
+{
+	const char *forced = getenv ("GDIPLUS_PREMULTIPLY");
+	GpPremultiplyRowFunc premul = premultiply_row_table;
+	GpPremultiplyRowFunc unpremul = unpremultiply_row_table;
+
+	if (forced && *forced == '\0')
+		forced = NULL;
+
+	if (!forced || strcmp (forced, "table") != 0) {
+#if defined(__SSE2__)
+		if (!forced || strcmp (forced, "sse2") == 0) {
+			premul = premultiply_row_sse2;
+			unpremul = unpremultiply_row_sse2;
+		}
+#endif
+#if defined(HAVE_AVX2_KERNELS)
+		if ((!forced || strcmp (forced, "avx2") == 0) && __builtin_cpu_supports ("avx2")) {
+			premul = premultiply_row_avx2;
+			unpremul = unpremultiply_row_avx2;
+		}
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+		if (!forced || strcmp (forced, "neon") == 0) {
+			premul = premultiply_row_neon;
+			unpremul = unpremultiply_row_neon;
+		}
+#endif
+	}
+
+	/* both pointers are always written with the same values, so racing threads are harmless */
+	unpremultiply_row = unpremul;
+	premultiply_row = premul;
+}
+
+/* Premultiply count ARGB pixels from src into dest. src and dest may be the same buffer. */
+void
+gdip_premultiply_argb_row (const ARGB *src, ARGB *dest, int count)
+{
+	if (!premultiply_row)
+		gdip_premultiply_select_kernels ();
+
+	premultiply_row (src, dest, count);
+}
+
+/* Reverse the premultiplication of count PARGB pixels from src into dest. src and dest may be the same buffer. */
+void
+gdip_unpremultiply_argb_row (const ARGB *src, ARGB *dest, int count)
+{
+	if (!unpremultiply_row)
+		gdip_premultiply_select_kernels ();
+
+	unpremultiply_row (src, dest, count);
+}
@@ -103,6 +103,14 @@ typedef struct {
 	GUID		frame_dimension;	/* GUID describing the frame type */
 } FrameData;
 
+/* Decode a new bitmap from the source of a bitmap loaded without its pixels, see gdip_bitmap_set_deferred_source */
+typedef GpStatus (*GpDeferredLoadFunc) (void *source, UINT minWidth, UINT minHeight, GpImage **bitmap);
+typedef void (*GpDeferredFreeFunc) (void *source);
+/* Decode only @rect of the source into @scan0, in the layout of the bitmap's own scan0 */
+typedef GpStatus (*GpDeferredLoadRegionFunc) (void *source, const GpRect *rect, BYTE *scan0, int stride);
+
+typedef struct _BitmapGraphicsCount BitmapGraphicsCount;
+
 typedef struct _Image {
 	/* Image Description */
 	ImageType     	type;			/* Undefined, Bitmap, MetaFile */
@@ -117,6 +125,25 @@ typedef struct _Image {
 	/* Internal fields */
 	int             cairo_format;
 	cairo_surface_t *surface;
+	unsigned int	generation;		/* Bumped when the palette or the pixels of the active bitmap change */
+	/* 32bpp expansion of an indexed active bitmap, see gdip_bitmap_get_indexed_rgb */
+	struct _Image	*indexed_rgb;
+	ActiveBitmapData	*indexed_rgb_data;	/* active bitmap, palette and generation it was made from */
+	ColorPalette	*indexed_rgb_palette;
+	unsigned int	indexed_rgb_generation;
+	/* surface repeated by the tiling wrap modes, see gdip_bitmap_get_tile_surface */
+	cairo_surface_t	*tile_surface;
+	WrapMode	tile_wrap_mode;
+	unsigned int	tile_generation;
+	unsigned int	tile_graphics_released;
+	/* Graphics created on the bitmap, see gdip_bitmap_surface_add_graphics */
+	BitmapGraphicsCount	*graphics_count;
+	/* the pixels of deferred_data are decoded from deferred_source on first use, see gdip_bitmap_ensure_pixels */
+	GpDeferredLoadFunc	deferred_load;
+	GpDeferredLoadRegionFunc	deferred_load_region;
+	GpDeferredFreeFunc	deferred_free;
+	void		*deferred_source;
+	ActiveBitmapData	*deferred_data;
 } GpBitmap;
 
 
@@ -130,6 +157,7 @@ GpStatus gdip_bitmap_dispose (GpBitmap *bitmap) GDIP_INTERNAL;
 GpStatus gdip_bitmap_clone (GpBitmap *bitmap, GpBitmap **clonedbitmap) GDIP_INTERNAL;
 GpStatus gdip_bitmap_setactive (GpBitmap *bitmap, const GUID *dimension, int index) GDIP_INTERNAL;
 GpStatus gdip_bitmapdata_clone (ActiveBitmapData *src, ActiveBitmapData **dest, int count) GDIP_INTERNAL;
+GpStatus gdip_bitmap_change_rect_pixel_format (ActiveBitmapData *srcData, const Rect *srcRect, ActiveBitmapData *destData, Rect *destRect) GDIP_INTERNAL;
 ColorPalette *gdip_palette_clone(ColorPalette *original) GDIP_INTERNAL;
 GpStatus gdip_property_get_short (int offset, void *value, unsigned short *result) GDIP_INTERNAL;
 GpStatus gdip_property_get_long (int offset, void *value, guint32 *result) GDIP_INTERNAL;
@@ -146,15 +174,32 @@ GpStatus gdip_bitmapdata_property_remove_id (ActiveBitmapData *bitmap_data, PROP
 GpStatus gdip_bitmapdata_property_remove_index (ActiveBitmapData *bitmap_data, int index) GDIP_INTERNAL;
 GpStatus gdip_bitmapdata_property_find_id (ActiveBitmapData *bitmap_data, PROPID id, int *index) GDIP_INTERNAL;
 
+void gdip_bitmap_set_deferred_source (GpBitmap *bitmap, GpDeferredLoadFunc load, GpDeferredLoadRegionFunc load_region, GpDeferredFreeFunc free, void *source) GDIP_INTERNAL;
+GpStatus gdip_bitmap_ensure_pixels (GpBitmap *bitmap) GDIP_INTERNAL;
+GpStatus gdip_bitmap_load_deferred_scaled (GpBitmap *bitmap, UINT minWidth, UINT minHeight, GpBitmap **scaled) GDIP_INTERNAL;
+GpStatus gdip_bitmap_load_deferred_region (GpBitmap *bitmap, const GpRect *rect, ActiveBitmapData *dest) GDIP_INTERNAL;
 cairo_surface_t* gdip_bitmap_ensure_surface (GpBitmap *bitmap) GDIP_INTERNAL;
 void gdip_bitmap_flush_surface (GpBitmap *bitmap) GDIP_INTERNAL;
 void gdip_bitmap_invalidate_surface (GpBitmap *bitmap) GDIP_INTERNAL;
+void gdip_bitmap_surface_add_graphics (GpBitmap *bitmap, cairo_t *ct) GDIP_INTERNAL;
+void gdip_bitmap_surface_mark_dirty (GpBitmap *bitmap, int x, int y, int width, int height) GDIP_INTERNAL;
 GpBitmap* gdip_convert_indexed_to_rgb (GpBitmap *bitmap) GDIP_INTERNAL;
+GpBitmap* gdip_convert_wide_to_rgb (GpBitmap *bitmap) GDIP_INTERNAL;
+GpBitmap* gdip_bitmap_get_indexed_rgb (GpBitmap *bitmap) GDIP_INTERNAL;
+cairo_surface_t* gdip_bitmap_get_tile_surface (GpBitmap *bitmap, WrapMode wrapMode) GDIP_INTERNAL;
 
 BOOL gdip_bitmap_format_needs_premultiplication (GpBitmap *bitmap) GDIP_INTERNAL;
 BYTE* gdip_bitmap_get_premultiplied_scan0 (GpBitmap *bitmap) GDIP_INTERNAL;
-void gdip_bitmap_get_premultiplied_scan0_inplace (GpBitmap *bitmap, BYTE *premul) GDIP_INTERNAL;
-void gdip_bitmap_get_premultiplied_scan0_reverse (GpBitmap *bitmap, BYTE *premul) GDIP_INTERNAL;
+void gdip_bitmap_get_premultiplied_scan0_inplace (GpBitmap *bitmap, BYTE *premul, const Rect *rect) GDIP_INTERNAL;
+void gdip_bitmap_get_premultiplied_scan0_reverse (GpBitmap *bitmap, BYTE *premul, const Rect *rect) GDIP_INTERNAL;
+
+/* scanline kernels (bitmap-premultiply.c), src and dest may be the same buffer */
+void gdip_premultiply_argb_row (const ARGB *src, ARGB *dest, int count) GDIP_INTERNAL;
+void gdip_unpremultiply_argb_row (const ARGB *src, ARGB *dest, int count) GDIP_INTERNAL;
+
+/* color quantization of 32bpp pixels for the indexed encoders (bitmap-quantize.c) */
+GpStatus gdip_quantize_argb (const BYTE *scan0, int stride, int width, int height, int max_colors, BOOL dither,
+	ARGB *palette, int *count, BYTE *indices) GDIP_INTERNAL;
 
 GpStatus gdip_process_bitmap_attributes (GpBitmap *bitmap, GpImageAttributes* attr, GpBitmap **dest_bitmap) GDIP_INTERNAL;
 
@@ -175,6 +220,22 @@ typedef struct {
 GpStatus gdip_init_pixel_stream (StreamingState *state, ActiveBitmapData *data, int x, int y, int w, int h) GDIP_INTERNAL;
 unsigned int gdip_pixel_stream_get_next (StreamingState *state) GDIP_INTERNAL;
 
+/* scanline format converters (bitmap-convert.c), x and count are in pixels */
+typedef struct _GdipRowConverter GdipRowConverter;
+typedef void (*GdipRowConvertFunc) (const GdipRowConverter *converter, const BYTE *src, int src_x, BYTE *dest, int dest_x, int count);
+
+struct _GdipRowConverter {
+	GdipRowConvertFunc	convert;
+	GdipRowConvertFunc	to_argb;	/* the two steps of conversions going through 32bpp ARGB */
+	GdipRowConvertFunc	from_argb;
+	int			bits;		/* bits per pixel of the source */
+	PixelFormat		src_format;
+	PixelFormat		dest_format;
+	ARGB			palette[256];	/* for indexed sources, ready to be stored in the destination */
+};
+
+BOOL gdip_row_converter_init (GdipRowConverter *converter, const ActiveBitmapData *src, const ActiveBitmapData *dest) GDIP_INTERNAL;
+
 #include "bitmap.h"
 
 #endif
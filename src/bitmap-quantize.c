@@ -0,0 +1,640 @@
+/*
+ * bitmap-quantize.c
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+ * NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Color quantization, used by the encoders of indexed formats to save 32bpp bitmaps.
+ *
+ * Images with no more different colors than the palette can hold keep them exactly. The pixels of the
+ * others are counted in a histogram of 5-6-5 bins, which also sums the colors that fall in each bin to
+ * get their average. Large images are counted on several threads. The palette is seeded by median cuts
+ * of the occupied bins and then refined by a few k-means iterations over the bins, rather than over the
+ * pixels. An inverse lookup table giving the nearest palette entry of every bin finally maps the pixels,
+ * directly or with Floyd-Steinberg dithering.
+ */
+
+#include "bitmap-private.h"
+#include "general-private.h"
+
+#define QUANTIZE_BINS		65536
+#define QUANTIZE_BIN(r, g, b)	((((r) >> 3) << 11) | (((g) >> 2) << 5) | ((b) >> 3))
+#define QUANTIZE_ITERATIONS	4
+#define QUANTIZE_EXACT_SLOTS	1024
+
+typedef struct {
+	guint32	count;
+	guint64	red;
+	guint64	green;
+	guint64	blue;
+} QuantizeBin;
+
+/* An occupied bin, with the average of the colors that fell into it */
+typedef struct {
+	BYTE	color[3];
+	guint32	bin;
+} QuantizeEntry;
+
+/* A set of entries, [start, end), to be split along axis */
+typedef struct {
+	int	start;
+	int	end;
+	int	axis;
+	double	score;
+} QuantizeBox;
+
+/* The palette sorted on green, which allows the search for the nearest entry to stop early */
+typedef struct {
+	int	count;
+	BYTE	red[256];
+	BYTE	green[256];
+	BYTE	blue[256];
+	BYTE	index[256];
+	int	first[257];
+} QuantizePalette;
+
+/* The different colors of an image, as long as they fit in a palette */
+typedef struct {
+	ARGB	color[QUANTIZE_EXACT_SLOTS];
+	BYTE	index[QUANTIZE_EXACT_SLOTS];
+} QuantizeExactTable;
+
+typedef struct {
+	const BYTE	*scan0;
+	int		stride;
+	int		width;
+	int		height;
+	QuantizeBin	*bins;
+	const BYTE	*lut;
+	BYTE		*indices;
+	GMutex		lock;
+} QuantizeImage;
+
+static void
+gdip_quantize_count_rows (QuantizeBin *bins, const QuantizeImage *image, int y_start, int y_end)
+{
+	int x, y;
+
+	for (y = y_start; y < y_end; y++) {
+		const ARGB *row = (const ARGB *) (image->scan0 + y * image->stride);
+
+		for (x = 0; x < image->width; x++) {
+			BYTE r = (row[x] >> 16) & 0xFF;
+			BYTE g = (row[x] >> 8) & 0xFF;
+			BYTE b = row[x] & 0xFF;
+			QuantizeBin *bin = &bins[QUANTIZE_BIN (r, g, b)];
+
+			bin->count++;
+			bin->red += r;
+			bin->green += g;
+			bin->blue += b;
+		}
+	}
+}
+
+static void
+gdip_quantize_histogram_band (int y_start, int y_end, void *user_data)
+{
+	QuantizeImage *image = (QuantizeImage *) user_data;
+	QuantizeBin *bins;
+	int i;
+
+	if (y_start == 0 && y_end == image->height) {
+		gdip_quantize_count_rows (image->bins, image, y_start, y_end);
+		return;
+	}
+
+	/* each band counts its rows on its own and then adds them to the shared histogram */
+	bins = gdip_calloc (QUANTIZE_BINS, sizeof (QuantizeBin));
+	if (!bins) {
+		g_mutex_lock (&image->lock);
+		gdip_quantize_count_rows (image->bins, image, y_start, y_end);
+		g_mutex_unlock (&image->lock);
+		return;
+	}
+
+	gdip_quantize_count_rows (bins, image, y_start, y_end);
+
+	g_mutex_lock (&image->lock);
+	for (i = 0; i < QUANTIZE_BINS; i++) {
+		if (bins[i].count) {
+			image->bins[i].count += bins[i].count;
+			image->bins[i].red += bins[i].red;
+			image->bins[i].green += bins[i].green;
+			image->bins[i].blue += bins[i].blue;
+		}
+	}
+	g_mutex_unlock (&image->lock);
+
+	GdipFree (bins);
+}
+
+/* Finds the axis along which the weighted entries of a box vary the most */
+static void
+gdip_quantize_score_box (QuantizeBox *box, const QuantizeEntry *entries, const QuantizeBin *bins)
+{
+	double sum[3] = {0, 0, 0};
+	double squares[3] = {0, 0, 0};
+	double weight = 0;
+	int i, axis;
+
+	box->axis = 0;
+	box->score = 0;
+	if (box->end - box->start < 2)
+		return;
+
+	for (i = box->start; i < box->end; i++) {
+		double count = bins[entries[i].bin].count;
+
+		weight += count;
+		for (axis = 0; axis < 3; axis++) {
+			sum[axis] += count * entries[i].color[axis];
+			squares[axis] += count * entries[i].color[axis] * entries[i].color[axis];
+		}
+	}
+
+	for (axis = 0; axis < 3; axis++) {
+		double variance = squares[axis] - sum[axis] * sum[axis] / weight;
+
+		if (variance > box->score) {
+			box->score = variance;
+			box->axis = axis;
+		}
+	}
+}
+
+/* Splits a box in two halves of about the same number of pixels, sorting its entries with a counting sort */
+static int
+gdip_quantize_split_box (QuantizeBox *box, QuantizeEntry *entries, QuantizeEntry *sorted, const QuantizeBin *bins)
+{
+	int positions[256];
+	guint64 total = 0, half = 0;
+	int i, split;
+
+	memset (positions, 0, sizeof (positions));
+	for (i = box->start; i < box->end; i++) {
+		positions[entries[i].color[box->axis]]++;
+		total += bins[entries[i].bin].count;
+	}
+
+	for (i = 0, split = box->start; i < 256; i++) {
+		int count = positions[i];
+
+		positions[i] = split;
+		split += count;
+	}
+
+	for (i = box->start; i < box->end; i++)
+		sorted[positions[entries[i].color[box->axis]]++] = entries[i];
+	memcpy (entries + box->start, sorted + box->start, (box->end - box->start) * sizeof (QuantizeEntry));
+
+	/* both halves keep at least one entry */
+	for (split = box->start + 1; split < box->end - 1; split++) {
+		half += bins[entries[split - 1].bin].count;
+		if (half * 2 >= total)
+			break;
+	}
+
+	return split;
+}
+
+static void
+gdip_quantize_sort_palette (QuantizePalette *palette, const BYTE *red, const BYTE *green, const BYTE *blue, int count)
+{
+	int i, j;
+
+	palette->count = count;
+	for (i = 0; i < count; i++) {
+		/* insertion sort on green, the palette is small */
+		for (j = i; j > 0 && palette->green[j - 1] > green[i]; j--) {
+			palette->red[j] = palette->red[j - 1];
+			palette->green[j] = palette->green[j - 1];
+			palette->blue[j] = palette->blue[j - 1];
+			palette->index[j] = palette->index[j - 1];
+		}
+		palette->red[j] = red[i];
+		palette->green[j] = green[i];
+		palette->blue[j] = blue[i];
+		palette->index[j] = i;
+	}
+
+	for (i = 0, j = 0; i <= 256; i++) {
+		while (j < count && palette->green[j] < i)
+			j++;
+		palette->first[i] = j;
+	}
+}
+
+/* Returns the index of the palette entry closest to the color */
+static BYTE
+gdip_quantize_nearest (const QuantizePalette *palette, int r, int g, int b)
+{
+	int up = palette->first[g];
+	int down = up - 1;
+	int best = up < palette->count ? up : down;
+	int best_distance = G_MAXINT;
+
+	/* entries further away in green alone than the best one so far can't be closer */
+	while (up < palette->count || down >= 0) {
+		if (up < palette->count) {
+			int dg = palette->green[up] - g;
+
+			if (dg * dg >= best_distance) {
+				up = palette->count;
+			} else {
+				int dr = palette->red[up] - r;
+				int db = palette->blue[up] - b;
+				int distance = dr * dr + dg * dg + db * db;
+
+				if (distance < best_distance) {
+					best_distance = distance;
+					best = up;
+				}
+				up++;
+			}
+		}
+
+		if (down >= 0) {
+			int dg = palette->green[down] - g;
+
+			if (dg * dg >= best_distance) {
+				down = -1;
+			} else {
+				int dr = palette->red[down] - r;
+				int db = palette->blue[down] - b;
+				int distance = dr * dr + dg * dg + db * db;
+
+				if (distance < best_distance) {
+					best_distance = distance;
+					best = down;
+				}
+				down--;
+			}
+		}
+	}
+
+	return palette->index[best];
+}
+
+/* Moves every palette entry to the average of the bins closest to it */
+static void
+gdip_quantize_refine (BYTE *red, BYTE *green, BYTE *blue, int count, const QuantizeEntry *entries, int entry_count,
+	const QuantizeBin *bins)
+{
+	QuantizePalette palette;
+	guint64 sums[256][4];
+	int iteration, i;
+
+	for (iteration = 0; iteration < QUANTIZE_ITERATIONS; iteration++) {
+		BOOL moved = FALSE;
+
+		gdip_quantize_sort_palette (&palette, red, green, blue, count);
+		memset (sums, 0, sizeof (sums));
+
+		for (i = 0; i < entry_count; i++) {
+			const QuantizeBin *bin = &bins[entries[i].bin];
+			BYTE index = gdip_quantize_nearest (&palette, entries[i].color[0], entries[i].color[1],
+				entries[i].color[2]);
+
+			sums[index][0] += bin->red;
+			sums[index][1] += bin->green;
+			sums[index][2] += bin->blue;
+			sums[index][3] += bin->count;
+		}
+
+		for (i = 0; i < count; i++) {
+			BYTE r, g, b;
+
+			/* an entry that lost all its bins stays where it is */
+			if (!sums[i][3])
+				continue;
+
+			r = (sums[i][0] + sums[i][3] / 2) / sums[i][3];
+			g = (sums[i][1] + sums[i][3] / 2) / sums[i][3];
+			b = (sums[i][2] + sums[i][3] / 2) / sums[i][3];
+			if (r != red[i] || g != green[i] || b != blue[i])
+				moved = TRUE;
+			red[i] = r;
+			green[i] = g;
+			blue[i] = b;
+		}
+
+		if (!moved)
+			break;
+	}
+}
+
+/* Seeds the palette with median cuts of the occupied bins, returns the number of colors */
+static int
+gdip_quantize_median_cut (BYTE *red, BYTE *green, BYTE *blue, int max_colors, QuantizeEntry *entries,
+	QuantizeEntry *sorted, int entry_count, const QuantizeBin *bins)
+{
+	QuantizeBox boxes[256];
+	int count = 1;
+	int i, j;
+
+	boxes[0].start = 0;
+	boxes[0].end = entry_count;
+	gdip_quantize_score_box (&boxes[0], entries, bins);
+
+	while (count < max_colors) {
+		int largest = 0;
+		int split;
+
+		for (i = 1; i < count; i++) {
+			if (boxes[i].score > boxes[largest].score)
+				largest = i;
+		}
+		if (boxes[largest].score <= 0)
+			break;
+
+		split = gdip_quantize_split_box (&boxes[largest], entries, sorted, bins);
+		boxes[count].start = split;
+		boxes[count].end = boxes[largest].end;
+		boxes[largest].end = split;
+		gdip_quantize_score_box (&boxes[largest], entries, bins);
+		gdip_quantize_score_box (&boxes[count], entries, bins);
+		count++;
+	}
+
+	for (i = 0; i < count; i++) {
+		guint64 sum[4] = {0, 0, 0, 0};
+
+		for (j = boxes[i].start; j < boxes[i].end; j++) {
+			const QuantizeBin *bin = &bins[entries[j].bin];
+
+			sum[0] += bin->red;
+			sum[1] += bin->green;
+			sum[2] += bin->blue;
+			sum[3] += bin->count;
+		}
+
+		red[i] = (sum[0] + sum[3] / 2) / sum[3];
+		green[i] = (sum[1] + sum[3] / 2) / sum[3];
+		blue[i] = (sum[2] + sum[3] / 2) / sum[3];
+	}
+
+	return count;
+}
+
+static void
+gdip_quantize_map_band (int y_start, int y_end, void *user_data)
+{
+	QuantizeImage *image = (QuantizeImage *) user_data;
+	int x, y;
+
+	for (y = y_start; y < y_end; y++) {
+		const ARGB *row = (const ARGB *) (image->scan0 + y * image->stride);
+		BYTE *indices = image->indices + (size_t) y * image->width;
+
+		for (x = 0; x < image->width; x++)
+			indices[x] = image->lut[QUANTIZE_BIN ((row[x] >> 16) & 0xFF, (row[x] >> 8) & 0xFF, row[x] & 0xFF)];
+	}
+}
+
+static BYTE
+gdip_quantize_clamp (int value)
+{
+	return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+/* Floyd-Steinberg error diffusion, scanning every other row from right to left to avoid directional artifacts */
+static GpStatus
+gdip_quantize_dither (QuantizeImage *image, const ARGB *palette)
+{
+	int *errors;
+	int *current;
+	int *next;
+	int x, y, i;
+
+	/* one pixel of margin on each side, errors are kept multiplied by 16 */
+	errors = gdip_calloc ((image->width + 2) * 3 * 2, sizeof (int));
+	if (!errors)
+		return OutOfMemory;
+	current = errors;
+	next = errors + (image->width + 2) * 3;
+
+	for (y = 0; y < image->height; y++) {
+		const ARGB *row = (const ARGB *) (image->scan0 + y * image->stride);
+		BYTE *indices = image->indices + (size_t) y * image->width;
+		int step = (y & 1) ? -1 : 1;
+		int *swap;
+
+		memset (next, 0, (image->width + 2) * 3 * sizeof (int));
+
+		for (i = 0; i < image->width; i++) {
+			int *error, *error_next;
+			int r, g, b, dr, dg, db;
+			ARGB color;
+			BYTE index;
+
+			x = step > 0 ? i : image->width - 1 - i;
+			error = current + (x + 1) * 3;
+			error_next = next + (x + 1) * 3;
+
+			r = gdip_quantize_clamp (((row[x] >> 16) & 0xFF) + error[0] / 16);
+			g = gdip_quantize_clamp (((row[x] >> 8) & 0xFF) + error[1] / 16);
+			b = gdip_quantize_clamp ((row[x] & 0xFF) + error[2] / 16);
+
+			index = image->lut[QUANTIZE_BIN (r, g, b)];
+			indices[x] = index;
+			color = palette[index];
+			dr = r - (int) ((color >> 16) & 0xFF);
+			dg = g - (int) ((color >> 8) & 0xFF);
+			db = b - (int) (color & 0xFF);
+
+			error[step * 3] += dr * 7;
+			error[step * 3 + 1] += dg * 7;
+			error[step * 3 + 2] += db * 7;
+			error_next[-step * 3] += dr * 3;
+			error_next[-step * 3 + 1] += dg * 3;
+			error_next[-step * 3 + 2] += db * 3;
+			error_next[0] += dr * 5;
+			error_next[1] += dg * 5;
+			error_next[2] += db * 5;
+			error_next[step * 3] += dr;
+			error_next[step * 3 + 1] += dg;
+			error_next[step * 3 + 2] += db;
+		}
+
+		swap = current;
+		current = next;
+		next = swap;
+	}
+
+	GdipFree (errors);
+	return Ok;
+}
+
+/* Returns FALSE, after counting at most max_colors + 1 of them, if the image has more than @max_colors colors */
+static BOOL
+gdip_quantize_exact (const QuantizeImage *image, int max_colors, ARGB *palette, int *count)
+{
+	QuantizeExactTable *table;
+	int colors = 0;
+	int x, y;
+
+	table = gdip_calloc (1, sizeof (QuantizeExactTable));
+	if (!table)
+		return FALSE;
+
+	for (y = 0; y < image->height; y++) {
+		const ARGB *row = (const ARGB *) (image->scan0 + y * image->stride);
+		BYTE *indices = image->indices + (size_t) y * image->width;
+
+		for (x = 0; x < image->width; x++) {
+			/* opaque, so that 0 marks the empty slots */
+			ARGB color = row[x] | 0xFF000000;
+			guint32 slot;
+
+			if (x > 0 && color == (row[x - 1] | 0xFF000000)) {
+				indices[x] = indices[x - 1];
+				continue;
+			}
+
+			slot = (color * 2654435761U) >> 22;
+			while (table->color[slot] && table->color[slot] != color)
+				slot = (slot + 1) & (QUANTIZE_EXACT_SLOTS - 1);
+
+			if (!table->color[slot]) {
+				if (colors == max_colors) {
+					GdipFree (table);
+					return FALSE;
+				}
+				table->color[slot] = color;
+				table->index[slot] = colors;
+				palette[colors++] = color;
+			}
+			indices[x] = table->index[slot];
+		}
+	}
+
+	GdipFree (table);
+	*count = colors;
+	return TRUE;
+}
+
+/*
+ * Reduces 32bpp pixels (the alpha channel is ignored) to at most @max_colors (up to 256) opaque colors. The
+ * colors are stored in @palette, their number in @count and the palette index of every pixel in @indices, which
+ * holds width * height bytes without any padding.
+ */
+GpStatus
+gdip_quantize_argb (const BYTE *scan0, int stride, int width, int height, int max_colors, BOOL dither, ARGB *palette,
+	int *count, BYTE *indices)
+{
+	QuantizeImage image;
+	QuantizeEntry *entries = NULL;
+	QuantizeEntry *sorted = NULL;
+	QuantizePalette sorted_palette;
+	BYTE red[256], green[256], blue[256];
+	BYTE *lut = NULL;
+	int entry_count = 0;
+	int colors;
+	int i;
+	GpStatus status = OutOfMemory;
+
+	if (width <= 0 || height <= 0 || max_colors < 1 || max_colors > 256)
+		return InvalidParameter;
+
+	image.scan0 = scan0;
+	image.stride = stride;
+	image.width = width;
+	image.height = height;
+	image.indices = indices;
+
+	/* there is nothing to dither when every color is kept */
+	if (gdip_quantize_exact (&image, max_colors, palette, count))
+		return Ok;
+
+	image.bins = gdip_calloc (QUANTIZE_BINS, sizeof (QuantizeBin));
+	lut = GdipAlloc (QUANTIZE_BINS);
+	if (!image.bins || !lut)
+		goto error;
+
+	g_mutex_init (&image.lock);
+	gdip_process_row_bands (height, (size_t) width * sizeof (ARGB), gdip_quantize_histogram_band, &image);
+	g_mutex_clear (&image.lock);
+
+	for (i = 0; i < QUANTIZE_BINS; i++) {
+		if (image.bins[i].count)
+			entry_count++;
+	}
+
+	entries = GdipAlloc (entry_count * sizeof (QuantizeEntry));
+	sorted = GdipAlloc (entry_count * sizeof (QuantizeEntry));
+	if (!entries || !sorted)
+		goto error;
+
+	for (i = 0, entry_count = 0; i < QUANTIZE_BINS; i++) {
+		const QuantizeBin *bin = &image.bins[i];
+
+		if (!bin->count)
+			continue;
+		entries[entry_count].color[0] = (bin->red + bin->count / 2) / bin->count;
+		entries[entry_count].color[1] = (bin->green + bin->count / 2) / bin->count;
+		entries[entry_count].color[2] = (bin->blue + bin->count / 2) / bin->count;
+		entries[entry_count].bin = i;
+		entry_count++;
+	}
+
+	if (entry_count <= max_colors) {
+		/* every bin gets its own entry, the average of the colors that fell into it */
+		for (i = 0; i < entry_count; i++) {
+			red[i] = entries[i].color[0];
+			green[i] = entries[i].color[1];
+			blue[i] = entries[i].color[2];
+		}
+		colors = entry_count;
+	} else {
+		colors = gdip_quantize_median_cut (red, green, blue, max_colors, entries, sorted, entry_count, image.bins);
+		gdip_quantize_refine (red, green, blue, colors, entries, entry_count, image.bins);
+	}
+
+	for (i = 0; i < colors; i++)
+		palette[i] = 0xFF000000 | (red[i] << 16) | (green[i] << 8) | blue[i];
+
+	/* the occupied bins map their average color, dithering can also reach the others which map their center */
+	gdip_quantize_sort_palette (&sorted_palette, red, green, blue, colors);
+	if (dither) {
+		for (i = 0; i < QUANTIZE_BINS; i++)
+			lut[i] = gdip_quantize_nearest (&sorted_palette, ((i >> 11) << 3) | 4, (((i >> 5) & 0x3F) << 2) | 2,
+				((i & 0x1F) << 3) | 4);
+	}
+	for (i = 0; i < entry_count; i++)
+		lut[entries[i].bin] = gdip_quantize_nearest (&sorted_palette, entries[i].color[0], entries[i].color[1],
+			entries[i].color[2]);
+
+	image.lut = lut;
+	if (dither) {
+		status = gdip_quantize_dither (&image, palette);
+		if (status != Ok)
+			goto error;
+	} else {
+		gdip_process_row_bands (height, (size_t) width * sizeof (ARGB), gdip_quantize_map_band, &image);
+	}
+
+	*count = colors;
+	status = Ok;
+
+error:
+	GdipFree (image.bins);
+	GdipFree (lut);
+	GdipFree (entries);
+	GdipFree (sorted);
+	return status;
+}
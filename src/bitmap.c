@@ -36,6 +36,7 @@
 
 
 static GpStatus gdip_bitmap_clone_data_rect (ActiveBitmapData *srcData, Rect *srcRect, ActiveBitmapData *destData, Rect *destRect);
+static void gdip_graphics_count_unref (BitmapGraphicsCount *count);
 
 
 /* The default indexed palettes. This code was generated by a tiny C# program.
@@ -83,6 +84,12 @@ gdip_is_a_supported_pixelformat (PixelFormat fmt)
 	case PixelFormat32bppARGB:
 	case PixelFormat32bppPARGB:
 	case PixelFormat32bppRGB:
+	case PixelFormat16bppRGB555:
+	case PixelFormat16bppRGB565:
+	case PixelFormat16bppARGB1555:
+	case PixelFormat48bppRGB:
+	case PixelFormat64bppARGB:
+	case PixelFormat64bppPARGB:
 		return TRUE;
 	default:
 		return FALSE;
@@ -635,6 +642,10 @@ gdip_bitmap_clone (GpBitmap *bitmap, GpBitmap **clonedbitmap)
 	int		frame;
 	GpStatus	status;
 
+	status = gdip_bitmap_ensure_pixels (bitmap);
+	if (status != Ok)
+		return status;
+
 	result = (GpBitmap *) GdipAlloc (sizeof (GpBitmap));
 	if (result == NULL) {
 		return OutOfMemory;
@@ -651,6 +662,21 @@ gdip_bitmap_clone (GpBitmap *bitmap, GpBitmap **clonedbitmap)
 	result->active_bitmap = NULL;
 	result->cairo_format = bitmap->cairo_format;
 	result->surface = NULL;
+	result->generation = 0;
+	result->indexed_rgb = NULL;
+	result->indexed_rgb_data = NULL;
+	result->indexed_rgb_palette = NULL;
+	result->indexed_rgb_generation = 0;
+	result->tile_surface = NULL;
+	result->tile_wrap_mode = WrapModeTile;
+	result->tile_generation = 0;
+	result->tile_graphics_released = 0;
+	result->graphics_count = NULL;
+	result->deferred_load = NULL;
+	result->deferred_load_region = NULL;
+	result->deferred_free = NULL;
+	result->deferred_source = NULL;
+	result->deferred_data = NULL;
 
 	/* Allocate and copy frames, properties and bitmap data */
 	if (bitmap->frames != NULL) {
@@ -722,6 +748,83 @@ gdip_bitmap_new_with_frame (const GUID *dimension, BOOL add_bitmapdata)
 	return result;
 }
 
+/*
+ * Codecs can load a bitmap with everything but its pixels, scan0 is then decoded from @source by @load the first
+ * time it is needed. @free releases @source once it isn't needed anymore. Codecs that can decode a part of the image
+ * on its own also provide @load_region, which is then used by read only locks, see gdip_bitmap_load_deferred_region.
+ */
+void
+gdip_bitmap_set_deferred_source (GpBitmap *bitmap, GpDeferredLoadFunc load, GpDeferredLoadRegionFunc load_region, GpDeferredFreeFunc free, void *source)
+{
+	bitmap->deferred_load = load;
+	bitmap->deferred_load_region = load_region;
+	bitmap->deferred_free = free;
+	bitmap->deferred_source = source;
+	bitmap->deferred_data = bitmap->active_bitmap;
+}
+
+static void
+gdip_bitmap_release_deferred_source (GpBitmap *bitmap)
+{
+	if (bitmap->deferred_free)
+		bitmap->deferred_free (bitmap->deferred_source);
+
+	bitmap->deferred_load = NULL;
+	bitmap->deferred_load_region = NULL;
+	bitmap->deferred_free = NULL;
+	bitmap->deferred_source = NULL;
+	bitmap->deferred_data = NULL;
+}
+
+/* Decode the pixels of a bitmap loaded without them, must be called before scan0 is used. */
+GpStatus
+gdip_bitmap_ensure_pixels (GpBitmap *bitmap)
+{
+	GpBitmap *decoded;
+	ActiveBitmapData *data;
+	GpStatus status;
+
+	if (!bitmap->deferred_load)
+		return Ok;
+
+	status = bitmap->deferred_load (bitmap->deferred_source, 0, 0, &decoded);
+	if (status != Ok)
+		return status;
+
+	/* the source is kept open, it can only differ if it was modified in place */
+	data = bitmap->deferred_data;
+	if (decoded->active_bitmap->width != data->width || decoded->active_bitmap->height != data->height ||
+		decoded->active_bitmap->pixel_format != data->pixel_format) {
+		gdip_bitmap_dispose (decoded);
+		return OutOfMemory;
+	}
+
+	data->scan0 = decoded->active_bitmap->scan0;
+	data->stride = decoded->active_bitmap->stride;
+	data->reserved |= GBD_OWN_SCAN0;
+
+	decoded->active_bitmap->scan0 = NULL;
+	decoded->active_bitmap->reserved &= ~GBD_OWN_SCAN0;
+	gdip_bitmap_dispose (decoded);
+
+	gdip_bitmap_release_deferred_source (bitmap);
+	return Ok;
+}
+
+/*
+ * Decode a new, smaller, copy of a bitmap whose pixels haven't been decoded yet, e.g. for thumbnails. Codecs that can
+ * scale while decoding return at least @minWidth x @minHeight pixels, others the full size.
+ */
+GpStatus
+gdip_bitmap_load_deferred_scaled (GpBitmap *bitmap, UINT minWidth, UINT minHeight, GpBitmap **scaled)
+{
+	/* the palette may have been changed since loading */
+	if (!bitmap->deferred_load || bitmap->generation != 0)
+		return NotImplemented;
+
+	return bitmap->deferred_load (bitmap->deferred_source, minWidth, minHeight, scaled);
+}
+
 GpStatus
 gdip_bitmap_dispose (GpBitmap *bitmap)
 {
@@ -730,6 +833,12 @@ gdip_bitmap_dispose (GpBitmap *bitmap)
 		return Ok;
 
 	gdip_bitmap_invalidate_surface (bitmap);
+	gdip_bitmap_release_deferred_source (bitmap);
+
+	if (bitmap->graphics_count) {
+		gdip_graphics_count_unref (bitmap->graphics_count);
+		bitmap->graphics_count = NULL;
+	}
 
 	if (bitmap->frames) {
 		int frame;
@@ -830,8 +939,15 @@ GdipCreateBitmapFromScan0 (INT width, INT height, INT stride, PixelFormat format
 
 		case PixelFormat16bppRGB555:
 		case PixelFormat16bppRGB565:
-			/* fake them as 32bpp RGB as Cairo deprecated CAIRO_FORMAT_RGB16_565 support */
-			/* why 32bpp ? because that's the result of MS GDI+ when loading them, even if the bitmap is empty */
+		case PixelFormat48bppRGB:
+			/* stored as is, cairo draws from a 32bpp copy (see gdip_bitmap_ensure_surface) */
+			cairo_format = CAIRO_FORMAT_ARGB32;
+			break;
+
+		case PixelFormat16bppARGB1555:
+		case PixelFormat64bppARGB:
+		case PixelFormat64bppPARGB:
+			flags = ImageFlagsHasAlpha;
 			cairo_format = CAIRO_FORMAT_ARGB32;
 			break;
 
@@ -847,10 +963,6 @@ GdipCreateBitmapFromScan0 (INT width, INT height, INT stride, PixelFormat format
 			break;
 			
 		case PixelFormat16bppGrayScale:
-		case PixelFormat16bppARGB1555:
-		case PixelFormat48bppRGB:
-		case PixelFormat64bppARGB:
-		case PixelFormat64bppPARGB:
 		case PixelFormat32bppCMYK:
 			*bitmap = NULL;
 			return NotImplemented;
@@ -896,7 +1008,7 @@ GdipCreateBitmapFromScan0 (INT width, INT height, INT stride, PixelFormat format
 		if (gdip_is_an_indexed_pixelformat(format)) {
 			stride = ((gdip_get_pixel_format_depth(format) * width) + 7) / 8;
 		} else {
-			stride = (gdip_get_pixel_format_components (format) * gdip_get_pixel_format_depth (format) * width) / 8;
+			stride = (gdip_get_pixel_format_bpp (format) * width) / 8;
 		}
 
 		/* make sure the stride aligns the next row to a 32 bits boundary */
@@ -916,7 +1028,7 @@ GdipCreateBitmapFromScan0 (INT width, INT height, INT stride, PixelFormat format
 			return OutOfMemory;
 		}
 
-		if ((gdip_get_pixel_format_bpp(format) < 32) || gdip_is_an_alpha_pixelformat(format)) {
+		if ((format != PixelFormat24bppRGB && format != PixelFormat32bppRGB) || gdip_is_an_alpha_pixelformat(format)) {
 			memset (scan0, 0, size);
 		} else {
 			/* Since the pixel format is not an alpha pixel format (i.e., it is
@@ -1129,6 +1241,10 @@ GdipCloneBitmapAreaI (INT x, INT y, INT width, INT height, PixelFormat format,
 
 	result->image_format = original->image_format;
 
+	status = gdip_bitmap_ensure_pixels (original);
+	if (status != Ok)
+		goto fail;
+
 	gdip_bitmap_flush_surface (original);
 
 	status = gdip_bitmap_clone_data_rect (original->active_bitmap, &sr, result->active_bitmap, &dr);
@@ -1179,9 +1295,6 @@ gdip_copy_strides (BYTE *dst, int dstStride, BYTE *src, int srcStride, int realB
 static GpStatus
 gdip_bitmap_clone_data_rect (ActiveBitmapData *srcData, Rect *srcRect, ActiveBitmapData *destData, Rect *destRect)
 {
-	int dest_components;
-	int dest_depth; 
-
 	if ((srcData == NULL) || (srcRect == NULL) || (destData == NULL) || (destRect == NULL) || (srcRect->Width != destRect->Width) || (srcRect->Height != destRect->Height)) {
 		return InvalidParameter;
 	}
@@ -1190,14 +1303,10 @@ gdip_bitmap_clone_data_rect (ActiveBitmapData *srcData, Rect *srcRect, ActiveBit
 		return NotImplemented;
 	}
 
-	dest_components = gdip_get_pixel_format_components (destData->pixel_format);
-	
 	if (destData->scan0 == NULL) {
-		dest_components = gdip_get_pixel_format_components (srcData->pixel_format);
-		dest_depth = gdip_get_pixel_format_depth (srcData->pixel_format);
 		destData->pixel_format = srcData->pixel_format;
 
-		destData->stride = ((destRect->Width * dest_components * dest_depth) >> 3);
+		destData->stride = ((destRect->Width * gdip_get_pixel_format_bpp (srcData->pixel_format)) >> 3);
 		gdip_align_stride (destData->stride);
 
 		unsigned long long int size = (unsigned long long int)destData->stride * destRect->Height;
@@ -1226,9 +1335,11 @@ gdip_bitmap_clone_data_rect (ActiveBitmapData *srcData, Rect *srcRect, ActiveBit
 
 
 	if (!gdip_is_an_indexed_pixelformat (srcData->pixel_format)) {
+		int bytes_per_pixel = gdip_get_pixel_format_bpp (srcData->pixel_format) / 8;
+
 		gdip_copy_strides (destData->scan0, destData->stride,
-			srcData->scan0 + (srcData->stride * srcRect->Y) + (gdip_get_pixel_format_components (srcData->pixel_format) 
-			* srcRect->X), srcData->stride,   destRect->Width * dest_components,  destRect->Height);
+			srcData->scan0 + (srcData->stride * srcRect->Y) + (bytes_per_pixel * srcRect->X),
+			srcData->stride, destRect->Width * bytes_per_pixel, destRect->Height);
 	} else {
 		int src_depth;
 		int src_first_x_bit_index;
@@ -1309,6 +1420,9 @@ gdip_bitmap_clone_data_rect (ActiveBitmapData *srcData, Rect *srcRect, ActiveBit
  * 32bpp argb - 24bpp rgb 888
  * 32bpp argb - 32bpp Pargb
  * 32bpp argb - 32bpp rgb
+ * 32bpp argb - 48bpp rgb
+ * 32bpp argb - 64bpp argb
+ * 32bpp argb - 64bpp Pargb
  *
  * Upconversion is allowed (e.g 8bpp indexed to 32bpp rgb), but no downconversion (32bpp to 8bpp indexed)
  *
@@ -1321,28 +1435,13 @@ gdip_is_pixel_format_conversion_valid (PixelFormat src, PixelFormat dest)
 		return 1;
 	}
 
-	/* non-GDI supported formats can't be converted */
-	if (!(src & PixelFormatGDI)) {
-		return 0;
-	}
-
 	/* We don't allow converting *to* indexed formats */
 	if (dest & PixelFormatIndexed) {
 		return 0;
 	}
 
-	/* These are the RGB formats */
-	if ((src & PixelFormatGDI) && !(src & PixelFormatExtended)) {
-		/* all of these should be supported, but we only report the
-		 * ones we really can do for now */
-		/* We can't handle converting to/from the 565/555/1555 ones */
-		if ((src & 0xff00) == PixelFormatMax || (dest & 0xff00) == PixelFormatMax) {
-			return 0;
-		}
-		return 1;
-	}
-
-	return 0;
+	/* Everything we can store can be converted to any of the RGB[A] formats, including the 16 bits per channel ones */
+	return gdip_is_a_supported_pixelformat (src) && gdip_is_a_supported_pixelformat (dest);
 }
 
 GpStatus
@@ -1762,6 +1861,29 @@ gdip_pixel_stream_copy_optimized (StreamingState *dst_state, StreamingState *src
 	return TRUE;
 }
 
+typedef struct {
+	const GdipRowConverter	*converter;
+	BYTE			*src;
+	int			src_stride;
+	int			src_x;
+	BYTE			*dest;
+	int			dest_stride;
+	int			dest_x;
+	int			width;
+} ConvertRowsArgs;
+
+static void
+gdip_convert_rows (int y_start, int y_end, void *user_data)
+{
+	ConvertRowsArgs *args = (ConvertRowsArgs *) user_data;
+	int y;
+
+	for (y = y_start; y < y_end; y++) {
+		args->converter->convert (args->converter, args->src + y * args->src_stride, args->src_x,
+			args->dest + y * args->dest_stride, args->dest_x, args->width);
+	}
+}
+
 /**
  * srcData - input data
  * srcRect - rectangle of input data to place in destData
@@ -1774,13 +1896,14 @@ gdip_pixel_stream_copy_optimized (StreamingState *dst_state, StreamingState *src
  *	- rectangles are valid
  *	- the pixel format conversion has already been validated.
  */
-static GpStatus
+GpStatus
 gdip_bitmap_change_rect_pixel_format (ActiveBitmapData *srcData, const Rect *srcRect, ActiveBitmapData *destData, Rect *destRect)
 {
 	PixelFormat	srcFormat;
 	PixelFormat	destFormat;
 	StreamingState	srcStream;
 	StreamingState	destStream;
+	GdipRowConverter	converter;
 	Rect		effectiveDestRect;
 	GpStatus	status;
 
@@ -1820,6 +1943,22 @@ gdip_bitmap_change_rect_pixel_format (ActiveBitmapData *srcData, const Rect *src
 		return status;
 	}
 
+	/* Convert whole rows at once if there is a converter for these formats */
+	if (gdip_row_converter_init (&converter, srcData, destData)) {
+		ConvertRowsArgs args;
+
+		args.converter = &converter;
+		args.src = (BYTE *) srcData->scan0 + srcRect->Y * srcData->stride;
+		args.src_stride = srcData->stride;
+		args.src_x = srcRect->X;
+		args.dest = (BYTE *) destData->scan0 + effectiveDestRect.Y * destData->stride;
+		args.dest_stride = destData->stride;
+		args.dest_x = effectiveDestRect.X;
+		args.width = effectiveDestRect.Width;
+		gdip_process_row_bands (effectiveDestRect.Height, (size_t) effectiveDestRect.Width * 4, gdip_convert_rows, &args);
+		return Ok;
+	}
+
 	/* Move the data; special path going from indexed to not-indexed */
 	if ((srcFormat & PixelFormatIndexed) && !(destFormat & PixelFormatIndexed)) {
 		int	pixel;
@@ -1845,6 +1984,48 @@ gdip_bitmap_change_rect_pixel_format (ActiveBitmapData *srcData, const Rect *src
 	return Ok;
 }
 
+/*
+ * Decode @rect of a bitmap whose pixels haven't been decoded yet, without decoding the rest of it, and convert it to
+ * the format of @dest at its origin. The cost is proportional to the size of @rect rather than to the size of the
+ * image, e.g. for tiles taken out of huge scans. scan0 itself is left undecoded.
+ */
+GpStatus
+gdip_bitmap_load_deferred_region (GpBitmap *bitmap, const GpRect *rect, ActiveBitmapData *dest)
+{
+	ActiveBitmapData region;
+	Rect region_rect = {0, 0, rect->Width, rect->Height};
+	unsigned long long int size;
+	int bpp;
+	GpStatus status;
+
+	if (!bitmap->deferred_load_region || bitmap->active_bitmap != bitmap->deferred_data)
+		return NotImplemented;
+
+	/* same format and palette as scan0 would have, 24bppRGB being stored in 32 bits */
+	region = *bitmap->deferred_data;
+	bpp = region.pixel_format == PixelFormat24bppRGB ? 32 : gdip_get_pixel_format_bpp (region.pixel_format);
+	region.width = rect->Width;
+	region.height = rect->Height;
+	region.stride = (rect->Width * bpp + 7) >> 3;
+	gdip_align_stride (region.stride);
+	region.reserved = 0;
+
+	size = (unsigned long long int) region.stride * rect->Height;
+	if (size > G_MAXINT32)
+		return OutOfMemory;
+
+	region.scan0 = GdipAlloc (size);
+	if (!region.scan0)
+		return OutOfMemory;
+
+	status = bitmap->deferred_load_region (bitmap->deferred_source, rect, region.scan0, region.stride);
+	if (status == Ok)
+		status = gdip_bitmap_change_rect_pixel_format (&region, &region_rect, dest, &region_rect);
+
+	GdipFree (region.scan0);
+	return status;
+}
+
 GpStatus WINGDIPAPI
 GdipBitmapLockBits (GpBitmap *bitmap, GDIPCONST GpRect *rect, UINT flags, PixelFormat format, BitmapData *lockedBitmapData)
 {
@@ -1852,6 +2033,7 @@ GdipBitmapLockBits (GpBitmap *bitmap, GDIPCONST GpRect *rect, UINT flags, PixelF
 	ActiveBitmapData	*src_data;
 	ActiveBitmapData	*dest_data;
 	GpStatus	status;
+	BOOL		region_only;
 
 	if (!bitmap || !lockedBitmapData)
 		return InvalidParameter;
@@ -1888,6 +2070,18 @@ GdipBitmapLockBits (GpBitmap *bitmap, GDIPCONST GpRect *rect, UINT flags, PixelF
 	if (!gdip_is_a_supported_pixelformat (format))
 		return InvalidParameter;
 
+	/* Reading a part of a bitmap whose pixels haven't been decoded yet only decodes that part, into the locked buffer */
+	region_only = (flags & ImageLockModeWrite) == 0 && (flags & ImageLockModeRead) != 0 &&
+		bitmap->deferred_load_region && src_data == bitmap->deferred_data &&
+		(src_rect.Width < src_data->width || src_rect.Height < src_data->height);
+
+	/* Decode the pixels before anything is locked or allocated, so a failure leaves the bitmap as it was */
+	if (!region_only) {
+		status = gdip_bitmap_ensure_pixels (bitmap);
+		if (status != Ok)
+			return status;
+	}
+
 	/* Common stuff */
 	if ((flags & ImageLockModeWrite) != 0) {
 		dest_data->reserved |= GBD_WRITE_OK;
@@ -1910,7 +2104,7 @@ GdipBitmapLockBits (GpBitmap *bitmap, GDIPCONST GpRect *rect, UINT flags, PixelF
 	dest_data->pixel_format = format;
 	dest_data->palette = NULL;
 
-	if (format != PixelFormat24bppRGB && format == src_data->pixel_format && (flags & ImageLockModeUserInputBuf) == 0) {
+	if (format != PixelFormat24bppRGB && format == src_data->pixel_format && (flags & ImageLockModeUserInputBuf) == 0 && !region_only) {
 		// No conversion needed, just read the bits directly.
 		dest_data->reserved &= ~GBD_OWN_SCAN0;
 		dest_data->stride = src_data->stride;
@@ -1952,7 +2146,25 @@ GdipBitmapLockBits (GpBitmap *bitmap, GDIPCONST GpRect *rect, UINT flags, PixelF
 		}
 	}
 
+	if (region_only) {
+		status = gdip_bitmap_load_deferred_region (bitmap, &src_rect, dest_data);
+		if (status != Ok) {
+			if ((dest_data->reserved & GBD_OWN_SCAN0) != 0) {
+				GdipFree (dest_data->scan0);
+				dest_data->scan0 = NULL;
+				dest_data->reserved &= ~GBD_OWN_SCAN0;
+			}
+
+			src_data->reserved &= ~GBD_LOCKED;
+			dest_data->reserved &= ~GBD_LOCKED;
+		}
+
+		return status;
+	}
+
 	gdip_bitmap_flush_surface (bitmap);
+	if ((flags & ImageLockModeWrite) != 0)
+		bitmap->generation++;
 
 	/* If the user wants the original data to be readable, then convert the bits. */
 	if ((flags & ImageLockModeRead) != 0) {
@@ -2003,6 +2215,7 @@ GdipBitmapUnlockBits (GpBitmap *bitmap, BitmapData *lockedBitmapData)
 		Rect dest_rect = { src_data->x, src_data->y, src_data->width, src_data->height };
 
 		status = gdip_bitmap_change_rect_pixel_format (src_data, &src_rect, dest_data, &dest_rect);
+		bitmap->generation++;
 	} else {
 		status = Ok;
 	}
@@ -2018,10 +2231,12 @@ GdipBitmapUnlockBits (GpBitmap *bitmap, BitmapData *lockedBitmapData)
 		src_data->palette = NULL;
 	}
 
-	if (bitmap->surface != NULL) {
+	/* only the locked rectangle can have changed, the rest of the premultiplied surface is still valid */
+	if (bitmap->surface != NULL && (src_data->reserved & GBD_WRITE_OK) != 0) {
 		BYTE *surface_scan0 = cairo_image_surface_get_data (bitmap->surface);
 		if (surface_scan0 != bitmap->active_bitmap->scan0) {
-			gdip_bitmap_get_premultiplied_scan0_inplace (bitmap, surface_scan0);
+			Rect dest_rect = { src_data->x, src_data->y, src_data->width, src_data->height };
+			gdip_bitmap_get_premultiplied_scan0_inplace (bitmap, surface_scan0, &dest_rect);
 		}
 	}
 
@@ -2031,12 +2246,29 @@ GdipBitmapUnlockBits (GpBitmap *bitmap, BitmapData *lockedBitmapData)
 	return status;
 }
 
+/* Convert a single pixel of the formats stored without a palette. */
+static void
+gdip_convert_pixel (PixelFormat src_format, const BYTE *src, int src_x, PixelFormat dest_format, BYTE *dest, int dest_x)
+{
+	ActiveBitmapData src_data, dest_data;
+	GdipRowConverter converter;
+
+	memset (&src_data, 0, sizeof (ActiveBitmapData));
+	memset (&dest_data, 0, sizeof (ActiveBitmapData));
+	src_data.pixel_format = src_format;
+	dest_data.pixel_format = dest_format;
+
+	if (gdip_row_converter_init (&converter, &src_data, &dest_data))
+		converter.convert (&converter, src, src_x, dest, dest_x, 1);
+}
+
 GpStatus WINGDIPAPI
 GdipBitmapSetPixel (GpBitmap *bitmap, INT x, INT y, ARGB color)
 {
 	BYTE *v;
 	ActiveBitmapData *data;
 	PixelFormat pixel_format;
+	GpStatus status;
 	
 	if (!bitmap || !bitmap->active_bitmap)
 		return InvalidParameter;
@@ -2050,8 +2282,12 @@ GdipBitmapSetPixel (GpBitmap *bitmap, INT x, INT y, ARGB color)
 	if (x < 0 || x >= data->width || y < 0 || y >= data->height)
 		return InvalidParameter;
 
+	status = gdip_bitmap_ensure_pixels (bitmap);
+	if (status != Ok)
+		return status;
+
 	if (bitmap->surface != NULL && gdip_bitmap_format_needs_premultiplication(bitmap)) {
-		v = (BYTE*)(cairo_image_surface_get_data (bitmap->surface)) + y * data->stride;
+		v = (BYTE*)(cairo_image_surface_get_data (bitmap->surface)) + y * cairo_image_surface_get_stride (bitmap->surface);
 		pixel_format = PixelFormat32bppPARGB;
 	} else {
 		v = (BYTE*)(data->scan0) + y * data->stride;
@@ -2082,12 +2318,24 @@ GdipBitmapSetPixel (GpBitmap *bitmap, INT x, INT y, ARGB color)
 		}
 		break;
 	}
+	case PixelFormat16bppRGB555:
+	case PixelFormat16bppRGB565:
+	case PixelFormat16bppARGB1555:
+	case PixelFormat48bppRGB:
+	case PixelFormat64bppARGB:
+	case PixelFormat64bppPARGB:
+		gdip_convert_pixel (PixelFormat32bppARGB, (BYTE *) &color, 0, pixel_format, v, x);
+		break;
 	case PixelFormat16bppGrayScale:
 		return InvalidParameter;
 	default:
 		return NotImplemented;
 	} 
 
+	if (pixel_format != data->pixel_format)
+		gdip_bitmap_surface_mark_dirty (bitmap, x, y, 1, 1);
+
+	bitmap->generation++;
 	return Ok;		
 }
 
@@ -2095,10 +2343,15 @@ GpStatus WINGDIPAPI
 GdipBitmapGetPixel (GpBitmap *bitmap, INT x, INT y, ARGB *color)
 {
 	ActiveBitmapData	*data;
+	GpStatus		status;
 
 	if (!bitmap || !bitmap->active_bitmap || !color)
 		return InvalidParameter;
 
+	status = gdip_bitmap_ensure_pixels (bitmap);
+	if (status != Ok)
+		return status;
+
 	data = bitmap->active_bitmap;
 
 	if (gdip_is_an_indexed_pixelformat (data->pixel_format)) {
@@ -2133,7 +2386,7 @@ GdipBitmapGetPixel (GpBitmap *bitmap, INT x, INT y, ARGB *color)
 		PixelFormat pixel_format;
 
 		if (bitmap->surface != NULL && gdip_bitmap_format_needs_premultiplication(bitmap)) {
-			v = (BYTE*)(cairo_image_surface_get_data (bitmap->surface)) + y * data->stride;
+			v = (BYTE*)(cairo_image_surface_get_data (bitmap->surface)) + y * cairo_image_surface_get_stride (bitmap->surface);
 			pixel_format = PixelFormat32bppPARGB;
 		} else {
 			v = (BYTE*)(data->scan0) + y * data->stride;
@@ -2168,13 +2421,18 @@ GdipBitmapGetPixel (GpBitmap *bitmap, INT x, INT y, ARGB *color)
 			*color = scan[x] | 0xFF000000;
 			break;
 		}
-		case PixelFormat16bppARGB1555:
 		case PixelFormat16bppRGB555:
 			*color = gdip_getpixel_16bppRGB555 (v, x);
 			break;
 		case PixelFormat16bppRGB565:
 			*color = gdip_getpixel_16bppRGB565 (v, x);
 			break;
+		case PixelFormat16bppARGB1555:
+		case PixelFormat48bppRGB:
+		case PixelFormat64bppARGB:
+		case PixelFormat64bppPARGB:
+			gdip_convert_pixel (pixel_format, v, x, PixelFormat32bppARGB, (BYTE *) color, 0);
+			break;
 		default:
 			return NotImplemented;
 		}
@@ -2197,12 +2455,120 @@ GdipBitmapSetResolution (GpBitmap *bitmap, REAL xdpi, REAL ydpi)
 	return Ok;
 }
 
+/*
+ * PixelFormat32bppARGB bitmaps are drawn through a premultiplied copy of scan0. Both buffers are
+ * kept alive together and only the areas modified on one side are converted to the other: LockBits
+ * premultiplies the rectangle that was written when unlocking and flushing only reverses what was
+ * changed in the surface (SetPixel, or anything a graphics context may have drawn).
+ */
+typedef struct {
+	gint	ref_count;
+	gint	graphics;	/* number of graphics contexts that can draw on the surface */
+	Rect	dirty;		/* area of the surface modified since scan0 was last updated */
+	int	width;
+	int	height;
+	BYTE	*premul;	/* surface data, released with the state */
+} BitmapSurfaceState;
+
+static cairo_user_data_key_t surface_state_key;
+static cairo_user_data_key_t graphics_state_key;
+static cairo_user_data_key_t graphics_count_key;
+
+static void
+gdip_surface_state_unref (void *data)
+{
+	BitmapSurfaceState *state = (BitmapSurfaceState *) data;
+
+	if (g_atomic_int_dec_and_test (&state->ref_count)) {
+		GdipFree (state->premul);
+		GdipFree (state);
+	}
+}
+
+static BitmapSurfaceState *
+gdip_bitmap_get_surface_state (GpBitmap *bitmap)
+{
+	if (!bitmap->surface)
+		return NULL;
+
+	return (BitmapSurfaceState *) cairo_surface_get_user_data (bitmap->surface, &surface_state_key);
+}
+
+static void
+gdip_surface_state_mark_dirty (BitmapSurfaceState *state, int x, int y, int width, int height)
+{
+	Rect *dirty = &state->dirty;
+
+	if (dirty->Width <= 0 || dirty->Height <= 0) {
+		dirty->X = x;
+		dirty->Y = y;
+		dirty->Width = width;
+		dirty->Height = height;
+	} else {
+		int right = max (dirty->X + dirty->Width, x + width);
+		int bottom = max (dirty->Y + dirty->Height, y + height);
+
+		dirty->X = min (dirty->X, x);
+		dirty->Y = min (dirty->Y, y);
+		dirty->Width = right - dirty->X;
+		dirty->Height = bottom - dirty->Y;
+	}
+}
+
+static void
+gdip_surface_state_release_graphics (void *data)
+{
+	BitmapSurfaceState *state = (BitmapSurfaceState *) data;
+
+	/* anything could have been drawn */
+	gdip_surface_state_mark_dirty (state, 0, 0, state->width, state->height);
+	g_atomic_int_add (&state->graphics, -1);
+	gdip_surface_state_unref (state);
+}
+
+/*
+ * Counts the graphics contexts created on a bitmap, for every pixel format: the tiles cached from the bitmap
+ * must not be reused while one of them can draw, or after one was deleted.
+ */
+struct _BitmapGraphicsCount {
+	gint	ref_count;
+	gint	graphics;	/* graphics contexts that can still draw on the bitmap */
+	gint	released;	/* graphics contexts deleted so far */
+};
+
+static void
+gdip_graphics_count_unref (BitmapGraphicsCount *count)
+{
+	if (g_atomic_int_dec_and_test (&count->ref_count))
+		GdipFree (count);
+}
+
+static void
+gdip_graphics_count_release (void *data)
+{
+	BitmapGraphicsCount *count = (BitmapGraphicsCount *) data;
+
+	g_atomic_int_inc (&count->released);
+	g_atomic_int_add (&count->graphics, -1);
+	gdip_graphics_count_unref (count);
+}
+
+/* 32bpp ARGB data is premultiplied with the same layout, other formats get a packed 32bpp copy */
+static int
+gdip_bitmap_premultiplied_stride (ActiveBitmapData *data)
+{
+	return (data->pixel_format == PixelFormat32bppARGB) ? data->stride : data->width * 4;
+}
+
 cairo_surface_t *
 gdip_bitmap_ensure_surface (GpBitmap *bitmap)
 {
 	cairo_format_t format;
 	ActiveBitmapData *data = bitmap->active_bitmap;
 
+	if (!bitmap->surface && gdip_bitmap_ensure_pixels (bitmap) != Ok)
+		return NULL;
+
 	if (bitmap->surface || !data || !data->scan0)
 		return bitmap->surface;
 
@@ -2217,17 +2583,43 @@ gdip_bitmap_ensure_surface (GpBitmap *bitmap)
 		format = CAIRO_FORMAT_ARGB32;
 		break;
 
+	case PixelFormat16bppRGB555:	/* converted to premultiplied 32bpp */
+	case PixelFormat16bppRGB565:
+	case PixelFormat16bppARGB1555:
+	case PixelFormat48bppRGB:
+	case PixelFormat64bppARGB:
+	case PixelFormat64bppPARGB:
+		format = CAIRO_FORMAT_ARGB32;
+		break;
+
 	default:
 		g_warning ("gdip_bitmap_ensure_surface: Unable to create a surface for raw bitmap data of format 0x%08x", data->pixel_format);
 		return NULL;
 	}
 
 	if (gdip_bitmap_format_needs_premultiplication (bitmap)) {
-		BYTE *premul = gdip_bitmap_get_premultiplied_scan0 (bitmap);
-		if (!premul)
+		BitmapSurfaceState *state = (BitmapSurfaceState *) gdip_calloc (1, sizeof (BitmapSurfaceState));
+		if (!state)
 			return NULL;
-		bitmap->surface = cairo_image_surface_create_for_data (premul, CAIRO_FORMAT_ARGB32,
-			data->width, data->height, data->stride);
+
+		state->premul = gdip_bitmap_get_premultiplied_scan0 (bitmap);
+		if (!state->premul) {
+			GdipFree (state);
+			return NULL;
+		}
+
+		state->ref_count = 1;
+		state->width = data->width;
+		state->height = data->height;
+
+		bitmap->surface = cairo_image_surface_create_for_data (state->premul, CAIRO_FORMAT_ARGB32,
+			data->width, data->height, gdip_bitmap_premultiplied_stride (data));
+		if (cairo_surface_set_user_data (bitmap->surface, &surface_state_key, state, gdip_surface_state_unref) != CAIRO_STATUS_SUCCESS) {
+			cairo_surface_destroy (bitmap->surface);
+			bitmap->surface = NULL;
+			gdip_surface_state_unref (state);
+			return NULL;
+		}
 	} else {
 		bitmap->surface = cairo_image_surface_create_for_data ((BYTE*)data->scan0, format, 
 			data->width, data->height, data->stride);
@@ -2236,13 +2628,161 @@ gdip_bitmap_ensure_surface (GpBitmap *bitmap)
 	return bitmap->surface;
 }
 
+/* Create a tile made of @surface and, for the flipping wrap modes, its mirror images on the right and/or below. */
+static cairo_surface_t *
+gdip_create_tile_surface (cairo_surface_t *surface, int width, int height, BOOL flipX, BOOL flipY)
+{
+	cairo_surface_t *tile;
+	cairo_t *ct;
+	int i;
+
+	tile = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, flipX ? width * 2 : width, flipY ? height * 2 : height);
+	if (cairo_surface_status (tile) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy (tile);
+		return NULL;
+	}
+
+	ct = cairo_create (tile);
+	cairo_set_operator (ct, CAIRO_OPERATOR_SOURCE);
+
+	for (i = 0; i < 4; i++) {
+		BOOL mirrorX = (i & 1) != 0;
+		BOOL mirrorY = (i & 2) != 0;
+
+		if ((mirrorX && !flipX) || (mirrorY && !flipY))
+			continue;
+
+		cairo_save (ct);
+		cairo_translate (ct, mirrorX ? width * 2 : 0, mirrorY ? height * 2 : 0);
+		cairo_scale (ct, mirrorX ? -1 : 1, mirrorY ? -1 : 1);
+		cairo_set_source_surface (ct, surface, 0, 0);
+		cairo_rectangle (ct, 0, 0, width, height);
+		cairo_fill (ct);
+		cairo_restore (ct);
+	}
+
+	cairo_destroy (ct);
+	return tile;
+}
+
+/*
+ * Returns a reference to the surface that, repeated, tiles the bitmap with @wrapMode: the bitmap surface itself
+ * for WrapModeTile, or a copy with the mirrored images for the flipping modes. The copy is cached on the bitmap
+ * until its pixels change, and is not kept while a Graphics can draw on the bitmap.
+ */
+cairo_surface_t *
+gdip_bitmap_get_tile_surface (GpBitmap *bitmap, WrapMode wrapMode)
+{
+	cairo_surface_t *surface;
+	cairo_surface_t *tile;
+	BitmapGraphicsCount *count = bitmap->graphics_count;
+	BOOL drawing = FALSE;
+	unsigned int released = 0;
+	BOOL flipX = (wrapMode == WrapModeTileFlipX) || (wrapMode == WrapModeTileFlipXY);
+	BOOL flipY = (wrapMode == WrapModeTileFlipY) || (wrapMode == WrapModeTileFlipXY);
+
+	surface = gdip_bitmap_ensure_surface (bitmap);
+	if (!surface)
+		return NULL;
+
+	if (!flipX && !flipY)
+		return cairo_surface_reference (surface);
+
+	if (count) {
+		drawing = g_atomic_int_get (&count->graphics) != 0;
+		released = (unsigned int) g_atomic_int_get (&count->released);
+	}
+
+	if (bitmap->tile_surface != NULL) {
+		if (bitmap->tile_wrap_mode == wrapMode && bitmap->tile_generation == bitmap->generation &&
+			bitmap->tile_graphics_released == released && !drawing)
+			return cairo_surface_reference (bitmap->tile_surface);
+
+		cairo_surface_destroy (bitmap->tile_surface);
+		bitmap->tile_surface = NULL;
+	}
+
+	tile = gdip_create_tile_surface (surface, bitmap->active_bitmap->width, bitmap->active_bitmap->height, flipX, flipY);
+	if (tile && !drawing) {
+		bitmap->tile_surface = cairo_surface_reference (tile);
+		bitmap->tile_wrap_mode = wrapMode;
+		bitmap->tile_generation = bitmap->generation;
+		bitmap->tile_graphics_released = released;
+	}
+
+	return tile;
+}
+
+/* Called when a graphics context is created on the bitmap surface, ct is the context drawing on it. */
+void
+gdip_bitmap_surface_add_graphics (GpBitmap *bitmap, cairo_t *ct)
+{
+	BitmapSurfaceState *state;
+	BitmapGraphicsCount *count = bitmap->graphics_count;
+
+	if (!count) {
+		count = (BitmapGraphicsCount *) gdip_calloc (1, sizeof (BitmapGraphicsCount));
+		if (count) {
+			count->ref_count = 1;
+			bitmap->graphics_count = count;
+		}
+	}
+
+	if (count) {
+		/* like the surface state, the count is shared by the bitmap and the context */
+		g_atomic_int_inc (&count->ref_count);
+		g_atomic_int_inc (&count->graphics);
+		/* without the user data the count is never decremented, and the tiles are no longer cached */
+		if (cairo_set_user_data (ct, &graphics_count_key, count, gdip_graphics_count_release) != CAIRO_STATUS_SUCCESS)
+			gdip_graphics_count_unref (count);
+	}
+
+	state = gdip_bitmap_get_surface_state (bitmap);
+	if (!state)
+		return;
+
+	/* the context may outlive the bitmap (and the surface), so it holds its own reference on the state */
+	g_atomic_int_inc (&state->ref_count);
+	if (cairo_set_user_data (ct, &graphics_state_key, state, gdip_surface_state_release_graphics) != CAIRO_STATUS_SUCCESS) {
+		gdip_surface_state_unref (state);
+		/* we can't tell when drawing stops, always assume the whole surface changed */
+		g_atomic_int_inc (&state->graphics);
+		return;
+	}
+
+	g_atomic_int_inc (&state->graphics);
+}
+
+/* Mark an area of the premultiplied surface as modified, e.g. by SetPixel. */
+void
+gdip_bitmap_surface_mark_dirty (GpBitmap *bitmap, int x, int y, int width, int height)
+{
+	BitmapSurfaceState *state = gdip_bitmap_get_surface_state (bitmap);
+
+	if (state)
+		gdip_surface_state_mark_dirty (state, x, y, width, height);
+}
+
 void gdip_bitmap_flush_surface (GpBitmap *bitmap)
 {
 	if (bitmap->surface != NULL) {
 		BYTE *surface_scan0 = cairo_image_surface_get_data (bitmap->surface);
 		if (surface_scan0 != bitmap->active_bitmap->scan0) {
-			// The surface had to be premultiplied, we need to reverse the transition
-			gdip_bitmap_get_premultiplied_scan0_reverse (bitmap, surface_scan0);
+			// The surface had to be premultiplied, reverse the transition for what changed since the last flush
+			BitmapSurfaceState *state = gdip_bitmap_get_surface_state (bitmap);
+			Rect rect = {0, 0, bitmap->active_bitmap->width, bitmap->active_bitmap->height};
+
+			if (state && g_atomic_int_get (&state->graphics) == 0) {
+				rect = state->dirty;
+				if (rect.Width <= 0 || rect.Height <= 0)
+					return;
+			}
+
+			gdip_bitmap_get_premultiplied_scan0_reverse (bitmap, surface_scan0, &rect);
+			if (state) {
+				state->dirty.Width = 0;
+				state->dirty.Height = 0;
+			}
 		}
 	}
 }
@@ -2250,76 +2790,180 @@ void gdip_bitmap_flush_surface (GpBitmap *bitmap)
 void gdip_bitmap_invalidate_surface (GpBitmap *bitmap)
 {
 	if (bitmap->surface != NULL) {
-		BYTE *surface_scan0 = cairo_image_surface_get_data (bitmap->surface);
+		/* a premultiplied copy of scan0 is released along with the surface */
 		cairo_surface_destroy (bitmap->surface);
 		bitmap->surface = NULL;
-		if (surface_scan0 != bitmap->active_bitmap->scan0) {
-			GdipFree (surface_scan0);
-		}
+	}
+
+	if (bitmap->indexed_rgb != NULL) {
+		GdipDisposeImage (bitmap->indexed_rgb);
+		bitmap->indexed_rgb = NULL;
+	}
+
+	if (bitmap->tile_surface != NULL) {
+		cairo_surface_destroy (bitmap->tile_surface);
+		bitmap->tile_surface = NULL;
 	}
 }
 
+/* TRUE when the surface is a premultiplied 32bpp copy of scan0 rather than scan0 itself */
 BOOL
 gdip_bitmap_format_needs_premultiplication (GpBitmap *bitmap)
 {
-	return (bitmap->active_bitmap->pixel_format == PixelFormat32bppARGB);
+	switch (bitmap->active_bitmap->pixel_format) {
+	case PixelFormat32bppARGB:
+	case PixelFormat16bppRGB555:
+	case PixelFormat16bppRGB565:
+	case PixelFormat16bppARGB1555:
+	case PixelFormat48bppRGB:
+	case PixelFormat64bppARGB:
+	case PixelFormat64bppPARGB:
+		return TRUE;
+	default:
+		return FALSE;
+	}
 }
 
+
+/*
+ * The surface of a 48 or 64bpp bitmap only has 8 bits per channel, so writing a dirty rectangle back would reduce
+ * every pixel in it, drawn or not, to 8 bits. Only the pixels of the surface that differ from what scan0 converts
+ * to are written back, the others keep their full precision.
+ */
+typedef struct {
+	const GdipRowConverter	*forward;	/* scan0 to the surface */
+	const GdipRowConverter	*reverse;	/* the surface to scan0 */
+	BYTE			*surface;
+	int			surface_stride;
+	BYTE			*scan0;
+	int			stride;
+	int			x;
+	int			width;
+} WriteBackRowsArgs;
+
 static void
-gdip_bitmap_get_premultiplied_scan0_internal (GpBitmap *bitmap, BYTE *src, BYTE *dest, const BYTE pre_multiplied_table[256][256])
+gdip_write_back_changed_rows (int y_start, int y_end, void *user_data)
 {
-	ActiveBitmapData *data = bitmap->active_bitmap;
-	BYTE *source = src;
-	BYTE *target = dest;
-	int y, x;
-	for (y = 0; y < data->height; y++) {
-		ARGB *sp = (ARGB*) source;
-		ARGB *tp = (ARGB*) target;
-		for (x = 0; x < data->width; x++) {
-			BYTE r, g, b, a;
-			get_pixel_bgra (*sp, b, g, r, a);
+	WriteBackRowsArgs *args = (WriteBackRowsArgs *) user_data;
+	ARGB *unchanged = GdipAlloc ((unsigned long long int) args->width * sizeof (ARGB));
+	int y;
 
-			if (a < 0xff) {
-				b = pre_multiplied_table [b][a];
-				g = pre_multiplied_table [g][a];
-				r = pre_multiplied_table [r][a];
-				set_pixel_bgra (tp, 0, b, g, r, a);
-			} else {
-				*tp = *sp;
-			}
-			sp++;
-			tp++;
+	for (y = y_start; y < y_end; y++) {
+		BYTE *surface = args->surface + y * args->surface_stride;
+		BYTE *scan0 = args->scan0 + y * args->stride;
+		const ARGB *drawn = (const ARGB *) surface + args->x;
+		int start, end;
+
+		if (!unchanged) {
+			args->reverse->convert (args->reverse, surface, args->x, scan0, args->x, args->width);
+			continue;
+		}
+
+		args->forward->convert (args->forward, scan0, args->x, (BYTE *) unchanged, 0, args->width);
+		for (start = 0; start < args->width; start = end) {
+			while (start < args->width && drawn[start] == unchanged[start])
+				start++;
+			for (end = start; end < args->width && drawn[end] != unchanged[end]; end++)
+				;
+			if (end > start)
+				args->reverse->convert (args->reverse, surface, args->x + start, scan0, args->x + start, end - start);
 		}
-		source += data->stride;
-		target += data->stride;
 	}
+
+	GdipFree (unchanged);
+}
+
+static void
+gdip_bitmap_get_premultiplied_scan0_internal (GpBitmap *bitmap, BYTE *premul, const Rect *rect, BOOL reverse)
+{
+	ActiveBitmapData *data = bitmap->active_bitmap;
+	ActiveBitmapData premul_data;
+	GdipRowConverter converter;
+	ConvertRowsArgs args;
+	int x = max (rect->X, 0);
+	int y = max (rect->Y, 0);
+	int right = min (rect->X + rect->Width, (int) data->width);
+	int bottom = min (rect->Y + rect->Height, (int) data->height);
+
+	if (right <= x || bottom <= y)
+		return;
+
+	memset (&premul_data, 0, sizeof (ActiveBitmapData));
+	premul_data.width = data->width;
+	premul_data.height = data->height;
+	premul_data.stride = gdip_bitmap_premultiplied_stride (data);
+	premul_data.pixel_format = PixelFormat32bppPARGB;
+	premul_data.scan0 = premul;
+
+	if (reverse && gdip_get_pixel_format_bpp (data->pixel_format) > 32) {
+		GdipRowConverter forward;
+		WriteBackRowsArgs write_back;
+
+		if (!gdip_row_converter_init (&converter, &premul_data, data) || !gdip_row_converter_init (&forward, data, &premul_data))
+			return;
+
+		write_back.forward = &forward;
+		write_back.reverse = &converter;
+		write_back.surface = premul + y * premul_data.stride;
+		write_back.surface_stride = premul_data.stride;
+		write_back.scan0 = (BYTE *) data->scan0 + y * data->stride;
+		write_back.stride = data->stride;
+		write_back.x = x;
+		write_back.width = right - x;
+		gdip_process_row_bands (bottom - y, (size_t) write_back.width * sizeof (ARGB) * 2, gdip_write_back_changed_rows, &write_back);
+		return;
+	}
+
+	if (reverse) {
+		if (!gdip_row_converter_init (&converter, &premul_data, data))
+			return;
+		args.src = premul + y * premul_data.stride;
+		args.src_stride = premul_data.stride;
+		args.dest = (BYTE *) data->scan0 + y * data->stride;
+		args.dest_stride = data->stride;
+	} else {
+		if (!gdip_row_converter_init (&converter, data, &premul_data))
+			return;
+		args.src = (BYTE *) data->scan0 + y * data->stride;
+		args.src_stride = data->stride;
+		args.dest = premul + y * premul_data.stride;
+		args.dest_stride = premul_data.stride;
+	}
+
+	/* bands are numbered from the first row of the rectangle */
+	args.converter = &converter;
+	args.src_x = x;
+	args.dest_x = x;
+	args.width = right - x;
+	gdip_process_row_bands (bottom - y, (size_t) args.width * sizeof (ARGB), gdip_convert_rows, &args);
 }
 
 BYTE*
 gdip_bitmap_get_premultiplied_scan0 (GpBitmap *bitmap)
 {
 	ActiveBitmapData *data = bitmap->active_bitmap;
-	unsigned long long int size = (unsigned long long int)data->height * data->stride;
+	Rect rect = {0, 0, data->width, data->height};
+	unsigned long long int size = (unsigned long long int)data->height * gdip_bitmap_premultiplied_stride (data);
 	if (size > G_MAXINT32)
 		return NULL;
 	BYTE* premul = (BYTE*) GdipAlloc (size);
 	if (!premul)
 		return NULL;
 
-	gdip_bitmap_get_premultiplied_scan0_internal (bitmap, (BYTE*)data->scan0, premul, pre_multiplied_table);
+	gdip_bitmap_get_premultiplied_scan0_internal (bitmap, premul, &rect, FALSE);
 	return premul;
 }
 
 void
-gdip_bitmap_get_premultiplied_scan0_inplace (GpBitmap *bitmap, BYTE *premul)
+gdip_bitmap_get_premultiplied_scan0_inplace (GpBitmap *bitmap, BYTE *premul, const Rect *rect)
 {
-	gdip_bitmap_get_premultiplied_scan0_internal (bitmap, (BYTE*)bitmap->active_bitmap->scan0, premul, pre_multiplied_table);
+	gdip_bitmap_get_premultiplied_scan0_internal (bitmap, premul, rect, FALSE);
 }
 
 void
-gdip_bitmap_get_premultiplied_scan0_reverse (GpBitmap *bitmap, BYTE *premul)
+gdip_bitmap_get_premultiplied_scan0_reverse (GpBitmap *bitmap, BYTE *premul, const Rect *rect)
 {
-	gdip_bitmap_get_premultiplied_scan0_internal (bitmap, premul, (BYTE*)bitmap->active_bitmap->scan0, pre_multiplied_table_reverse);
+	gdip_bitmap_get_premultiplied_scan0_internal (bitmap, premul, rect, TRUE);
 }
 
 GpBitmap *
@@ -2347,7 +2991,7 @@ gdip_convert_indexed_to_rgb (GpBitmap *indexed_bmp)
 	int		format;
 
 	data = indexed_bmp->active_bitmap;
-	if (data == NULL) {
+	if (data == NULL || gdip_bitmap_ensure_pixels (indexed_bmp) != Ok) {
 		return NULL;
 	}
 
@@ -2447,6 +3091,80 @@ gdip_convert_indexed_to_rgb (GpBitmap *indexed_bmp)
 	return NULL;
 }
 
+/*
+ * Returns a copy of the 48 or 64bpp active bitmap with 8 bits per channel, 24bppRGB or 32bppARGB, for
+ * the encoders that can't write 16 bits per channel. NULL for other formats or if it can't be converted.
+ */
+GpBitmap *
+gdip_convert_wide_to_rgb (GpBitmap *bitmap)
+{
+	ActiveBitmapData	*data = bitmap->active_bitmap;
+	Rect			rect;
+	PixelFormat		format;
+	GpBitmap		*ret;
+
+	if (data == NULL || gdip_bitmap_ensure_pixels (bitmap) != Ok)
+		return NULL;
+
+	switch (data->pixel_format) {
+	case PixelFormat48bppRGB:
+		format = PixelFormat24bppRGB;
+		break;
+	case PixelFormat64bppARGB:
+	case PixelFormat64bppPARGB:
+		format = PixelFormat32bppARGB;
+		break;
+	default:
+		return NULL;
+	}
+
+	gdip_bitmap_flush_surface (bitmap);
+
+	if (GdipCreateBitmapFromScan0 (data->width, data->height, 0, format, NULL, &ret) != Ok)
+		return NULL;
+
+	rect.X = 0;
+	rect.Y = 0;
+	rect.Width = data->width;
+	rect.Height = data->height;
+	if (gdip_bitmap_change_rect_pixel_format (data, &rect, ret->active_bitmap, &rect) != Ok) {
+		gdip_bitmap_dispose (ret);
+		return NULL;
+	}
+
+	ret->active_bitmap->dpi_horz = data->dpi_horz;
+	ret->active_bitmap->dpi_vert = data->dpi_vert;
+	ret->active_bitmap->image_flags |= data->image_flags & ImageFlagsHasRealDPI;
+	return ret;
+}
+
+/*
+ * Returns the 32bpp expansion of the indexed active bitmap, cached on @bitmap until
+ * its active bitmap, palette or pixels change. The result belongs to @bitmap.
+ */
+GpBitmap *
+gdip_bitmap_get_indexed_rgb (GpBitmap *bitmap)
+{
+	ActiveBitmapData *data = bitmap->active_bitmap;
+
+	if (bitmap->indexed_rgb != NULL) {
+		if (bitmap->indexed_rgb_data == data && bitmap->indexed_rgb_palette == data->palette &&
+			bitmap->indexed_rgb_generation == bitmap->generation)
+			return bitmap->indexed_rgb;
+
+		GdipDisposeImage (bitmap->indexed_rgb);
+	}
+
+	bitmap->indexed_rgb = gdip_convert_indexed_to_rgb (bitmap);
+	if (bitmap->indexed_rgb != NULL) {
+		bitmap->indexed_rgb_data = data;
+		bitmap->indexed_rgb_palette = data->palette;
+		bitmap->indexed_rgb_generation = bitmap->generation;
+	}
+
+	return bitmap->indexed_rgb;
+}
+
 
 ColorPalette*
 gdip_create_greyscale_palette (int num_colors)
@@ -1126,8 +1126,42 @@ gdip_read_bmp_indexed (void *pointer, BYTE *pixels, BOOL upsidedown, PixelFormat
 }
 
 /* For use with in-memory bitmaps, where the BITMAPFILEHEADER doesn't exists */
-GpStatus 
-gdip_read_bmp_image (void *pointer, GpImage **image, ImageSource source)
+/*
+ * Whether the pixels left in @ms, read as gdip_read_bmp_image does, are enough to decode the image: those are deferred
+ * to their first use, decoding everything else at load time keeps its errors there.
+ */
+static BOOL
+gdip_bmp_can_defer_pixels (MemorySource *ms, const BITMAPV5HEADER *bmi, BOOL upsidedown, PixelFormat format, PixelFormat originalFormat, INT originalStride, INT height)
+{
+	unsigned long long int needed = (unsigned long long int) originalStride * height;
+
+	switch (originalFormat) {
+	case PixelFormat1bppIndexed:
+	case PixelFormat4bppIndexed:
+	case PixelFormat8bppIndexed:
+	case PixelFormat16bppRGB555:
+	case PixelFormat16bppRGB565:
+	case PixelFormat24bppRGB:
+	case PixelFormat32bppRGB:
+		break;
+	default:
+		return FALSE;
+	}
+
+	if (gdip_is_an_indexed_pixelformat (format)) {
+		if (bmi->bV5Compression == BI_RLE4 || bmi->bV5Compression == BI_RLE8)
+			return FALSE;
+		/* top-down indexed images are read at once and only need a line */
+		if (!upsidedown)
+			needed = originalStride;
+	}
+
+	return ms->size - ms->pos >= needed;
+}
+
+/* With @headerOnly, which requires a Memory source, an image whose pixels can be deferred is loaded without them */
+static GpStatus
+gdip_read_bmp_image_internal (void *pointer, GpImage **image, ImageSource source, BOOL headerOnly)
 {
 	BITMAPV5HEADER bmi;
 	GpBitmap	*result;
@@ -1182,6 +1216,20 @@ gdip_read_bmp_image (void *pointer, GpImage **image, ImageSource source)
 		return OutOfMemory;
 	}
 
+	result->active_bitmap->image_flags = ImageFlagsReadOnly | ImageFlagsHasRealPixelSize | ImageFlagsColorSpaceRGB;
+	if (bmi.bV5XPelsPerMeter != 0 && bmi.bV5YPelsPerMeter != 0)
+		result->active_bitmap->image_flags |= ImageFlagsHasRealDPI;
+
+	if (headerOnly) {
+		if (!gdip_bmp_can_defer_pixels ((MemorySource *) pointer, &bmi, upsidedown, result->active_bitmap->pixel_format, originalFormat, originalStride, result->active_bitmap->height)) {
+			gdip_bitmap_dispose (result);
+			return NotImplemented;
+		}
+
+		*image = result;
+		return Ok;
+	}
+
 	pixels = GdipAlloc (size);
 	if (!pixels) {
 		gdip_bitmap_dispose (result);
@@ -1190,9 +1238,6 @@ gdip_read_bmp_image (void *pointer, GpImage **image, ImageSource source)
 
 	result->active_bitmap->scan0 = pixels;
 	result->active_bitmap->reserved = GBD_OWN_SCAN0;
-	result->active_bitmap->image_flags = ImageFlagsReadOnly | ImageFlagsHasRealPixelSize | ImageFlagsColorSpaceRGB;
-	if (bmi.bV5XPelsPerMeter != 0 && bmi.bV5YPelsPerMeter != 0)
-		result->active_bitmap->image_flags |= ImageFlagsHasRealDPI;
 
 	if (gdip_is_an_indexed_pixelformat (result->active_bitmap->pixel_format)) {
 		if (bmi.bV5Compression == BI_RLE4)
@@ -1218,6 +1263,12 @@ gdip_read_bmp_image (void *pointer, GpImage **image, ImageSource source)
 	return Ok;
 }
 
+GpStatus 
+gdip_read_bmp_image (void *pointer, GpImage **image, ImageSource source)
+{
+	return gdip_read_bmp_image_internal (pointer, image, source, FALSE);
+}
+
 /* BMP read from files have a BITMAPFILEHEADER but this isn't the case for the GDI API
  * (e.g. displaying a bitmap) */
 static void
@@ -1233,7 +1284,7 @@ BitmapFileHeaderFromLE (BITMAPFILEHEADER *bitmapFileHeader)
 }
 
 static GpStatus 
-gdip_read_bmp_image_from_file_stream (void *pointer, GpImage **image, ImageSource source)
+gdip_read_bmp_image_from_file_stream (void *pointer, GpImage **image, ImageSource source, BOOL headerOnly)
 {
 	BITMAPFILEHEADER bmfh;
 	int size_read;
@@ -1248,19 +1299,45 @@ gdip_read_bmp_image_from_file_stream (void *pointer, GpImage **image, ImageSourc
 		return UnknownImageFormat;
 	}
 
-	return gdip_read_bmp_image (pointer, image, source);
+	return gdip_read_bmp_image_internal (pointer, image, source, headerOnly);
 }
 
 GpStatus 
 gdip_load_bmp_image_from_file (FILE *fp, GpImage **image)
 {
-	return gdip_read_bmp_image_from_file_stream ((void*)fp, image, File);
+	return gdip_read_bmp_image_from_file_stream ((void*)fp, image, File, FALSE);
 }
 
 GpStatus 
 gdip_load_bmp_image_from_stream_delegate (dstream_t *loader, GpImage **image)
 {
-	return gdip_read_bmp_image_from_file_stream ((void*)loader, image, DStream);
+	return gdip_read_bmp_image_from_file_stream ((void*)loader, image, DStream, FALSE);
+}
+
+GpStatus
+gdip_load_bmp_image_from_memory (MemorySource *source, GpImage **image)
+{
+	return gdip_read_bmp_image_from_file_stream ((void*)source, image, Memory, FALSE);
+}
+
+/* Only the headers are read here when possible, the pixels are decoded from the file on first use */
+GpStatus
+gdip_load_bmp_image_from_mapping (GpFileMapping *mapping, GpImage **image)
+{
+	MemorySource ms = { mapping->ptr, mapping->size, 0 };
+	GpStatus status;
+
+	status = gdip_read_bmp_image_from_file_stream ((void*)&ms, image, Memory, TRUE);
+	if (status == Ok) {
+		if (gdip_file_mapping_defer_load (mapping, *image, gdip_load_bmp_image_from_memory))
+			return Ok;
+
+		gdip_bitmap_dispose (*image);
+	}
+
+	/* decode everything now, which also gives the error of an image that can't be loaded */
+	ms.pos = 0;
+	return gdip_load_bmp_image_from_memory (&ms, image);
 }
 
 int 
@@ -1328,6 +1405,24 @@ gdip_save_bmp_image_to_file_stream (void *pointer, GpImage *image, BOOL useFile)
 	ActiveBitmapData		*activebmp;
 	BYTE			*scan0;
 
+	/* BMP has no 48 or 64 bits per pixel formats, they are saved with 8 bits per channel */
+	switch (image->active_bitmap->pixel_format) {
+	case PixelFormat48bppRGB:
+	case PixelFormat64bppARGB:
+	case PixelFormat64bppPARGB: {
+		GpStatus status;
+		GpBitmap *converted = gdip_convert_wide_to_rgb (image);
+		if (!converted)
+			return OutOfMemory;
+
+		status = gdip_save_bmp_image_to_file_stream (pointer, converted, useFile);
+		gdip_bitmap_dispose (converted);
+		return status;
+	}
+	default:
+		break;
+	}
+
 	activebmp = image->active_bitmap;
 	if (activebmp->pixel_format != PixelFormat24bppRGB) {
 		bitmapLen = activebmp->stride * activebmp->height;
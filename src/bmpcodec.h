@@ -61,6 +61,8 @@ typedef struct {
 GpStatus gdip_read_bmp_image (void *pointer, GpImage **image, ImageSource source) GDIP_INTERNAL;
 GpStatus gdip_load_bmp_image_from_file (FILE *fp, GpImage **image) GDIP_INTERNAL;
 GpStatus gdip_load_bmp_image_from_stream_delegate (dstream_t *loader, GpImage **image) GDIP_INTERNAL;
+GpStatus gdip_load_bmp_image_from_memory (MemorySource *source, GpImage **image) GDIP_INTERNAL;
+GpStatus gdip_load_bmp_image_from_mapping (GpFileMapping *mapping, GpImage **image) GDIP_INTERNAL;
 
 GpStatus gdip_save_bmp_image_to_file (FILE *fp, GpImage *image) GDIP_INTERNAL;
 GpStatus gdip_save_bmp_image_to_stream_delegate (PutBytesDelegate putBytesFunc, GpImage *image) GDIP_INTERNAL;
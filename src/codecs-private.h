@@ -49,6 +49,14 @@ typedef struct {
 	int pos;
 } MemorySource;
 
+/* A read-only mapping of a whole image file, codecs read it through a MemorySource over ptr and size */
+typedef struct {
+	BYTE* ptr;
+	int size;
+	int fd;		/* not owned, only valid while the image is loaded */
+	int ref_count;
+} GpFileMapping;
+
 
 static const CLSID gdip_image_frameDimension_page_guid = {0x7462dc86U, 0x6180U, 0x4c7eU, {0x8e, 0x3f, 0xee, 0x73, 0x33, 0xa7, 0xa4, 0x83}};
 static const CLSID gdip_image_frameDimension_time_guid = {0x6aedbd6dU, 0x3fb5U, 0x418aU, {0x83, 0xa6, 0x7f, 0x45, 0x22, 0x9d, 0xc8, 0x72}};
@@ -56,6 +64,35 @@ static const CLSID gdip_image_frameDimension_resolution_guid = {0x84236f7bU, 0x3
 
 const EncoderParameter *gdip_find_encoder_parameter (GDIPCONST EncoderParameters *eps, const GUID *guid) GDIP_INTERNAL;
 
+/*
+ * Scanline by scanline access to an image file, used to transcode images without decoding them as a whole. Readers
+ * return the rows from top to bottom as 32bppARGB, writers take them in the same format and store the alpha channel
+ * only if they were created with one. close frees the reader or writer, for writers it also completes the file.
+ */
+typedef struct _GpRowReader GpRowReader;
+struct _GpRowReader {
+	UINT		width;
+	UINT		height;
+	BOOL		has_alpha;
+	GpStatus	(*read_row) (GpRowReader *reader, ARGB *row);
+	void		(*close) (GpRowReader *reader);
+};
+
+typedef struct _GpRowWriter GpRowWriter;
+struct _GpRowWriter {
+	GpStatus	(*write_row) (GpRowWriter *writer, const ARGB *row);
+	GpStatus	(*close) (GpRowWriter *writer);
+};
+
+GpFileMapping *gdip_file_mapping_new (FILE *fp) GDIP_INTERNAL;
+GpFileMapping *gdip_file_mapping_new_from_fd (int fd) GDIP_INTERNAL;
+GpFileMapping *gdip_file_mapping_ref (GpFileMapping *mapping) GDIP_INTERNAL;
+void gdip_file_mapping_unref (GpFileMapping *mapping) GDIP_INTERNAL;
+
+/* Decodes a whole image, header and pixels, from memory */
+typedef GpStatus (*GpMemoryLoadFunc) (MemorySource *source, GpImage **image);
+BOOL gdip_file_mapping_defer_load (GpFileMapping *mapping, GpImage *image, GpMemoryLoadFunc load) GDIP_INTERNAL;
+
 GpStatus initCodecList (void) GDIP_INTERNAL;
 void releaseCodecList (void) GDIP_INTERNAL;
 
@@ -68,5 +105,10 @@ extern GUID GdipEncoderTransformation;
 extern GUID GdipEncoderQuality;
 extern GUID GdipEncoderLuminanceTable;
 extern GUID GdipEncoderChrominanceTable;
+extern GUID GdipEncoderPngCompressionLevel;
+extern GUID GdipEncoderPngFilter;
+extern GUID GdipEncoderPngParallel;
+extern GUID GdipEncoderTiffTileSize;
+extern GUID GdipEncoderGifDither;
 
 #endif
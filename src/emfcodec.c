@@ -645,3 +645,9 @@ gdip_load_emf_image_from_stream_delegate (dstream_t *loader, GpImage **image)
 {
 	return gdip_get_metafile_from ((void *)loader, (GpMetafile**)image, DStream);
 }
+
+GpStatus
+gdip_load_emf_image_from_memory (MemorySource *source, GpImage **image)
+{
+	return gdip_get_metafile_from ((void *)source, (GpMetafile**)image, Memory);
+}
@@ -45,6 +45,9 @@
 #endif
 #endif
 
+/* guards building, using and dropping the family_index of every collection, families can be created on any thread */
+static GMutex family_index_mutex;
+
 /* Generic fonts families */
 static GMutex generic;
 static GpFontFamily *familySerif = NULL;
@@ -121,6 +124,8 @@ GdipNewInstalledFontCollection (GpFontCollection **fontCollection)
 	if (!fontCollection)
 		return InvalidParameter;
 
+	gdip_fontconfig_init ();
+
 	/*
 	 * Ensure we leak this data only a single time, because:
 	 * (a) there is no API to free it;
@@ -147,6 +152,8 @@ GdipNewInstalledFontCollection (GpFontCollection **fontCollection)
 
 		sysfonts->fontset = col;
 		sysfonts->config = NULL;
+		sysfonts->fontset_stale = FALSE;
+		sysfonts->family_index = NULL;
 
 #if USE_PANGO_RENDERING
 		sysfonts->pango_font_map = pango_cairo_font_map_new_for_font_type (CAIRO_FONT_TYPE_FT);
@@ -176,8 +183,12 @@ GdipNewPrivateFontCollection (GpFontCollection **fontCollection)
 	if (!result)
 		return OutOfMemory;
 
+	gdip_fontconfig_init ();
+
 	result->fontset = NULL;
 	result->config = FcConfigCreate ();
+	result->fontset_stale = FALSE;
+	result->family_index = NULL;
 
 #if USE_PANGO_RENDERING
 	result->pango_font_map = pango_cairo_font_map_new_for_font_type (CAIRO_FONT_TYPE_FT);
@@ -206,6 +217,10 @@ GdipDeletePrivateFontCollection (GpFontCollection **fontCollection)
 			(*fontCollection)->pango_font_map = NULL;
 		}
 #endif
+		if ((*fontCollection)->family_index != NULL) {
+			g_hash_table_destroy ((*fontCollection)->family_index);
+			(*fontCollection)->family_index = NULL;
+		}
 		if ((*fontCollection)->fontset != NULL) {
 			FcFontSetDestroy ((*fontCollection)->fontset);
 			(*fontCollection)->fontset = NULL;
@@ -242,6 +257,7 @@ GdipPrivateAddFontFile (GpFontCollection *fontCollection, GDIPCONST WCHAR *filen
 
 	fclose (fileHandle);
 	FcConfigAppFontAddFile (fontCollection->config, file);
+	fontCollection->fontset_stale = TRUE;
 
 	GdipFree (file);
 	return Ok;
@@ -321,13 +337,27 @@ GdipDeleteFontFamily (GpFontFamily *fontFamily)
 	return Ok;
 }
 
+/* lists the fonts of a private collection, only once after fonts were added */
 static void
 gdip_createPrivateFontSet (GpFontCollection *font_collection)
 {
-	FcObjectSet *os = FcObjectSetBuild (FC_FAMILY, FC_FOUNDRY, FC_FILE, NULL);
-	FcPattern *pat = FcPatternCreate ();
-	FcFontSet *col = FcFontList (font_collection->config, pat, os);
+	FcObjectSet *os;
+	FcPattern *pat;
+	FcFontSet *col;
+
+	if (font_collection->fontset && !font_collection->fontset_stale)
+		return;
 
+	os = FcObjectSetBuild (FC_FAMILY, FC_FOUNDRY, FC_FILE, NULL);
+	pat = FcPatternCreate ();
+	col = FcFontList (font_collection->config, pat, os);
+
+	g_mutex_lock (&family_index_mutex);
+	if (font_collection->family_index) {
+		g_hash_table_destroy (font_collection->family_index);
+		font_collection->family_index = NULL;
+	}
+	g_mutex_unlock (&family_index_mutex);
 	if (font_collection->fontset)
 		FcFontSetDestroy (font_collection->fontset);
 
@@ -335,6 +365,7 @@ gdip_createPrivateFontSet (GpFontCollection *font_collection)
 	FcObjectSetDestroy (os);
 
 	font_collection->fontset = col;
+	font_collection->fontset_stale = FALSE;
 }
 
 GpStatus WINGDIPAPI
@@ -365,7 +396,7 @@ GdipGetFontCollectionFamilyList (GpFontCollection *fontCollection, INT numSought
 	if (fontCollection->config)
 		gdip_createPrivateFontSet (fontCollection);
 
-	for (i = 0; i < numSought && i < fontCollection->fontset->nfont; i++) {
+	for (i = 0; fontCollection->fontset && i < numSought && i < fontCollection->fontset->nfont; i++) {
 		gpfamilies[i] = gdip_fontfamily_new ();
 		if (!gpfamilies[i]) {
 			while (--i >= 0) {
@@ -448,6 +479,10 @@ create_pattern_from_name (char* name)
 static GMutex patterns_mutex;
 static GHashTable *patterns_hashtable = NULL;
 
+#ifndef USE_PANGO_RENDERING
+static void gdip_font_clear_face_cache (void);
+#endif
+
 static GpStatus
 create_fontfamily_from_name (char* name, GpFontFamily **fontFamily)
 {
@@ -518,6 +553,42 @@ gdip_font_clear_pattern_cache (void)
 	ref_familySansSerif = 0;
 	ref_familyMonospace = 0;
 	g_mutex_unlock (&patterns_mutex);
+
+#ifndef USE_PANGO_RENDERING
+	gdip_font_clear_face_cache ();
+#endif
+}
+
+/* family names are matched case insensitively, the first font of a family in the fontset wins */
+static GpStatus
+gdip_build_family_index (GpFontCollection *font_collection)
+{
+	GHashTable *index = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	FcPattern **gpfam = font_collection->fontset->fonts;
+	int i;
+
+	for (i = 0; i < font_collection->fontset->nfont; gpfam++, i++) {
+		FcChar8 *str;
+		FcResult rlt;
+		int n;
+
+		for (n = 0; (rlt = FcPatternGetString (*gpfam, FC_FAMILY, n, &str)) == FcResultMatch; n++) {
+			gchar *key = g_utf8_casefold ((const gchar *) str, -1);
+			if (g_hash_table_lookup (index, key))
+				g_free (key);
+			else
+				g_hash_table_insert (index, key, *gpfam);
+		}
+
+		/* every font must have a family name */
+		if (n == 0) {
+			g_hash_table_destroy (index);
+			return gdip_status_from_fontconfig (rlt);
+		}
+	}
+
+	font_collection->family_index = index;
+	return Ok;
 }
 
 static GpStatus
@@ -525,28 +596,35 @@ create_fontfamily_from_collection (char* name, GpFontCollection *font_collection
 {
 	/* note: fontset can be NULL when we supply an empty private collection */
 	if (font_collection->fontset) {
-		int i;
-		FcChar8 *str;
-		FcPattern **gpfam = font_collection->fontset->fonts;
-    
-		for (i=0; i < font_collection->fontset->nfont; gpfam++, i++) {
-			FcResult rlt = FcPatternGetString (*gpfam, FC_FAMILY, 0, &str);
-			GpStatus status = gdip_status_from_fontconfig (rlt);
-			if (status != Ok)
+		FcPattern *pattern;
+		gchar *key;
+
+		key = g_utf8_casefold (name, -1);
+		g_mutex_lock (&family_index_mutex);
+		if (!font_collection->family_index) {
+			GpStatus status = gdip_build_family_index (font_collection);
+			if (status != Ok) {
+				g_mutex_unlock (&family_index_mutex);
+				g_free (key);
 				return status;
+			}
+		}
 
-			if (strcmp ((char *)name, (const char *)str) == 0) {
-				GpFontFamily *result = gdip_fontfamily_new ();
-				if (!result)
-					return OutOfMemory;
+		pattern = (FcPattern *) g_hash_table_lookup (font_collection->family_index, key);
+		g_mutex_unlock (&family_index_mutex);
+		g_free (key);
 
-				result->pattern = *gpfam;
-				result->allocated = FALSE;
-				result->collection = font_collection;
+		if (pattern) {
+			GpFontFamily *result = gdip_fontfamily_new ();
+			if (!result)
+				return OutOfMemory;
 
-				*fontFamily = result;
-				return Ok;
-			}
+			result->pattern = pattern;
+			result->allocated = FALSE;
+			result->collection = font_collection;
+
+			*fontFamily = result;
+			return Ok;
 		}
 	}
 	return FontFamilyNotFound;
@@ -841,23 +919,129 @@ gdip_get_fontfamily_details (GpFontFamily *family, FontStyle style)
 
 #else
 
+/*
+ * cairo font faces are shared by all the fonts of a family and style, so creating a font per draw call keeps using the
+ * glyph and scaled font caches of the same face. The cache holds one reference on every face and each font another one,
+ * the least recently used faces are dropped once there are more than FONT_FACE_CACHE_SIZE.
+ */
+#define FONT_FACE_CACHE_SIZE	128
+
+typedef struct {
+	FcPattern		*pattern;	/* the family pattern, referenced */
+	int			style;		/* only FontStyleBold and FontStyleItalic */
+	guint			hash;
+	cairo_font_face_t	*face;
+	GList			link;		/* in font_faces_lru, most recently used first */
+} GpFontFaceCacheEntry;
+
+static GMutex font_faces_mutex;
+static GHashTable *font_faces_hashtable = NULL;
+static GQueue font_faces_lru = G_QUEUE_INIT;
+
+static guint
+font_face_cache_hash (gconstpointer key)
+{
+	return ((const GpFontFaceCacheEntry *) key)->hash;
+}
+
+static gboolean
+font_face_cache_equal (gconstpointer a, gconstpointer b)
+{
+	const GpFontFaceCacheEntry *ea = (const GpFontFaceCacheEntry *) a;
+	const GpFontFaceCacheEntry *eb = (const GpFontFaceCacheEntry *) b;
+
+	return ea->hash == eb->hash && ea->style == eb->style &&
+		(ea->pattern == eb->pattern || FcPatternEqual (ea->pattern, eb->pattern));
+}
+
+static void
+font_face_cache_entry_free (gpointer data)
+{
+	GpFontFaceCacheEntry *entry = (GpFontFaceCacheEntry *) data;
+
+	cairo_font_face_destroy (entry->face);
+	FcPatternDestroy (entry->pattern);
+	GdipFree (entry);
+}
+
+static cairo_font_face_t *
+gdip_create_cairo_font_face (FcPattern *family_pattern, int style)
+{
+	cairo_font_face_t *face;
+	FcPattern *pattern = FcPatternBuild (
+		FcPatternDuplicate (family_pattern),
+		FC_SLANT,  FcTypeInteger, ((style & FontStyleItalic) ? FC_SLANT_ITALIC : FC_SLANT_ROMAN), 
+		FC_WEIGHT, FcTypeInteger, ((style & FontStyleBold)   ? FC_WEIGHT_BOLD  : FC_WEIGHT_MEDIUM),
+		NULL);
+
+	face = cairo_ft_font_face_create_for_pattern (pattern);
+	FcPatternDestroy (pattern);
+	return face;
+}
+
 cairo_font_face_t*
 gdip_get_cairo_font_face (GpFont *font)
 {
-	if (!font->cairofnt) {
-		FcPattern *pattern = FcPatternBuild (
-			FcPatternDuplicate (font->family->pattern),
-			FC_SLANT,  FcTypeInteger, ((font->style & FontStyleItalic) ? FC_SLANT_ITALIC : FC_SLANT_ROMAN), 
-			FC_WEIGHT, FcTypeInteger, ((font->style & FontStyleBold)   ? FC_WEIGHT_BOLD  : FC_WEIGHT_MEDIUM),
-			NULL);
-
-		font->cairofnt = cairo_ft_font_face_create_for_pattern (pattern);
-		cairo_font_face_reference (font->cairofnt);
-		FcPatternDestroy (pattern);
+	GpFontFaceCacheEntry key;
+	GpFontFaceCacheEntry *entry;
+
+	if (font->cairofnt)
+		return font->cairofnt;
+
+	key.pattern = font->family->pattern;
+	key.style = font->style & (FontStyleBold | FontStyleItalic);
+	key.hash = FcPatternHash (key.pattern) ^ key.style;
+
+	g_mutex_lock (&font_faces_mutex);
+
+	if (!font_faces_hashtable)
+		font_faces_hashtable = g_hash_table_new_full (font_face_cache_hash, font_face_cache_equal, NULL, font_face_cache_entry_free);
+
+	entry = (GpFontFaceCacheEntry *) g_hash_table_lookup (font_faces_hashtable, &key);
+	if (entry) {
+		g_queue_unlink (&font_faces_lru, &entry->link);
+		g_queue_push_head_link (&font_faces_lru, &entry->link);
+		font->cairofnt = cairo_font_face_reference (entry->face);
+	} else {
+		font->cairofnt = gdip_create_cairo_font_face (key.pattern, key.style);
+
+		entry = (GpFontFaceCacheEntry *) gdip_calloc (1, sizeof (GpFontFaceCacheEntry));
+		if (entry && cairo_font_face_status (font->cairofnt) == CAIRO_STATUS_SUCCESS) {
+			entry->pattern = key.pattern;
+			FcPatternReference (entry->pattern);
+			entry->style = key.style;
+			entry->hash = key.hash;
+			entry->face = cairo_font_face_reference (font->cairofnt);
+			entry->link.data = entry;
+			g_hash_table_insert (font_faces_hashtable, entry, entry);
+			g_queue_push_head_link (&font_faces_lru, &entry->link);
+
+			/* the fonts still using an evicted face keep their own reference */
+			if (font_faces_lru.length > FONT_FACE_CACHE_SIZE) {
+				GList *oldest = g_queue_pop_tail_link (&font_faces_lru);
+				g_hash_table_remove (font_faces_hashtable, oldest->data);
+			}
+		} else {
+			GdipFree (entry);
+		}
 	}
+
+	g_mutex_unlock (&font_faces_mutex);
 	return font->cairofnt;
 }
 
+static void
+gdip_font_clear_face_cache (void)
+{
+	g_mutex_lock (&font_faces_mutex);
+	if (font_faces_hashtable) {
+		g_queue_init (&font_faces_lru);
+		g_hash_table_destroy (font_faces_hashtable);
+		font_faces_hashtable = NULL;
+	}
+	g_mutex_unlock (&font_faces_mutex);
+}
+
 static GpStatus
 gdip_get_fontfamily_details (GpFontFamily *family, FontStyle style)
 {
@@ -1327,6 +1511,11 @@ gdip_create_font_from_logfont (HDC hdc, void *lf, GpFont **font, BOOL ucs2)
 		return status;
 	}
 
+#ifndef USE_PANGO_RENDERING
+	if (result->family)
+		gdip_get_cairo_font_face (result);
+#endif
+
 	*font = result;
 	return Ok;
 }
@@ -1386,6 +1575,7 @@ GdipPrivateAddMemoryFont(GpFontCollection *fontCollection, GDIPCONST void *memor
 #endif
 
 	FcConfigAppFontAddFile (fontCollection->config, fontfile);
+	fontCollection->fontset_stale = TRUE;
 	/* FIXME - May we delete our temporary font file or does 
 	   FcConfigAppFontAddFile just reference our file?  */
 	/* unlink(fontfile); */
@@ -40,6 +40,8 @@
 struct _FontCollection {
 	FcFontSet*	fontset;
 	FcConfig*	config;		/* Only for private collections */
+	BOOL		fontset_stale;	/* fonts were added since the fontset was listed */
+	GHashTable*	family_index;	/* casefolded family name -> pattern of fontset, built on first lookup */
 #ifdef USE_PANGO_RENDERING
 	PangoFontMap*	pango_font_map;
 	GMutex	pango_font_map_lock;
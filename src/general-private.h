@@ -113,6 +113,7 @@ int iround (float d) GDIP_INTERNAL;
 float gdip_erf (float x, float std, float mean) GDIP_INTERNAL;
 
 float gdip_get_display_dpi () GDIP_INTERNAL;
+void gdip_fontconfig_init (void) GDIP_INTERNAL;
 GpStatus gdip_get_status (cairo_status_t status) GDIP_INTERNAL;
 GpStatus gdip_get_pattern_status (cairo_pattern_t *pat) GDIP_INTERNAL;
 
@@ -143,6 +144,14 @@ void* gdip_calloc (size_t nelem, size_t elsize) GDIP_INTERNAL;
 /* checksums */
 DWORD gdip_crc32 (const BYTE *buf, size_t size) GDIP_INTERNAL;
 
+/* splitting per-row image work across threads */
+#define GDIP_ROW_BANDS_MIN_BYTES	(4 * 1024 * 1024)
+#define GDIP_ROW_BANDS_MAX_THREADS	8
+
+typedef void (*GdipRowBandFunc) (int y_start, int y_end, void *user_data);
+
+void gdip_process_row_bands (int height, size_t bytes_per_row, GdipRowBandFunc func, void *user_data) GDIP_INTERNAL;
+
 #include "general.h"
 
 #endif
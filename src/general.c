@@ -30,7 +30,14 @@
 #include "codecs-private.h"
 #include "graphics-private.h"
 #include "font-private.h"
+#include "fontcollection-private.h"
+#include "fontfamily-private.h"
 #include "stringformat-private.h"
+#ifdef USE_PANGO_RENDERING
+#include "text-pango-private.h"
+#else
+#include "text-cairo-private.h"
+#endif
 #include "carbon-private.h"
 #ifdef WIN32
 #include "win32-private.h"
@@ -42,27 +49,25 @@
 BOOL gdiplusInitialized = FALSE;
 static BOOL suppressBackgroundThread = FALSE;
 
-GpStatus WINGDIPAPI
-GdiplusStartup (ULONG_PTR *token, const GdiplusStartupInput *input, GdiplusStartupOutput *output)
-{
-	GpStatus status;
+static GMutex fontconfigMutex;
+static gint fontconfigInitialized = FALSE;
+static GThread *fontWarmupThread = NULL;
 
-	if (!token || !input)
-		return InvalidParameter;
-	if (input->SuppressBackgroundThread && !output)
-		return InvalidParameter;
-	if (input->GdiplusVersion != 1 && input->GdiplusVersion != 2)
-		return UnsupportedGdiplusVersion;
-
-	/* Don't initialize multiple time, e.g. for each appdomain. */
-	if (gdiplusInitialized)
-		return Ok;
-	
-	gdiplusInitialized = TRUE;
+/*
+ * Sets up fontconfig. This is deferred from GdiplusStartup to the first font collection since loading the
+ * configuration and the font cache dominates the startup of processes that never draw text.
+ */
+void
+gdip_fontconfig_init (void)
+{
+	if (g_atomic_int_get (&fontconfigInitialized))
+		return;
 
-	status = initCodecList ();
-	if (status != Ok)
-		return status;
+	g_mutex_lock (&fontconfigMutex);
+	if (fontconfigInitialized) {
+		g_mutex_unlock (&fontconfigMutex);
+		return;
+	}
 
 	FcInit ();
 
@@ -116,9 +121,60 @@ GdiplusStartup (ULONG_PTR *token, const GdiplusStartupInput *input, GdiplusStart
 		FcStrFree (fontConfigName);
 	}
 
-	gdip_get_display_dpi();
+	g_atomic_int_set (&fontconfigInitialized, TRUE);
+	g_mutex_unlock (&fontconfigMutex);
+}
+
+static BOOL
+gdip_font_warmup_requested (void)
+{
+	const char *warmup = getenv ("GDIPLUS_FONT_WARMUP");
+
+	return warmup && *warmup && strcmp (warmup, "0") != 0;
+}
+
+/* loads fontconfig, lists the installed fonts and resolves the default family while the application starts */
+static gpointer
+gdip_font_warmup (gpointer data)
+{
+	GpFontCollection *collection;
+	GpFontFamily *family;
+
+	GdipNewInstalledFontCollection (&collection);
+	if (GdipGetGenericFontFamilySansSerif (&family) == Ok)
+		GdipDeleteFontFamily (family);
+	gdip_get_display_dpi ();
+	return NULL;
+}
+
+GpStatus WINGDIPAPI
+GdiplusStartup (ULONG_PTR *token, const GdiplusStartupInput *input, GdiplusStartupOutput *output)
+{
+	GpStatus status;
+
+	if (!token || !input)
+		return InvalidParameter;
+	if (input->SuppressBackgroundThread && !output)
+		return InvalidParameter;
+	if (input->GdiplusVersion != 1 && input->GdiplusVersion != 2)
+		return UnsupportedGdiplusVersion;
+
+	/* Don't initialize multiple time, e.g. for each appdomain. */
+	if (gdiplusInitialized)
+		return Ok;
+	
+	gdiplusInitialized = TRUE;
+
+	status = initCodecList ();
+	if (status != Ok)
+		return status;
+
 	gdip_create_generic_stringformats ();
 
+	/* fontconfig is set up by the first font call, unless a warm-up thread was asked for */
+	if (!input->SuppressBackgroundThread && gdip_font_warmup_requested ())
+		fontWarmupThread = g_thread_try_new ("gdiplus-fonts", gdip_font_warmup, NULL, NULL);
+
 	if (input->SuppressBackgroundThread) {
 		output->NotificationHook = GdiplusNotificationHook;
 		output->NotificationUnhook = GdiplusNotificationUnhook;
@@ -134,13 +190,24 @@ void
 WINGDIPAPI GdiplusShutdown (ULONG_PTR token)
 {
 	if (gdiplusInitialized) {
+		if (fontWarmupThread) {
+			g_thread_join (fontWarmupThread);
+			fontWarmupThread = NULL;
+		}
 		releaseCodecList ();
 		gdip_font_clear_pattern_cache ();
+#ifdef USE_PANGO_RENDERING
+		gdip_pango_clear_layout_cache ();
+#else
+		gdip_text_cairo_clear_advance_cache ();
+#endif
 		gdip_delete_system_fonts ();
 		gdip_delete_generic_stringformats ();
 #if HAVE_FCFINI
-		FcFini ();
+		if (fontconfigInitialized)
+			FcFini ();
 #endif
+		fontconfigInitialized = FALSE;
 		gdiplusInitialized = FALSE; /* in case we want to restart it */
 		suppressBackgroundThread = FALSE;
 	}
@@ -816,3 +883,71 @@ gdip_crc32 (const BYTE *buf, size_t size)
 
 	return crc;
 }
+
+typedef struct {
+	GdipRowBandFunc	func;
+	void		*user_data;
+	int		y_start;
+	int		y_end;
+} GpRowBand;
+
+static gpointer
+gdip_row_band_thread (gpointer data)
+{
+	GpRowBand *band = (GpRowBand *) data;
+
+	band->func (band->y_start, band->y_end, band->user_data);
+	return NULL;
+}
+
+/*
+ * Split [0, height) into horizontal bands and run func on each one. Small images (less than
+ * GDIP_ROW_BANDS_MIN_BYTES of pixel data) are processed on the calling thread, larger ones are
+ * spread over up to GDIP_ROW_BANDS_MAX_THREADS threads. func must only touch the rows it is given.
+ */
+void
+gdip_process_row_bands (int height, size_t bytes_per_row, GdipRowBandFunc func, void *user_data)
+{
+	GpRowBand bands[GDIP_ROW_BANDS_MAX_THREADS];
+	GThread *threads[GDIP_ROW_BANDS_MAX_THREADS];
+	int count, i, rows;
+
+	if (height <= 0)
+		return;
+
+	count = 1;
+	if ((size_t) height * bytes_per_row >= GDIP_ROW_BANDS_MIN_BYTES) {
+		count = (int) g_get_num_processors ();
+		if (count > GDIP_ROW_BANDS_MAX_THREADS)
+			count = GDIP_ROW_BANDS_MAX_THREADS;
+		/* don't bother creating bands that are only a few rows high */
+		if (count > height / 16)
+			count = height / 16;
+	}
+
+	if (count <= 1) {
+		func (0, height, user_data);
+		return;
+	}
+
+	rows = (height + count - 1) / count;
+	for (i = 0; i < count; i++) {
+		bands[i].func = func;
+		bands[i].user_data = user_data;
+		bands[i].y_start = i * rows;
+		bands[i].y_end = min ((i + 1) * rows, height);
+	}
+
+	/* the calling thread handles the first band itself */
+	for (i = 1; i < count; i++)
+		threads[i] = g_thread_try_new ("gdiplus-band", gdip_row_band_thread, &bands[i], NULL);
+
+	func (bands[0].y_start, bands[0].y_end, user_data);
+
+	for (i = 1; i < count; i++) {
+		if (threads[i])
+			g_thread_join (threads[i]);
+		else
+			func (bands[i].y_start, bands[i].y_end, user_data);
+	}
+}
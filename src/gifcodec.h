@@ -18,8 +18,10 @@ GpStatus gdip_load_gif_image_from_file (FILE *fp, GpImage **image) GDIP_INTERNAL
 
 GpStatus gdip_load_gif_image_from_stream_delegate (GetBytesDelegate getBytesFunc, SeekDelegate seekFunc, 
 	GpImage **image) GDIP_INTERNAL;
+
+GpStatus gdip_load_gif_image_from_memory (MemorySource *source, GpImage **image) GDIP_INTERNAL;
 					   
-GpStatus gdip_save_gif_image_to_file (unsigned char *filename, GpImage *image) GDIP_INTERNAL;
+GpStatus gdip_save_gif_image_to_file (unsigned char *filename, GpImage *image, GDIPCONST EncoderParameters *params) GDIP_INTERNAL;
 
 GpStatus gdip_save_gif_image_to_stream_delegate (PutBytesDelegate putBytesFunc, GpImage *image, 
 	GDIPCONST EncoderParameters *params) GDIP_INTERNAL;
@@ -36,4 +38,11 @@ typedef struct
   LONG saveFlagValue;
 } GifEncoderParameters;
 
+/*
+ * Frames that aren't indexed are reduced to 256 colors, see gdip_quantize_argb. libgdiplus specific encoder parameter:
+ *
+ * GdipEncoderGifDither {3c5f1d2e-8a47-4b9c-b6e0-71d2f49a8c53}: EncoderParameterValueTypeLong, non zero to spread the
+ *	quantization error with Floyd-Steinberg dithering, which hides banding in gradients. Defaults to 0.
+ */
+
 #endif /* _GIFCODEC_H */
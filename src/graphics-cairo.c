@@ -728,6 +728,24 @@ cairo_FillRegion (GpGraphics *graphics, GpBrush *brush, GpRegion *region)
 		if (!region->bitmap)
 			return OutOfMemory;
 
+		/* bitmaps too big for a mask are filled one band of spans at a time */
+		if (region->bitmap->Spans) {
+			int count = gdip_region_bitmap_get_scans (region->bitmap, NULL);
+			GpRectF *rects;
+
+			if (count == 0)
+				return Ok;
+
+			rects = (GpRectF *) GdipAlloc (count * sizeof (GpRectF));
+			if (!rects)
+				return OutOfMemory;
+
+			gdip_region_bitmap_get_scans (region->bitmap, rects);
+			status = cairo_FillRectangles (graphics, brush, rects, count);
+			GdipFree (rects);
+			return status;
+		}
+
 		mask_surface = gdip_region_bitmap_to_cairo_surface (region->bitmap);
 		cairo_save (graphics->ct);
 	
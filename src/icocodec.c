@@ -334,3 +334,9 @@ gdip_load_ico_image_from_stream_delegate (dstream_t *loader, GpImage **image)
 {
 	return gdip_read_ico_image_from_file_stream ((void *)loader, image, DStream);
 }
+
+GpStatus
+gdip_load_ico_image_from_memory (MemorySource *source, GpImage **image)
+{
+	return gdip_read_ico_image_from_file_stream ((void *)source, image, Memory);
+}
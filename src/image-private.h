@@ -60,6 +60,9 @@ BOOL gdip_is_an_indexed_pixelformat (PixelFormat pixfmt) GDIP_INTERNAL;
 
 void gdip_image_init (GpImage *image) GDIP_INTERNAL;
 
+ImageFormat get_image_format (char *sig_read, size_t size_read, ImageFormat *final) GDIP_INTERNAL;
+ImageFormat gdip_get_imageformat_from_codec_clsid (CLSID *encoderCLSID) GDIP_INTERNAL;
+
 #include "image.h"
 
 #endif
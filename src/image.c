@@ -46,6 +46,12 @@
 #include "emfcodec.h"
 #include "wmfcodec.h"
 
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 /*
  * format guids
  */
@@ -72,6 +78,12 @@ GUID GdipEncoderTransformation = {0x8D0EB2D1U, 0x0A58EU, 0x4EA8U, {0x0AA, 0x14,
 GUID GdipEncoderQuality = {0x1D5BE4B5U, 0x0FA4AU, 0x452DU, {0x9C, 0x0DD, 0x5D, 0x0B3, 0x51, 0x5, 0x0E7, 0x0EB}};
 GUID GdipEncoderLuminanceTable = {0x0EDB33BCEU, 0x266U, 0x4A77U, {0x0B9, 0x4, 0x27, 0x21, 0x60, 0x99, 0x0E7, 0x17}};
 GUID GdipEncoderChrominanceTable = {0x0F2E455DCU, 0x9B3U, 0x4316U, {0x82, 0x60, 0x67, 0x6A, 0x0DA, 0x32, 0x48, 0x1C}};
+/* libgdiplus extensions, see gifcodec.h, pngcodec.h and tiffcodec.h */
+GUID GdipEncoderPngCompressionLevel = {0x55273C16U, 0xA11EU, 0x4EB0U, {0x8F, 0xD8, 0x2F, 0x05, 0xE7, 0x5E, 0xC1, 0x0F}};
+GUID GdipEncoderPngFilter = {0xCE9D2466U, 0x11B4U, 0x4355U, {0xA0, 0x97, 0x6E, 0x53, 0x20, 0xD1, 0x4F, 0x00}};
+GUID GdipEncoderPngParallel = {0x638A7A4DU, 0x570BU, 0x46E7U, {0x81, 0x0B, 0x05, 0x47, 0x87, 0xDD, 0x41, 0x69}};
+GUID GdipEncoderTiffTileSize = {0x93EA0A28U, 0xC5B0U, 0x422DU, {0xA9, 0x05, 0x6C, 0x56, 0x91, 0x73, 0x36, 0xC1}};
+GUID GdipEncoderGifDither = {0x3C5F1D2EU, 0x8A47U, 0x4B9CU, {0xB6, 0xE0, 0x71, 0xD2, 0xF4, 0x9A, 0x8C, 0x53}};
 
 #define DECODERS_SUPPORTED 8
 #define ENCODERS_SUPPORTED 5
@@ -136,7 +148,7 @@ signature_match (char *data, size_t data_size, int size, int count, BYTE* sig_pa
 	return FALSE;
 }
 
-static ImageFormat 
+ImageFormat
 get_image_format (char *sig_read, size_t size_read, ImageFormat *final)
 {
 	ImageCodecInfo *decoder = (ImageCodecInfo*)g_decoder_list;
@@ -210,12 +222,14 @@ gdip_flip_x (GpImage *image)
 	stride = image->active_bitmap->stride;
 	width = image->active_bitmap->width;
 	height = image->active_bitmap->height;
-	pixel_size = gdip_get_pixel_format_components (image->active_bitmap->pixel_format) * gdip_get_pixel_format_depth (image->active_bitmap->pixel_format) / 8;
+	pixel_size = gdip_get_pixel_format_bpp (image->active_bitmap->pixel_format) / 8;
 	line = GdipAlloc (stride);
 	if (!line) {
 		return OutOfMemory;
 	}
 
+	/* bring scan0 up to date with whatever was drawn on the premultiplied surface */
+	gdip_bitmap_flush_surface (image);
 	src = (BYTE *) image->active_bitmap->scan0;
 	
 	for (i = 0; i < height; i++, src += stride) {
@@ -228,6 +242,8 @@ gdip_flip_x (GpImage *image)
 	
 	GdipFree (line);
 
+	/* the surfaces are recreated from the flipped scan0 when needed */
+	gdip_bitmap_invalidate_surface (image);
 	return Ok;
 }
 
@@ -248,6 +264,7 @@ gdip_flip_y (GpImage *image)
 		return OutOfMemory;
 	}
 
+	gdip_bitmap_flush_surface (image);
 	src = (BYTE *) image->active_bitmap->scan0;
 	trg = (BYTE *) image->active_bitmap->scan0;
 	trg +=  (height-1) * stride;
@@ -260,6 +277,7 @@ gdip_flip_y (GpImage *image)
 	
 	GdipFree (line);
 
+	gdip_bitmap_invalidate_surface (image);
 	return Ok;
 }
 
@@ -304,14 +322,18 @@ GdipGetImageGraphicsContext (GpImage *image, GpGraphics **graphics)
 
 	/*
 	 * Microsoft GDI+ only supports these pixel formats Format24bppRGB, Format32bppARGB, 
-	 * Format32bppPARGB, Format32bppRGB, Format48bppRGB, Format64bppARGB, Format64bppPARGB
-	 * but we're limited to 24/32 inside libgdiplus
+	 * Format32bppPARGB, Format32bppRGB, Format48bppRGB, Format64bppARGB, Format64bppPARGB.
+	 * The 48/64bpp ones are drawn on a 32bpp premultiplied surface, only the pixels that
+	 * were drawn are written back to scan0 and reduced to 8 bits per channel
 	 */
 	switch (image->active_bitmap->pixel_format) {
 	case PixelFormat24bppRGB:
 	case PixelFormat32bppARGB:
 	case PixelFormat32bppPARGB:
 	case PixelFormat32bppRGB:
+	case PixelFormat48bppRGB:
+	case PixelFormat64bppARGB:
+	case PixelFormat64bppPARGB:
 		break;
 	default:
 		return OutOfMemory;
@@ -333,6 +355,7 @@ GdipGetImageGraphicsContext (GpImage *image, GpGraphics **graphics)
 
 	gfx->image = image;
 	gfx->type = gtMemoryBitmap;
+	gdip_bitmap_surface_add_graphics (image, gfx->ct);
 	filter = cairo_pattern_create_for_surface (image->surface);
 	cairo_pattern_set_filter (filter, gdip_get_cairo_filter (gfx->interpolation));
 	cairo_pattern_destroy (filter);
@@ -399,14 +422,11 @@ GdipDrawImageRect (GpGraphics *graphics, GpImage *image, REAL x, REAL y, REAL wi
 			return ValueOverflow;
 
 		if (gdip_is_an_indexed_pixelformat (image->active_bitmap->pixel_format)) {
-			GpStatus status = OutOfMemory;
-			GpBitmap *rgb_bitmap = gdip_convert_indexed_to_rgb (image);
+			GpBitmap *rgb_bitmap = gdip_bitmap_get_indexed_rgb (image);
+			if (!rgb_bitmap)
+				return OutOfMemory;
 
-			if (rgb_bitmap) {
-				status = GdipDrawImageRect (graphics, rgb_bitmap, x, y, width, height);
-				GdipDisposeImage (rgb_bitmap);
-			}
-			return status;
+			return GdipDrawImageRect (graphics, rgb_bitmap, x, y, width, height);
 		}
 	}
 
@@ -495,13 +515,11 @@ GdipDrawImagePoints (GpGraphics *graphics, GpImage *image, GDIPCONST GpPointF *d
 
 	if (image->type == ImageTypeBitmap) {
 		if (gdip_is_an_indexed_pixelformat (image->active_bitmap->pixel_format)) {
-			GpStatus status = OutOfMemory;
-			GpBitmap *rgb_bitmap = gdip_convert_indexed_to_rgb (image);
-			if (rgb_bitmap) {
-				status = GdipDrawImagePoints (graphics, rgb_bitmap, dstPoints, count);
-				GdipDisposeImage(rgb_bitmap);
-			}
-			return status;
+			GpBitmap *rgb_bitmap = gdip_bitmap_get_indexed_rgb (image);
+			if (!rgb_bitmap)
+				return OutOfMemory;
+
+			return GdipDrawImagePoints (graphics, rgb_bitmap, dstPoints, count);
 		}
 		tRect.Width = image->active_bitmap->width; 
 		tRect.Height = image->active_bitmap->height;
@@ -629,17 +647,14 @@ GdipDrawImageRectRect (GpGraphics *graphics, GpImage *image,
 
 	if (image->type == ImageTypeBitmap) {
 		if (gdip_is_an_indexed_pixelformat (image->active_bitmap->pixel_format)) {
-			GpBitmap *rgb_bitmap = gdip_convert_indexed_to_rgb (image);
+			GpBitmap *rgb_bitmap = gdip_bitmap_get_indexed_rgb (image);
 			if (!rgb_bitmap)
 				return OutOfMemory;
 
-			status = GdipDrawImageRectRect (graphics, rgb_bitmap,
+			return GdipDrawImageRectRect (graphics, rgb_bitmap,
 				dstx, dsty, dstwidth, dstheight,
 				srcx, srcy, srcwidth, srcheight,
 				srcUnit, imageAttributes, callback, callbackData);
-			GdipDisposeImage (rgb_bitmap);
-
-			return status;
 		}
 	} else {
 		/* metafile support */
@@ -674,149 +689,33 @@ GdipDrawImageRectRect (GpGraphics *graphics, GpImage *image,
 	cairo_matrix_init (&mat, 1, 0, 0, 1, 0, 0);
 
 	if (imageAttributes && imageAttributes->wrapmode != WrapModeClamp) {
-		float		posx;
-		float		posy;
-		BOOL		flipXOn = (imageAttributes->wrapmode == WrapModeTileFlipX);
-		BOOL		flipYOn = (imageAttributes->wrapmode == WrapModeTileFlipY);
-		BOOL		flipX = FALSE;
-		BOOL		flipY = FALSE;
-		GpBitmap	*imgflipX = NULL;
-		GpBitmap	*imgflipY = NULL;
-		GpBitmap	*imgflipXY = NULL;
-
-		float img_width = preprocessed_image->active_bitmap->width *  (dstwidth / srcwidth);
-		float img_height = preprocessed_image->active_bitmap->height * (dstheight / srcheight);
-		cairo_surface_t *cur_surface;
-
-		if (imageAttributes->wrapmode == WrapModeTileFlipXY) {
-			flipXOn = flipYOn = TRUE;
-		}
-		
-		if (flipXOn) {			
-			/* We're ok just cloning the bitmap, we don't need the image data
-			 * and we destroy it before we leave this function */
-			status = gdip_bitmap_clone (preprocessed_image, &imgflipX);
-			if (status != Ok) {
-				gdip_bitmap_dispose(imgflipX);
-				return status;
-			}
-
-			status = gdip_flip_x (imgflipX);
-			if (status != Ok) {
-				gdip_bitmap_dispose (imgflipX);
-				return status;
-			}
-
-			gdip_bitmap_ensure_surface (imgflipX);
-		}
-		
-		if (flipYOn) {			
-			status = gdip_bitmap_clone (preprocessed_image, &imgflipY);
-			if (status != Ok) {
-				gdip_bitmap_dispose(imgflipX);
-				gdip_bitmap_dispose(imgflipY);
-				return status;
-			}
-
-			status = gdip_flip_y (imgflipY);
-			if (status != Ok) {
-				gdip_bitmap_dispose (imgflipX);
-				gdip_bitmap_dispose (imgflipY);
-				return status;
-			}
-
-			gdip_bitmap_ensure_surface (imgflipY);			
-		}
-		
-		if (flipXOn && flipYOn) {			
-			status = gdip_bitmap_clone (preprocessed_image, &imgflipXY);
-			if (status != Ok) {
-				gdip_bitmap_dispose(imgflipX);
-				gdip_bitmap_dispose(imgflipY);
-				gdip_bitmap_dispose(imgflipXY);
-				return status;
-			}
-
-			status = gdip_flip_x (imgflipXY);
-			if (status != Ok) {
-				gdip_bitmap_dispose(imgflipX);
-				gdip_bitmap_dispose(imgflipY);
-				gdip_bitmap_dispose(imgflipXY);
-				return status;
-			}
-
-			status = gdip_flip_y (imgflipXY);
-			if (status != Ok) {
-				gdip_bitmap_dispose(imgflipX);
-				gdip_bitmap_dispose(imgflipY);
-				gdip_bitmap_dispose(imgflipXY);
-				return status;
-			}
-
-			gdip_bitmap_ensure_surface (imgflipXY);			
+		/* a single repeated pattern covers the destination, the flipping modes repeat a tile with the mirror images */
+		cairo_surface_t *tile = gdip_bitmap_get_tile_surface (preprocessed_image, imageAttributes->wrapmode);
+		if (!tile) {
+			if (preprocessed_image != image)
+				GdipDisposeImage ((GpImage *) preprocessed_image);
+			return OutOfMemory;
 		}
-		
-		gdip_bitmap_ensure_surface (preprocessed_image);
-
-		for (posy = 0; posy < dstheight; posy += img_height) {
-			for (posx = 0; posx < dstwidth; posx += img_width) {
-				if (flipX && flipY) {
-					cur_surface = imgflipXY->surface;
-				} else {
-					if (flipX) {
-						cur_surface = imgflipX->surface;
-					} else {
-						if (flipY) {
-							cur_surface = imgflipY->surface;
-						} else {
-							cur_surface = preprocessed_image->surface;
-						}
-					}
-				}
-
-				cairo_matrix_translate (&mat, srcx, srcy);
-				cairo_matrix_scale (&mat, srcwidth / dstwidth, srcheight / dstheight);
-				cairo_matrix_translate (&mat, - (dstx + posx), - (dsty + posy));
 
-				pattern = cairo_pattern_create_for_surface (cur_surface);
-				cairo_pattern_set_matrix (pattern, &mat);
-
-				orig = cairo_get_source (graphics->ct);
-				cairo_pattern_reference (orig);
-
-				cairo_set_source (graphics->ct, pattern);
-				cairo_rectangle (graphics->ct, dstx + posx, dsty + posy, img_width, img_height);
-				cairo_fill (graphics->ct);
-
-				cairo_set_source (graphics->ct, orig);
-
-				cairo_matrix_init_identity (&mat);
-				cairo_pattern_set_matrix (pattern, &mat);
+		cairo_matrix_translate (&mat, srcx, srcy);
+		cairo_matrix_scale (&mat, srcwidth / dstwidth, srcheight / dstheight);
+		cairo_matrix_translate (&mat, -dstx, -dsty);
 
-				cairo_pattern_destroy (orig);
-				cairo_pattern_destroy (pattern);
+		pattern = cairo_pattern_create_for_surface (tile);
+		cairo_pattern_set_matrix (pattern, &mat);
+		cairo_pattern_set_extend (pattern, CAIRO_EXTEND_REPEAT);
 
-				if (flipXOn) {
-					flipX = !flipX;
-				}
-			}
+		orig = cairo_get_source (graphics->ct);
+		cairo_pattern_reference (orig);
 
-			if (flipYOn) {
-				flipY = !flipY; 
-			}
-		}	
-		
-		if (imgflipX) {
-			GdipDisposeImage ((GpImage *) imgflipX);
-		}
-			
-		if (imgflipY) {
-			GdipDisposeImage ((GpImage *) imgflipY);
-		}
+		cairo_set_source (graphics->ct, pattern);
+		cairo_rectangle (graphics->ct, dstx, dsty, dstwidth, dstheight);
+		cairo_fill (graphics->ct);
 
-		if (imgflipXY) {
-			GdipDisposeImage ((GpImage *) imgflipXY);
-		}
+		cairo_set_source (graphics->ct, orig);
+		cairo_pattern_destroy (orig);
+		cairo_pattern_destroy (pattern);
+		cairo_surface_destroy (tile);
 	} else {
 		cairo_pattern_t *filter;
 
@@ -991,11 +890,200 @@ GdipSaveImageToStream (GpImage *image, void *stream, GDIPCONST CLSID *encoderCLS
 	return NotImplemented; /* GdipSaveImageToStream - not supported */
 }
 
-/* coverity[+alloc : arg-*1] */
-GpStatus WINGDIPAPI 
-GdipLoadImageFromFile (GDIPCONST WCHAR *file, GpImage **image)
+/* Map the whole of @fp, returns NULL if it can't be mapped and must be read through stdio */
+GpFileMapping*
+gdip_file_mapping_new (FILE *fp)
+{
+	return gdip_file_mapping_new_from_fd (fileno (fp));
+}
+
+/* Map the whole file open on @fd, as it is now, which is how deferred sources read the file again */
+GpFileMapping*
+gdip_file_mapping_new_from_fd (int fd)
+{
+#ifdef HAVE_SYS_MMAN_H
+	GpFileMapping	*mapping;
+	struct stat	st;
+	void		*ptr;
+
+	/* MemorySource can't address more than 2GB */
+	if (fstat (fd, &st) != 0 || !S_ISREG (st.st_mode) || st.st_size <= 0 || st.st_size > G_MAXINT32)
+		return NULL;
+
+	ptr = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (ptr == MAP_FAILED)
+		return NULL;
+
+	mapping = GdipAlloc (sizeof (GpFileMapping));
+	if (!mapping) {
+		munmap (ptr, st.st_size);
+		return NULL;
+	}
+
+	mapping->ptr = ptr;
+	mapping->size = st.st_size;
+	mapping->fd = fd;
+	mapping->ref_count = 1;
+	return mapping;
+#else
+	return NULL;
+#endif
+}
+
+/*
+ * Codecs that keep reading the mapping after loading hold their own reference. The pixels of a deferred
+ * source are not decoded from it though: reading a mapping of a file truncated since raises SIGBUS, so those
+ * keep a duplicate of fd and map the file again when they decode, see gdip_file_mapping_new_from_fd.
+ */
+GpFileMapping*
+gdip_file_mapping_ref (GpFileMapping *mapping)
+{
+	mapping->ref_count++;
+	return mapping;
+}
+
+void
+gdip_file_mapping_unref (GpFileMapping *mapping)
+{
+	if (--mapping->ref_count > 0)
+		return;
+
+#ifdef HAVE_SYS_MMAN_H
+	munmap (mapping->ptr, mapping->size);
+#endif
+	GdipFree (mapping);
+}
+
+/*
+ * The file of an image loaded from a mapping by a codec that only parsed its header. Like for the JPEG and TIFF
+ * codecs the file is kept open and mapped again when the pixels are needed, then decoded as a whole by load.
+ */
+typedef struct {
+	int		fd;
+	GpMemoryLoadFunc	load;
+} GpMappedDeferredSource;
+
+static GpStatus
+gdip_mapped_deferred_load (void *source, UINT minWidth, UINT minHeight, GpImage **image)
+{
+	GpMappedDeferredSource *deferred = (GpMappedDeferredSource *) source;
+	GpFileMapping *mapping;
+	MemorySource memory;
+	GpStatus status;
+
+	mapping = gdip_file_mapping_new_from_fd (deferred->fd);
+	if (!mapping)
+		return OutOfMemory;
+
+	memory.ptr = mapping->ptr;
+	memory.size = mapping->size;
+	memory.pos = 0;
+	status = deferred->load (&memory, image);
+	gdip_file_mapping_unref (mapping);
+	return status;
+}
+
+static void
+gdip_mapped_deferred_free (void *source)
+{
+	GpMappedDeferredSource *deferred = (GpMappedDeferredSource *) source;
+
+#ifdef HAVE_SYS_MMAN_H
+	close (deferred->fd);
+#endif
+	GdipFree (deferred);
+}
+
+/*
+ * Makes @image, loaded from @mapping without its pixels, decode them with @load on first use. Returns FALSE if the
+ * file can't be kept open, the caller must then decode the pixels now.
+ */
+BOOL
+gdip_file_mapping_defer_load (GpFileMapping *mapping, GpImage *image, GpMemoryLoadFunc load)
+{
+#ifdef HAVE_SYS_MMAN_H
+	GpMappedDeferredSource *deferred;
+
+	deferred = GdipAlloc (sizeof (GpMappedDeferredSource));
+	if (!deferred)
+		return FALSE;
+
+	deferred->fd = dup (mapping->fd);
+	if (deferred->fd < 0) {
+		GdipFree (deferred);
+		return FALSE;
+	}
+
+	deferred->load = load;
+	gdip_bitmap_set_deferred_source (image, gdip_mapped_deferred_load, NULL, gdip_mapped_deferred_free, deferred);
+	return TRUE;
+#else
+	return FALSE;
+#endif
+}
+
+static GpStatus
+gdip_load_image_from_stdio (FILE *fp, ImageFormat format, const char *file_name, UINT minWidth, UINT minHeight, GpImage **image)
+{
+	switch (format) {
+	case BMP:
+		return gdip_load_bmp_image_from_file (fp, image);
+	case TIF:
+		return gdip_load_tiff_image_from_file (fp, image);
+	case GIF:
+		return gdip_load_gif_image_from_file (fp, image);
+	case PNG:
+		return gdip_load_png_image_from_file (fp, image);
+	case JPEG:
+		return gdip_load_jpeg_image_from_file (fp, file_name, minWidth, minHeight, image);
+	case ICON:
+		return gdip_load_ico_image_from_file (fp, image);
+	case WMF:
+		return gdip_load_wmf_image_from_file (fp, image);
+	case EMF:
+		return gdip_load_emf_image_from_file (fp, image);
+	case EXIF:
+		return NotImplemented;
+	default:
+		return OutOfMemory;
+	}
+}
+
+/* Same as gdip_load_image_from_stdio, but the codecs read straight from the mapped file */
+static GpStatus
+gdip_load_image_from_mapping (GpFileMapping *mapping, ImageFormat format, const char *file_name, UINT minWidth, UINT minHeight, GpImage **image)
+{
+	MemorySource ms = { mapping->ptr, mapping->size, 0 };
+
+	switch (format) {
+	case BMP:
+		return gdip_load_bmp_image_from_mapping (mapping, image);
+	case TIF:
+		return gdip_load_tiff_image_from_mapping (mapping, image);
+	case GIF:
+		return gdip_load_gif_image_from_memory (&ms, image);
+	case PNG:
+		return gdip_load_png_image_from_mapping (mapping, image);
+	case JPEG:
+		return gdip_load_jpeg_image_from_mapping (mapping, file_name, minWidth, minHeight, image);
+	case ICON:
+		return gdip_load_ico_image_from_memory (&ms, image);
+	case WMF:
+		return gdip_load_wmf_image_from_memory (&ms, image);
+	case EMF:
+		return gdip_load_emf_image_from_memory (&ms, image);
+	case EXIF:
+		return NotImplemented;
+	default:
+		return OutOfMemory;
+	}
+}
+
+static GpStatus
+gdip_load_image_from_file (GDIPCONST WCHAR *file, UINT minWidth, UINT minHeight, GpImage **image)
 {
 	FILE		*fp = NULL;
+	GpFileMapping	*mapping;
 	GpImage		*result = NULL;
 	GpStatus	status = Ok;
 	ImageFormat	format, public_format;
@@ -1024,38 +1112,13 @@ GdipLoadImageFromFile (GDIPCONST WCHAR *file, GpImage **image)
 	format_peek_sz = fread (format_peek, 1, MAX_CODEC_SIG_LENGTH, fp);
 	format = get_image_format (format_peek, format_peek_sz, &public_format);
 	fseek (fp, 0, SEEK_SET);
-	
-	switch (format) {
-	case BMP:
-		status = gdip_load_bmp_image_from_file (fp, &result);
-		break;
-	case TIF:
-		status = gdip_load_tiff_image_from_file (fp, &result);
-		break;
-	case GIF:
-		status = gdip_load_gif_image_from_file (fp, &result);
-		break;
-	case PNG:
-		status = gdip_load_png_image_from_file (fp, &result);
-		break;
-	case JPEG:
-		status = gdip_load_jpeg_image_from_file (fp, file_name, &result);
-		break;
-	case ICON:
-		status = gdip_load_ico_image_from_file (fp, &result);
-		break;
-	case WMF:
-		status = gdip_load_wmf_image_from_file (fp, &result);
-		break;
-	case EMF:
-		status = gdip_load_emf_image_from_file (fp, &result);
-		break;
-	case EXIF:
-		status = NotImplemented;
-		break;
-	default:
-		status = OutOfMemory;
-		break;
+
+	mapping = gdip_file_mapping_new (fp);
+	if (mapping) {
+		status = gdip_load_image_from_mapping (mapping, format, file_name, minWidth, minHeight, &result);
+		gdip_file_mapping_unref (mapping);
+	} else {
+		status = gdip_load_image_from_stdio (fp, format, file_name, minWidth, minHeight, &result);
 	}
 
 	if (result && (status == Ok))
@@ -1075,8 +1138,22 @@ GdipLoadImageFromFile (GDIPCONST WCHAR *file, GpImage **image)
 	return status;
 }
 
+/* coverity[+alloc : arg-*1] */
+GpStatus WINGDIPAPI 
+GdipLoadImageFromFile (GDIPCONST WCHAR *file, GpImage **image)
+{
+	return gdip_load_image_from_file (file, 0, 0, image);
+}
+
+/* libgdiplus extension: only the JPEG codec can decode at a lower resolution, other formats are loaded at full size */
+GpStatus WINGDIPAPI
+GdipLoadImageFromFileScaled_linux (GDIPCONST WCHAR *file, UINT minWidth, UINT minHeight, GpImage **image)
+{
+	return gdip_load_image_from_file (file, minWidth, minHeight, image);
+}
+
 /* Note: use only for encoders (there's more decoders than encoders) */
-static ImageFormat 
+ImageFormat
 gdip_get_imageformat_from_codec_clsid (CLSID *encoderCLSID)
 {
 	GpStatus status;
@@ -1125,6 +1202,10 @@ GdipSaveImageToFile (GpImage *image, GDIPCONST WCHAR *file, GDIPCONST CLSID *enc
 	if (format == INVALID)
 		return UnknownImageFormat;
 	
+	status = gdip_bitmap_ensure_pixels (image);
+	if (status != Ok)
+		return status;
+
 	file_name = (char *) utf16_to_utf8 ((const gunichar2 *)file, -1);
 	if (file_name == NULL)
 		return InvalidParameter;
@@ -1132,7 +1213,7 @@ GdipSaveImageToFile (GpImage *image, GDIPCONST WCHAR *file, GDIPCONST CLSID *enc
 	gdip_bitmap_flush_surface (image);
 	
 	if (format == GIF) { /* gif library has to open the file itself*/
-		status = gdip_save_gif_image_to_file ((BYTE*)file_name, image);
+		status = gdip_save_gif_image_to_file ((BYTE*)file_name, image, params);
 		GdipFree (file_name);
 		return status;
 	} else if (format == TIF) { 
@@ -1505,13 +1586,9 @@ gdip_rotate_orthogonal_flip_x (GpImage *image, int angle, BOOL flip_x)
 	int	source_stride, source_height, source_width, source_pixel_delta, source_interscan_delta;
 	int	target_stride, target_height, target_width, target_pixel_delta, target_interscan_delta;
 	int	initial_source_offset, initial_target_offset;
-	int	components;
-	int	depth;
 	int	pixel_size;
 
-	components = gdip_get_pixel_format_components (image->active_bitmap->pixel_format);
-	depth = gdip_get_pixel_format_depth (image->active_bitmap->pixel_format);
-	pixel_size = components * depth / 8;
+	pixel_size = gdip_get_pixel_format_bpp (image->active_bitmap->pixel_format) / 8;
 
 	source_stride = image->active_bitmap->stride;
 	source_width = image->active_bitmap->width;
@@ -1589,14 +1666,9 @@ gdip_rotate_orthogonal_flip_x (GpImage *image, int angle, BOOL flip_x)
 		return OutOfMemory;
 	}
 
-	int isSurfaceSource = 0;
-	if (image->surface != NULL && gdip_bitmap_format_needs_premultiplication(image)) {
-		isSurfaceSource = 1;
-		source = initial_source_offset + (BYTE*)(cairo_image_surface_get_data(image->surface));
-	}
-	else {
-		source = initial_source_offset + (BYTE *)image->active_bitmap->scan0;
-	}
+	/* bring scan0 up to date with whatever was drawn on the premultiplied surface */
+	gdip_bitmap_flush_surface (image);
+	source = initial_source_offset + (BYTE *)image->active_bitmap->scan0;
 	target = initial_target_offset + rotated;
 
 	for (y = 0; y < source_height;
@@ -1622,15 +1694,8 @@ gdip_rotate_orthogonal_flip_x (GpImage *image, int angle, BOOL flip_x)
 	image->active_bitmap->scan0 = rotated;
 	image->active_bitmap->reserved |= GBD_OWN_SCAN0;
 
-	if (isSurfaceSource == 0) {
-		gdip_bitmap_flush_surface (image);
-		gdip_bitmap_invalidate_surface (image);
-	} else {
-		/* recalculate surface from rotated scan0 */
-		cairo_surface_destroy(image->surface);
-		image->surface = NULL;
-		gdip_bitmap_ensure_surface(image);
-	}
+	/* the surface is recreated from the rotated scan0 when needed */
+	gdip_bitmap_invalidate_surface (image);
 
 	return Ok;
 }
@@ -1817,8 +1882,9 @@ gdip_rotate_flip_packed_indexed (GpImage *image, PixelFormat pixel_format, int a
 GpStatus WINGDIPAPI 
 GdipImageRotateFlip (GpImage *image, RotateFlipType type)
 {
-	int	angle;
-	BOOL	flip_x;
+	int		angle;
+	BOOL		flip_x;
+	GpStatus	status;
 
 	if (!image)
 		return InvalidParameter;
@@ -1827,6 +1893,10 @@ GdipImageRotateFlip (GpImage *image, RotateFlipType type)
 	if (image->type != ImageTypeBitmap)
 		return NotImplemented;
 
+	status = gdip_bitmap_ensure_pixels (image);
+	if (status != Ok)
+		return status;
+
 	angle = flip_x = 0;
 
 	switch (type) {
@@ -1933,6 +2003,7 @@ GdipSetImagePalette (GpImage *image, GDIPCONST ColorPalette *palette)
 	}
 
 	memcpy (image->active_bitmap->palette, palette, size);
+	image->generation++;
 	return Ok;
 }
 
@@ -2155,10 +2226,13 @@ GdipCloneImage (GpImage *image, GpImage **cloneImage)
 		return InvalidParameter;
 
 	switch (image->type){
-	case ImageTypeBitmap:
-		gdip_bitmap_clone (image, cloneImage);
+	case ImageTypeBitmap: {
+		GpStatus status = gdip_bitmap_clone (image, cloneImage);
+		if (status != Ok)
+			return status;
 		gdip_bitmap_setactive(*cloneImage, NULL, 0);
 		return Ok;
+	}
 
 	case ImageTypeMetafile:
 		return gdip_metafile_clone ((GpMetafile*)image, (GpMetafile**)cloneImage);
@@ -2172,7 +2246,16 @@ GdipCloneImage (GpImage *image, GpImage **cloneImage)
 int 
 gdip_get_pixel_format_bpp (PixelFormat pixfmt)
 {
-	return gdip_get_pixel_format_depth (pixfmt) * gdip_get_pixel_format_components (pixfmt);
+	switch (pixfmt) {
+		case PixelFormat16bppARGB1555:
+		case PixelFormat16bppGrayScale:
+		case PixelFormat16bppRGB555:
+		case PixelFormat16bppRGB565:
+			return 16;
+
+		default:
+			return gdip_get_pixel_format_depth (pixfmt) * gdip_get_pixel_format_components (pixfmt);
+	}
 }
 
 int
@@ -2318,9 +2401,15 @@ GdipSaveImageToDelegate_linux (GpImage *image, GetBytesDelegate getBytesFunc, Pu
 	SeekDelegate seekFunc, CloseDelegate closeFunc, SizeDelegate sizeFunc, GDIPCONST CLSID *encoderCLSID,
 	GDIPCONST EncoderParameters *params)
 {
+	GpStatus status;
+
 	if (!image || !encoderCLSID || (image->type != ImageTypeBitmap))
 		return InvalidParameter;
 
+	status = gdip_bitmap_ensure_pixels (image);
+	if (status != Ok)
+		return status;
+
 	gdip_bitmap_flush_surface (image);
 
 	switch (gdip_get_imageformat_from_codec_clsid ((CLSID *)encoderCLSID)) {
@@ -2613,6 +2702,8 @@ GdipGetImageThumbnail (GpImage *image, UINT thumbWidth, UINT thumbHeight, GpImag
 	GpStatus status;
 	PixelFormat format;
 	GpImage *result;
+	GpImage *source = image;
+	GpBitmap *scaled = NULL;
 	GpGraphics *graphics;
 
 	if (!image || !thumbImage)
@@ -2634,26 +2725,33 @@ GdipGetImageThumbnail (GpImage *image, UINT thumbWidth, UINT thumbHeight, GpImag
 		return InvalidParameter;
 	}
 
+	/* a lazily loaded image can be decoded straight at (about) the thumbnail size */
+	if (image->type == ImageTypeBitmap && gdip_bitmap_load_deferred_scaled (image, thumbWidth, thumbHeight, &scaled) == Ok)
+		source = scaled;
+
 	status = GdipCreateBitmapFromScan0 (thumbWidth, thumbHeight, 0, format, NULL, (GpBitmap **) &result);
 	if (status != Ok)
-		return status;
+		goto done;
 
 	status = GdipGetImageGraphicsContext (result, &graphics);
 	if (status != Ok) {
 		GdipDisposeImage (result);
-		return status;
+		goto done;
 	}
 
-	status = GdipDrawImageRectI (graphics, image, 0, 0, thumbWidth, thumbHeight);
+	status = GdipDrawImageRectI (graphics, source, 0, 0, thumbWidth, thumbHeight);
+	GdipDeleteGraphics (graphics);
 	if (status != Ok) {
 		GdipDisposeImage (result);
-		GdipDeleteGraphics (graphics);
-		return status;
+		goto done;
 	}
 
-	GdipDeleteGraphics (graphics);
 	*thumbImage = result;
-	return Ok;
+
+done:
+	if (scaled)
+		gdip_bitmap_dispose (scaled);
+	return status;
 }
 
 /* coverity[+alloc : arg-*1] */
@@ -2703,5 +2801,9 @@ GdipImageForceValidation (GpImage *image)
 	if (!image)
 		return InvalidParameter;
 
+	/* decode the pixels of images that were loaded lazily */
+	if (image->type == ImageTypeBitmap)
+		return gdip_bitmap_ensure_pixels (image);
+
 	return Ok;
 }
@@ -50,6 +50,14 @@ GpStatus WINGDIPAPI GdipSaveImageToDelegate_linux (GpImage *image, GetBytesDeleg
 	SeekDelegate seekFunc, CloseDelegate closeFunc, SizeDelegate sizeFunc, GDIPCONST CLSID *encoderCLSID,
 	GDIPCONST EncoderParameters *params);
 
+/* Like GdipLoadImageFromFile, but JPEG images are decoded at a lower resolution that still has minWidth x minHeight pixels */
+GpStatus WINGDIPAPI GdipLoadImageFromFileScaled_linux (GDIPCONST WCHAR *file, UINT minWidth, UINT minHeight, GpImage **image);
+
+/* Converts an image file to another format and size without decoding the whole image in memory when the codecs allow it.
+   A zero width or height keeps the aspect ratio, a zero format keeps the alpha channel of the source */
+GpStatus WINGDIPAPI GdipTranscodeImageFile_linux (GDIPCONST WCHAR *source, GDIPCONST WCHAR *destination, GDIPCONST CLSID *encoderClsid,
+	GDIPCONST EncoderParameters *params, PixelFormat format, UINT width, UINT height);
+
 
 /* GDI+ exported Image functions */
 GpStatus WINGDIPAPI GdipLoadImageFromStream (void /*IStream*/ *stream, GpImage **image);
@@ -28,6 +28,10 @@
 #include "bitmap-private.h"
 #include "general-private.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 static void
 gdip_init_image_attribute (GpImageAttribute* attr)
 {
@@ -135,6 +139,344 @@ gdip_get_image_attribute (GpImageAttributes* attr, ColorAdjustType type)
 	}
 }
 
+/*
+ * The enabled attributes are compiled once into an ImageAttributesPipeline and then applied
+ * to the destination bitmap in a single pass, one scanline at a time. Per-channel operations
+ * (gamma and threshold) are folded into a lookup table and the remap table is sorted so it
+ * can be binary searched.
+ */
+typedef struct {
+	ARGB	oldColor;
+	ARGB	newColor;
+	int	index;
+} ColorRemapEntry;
+
+typedef struct {
+	ActiveBitmapData	*data;
+	BOOL			premultiplied;	/* scan0 holds PARGB values */
+	BOOL			opaque;		/* scan0 has no alpha channel */
+	/* colormap */
+	ColorRemapEntry		*remap;
+	int			remap_count;
+	/* gamma and threshold */
+	BOOL			use_channel_lut;
+	BYTE			channel_lut[256];
+	/* CMYK output channel */
+	BOOL			use_output_channel;
+	ColorChannelFlags	output_channel;
+	/* color keys */
+	BOOL			use_color_keys;
+	ARGB			key_colorlow;
+	ARGB			key_colorhigh;
+	/* color matrix */
+	ColorMatrix		*colormatrix;
+	ColorMatrix		*graymatrix;
+	ColorMatrixFlags	colormatrix_flags;
+	BOOL			matrix_premultiplied;
+} ImageAttributesPipeline;
+
+static int
+compare_color_remap_entry (const void *a, const void *b)
+{
+	const ColorRemapEntry *ea = (const ColorRemapEntry *) a;
+	const ColorRemapEntry *eb = (const ColorRemapEntry *) b;
+
+	if (ea->oldColor != eb->oldColor)
+		return (ea->oldColor < eb->oldColor) ? -1 : 1;
+
+	/* keep the first matching entry of the original table first */
+	return ea->index - eb->index;
+}
+
+static BOOL
+gdip_color_remap_lookup (const ImageAttributesPipeline *pipeline, ARGB *color)
+{
+	int low = 0;
+	int high = pipeline->remap_count;
+
+	/* lower bound, so duplicated entries resolve to the first one in the table */
+	while (low < high) {
+		int mid = (low + high) / 2;
+		if (pipeline->remap[mid].oldColor < *color)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	if (low < pipeline->remap_count && pipeline->remap[low].oldColor == *color) {
+		*color = pipeline->remap[low].newColor;
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+static ARGB
+gdip_apply_output_channel (ARGB color, ColorChannelFlags channel)
+{
+	BYTE r, g, b, a, C, M, Y, K;
+
+	get_pixel_bgra (color, b, g, r, a);
+
+	C = 255 - r;
+	M = 255 - g;
+	Y = 255 - b;
+	K = min (min (C, M), Y);
+
+	/* correct complementary color lever based on k */
+	C -= K;
+	M -= K;
+	Y -= K;
+
+	switch (channel) {
+	case ColorChannelFlagsC:
+		r = g = b = C;
+		break;
+	case ColorChannelFlagsM:
+		r = g = b = M;
+		break;
+	case ColorChannelFlagsY:
+		r = g = b = Y;
+		break;
+	default:
+		r = g = b = K;
+		break;
+	}
+
+	return ((guint32)a << 24) | (r << 16) | (g << 8) | b;
+}
+
+/* Apply the colormap, gamma, threshold, output channel and color key attributes to a scanline. */
+static void
+gdip_apply_color_adjustments_row (const ImageAttributesPipeline *pipeline, ARGB *scan, int width)
+{
+	ARGB last_in = 0, last_out = 0;
+	BOOL have_last = FALSE;
+	int x;
+
+	for (x = 0; x < width; x++) {
+		ARGB pixel = scan[x];
+		ARGB color;
+		BYTE r, g, b, a;
+
+		/* neighbouring pixels are frequently identical */
+		if (have_last && pixel == last_in) {
+			scan[x] = last_out;
+			continue;
+		}
+
+		if (pipeline->opaque) {
+			color = pixel | 0xFF000000;
+		} else if (pipeline->premultiplied) {
+			get_pixel_bgra (pixel, b, g, r, a);
+			if (a < 0xff) {
+				b = pre_multiplied_table_reverse [b][a];
+				g = pre_multiplied_table_reverse [g][a];
+				r = pre_multiplied_table_reverse [r][a];
+				color = ((guint32)a << 24) | (r << 16) | (g << 8) | b;
+			} else {
+				color = pixel;
+			}
+		} else {
+			color = pixel;
+		}
+
+		if (pipeline->remap_count > 0)
+			gdip_color_remap_lookup (pipeline, &color);
+
+		if (pipeline->use_channel_lut) {
+			const BYTE *lut = pipeline->channel_lut;
+			get_pixel_bgra (color, b, g, r, a);
+			color = ((guint32)a << 24) | (lut[r] << 16) | (lut[g] << 8) | lut[b];
+		}
+
+		if (pipeline->use_output_channel)
+			color = gdip_apply_output_channel (color, pipeline->output_channel);
+
+		if (pipeline->use_color_keys) {
+			ARGB rgb = color & ~ALPHA_MASK;
+			if (rgb >= (pipeline->key_colorlow & ~ALPHA_MASK) && rgb <= (pipeline->key_colorhigh & ~ALPHA_MASK))
+				color = 0x00FFFFFF; /* transparent white */
+		}
+
+		if (pipeline->opaque) {
+			color |= 0xFF000000;
+		} else if (pipeline->premultiplied) {
+			get_pixel_bgra (color, b, g, r, a);
+			if (a < 0xff) {
+				b = pre_multiplied_table [b][a];
+				g = pre_multiplied_table [g][a];
+				r = pre_multiplied_table [r][a];
+				color = ((guint32)a << 24) | (r << 16) | (g << 8) | b;
+			}
+		}
+
+		last_in = pixel;
+		last_out = color;
+		have_last = TRUE;
+		scan[x] = color;
+	}
+}
+
+/*
+ * Compute the new (r, g, b, a) values of a pixel. The SSE2 version evaluates the four dot products
+ * with the exact same sequence of float operations as the scalar one, so results are identical.
+ */
+static inline void
+gdip_color_matrix_transform (const ColorMatrix *cm, BYTE r, BYTE g, BYTE b, BYTE a, int *out)
+{
+#if defined(__SSE2__)
+	__m128 acc;
+
+	acc = _mm_mul_ps (_mm_set1_ps ((float) r), _mm_loadu_ps (cm->m[0]));
+	acc = _mm_add_ps (acc, _mm_mul_ps (_mm_set1_ps ((float) g), _mm_loadu_ps (cm->m[1])));
+	acc = _mm_add_ps (acc, _mm_mul_ps (_mm_set1_ps ((float) b), _mm_loadu_ps (cm->m[2])));
+	acc = _mm_add_ps (acc, _mm_mul_ps (_mm_set1_ps ((float) a), _mm_loadu_ps (cm->m[3])));
+	acc = _mm_add_ps (acc, _mm_mul_ps (_mm_set1_ps (255.0f), _mm_loadu_ps (cm->m[4])));
+	_mm_storeu_si128 ((__m128i *) out, _mm_cvttps_epi32 (acc));
+#else
+	out[0] = (r * cm->m[0][0] + g * cm->m[1][0] + b * cm->m[2][0] + a * cm->m[3][0] + (255 * cm->m[4][0]));
+	out[1] = (r * cm->m[0][1] + g * cm->m[1][1] + b * cm->m[2][1] + a * cm->m[3][1] + (255 * cm->m[4][1]));
+	out[2] = (r * cm->m[0][2] + g * cm->m[1][2] + b * cm->m[2][2] + a * cm->m[3][2] + (255 * cm->m[4][2]));
+	out[3] = (r * cm->m[0][3] + g * cm->m[1][3] + b * cm->m[2][3] + a * cm->m[3][3] + (255 * cm->m[4][3]));
+#endif
+}
+
+static void
+gdip_apply_color_matrix_row (const ImageAttributesPipeline *pipeline, ARGB *scan, int width)
+{
+	ColorMatrixFlags flags = pipeline->colormatrix_flags;
+	BOOL premultiplied = pipeline->matrix_premultiplied;
+	ARGB color;
+	BYTE *color_p = (BYTE*) &color;
+	int x;
+
+	for (x = 0; x < width; x++, scan++) {
+		const ColorMatrix *cm;
+		BYTE r, g, b, a;
+		int result[4];
+		int r_new, g_new, b_new, a_new;
+
+		get_pixel_bgra (*scan, b, g, r, a);
+
+		/* by default the matrix applies to all colors, including grays */
+		if ((flags != ColorMatrixFlagsDefault) && (b == g) && (b == r)) {
+			if (flags == ColorMatrixFlagsSkipGrays) {
+				/* does not apply */
+				continue;
+			}
+			/* ColorMatrixFlagsAltGray */
+			cm = pipeline->graymatrix;
+		} else {
+			cm = pipeline->colormatrix;
+		}
+
+		gdip_color_matrix_transform (cm, r, g, b, a, result);
+		r_new = result[0];
+		g_new = result[1];
+		b_new = result[2];
+		a_new = result[3];
+
+		if (a_new == 0 && premultiplied) {
+			/* 100% transparency, don't waste time computing other values (pre-mul will always be 0) */
+			*scan = 0;
+			continue;
+		}
+
+		if (premultiplied && a != (BYTE) a_new && a < 0xff && a != 0) {
+			/* reverse previous pre-multiplication if necessary */
+			r_new = r_new * 255 / a;
+			g_new = g_new * 255 / a;
+			b_new = b_new * 255 / a;
+		}
+
+		r = (r_new > 0xff) ? 0xff : (BYTE) r_new;
+		g = (g_new > 0xff) ? 0xff : (BYTE) g_new;
+		b = (b_new > 0xff) ? 0xff : (BYTE) b_new;
+
+		/* remember that Cairo use pre-multiplied alpha, e.g. 50% red == 0x80800000 not 0x80ff0000 */
+		if (premultiplied && a != (BYTE) a_new && a_new < 0xff) {
+			/* apply new pre-multiplication */
+			a = (BYTE) a_new;
+			r = pre_multiplied_table [r][a];
+			g = pre_multiplied_table [g][a];
+			b = pre_multiplied_table [b][a];
+		} else {
+			a = (BYTE) a_new;
+		}
+
+		set_pixel_bgra (color_p, 0, b, g, r, a);
+		*scan = color;
+	}
+}
+
+static void
+gdip_apply_image_attributes_rows (int y_start, int y_end, void *user_data)
+{
+	const ImageAttributesPipeline *pipeline = (const ImageAttributesPipeline *) user_data;
+	ActiveBitmapData *data = pipeline->data;
+	BOOL adjust_colors = pipeline->remap_count > 0 || pipeline->use_channel_lut ||
+		pipeline->use_output_channel || pipeline->use_color_keys;
+	int y;
+
+	for (y = y_start; y < y_end; y++) {
+		ARGB *scan = (ARGB *) (data->scan0 + y * data->stride);
+
+		if (adjust_colors)
+			gdip_apply_color_adjustments_row (pipeline, scan, data->width);
+		if (pipeline->colormatrix)
+			gdip_apply_color_matrix_row (pipeline, scan, data->width);
+	}
+}
+
+/*
+ * Only formats stored as 32 bits per pixel can be processed in a clone of the bitmap, and only if they have an alpha
+ * channel when colour keys make pixels transparent.
+ */
+static BOOL
+gdip_attributes_can_process_in_place (ActiveBitmapData *data, BOOL needs_alpha)
+{
+	switch (data->pixel_format) {
+	case PixelFormat24bppRGB:
+		return !needs_alpha && (data->reserved & GBD_TRUE24BPP) == 0;
+	case PixelFormat32bppRGB:
+		return !needs_alpha;
+	case PixelFormat32bppPARGB:
+	case PixelFormat32bppARGB:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+/*
+ * The other formats are converted to a 32bppARGB bitmap, which is processed instead. The result is only drawn,
+ * so it isn't converted back: colour keys can make the pixels of any format transparent, and the new colours of
+ * an indexed bitmap are usually not in its palette.
+ */
+static GpStatus
+gdip_attributes_convert_to_argb (ActiveBitmapData *src, GpBitmap **argb)
+{
+	Rect rect = {0, 0, src->width, src->height};
+	GpBitmap *result;
+	GpStatus status;
+
+	status = GdipCreateBitmapFromScan0 (src->width, src->height, 0, PixelFormat32bppARGB, NULL, &result);
+	if (status != Ok)
+		return status;
+
+	status = gdip_bitmap_change_rect_pixel_format (src, &rect, result->active_bitmap, &rect);
+	if (status != Ok) {
+		gdip_bitmap_dispose (result);
+		return status;
+	}
+
+	result->active_bitmap->dpi_horz = src->dpi_horz;
+	result->active_bitmap->dpi_vert = src->dpi_vert;
+	*argb = result;
+	return Ok;
+}
+
 GpStatus
 gdip_process_bitmap_attributes (GpBitmap *bitmap, GpImageAttributes* attr, GpBitmap **dest_bitmap)
 {
@@ -142,8 +484,9 @@ gdip_process_bitmap_attributes (GpBitmap *bitmap, GpImageAttributes* attr, GpBit
 	GpImageAttribute *imgattr, *def;
 	GpImageAttribute *colormap, *gamma, *trans, *cmatrix, *treshold, *cmyk;
 	GpBitmap *bmpdest = NULL;
-	ARGB color;
-	BYTE *color_p = (BYTE*) &color;
+	ImageAttributesPipeline pipeline;
+	BOOL use_remap, use_gamma, use_threshold;
+	PixelFormat format;
 
 	*dest_bitmap = NULL;
 	if (!bitmap || !attr)
@@ -188,18 +531,47 @@ gdip_process_bitmap_attributes (GpBitmap *bitmap, GpImageAttributes* attr, GpBit
 		cmyk = def;
 	}
 
-	if ((!(colormap->flags & ImageAttributeFlagsNoOp) && (colormap->flags & ImageAttributeFlagsColorRemapTableEnabled))
-		|| (!(gamma->flags & ImageAttributeFlagsNoOp) && (gamma->flags & ImageAttributeFlagsGammaEnabled))
-		|| (!(trans->flags & ImageAttributeFlagsNoOp) && (trans->flags & ImageAttributeFlagsColorKeysEnabled))
-		|| (!(cmatrix->flags & ImageAttributeFlagsNoOp) && (cmatrix->flags & ImageAttributeFlagsColorMatrixEnabled) && cmatrix->colormatrix != NULL)
-		|| (!(treshold->flags & ImageAttributeFlagsNoOp) && (treshold->flags & ImageAttributeFlagsThresholdEnabled))
-		|| (!(cmyk->flags & ImageAttributeFlagsNoOp) && (cmyk->flags & ImageAttributeFlagsOutputChannelEnabled))) {
+	memset (&pipeline, 0, sizeof (ImageAttributesPipeline));
+
+	use_remap = !(colormap->flags & ImageAttributeFlagsNoOp) && (colormap->flags & ImageAttributeFlagsColorRemapTableEnabled);
+	use_gamma = !(gamma->flags & ImageAttributeFlagsNoOp) && (gamma->flags & ImageAttributeFlagsGammaEnabled);
+	use_threshold = !(treshold->flags & ImageAttributeFlagsNoOp) && (treshold->flags & ImageAttributeFlagsThresholdEnabled);
+	pipeline.use_output_channel = !(cmyk->flags & ImageAttributeFlagsNoOp) && (cmyk->flags & ImageAttributeFlagsOutputChannelEnabled);
+	pipeline.use_color_keys = !(trans->flags & ImageAttributeFlagsNoOp) && (trans->flags & ImageAttributeFlagsColorKeysEnabled);
+	if (!(cmatrix->flags & ImageAttributeFlagsNoOp) && (cmatrix->flags & ImageAttributeFlagsColorMatrixEnabled) && cmatrix->colormatrix != NULL) {
+		pipeline.colormatrix = cmatrix->colormatrix;
+		pipeline.graymatrix = cmatrix->graymatrix;
+		pipeline.colormatrix_flags = cmatrix->colormatrix_flags;
+	}
+
+	if (!use_remap && !use_gamma && !use_threshold && !pipeline.use_output_channel &&
+		!pipeline.use_color_keys && !pipeline.colormatrix)
+		return Ok;
+
+	if (pipeline.use_output_channel) {
+		switch (cmyk->outputchannel_flags) {
+		case ColorChannelFlagsC:
+		case ColorChannelFlagsM:
+		case ColorChannelFlagsY:
+		case ColorChannelFlagsK:
+			pipeline.output_channel = cmyk->outputchannel_flags;
+			break;
+		default:
+			return InvalidParameter;
+		}
+	}
+
+	status = gdip_bitmap_ensure_pixels (bitmap);
+	if (status != Ok)
+		return status;
+
+	gdip_bitmap_flush_surface (bitmap);
+
+	if (gdip_attributes_can_process_in_place (bitmap->active_bitmap, pipeline.use_color_keys)) {
 		bmpdest = gdip_bitmap_new_with_frame (NULL, FALSE);
 		if (!bmpdest)
 			return OutOfMemory;
 
-		gdip_bitmap_flush_surface (bitmap);
-
 		status = gdip_bitmapdata_clone (bitmap->active_bitmap, &bmpdest->frames[0].bitmap, 1);
 		if (status != Ok) {
 			gdip_bitmap_dispose (bmpdest);
@@ -208,130 +580,61 @@ gdip_process_bitmap_attributes (GpBitmap *bitmap, GpImageAttributes* attr, GpBit
 
 		bmpdest->frames[0].count = 1;
 		gdip_bitmap_setactive (bmpdest, NULL, 0);
-		*dest_bitmap = bmpdest;
+	} else {
+		status = gdip_attributes_convert_to_argb (bitmap->active_bitmap, &bmpdest);
+		if (status != Ok)
+			return status;
+	}
+	*dest_bitmap = bmpdest;
+
+	pipeline.data = bmpdest->active_bitmap;
+	format = pipeline.data->pixel_format;
+
+	switch (format) {
+	case PixelFormat24bppRGB:
+	case PixelFormat32bppRGB:
+		pipeline.opaque = TRUE;
+		break;
+	case PixelFormat32bppPARGB:
+		pipeline.premultiplied = TRUE;
+		break;
+	default:
+		break;
 	}
-
-	/*
-		We use get/set pixel instead of direct buffer manipulation because it's a good way of keeping the pixel
-		logic in a single place
-	*/
 
 	/* Color mapping */
-	if (!(colormap->flags & ImageAttributeFlagsNoOp) && colormap->flags & ImageAttributeFlagsColorRemapTableEnabled) {
-		for (int y = 0; y <bitmap->active_bitmap->height; y++) {
-			for (int x = 0; x <bitmap->active_bitmap->width; x++) {
-				ColorMap* clrmap = colormap->colormap;
-
-				GdipBitmapGetPixel (bmpdest, x, y, &color);
-
-				for (int cnt = 0; cnt < colormap->colormap_elem; cnt++, clrmap++) {
-
-					if (color == clrmap->oldColor.Argb) {
-						color = clrmap->newColor.Argb;
-						GdipBitmapSetPixel (bmpdest, x, y, color);
-						break;
-					}
-				}
-			}
+	if (use_remap && colormap->colormap_elem > 0) {
+		pipeline.remap = GdipAlloc (sizeof (ColorRemapEntry) * colormap->colormap_elem);
+		if (!pipeline.remap) {
+			gdip_bitmap_dispose (bmpdest);
+			*dest_bitmap = NULL;
+			return OutOfMemory;
 		}
-	}
 
-	/* Gamma correction */
-	if (!(gamma->flags & ImageAttributeFlagsNoOp) && gamma->flags & ImageAttributeFlagsGammaEnabled) {
-		for (int y = 0; y < bitmap->active_bitmap->height; y++) {
-			for (int x = 0; x < bitmap->active_bitmap->width; x++) {
-
-				BYTE r,g,b,a;
-
-				GdipBitmapGetPixel (bmpdest, x, y, &color);
-
-				a = (color & 0xff000000) >> 24;
-				r = (color & 0x00ff0000) >> 16;
-				g = (color & 0x0000ff00) >> 8;
-				b = (color & 0x000000ff);
-
-				r = (int) roundf(powf(r / 255.0, gamma->gamma_correction) * 255.0);
-				g = (int) roundf(powf(g / 255.0, gamma->gamma_correction) * 255.0);
-				b = (int) roundf(powf(b / 255.0, gamma->gamma_correction) * 255.0);
-
-				color = ((guint32)a << 24) | (r << 16) | (g  << 8) | b;
-				GdipBitmapSetPixel (bmpdest, x, y, color);
-			}
+		for (int i = 0; i < colormap->colormap_elem; i++) {
+			pipeline.remap[i].oldColor = colormap->colormap[i].oldColor.Argb;
+			pipeline.remap[i].newColor = colormap->colormap[i].newColor.Argb;
+			pipeline.remap[i].index = i;
 		}
-
+		qsort (pipeline.remap, colormap->colormap_elem, sizeof (ColorRemapEntry), compare_color_remap_entry);
+		pipeline.remap_count = colormap->colormap_elem;
 	}
 
-	/* Treshold correction */
-	if (!(treshold->flags & ImageAttributeFlagsNoOp) && treshold->flags & ImageAttributeFlagsThresholdEnabled) {
-		BYTE cutoff = (BYTE)round(treshold->threshold * 255.0);
-
-		for (int y = 0; y < bitmap->active_bitmap->height; y++) {
-			for (int x = 0; x < bitmap->active_bitmap->width; x++) {
-
-				BYTE r, g, b, a;
+	/* Gamma and threshold correction are both per channel, fold them in a single table */
+	if (use_gamma || use_threshold) {
+		BYTE cutoff = use_threshold ? (BYTE)round(treshold->threshold * 255.0) : 0;
 
-				GdipBitmapGetPixel(bmpdest, x, y, &color);
+		for (int i = 0; i < 256; i++) {
+			BYTE value = (BYTE) i;
 
-				a = (color & 0xff000000) >> 24;
-				r = (color & 0x00ff0000) >> 16;
-				g = (color & 0x0000ff00) >> 8;
-				b = (color & 0x000000ff);
+			if (use_gamma)
+				value = (int) roundf(powf(value / 255.0, gamma->gamma_correction) * 255.0);
+			if (use_threshold)
+				value = value > cutoff ? 255 : 0;
 
-				r = r > cutoff ? 255 : 0;
-				g = g > cutoff ? 255 : 0;
-				b = b > cutoff ? 255 : 0;
-
-				color = ((guint32)a << 24) | (r << 16) | (g << 8) | b;
-				GdipBitmapSetPixel(bmpdest, x, y, color);
-			}
-		}
-	}
-
-	/* CMYK calculation */
-	if (!(cmyk->flags & ImageAttributeFlagsNoOp) && cmyk->flags & ImageAttributeFlagsOutputChannelEnabled) {
-		for (int y = 0; y < bitmap->active_bitmap->height; y++) {
-			for (int x = 0; x < bitmap->active_bitmap->width; x++) {
-
-				BYTE r, g, b, a, C, M, Y, K;
-
-				GdipBitmapGetPixel(bmpdest, x, y, &color);
-
-				a = (color & 0xff000000) >> 24;
-				r = (color & 0x00ff0000) >> 16;
-				g = (color & 0x0000ff00) >> 8;
-				b = (color & 0x000000ff);
-
-				C = 255 - r;
-				M = 255 - g;
-				Y = 255 - b;
-				K = min(min(C, M), Y);
-				
-				/* correct complementary color lever based on k */
-				C -= K;
-				M -= K;
-				Y -= K;
-
-				switch (cmyk->outputchannel_flags) {
-				case ColorChannelFlagsC:
-					r = g = b = C;
-					break;
-				case ColorChannelFlagsM:
-					r = g = b = M;
-					break;
-				case ColorChannelFlagsY:
-					r = g = b = Y;
-					break;
-				case ColorChannelFlagsK:
-					r = g = b = K;
-					break;
-				default:
-					return InvalidParameter;
-				}
-
-				color = ((guint32)a << 24) | (r << 16) | (g << 8) | b;
-				GdipBitmapSetPixel(bmpdest, x, y, color);
-			}
+			pipeline.channel_lut[i] = value;
 		}
+		pipeline.use_channel_lut = TRUE;
 	}
 
 	/* Apply transparency range */
@@ -339,88 +642,19 @@ gdip_process_bitmap_attributes (GpBitmap *bitmap, GpImageAttributes* attr, GpBit
 	          However, GdipDrawImageRectRect in image.c uses cairo_fill to draw these transparent pixels onto
 			  the target surface. This method will not copy the transparency value; rather, it will ignore
 			  transparent values. */
-	if (!(trans->flags & ImageAttributeFlagsNoOp) && trans->flags & ImageAttributeFlagsColorKeysEnabled) {
-		for (int y = 0; y < bitmap->active_bitmap->height; y++) {
-			for (int x = 0; x < bitmap->active_bitmap->width; x++) {
-
-				GdipBitmapGetPixel (bmpdest, x, y, &color);
-				color &= ~ALPHA_MASK;
-				
-				if (color >= (trans->key_colorlow & ~ALPHA_MASK) && color <= (trans->key_colorhigh & ~ALPHA_MASK)) {
-					GdipBitmapSetPixel (bmpdest, x, y, 0x00FFFFFF /* transparent white */);
-				}
-			}
-		}
+	if (pipeline.use_color_keys) {
+		pipeline.key_colorlow = trans->key_colorlow;
+		pipeline.key_colorhigh = trans->key_colorhigh;
 	}
 
-	/* Apply Color Matrix */
-	if (!(cmatrix->flags & ImageAttributeFlagsNoOp) && (cmatrix->flags & ImageAttributeFlagsColorMatrixEnabled) && cmatrix->colormatrix != NULL) {
-		ActiveBitmapData *data = bmpdest->active_bitmap;
-		BYTE *v = ((BYTE*)data->scan0);
-		ARGB *scan;
-		ColorMatrixFlags flags = cmatrix->colormatrix_flags;
-		ColorMatrix *cm;
-		BOOL bmpdest_is_premultiplied = !gdip_bitmap_format_needs_premultiplication (bmpdest);
-
-		for (int y = 0; y < data->height; y++) {
-			scan = (ARGB*) v;
-			for (int x = 0; x < data->width; x++) {
-				BYTE r,g,b,a;
-				int r_new,g_new,b_new,a_new;
-
-				get_pixel_bgra (*scan, b, g, r, a);
-
-				/* by default the matrix applies to all colors, including grays */
-				if ((flags != ColorMatrixFlagsDefault) && (b == g) && (b == r)) {
-					if (flags == ColorMatrixFlagsSkipGrays) {
-						/* does not apply */
-						scan++;
-						continue;
-					}
-					/* ColorMatrixFlagsAltGray */
-					cm = cmatrix->graymatrix;
-				} else {
-					cm = cmatrix->colormatrix;
-				}
-
-				a_new = (r * cm->m[0][3] + g * cm->m[1][3] + b * cm->m[2][3] + a * cm->m[3][3] + (255 * cm->m[4][3]));
-				if (a_new == 0 && bmpdest_is_premultiplied) {
-					/* 100% transparency, don't waste time computing other values (pre-mul will always be 0) */
-					*scan++ = 0;
-				} else {
-					r_new = (r * cm->m[0][0] + g * cm->m[1][0] + b * cm->m[2][0] + a * cm->m[3][0] + (255 * cm->m[4][0]));
-					g_new = (r * cm->m[0][1] + g * cm->m[1][1] + b * cm->m[2][1] + a * cm->m[3][1] + (255 * cm->m[4][1]));
-					b_new = (r * cm->m[0][2] + g * cm->m[1][2] + b * cm->m[2][2] + a * cm->m[3][2] + (255 * cm->m[4][2]));
-
-					if (bmpdest_is_premultiplied && a != (BYTE) a_new && a < 0xff && a != 0) {
-						/* reverse previous pre-multiplication if necessary */
-						r_new = r_new * 255 / a;
-						g_new = g_new * 255 / a;
-						b_new = b_new * 255 / a;
-					}
-
-					r = (r_new > 0xff) ? 0xff : (BYTE) r_new;
-					g = (g_new > 0xff) ? 0xff : (BYTE) g_new;
-					b = (b_new > 0xff) ? 0xff : (BYTE) b_new;
-
-					/* remember that Cairo use pre-multiplied alpha, e.g. 50% red == 0x80800000 not 0x80ff0000 */
-					if (bmpdest_is_premultiplied && a != (BYTE) a_new && a_new < 0xff) {
-						/* apply new pre-multiplication */
-						a = (BYTE) a_new;
-						r = pre_multiplied_table [r][a];
-						g = pre_multiplied_table [g][a];
-						b = pre_multiplied_table [b][a];
-					} else {
-						a = (BYTE) a_new;
-					}
-
-					set_pixel_bgra (color_p, 0, b, g, r, a);
-					*scan++ = color;
-				}
-			}
-			v += data->stride;
-		}
-	}
+	/* Color Matrix */
+	if (pipeline.colormatrix)
+		pipeline.matrix_premultiplied = !gdip_bitmap_format_needs_premultiplication (bmpdest);
+
+	gdip_process_row_bands (pipeline.data->height, (size_t) pipeline.data->stride, gdip_apply_image_attributes_rows, &pipeline);
+
+	if (pipeline.remap)
+		GdipFree (pipeline.remap);
 
 	return Ok;
 }
@@ -34,6 +34,7 @@ GUID gdip_jpg_image_format_guid = {0xb96b3caeU, 0x0728U, 0x11d3U, {0x9d, 0x7b, 0
 #ifdef HAVE_LIBJPEG
 
 #include <setjmp.h>
+#include <unistd.h>
 
 /* pkgsrc */
 #undef HAVE_STDLIB_H
@@ -232,6 +233,32 @@ _gdip_source_stream_skip_input_data (j_decompress_ptr cinfo, long skipbytes)
 	}
 }
 
+static BOOL
+_gdip_source_memory_fill_input_buffer (j_decompress_ptr cinfo)
+{
+	static const JOCTET eoi[2] = { (JOCTET) 0xFF, (JOCTET) JPEG_EOI };
+
+	/* the whole file was in the buffer already, insert the same fake EOI
+	 * marker as for the other sources */
+	cinfo->src->next_input_byte = eoi;
+	cinfo->src->bytes_in_buffer = 2;
+
+	return TRUE;
+}
+
+static void
+_gdip_source_memory_skip_input_data (j_decompress_ptr cinfo, long skipbytes)
+{
+	if (skipbytes > 0) {
+		if (skipbytes > (long) cinfo->src->bytes_in_buffer) {
+			(void) _gdip_source_memory_fill_input_buffer (cinfo);
+		} else {
+			cinfo->src->next_input_byte += (size_t) skipbytes;
+			cinfo->src->bytes_in_buffer -= (size_t) skipbytes;
+		}
+	}
+}
+
 static void
 _gdip_source_dummy_term (j_decompress_ptr cinfo)
 {
@@ -267,8 +294,93 @@ _gdip_dest_stream_term (j_compress_ptr cinfo)
 	dest->putBytesFunc (dest->buf, JPEG_BUFFER_SIZE - dest->parent.free_in_buffer);
 }
 
+/*
+ * Largest scale down supported by libjpeg (1/2, 1/4 or 1/8) that still decodes at least @minWidth x @minHeight
+ * pixels, the scaling is done while decoding the DCT blocks. Returns 1 to decode at full size.
+ */
+static unsigned int
+gdip_jpeg_scale_denom (unsigned int width, unsigned int height, UINT minWidth, UINT minHeight)
+{
+	unsigned int denom;
+
+	if (minWidth == 0 && minHeight == 0)
+		return 1;
+
+	for (denom = 8; denom > 1; denom /= 2) {
+		if ((width + denom - 1) / denom >= minWidth && (height + denom - 1) / denom >= minHeight)
+			return denom;
+	}
+
+	return 1;
+}
+
+static ARGB
+gdip_jpeg_cmyk_to_argb (const JOCTET *cmyk, BOOL adobe)
+{
+	JOCTET c, m, y, k;
+	JOCTET r, g, b;
+
+	c = cmyk [0];
+	m = cmyk [1];
+	y = cmyk [2];
+	k = cmyk [3];
+
+	/* Adobe photoshop seems to have a bug and inverts the CMYK data.
+	 * We might need to remove this check, if Adobe decides to fix it. */
+	if (adobe) {
+		b = (k * c) / 255;
+		g = (k * m) / 255;
+		r = (k * y) / 255;
+	}  else {
+		b = (255 - k) * (255 - c) / 255;
+		g = (255 - k) * (255 - m) / 255;
+		r = (255 - k) * (255 - y) / 255;
+	}
+
+	return 0xFF000000 | (r << 16) | (g << 8) | b;
+}
+
+/*
+ * Request cairo-compat output.
+ * libjpeg can do only following conversions,
+ * YCbCr => GRAYSCALE, YCbCr => RGB
+ * GRAYSCALE => RGB, YCCK => CMYK.
+ * Therefore, we convert YCbCr, GRAYSCALE to RGB and
+ * YCCK to CMYK using the libjpeg. We convert CMYK
+ * to RGB ourself.
+ */
+static BOOL
+gdip_jpeg_set_out_color_space (struct jpeg_decompress_struct *cinfo)
+{
+	switch (cinfo->jpeg_color_space) {
+	case JCS_GRAYSCALE:
+		/* special case for indexed 256 greyscale images (bug #81552) */
+		if (cinfo->num_components == 1) {
+			cinfo->out_color_space = JCS_GRAYSCALE;
+			cinfo->out_color_components = 1;
+			return TRUE;
+		}
+		/* else treat as RGB and */
+		/* fall through */
+	case JCS_RGB:
+	case JCS_YCbCr:
+		cinfo->out_color_space = JCS_RGB;
+		cinfo->out_color_components = 3;
+		return TRUE;
+	case JCS_YCCK:
+	case JCS_CMYK:
+		cinfo->out_color_space = JCS_CMYK;
+		cinfo->out_color_components = 4;
+		return TRUE;
+	default:
+		/* Unsupported JPEG color space */
+		return FALSE;
+	}
+}
+
+/* with @headerOnly the bitmap is returned without its pixels, i.e. scan0 is NULL */
 static GpStatus
-gdip_load_jpeg_image_internal (struct jpeg_source_mgr *src, GpImage **image)
+gdip_load_jpeg_image_internal (struct jpeg_source_mgr *src, UINT minWidth, UINT minHeight, BOOL headerOnly, GpImage **image)
 {
 	struct jpeg_decompress_struct	cinfo;
 	struct gdip_jpeg_error_mgr	jerr;
@@ -300,6 +412,9 @@ gdip_load_jpeg_image_internal (struct jpeg_source_mgr *src, GpImage **image)
 
 	cinfo.do_fancy_upsampling = FALSE;
 	cinfo.do_block_smoothing = FALSE;
+	cinfo.scale_num = 1;
+	cinfo.scale_denom = gdip_jpeg_scale_denom (cinfo.image_width, cinfo.image_height, minWidth, minHeight);
+	jpeg_calc_output_dimensions (&cinfo);
 
 	result = gdip_bitmap_new_with_frame (NULL, TRUE);
 	if (!result) {
@@ -308,9 +423,11 @@ gdip_load_jpeg_image_internal (struct jpeg_source_mgr *src, GpImage **image)
 	}
 
 	result->type = ImageTypeBitmap;
-	result->active_bitmap->width = cinfo.image_width;
-	result->active_bitmap->height = cinfo.image_height;
-	result->active_bitmap->image_flags = ImageFlagsReadOnly | ImageFlagsHasRealPixelSize;
+	result->active_bitmap->width = cinfo.output_width;
+	result->active_bitmap->height = cinfo.output_height;
+	result->active_bitmap->image_flags = ImageFlagsReadOnly;
+	if (cinfo.scale_denom == 1)
+		result->active_bitmap->image_flags |= ImageFlagsHasRealPixelSize;
 
 	if (cinfo.density_unit == 1) { /* dpi */
 		result->active_bitmap->dpi_horz = cinfo.X_density;
@@ -362,7 +479,7 @@ gdip_load_jpeg_image_internal (struct jpeg_source_mgr *src, GpImage **image)
 		break;
 	}
 
-	size *= cinfo.image_width;
+	size *= cinfo.output_width;
 	/* stride is a (signed) _int_ and once multiplied by 4 it should hold a value that can be allocated by GdipAlloc
 	 * this effectively limits 'width' to 536870911 pixels */
 	if (size > G_MAXINT32) {
@@ -371,48 +488,26 @@ gdip_load_jpeg_image_internal (struct jpeg_source_mgr *src, GpImage **image)
 	}
 	stride = result->active_bitmap->stride = size;
 
-	/* Request cairo-compat output */
-	/* libjpeg can do only following conversions,
-	 * YCbCr => GRAYSCALE, YCbCr => RGB
-	 * GRAYSCALE => RGB, YCCK => CMYK.
-	 * Therefore, we convert YCbCr, GRAYSCALE to RGB and
-	 * YCCK to CMYK using the libjpeg. We convert CMYK
-	 * to RGB ourself.
-	 */
-	switch (cinfo.jpeg_color_space) {
-	case JCS_GRAYSCALE:
-		/* special case for indexed 256 greyscale images (bug #81552) */
-		if (cinfo.num_components == 1) {
-			cinfo.out_color_space = JCS_GRAYSCALE;
-			cinfo.out_color_components = 1;
-			break;
-		}
-		/* else treat as RGB and */
-		/* fall through */
-	case JCS_RGB:
-	case JCS_YCbCr:
-		cinfo.out_color_space = JCS_RGB;
-		cinfo.out_color_components = 3;
-		break;
-	case JCS_YCCK:
-	case JCS_CMYK:
-		cinfo.out_color_space = JCS_CMYK;
-		cinfo.out_color_components = 4;
-		break;
-	default:
-		/* Unsupported JPEG color space */
-		status = InvalidParameter;
-		goto error;
-	}
-
-	jpeg_start_decompress (&cinfo);
-
 	/* ensure total 'size' does not overflow an integer and fits inside our 2GB limit */
 	size *= cinfo.output_height;
 	if (size > G_MAXINT32) {
 		status = OutOfMemory;
 		goto error;
 	}
+
+	if (headerOnly) {
+		jpeg_destroy_decompress (&cinfo);
+		*image = result;
+		return Ok;
+	}
+
+	if (!gdip_jpeg_set_out_color_space (&cinfo)) {
+		status = InvalidParameter;
+		goto error;
+	}
+
+	jpeg_start_decompress (&cinfo);
+
 	destbuf = GdipAlloc (size);
 	if (destbuf == NULL) {
 		status = OutOfMemory;
@@ -423,42 +518,23 @@ gdip_load_jpeg_image_internal (struct jpeg_source_mgr *src, GpImage **image)
 	while (cinfo.output_scanline < cinfo.output_height) {
 		int i;
 		int nlines;
-		for (i = 0; i < cinfo.rec_outbuf_height; i++) {
-			lines[i] = destptr;
-			destptr += stride;
-		}
+		for (i = 0; i < cinfo.rec_outbuf_height; i++)
+			lines[i] = destptr + i * stride;
 
 		nlines = jpeg_read_scanlines (&cinfo, lines, cinfo.rec_outbuf_height);
+		destptr += nlines * stride;
 
 		/* If the out colorspace is not RBG, we need to convert it to RBG. */
 		if (cinfo.out_color_space == JCS_CMYK) {
 			int i, j;
 
-			for (i = 0; i < cinfo.rec_outbuf_height; i++) {
+			for (i = 0; i < nlines; i++) {
 				BYTE *lineptr = lines [i];
 
 				for (j = 0; j < cinfo.output_width; j++) {
-					JOCTET c, m, y, k;
-					JOCTET r, g, b;
-
-					c = lineptr [0];
-					m = lineptr [1];
-					y = lineptr [2];
-					k = lineptr [3];
-
-					/* Adobe photoshop seems to have a bug and inverts the CMYK data.
-					 * We might need to remove this check, if Adobe decides to fix it. */
-					if (cinfo.saw_Adobe_marker) {
-						b = (k * c) / 255;
-						g = (k * m) / 255;
-						r = (k * y) / 255;
-					}  else {
-						b = (255 - k) * (255 - c) / 255;
-						g = (255 - k) * (255 - m) / 255;
-						r = (255 - k) * (255 - y) / 255;
-					}
-
-					set_pixel_bgra(lineptr, 0, b, g, r, 0xff);
+					ARGB color = gdip_jpeg_cmyk_to_argb (lineptr, cinfo.saw_Adobe_marker);
+
+					set_pixel_bgra(lineptr, 0, color & 0xFF, (color >> 8) & 0xFF, (color >> 16) & 0xFF, 0xff);
 					lineptr += 4;
 				}
 			}
@@ -537,6 +613,100 @@ error:
 	return status;
 }
 
+/*
+ * Decodes only @rect of the image, scaled the same way as by gdip_load_jpeg_image_internal, into @scan0 using the
+ * same pixel layout. When libjpeg supports it the rows above @rect skip the IDCT and color conversion and only the
+ * iMCU columns covering @rect are decoded, otherwise the rows are decoded and thrown away.
+ */
+static GpStatus
+gdip_load_jpeg_region_internal (struct jpeg_source_mgr *src, UINT minWidth, UINT minHeight, const GpRect *rect, BYTE *scan0, int stride)
+{
+	struct jpeg_decompress_struct	cinfo;
+	struct gdip_jpeg_error_mgr	jerr;
+	JSAMPARRAY	line;
+	JDIMENSION	x_offset;
+	int		y;
+
+	memset (&cinfo, 0, sizeof (cinfo));
+	cinfo.err = jpeg_std_error ((struct jpeg_error_mgr *) &jerr);
+	jerr.parent.error_exit = _gdip_jpeg_error_exit;
+	jerr.parent.output_message = _gdip_jpeg_output_message;
+
+	if (sigsetjmp (jerr.setjmp_buffer, 1)) {
+		/* Error occured during decompression */
+		jpeg_destroy_decompress (&cinfo);
+		return OutOfMemory;
+	}
+
+	jpeg_create_decompress (&cinfo);
+	cinfo.src = src;
+
+	jpeg_read_header (&cinfo, TRUE);
+
+	cinfo.do_fancy_upsampling = FALSE;
+	cinfo.do_block_smoothing = FALSE;
+	cinfo.scale_num = 1;
+	cinfo.scale_denom = gdip_jpeg_scale_denom (cinfo.image_width, cinfo.image_height, minWidth, minHeight);
+	if (!gdip_jpeg_set_out_color_space (&cinfo)) {
+		jpeg_destroy_decompress (&cinfo);
+		return InvalidParameter;
+	}
+
+	jpeg_start_decompress (&cinfo);
+
+	if (rect->X + rect->Width > cinfo.output_width || rect->Y + rect->Height > cinfo.output_height) {
+		jpeg_destroy_decompress (&cinfo);
+		return InvalidParameter;
+	}
+
+	x_offset = 0;
+#ifdef HAVE_JPEG_CROP_SCANLINE
+	{
+		JDIMENSION width = rect->Width;
+
+		/* x_offset is moved back to the start of its iMCU column and output_width becomes width */
+		x_offset = rect->X;
+		jpeg_crop_scanline (&cinfo, &x_offset, &width);
+		jpeg_skip_scanlines (&cinfo, rect->Y);
+	}
+#endif
+
+	/* freed along with cinfo */
+	line = (*cinfo.mem->alloc_sarray) ((j_common_ptr) &cinfo, JPOOL_IMAGE, cinfo.output_width * cinfo.output_components, 1);
+
+	while (cinfo.output_scanline < (JDIMENSION) rect->Y)
+		jpeg_read_scanlines (&cinfo, line, 1);
+
+	for (y = 0; y < rect->Height; y++) {
+		const JSAMPLE *inptr;
+		BYTE *outptr = scan0 + y * stride;
+		int x;
+
+		if (jpeg_read_scanlines (&cinfo, line, 1) != 1) {
+			jpeg_destroy_decompress (&cinfo);
+			return OutOfMemory;
+		}
+
+		inptr = line[0] + (rect->X - x_offset) * cinfo.output_components;
+		if (cinfo.out_color_space == JCS_CMYK) {
+			for (x = 0; x < rect->Width; x++, inptr += 4, outptr += 4) {
+				ARGB color = gdip_jpeg_cmyk_to_argb (inptr, cinfo.saw_Adobe_marker);
+
+				set_pixel_bgra(outptr, 0, color & 0xFF, (color >> 8) & 0xFF, (color >> 16) & 0xFF, 0xff);
+			}
+		} else if (cinfo.out_color_components == 1) {
+			memcpy (outptr, inptr, rect->Width);
+		} else {
+			for (x = 0; x < rect->Width; x++, inptr += 3, outptr += 4)
+				set_pixel_bgra(outptr, 0, inptr[2], inptr[1], inptr[0], 0xff);
+		}
+	}
+
+	/* the rows below the region are never decoded */
+	jpeg_destroy_decompress (&cinfo);
+	return Ok;
+}
+
 #ifdef HAVE_LIBEXIF
 static void
 add_properties_from_entry (ExifEntry *entry, void *user_data)
@@ -620,22 +790,20 @@ load_exif_data (ExifData *exif_data, GpImage *image)
 }
 #endif
 
-GpStatus 
-gdip_load_jpeg_image_from_file (FILE *fp, const char *filename, GpImage **image)
+static gdip_stdio_jpeg_source_mgr_ptr
+gdip_jpeg_stdio_source_new (FILE *fp)
 {
-	GpStatus st;
-
 	gdip_stdio_jpeg_source_mgr_ptr src;
 
 	src = (gdip_stdio_jpeg_source_mgr_ptr) GdipAlloc (sizeof (struct gdip_stdio_jpeg_source_mgr));
 	if (src == NULL) {
-		return OutOfMemory;
+		return NULL;
 	}
 
 	src->buf = GdipAlloc (JPEG_BUFFER_SIZE * sizeof(JOCTET));
 	if (src->buf == NULL) {
 		GdipFree(src);
-		return OutOfMemory;
+		return NULL;
 	}
 
 	src->parent.init_source = _gdip_source_dummy_init;
@@ -647,10 +815,189 @@ gdip_load_jpeg_image_from_file (FILE *fp, const char *filename, GpImage **image)
 	src->parent.next_input_byte = NULL;
 
 	src->infp = fp;
+	return src;
+}
 
-	st = gdip_load_jpeg_image_internal ((struct jpeg_source_mgr *) src, image);
+static void
+gdip_jpeg_stdio_source_free (gdip_stdio_jpeg_source_mgr_ptr src)
+{
 	GdipFree (src->buf);
 	GdipFree (src);
+}
+
+static GpStatus
+gdip_load_jpeg_image_from_stdio (FILE *fp, UINT minWidth, UINT minHeight, BOOL headerOnly, GpImage **image)
+{
+	GpStatus st;
+
+	gdip_stdio_jpeg_source_mgr_ptr src;
+
+	src = gdip_jpeg_stdio_source_new (fp);
+	if (src == NULL) {
+		return OutOfMemory;
+	}
+
+	st = gdip_load_jpeg_image_internal ((struct jpeg_source_mgr *) src, minWidth, minHeight, headerOnly, image);
+	gdip_jpeg_stdio_source_free (src);
+
+	return st;
+}
+
+/* libjpeg reads the mapped file in place, without copying it into a buffer */
+static void
+gdip_jpeg_memory_source_init (struct jpeg_source_mgr *src, GpFileMapping *mapping)
+{
+	src->init_source = _gdip_source_dummy_init;
+	src->fill_input_buffer = (boolean(*)(j_decompress_ptr))_gdip_source_memory_fill_input_buffer;
+	src->skip_input_data = _gdip_source_memory_skip_input_data;
+	src->resync_to_restart = jpeg_resync_to_restart;
+	src->term_source = _gdip_source_dummy_term;
+	src->bytes_in_buffer = mapping->size;
+	src->next_input_byte = mapping->ptr;
+}
+
+static GpStatus
+gdip_load_jpeg_image_from_memory (GpFileMapping *mapping, UINT minWidth, UINT minHeight, BOOL headerOnly, GpImage **image)
+{
+	struct jpeg_source_mgr src;
+
+	gdip_jpeg_memory_source_init (&src, mapping);
+	return gdip_load_jpeg_image_internal (&src, minWidth, minHeight, headerOnly, image);
+}
+
+/*
+ * The file of a JPEG image whose pixels are decoded on first use. It is mapped again for decoding, when possible,
+ * rather than the mapping it was loaded from being kept: the file may have been truncated since.
+ */
+typedef struct {
+	FILE		*fp;
+	long		offset;
+	UINT		minWidth;
+	UINT		minHeight;
+} JpegDeferredSource;
+
+static GpFileMapping*
+gdip_jpeg_deferred_map (JpegDeferredSource *jpeg)
+{
+	/* only whole files are mapped */
+	return jpeg->offset == 0 ? gdip_file_mapping_new_from_fd (fileno (jpeg->fp)) : NULL;
+}
+
+static GpStatus
+gdip_jpeg_deferred_load (void *source, UINT minWidth, UINT minHeight, GpImage **image)
+{
+	JpegDeferredSource *jpeg = (JpegDeferredSource *) source;
+	GpFileMapping *mapping;
+	GpStatus st;
+
+	/* without an explicit size the pixels must match the header loaded initially */
+	if (!minWidth && !minHeight) {
+		minWidth = jpeg->minWidth;
+		minHeight = jpeg->minHeight;
+	}
+
+	mapping = gdip_jpeg_deferred_map (jpeg);
+	if (mapping) {
+		st = gdip_load_jpeg_image_from_memory (mapping, minWidth, minHeight, FALSE, image);
+		gdip_file_mapping_unref (mapping);
+		return st;
+	}
+
+	if (fseek (jpeg->fp, jpeg->offset, SEEK_SET) != 0)
+		return OutOfMemory;
+
+	return gdip_load_jpeg_image_from_stdio (jpeg->fp, minWidth, minHeight, FALSE, image);
+}
+
+static GpStatus
+gdip_jpeg_deferred_load_region (void *source, const GpRect *rect, BYTE *scan0, int stride)
+{
+	JpegDeferredSource *jpeg = (JpegDeferredSource *) source;
+	gdip_stdio_jpeg_source_mgr_ptr src;
+	GpFileMapping *mapping;
+	GpStatus st;
+
+	mapping = gdip_jpeg_deferred_map (jpeg);
+	if (mapping) {
+		struct jpeg_source_mgr memory;
+
+		gdip_jpeg_memory_source_init (&memory, mapping);
+		st = gdip_load_jpeg_region_internal (&memory, jpeg->minWidth, jpeg->minHeight, rect, scan0, stride);
+		gdip_file_mapping_unref (mapping);
+		return st;
+	}
+
+	if (fseek (jpeg->fp, jpeg->offset, SEEK_SET) != 0)
+		return OutOfMemory;
+
+	src = gdip_jpeg_stdio_source_new (jpeg->fp);
+	if (!src)
+		return OutOfMemory;
+
+	st = gdip_load_jpeg_region_internal ((struct jpeg_source_mgr *) src, jpeg->minWidth, jpeg->minHeight, rect, scan0, stride);
+	gdip_jpeg_stdio_source_free (src);
+	return st;
+}
+
+static void
+gdip_jpeg_deferred_free (void *source)
+{
+	JpegDeferredSource *jpeg = (JpegDeferredSource *) source;
+
+	fclose (jpeg->fp);
+	GdipFree (jpeg);
+}
+
+/*
+ * Only the header is parsed here, the pixels are decoded on first use. Like GDI+ the file is kept open until then,
+ * through a duplicate of @fd since the caller closes it.
+ */
+static JpegDeferredSource*
+gdip_jpeg_deferred_source_new (int fd, long offset, UINT minWidth, UINT minHeight)
+{
+	JpegDeferredSource *jpeg;
+
+	jpeg = GdipAlloc (sizeof (JpegDeferredSource));
+	if (!jpeg)
+		return NULL;
+
+	fd = dup (fd);
+	if (fd < 0) {
+		GdipFree (jpeg);
+		return NULL;
+	}
+
+	jpeg->fp = fdopen (fd, "rb");
+	if (!jpeg->fp) {
+		close (fd);
+		GdipFree (jpeg);
+		return NULL;
+	}
+
+	jpeg->offset = offset;
+	jpeg->minWidth = minWidth;
+	jpeg->minHeight = minHeight;
+	return jpeg;
+}
+
+GpStatus 
+gdip_load_jpeg_image_from_file (FILE *fp, const char *filename, UINT minWidth, UINT minHeight, GpImage **image)
+{
+	GpStatus st;
+	JpegDeferredSource *source;
+	long offset;
+
+	offset = ftell (fp);
+	source = offset >= 0 ? gdip_jpeg_deferred_source_new (fileno (fp), offset, minWidth, minHeight) : NULL;
+
+	/* decode everything now if the file can't be kept around */
+	st = gdip_load_jpeg_image_from_stdio (fp, minWidth, minHeight, source != NULL, image);
+	if (source) {
+		if (st == Ok)
+			gdip_bitmap_set_deferred_source (*image, gdip_jpeg_deferred_load, gdip_jpeg_deferred_load_region, gdip_jpeg_deferred_free, source);
+		else
+			gdip_jpeg_deferred_free (source);
+	}
 #ifdef HAVE_LIBEXIF
 	if (st == Ok) {
 		load_exif_data (exif_data_new_from_file (filename), *image);
@@ -660,6 +1007,32 @@ gdip_load_jpeg_image_from_file (FILE *fp, const char *filename, GpImage **image)
 	return st;
 }
 
+/* Only the header is parsed here, the file is kept open, like from stdio, until the pixels are decoded */
+GpStatus
+gdip_load_jpeg_image_from_mapping (GpFileMapping *mapping, const char *filename, UINT minWidth, UINT minHeight, GpImage **image)
+{
+	GpStatus st;
+	JpegDeferredSource *source;
+
+	source = gdip_jpeg_deferred_source_new (mapping->fd, 0, minWidth, minHeight);
+
+	/* decode everything now if the file can't be kept around */
+	st = gdip_load_jpeg_image_from_memory (mapping, minWidth, minHeight, source != NULL, image);
+	if (source) {
+		if (st == Ok)
+			gdip_bitmap_set_deferred_source (*image, gdip_jpeg_deferred_load, gdip_jpeg_deferred_load_region, gdip_jpeg_deferred_free, source);
+		else
+			gdip_jpeg_deferred_free (source);
+	}
+#ifdef HAVE_LIBEXIF
+	if (st == Ok) {
+		load_exif_data (exif_data_new_from_data (mapping->ptr, mapping->size), *image);
+	}
+#endif
+
+	return st;
+}
+
 GpStatus
 gdip_load_jpeg_image_from_stream_delegate (dstream_t *loader, GpImage **image)
 {
@@ -695,7 +1068,7 @@ gdip_load_jpeg_image_from_stream_delegate (dstream_t *loader, GpImage **image)
 	dstream_keep_exif_buffer (loader);
 #endif
 
-	st = gdip_load_jpeg_image_internal ((struct jpeg_source_mgr *) src, image);
+	st = gdip_load_jpeg_image_internal ((struct jpeg_source_mgr *) src, 0, 0, FALSE, image);
 	GdipFree (src->buf);
 	GdipFree (src);
 #ifdef HAVE_LIBEXIF
@@ -708,13 +1081,44 @@ gdip_load_jpeg_image_from_stream_delegate (dstream_t *loader, GpImage **image)
 	return st;
 }
 
+/* Handle encoding parameters */
+static void
+gdip_jpeg_set_encoder_parameters (struct jpeg_compress_struct *cinfo, GDIPCONST EncoderParameters *params)
+{
+	const EncoderParameter *param;
+
+	if (!params)
+		return;
+
+	param = gdip_find_encoder_parameter (params, &GdipEncoderQuality);
+	if (param != NULL) {
+		int quality;
+
+		if (param->Type == EncoderParameterValueTypeLong) {
+			quality = * (int *) param->Value;
+		} else if (param->Type == EncoderParameterValueTypeLongRange) {
+			const int *pval = (int *) param->Value;
+
+			quality = (pval[0] + pval[1]) / 2;
+		} else if (param->Type == EncoderParameterValueTypeByte) {
+			quality = *(BYTE*)param->Value;
+		} else if (param->Type == EncoderParameterValueTypeShort) {
+			quality = *(short *)param->Value;
+		} else {
+			/* Should we report an error here? */
+			quality = 80;
+		}
+
+		jpeg_set_quality (cinfo, quality, 0);
+	}
+}
+
 static GpStatus
 gdip_save_jpeg_image_internal (FILE *fp, PutBytesDelegate putBytesFunc, GpImage *image, GDIPCONST EncoderParameters *params)
 {
 	gdip_stream_jpeg_dest_mgr_ptr	dest = NULL;
 	struct jpeg_compress_struct	cinfo;
 	struct gdip_jpeg_error_mgr	jerr;
-	const EncoderParameter		*param;
 	JOCTET		*scanline = NULL;
 	int		need_argb_conversion = 0;
 	GpStatus	status;
@@ -741,6 +1145,18 @@ gdip_save_jpeg_image_internal (FILE *fp, PutBytesDelegate putBytesFunc, GpImage
 			status = gdip_save_jpeg_image_internal(fp, putBytesFunc, image, params);
 			return status;
 
+		case PixelFormat48bppRGB:
+		case PixelFormat64bppARGB:
+		case PixelFormat64bppPARGB:
+			image = gdip_convert_wide_to_rgb (image);
+			if (image == NULL) {
+				return OutOfMemory;
+			}
+
+			status = gdip_save_jpeg_image_internal (fp, putBytesFunc, image, params);
+			gdip_bitmap_dispose (image);
+			return status;
+
 		default:
 			status = InvalidParameter;
 			goto error;
@@ -806,30 +1222,7 @@ gdip_save_jpeg_image_internal (FILE *fp, PutBytesDelegate putBytesFunc, GpImage
 		jpeg_set_colorspace (&cinfo, JCS_GRAYSCALE);
 	}
 
-	/* Handle encoding parameters */
-	if (params) {
-		param = gdip_find_encoder_parameter (params, &GdipEncoderQuality);
-		if (param != NULL) {
-			int quality;
-
-			if (param->Type == EncoderParameterValueTypeLong) {
-				quality = * (int *) param->Value;
-			} else if (param->Type == EncoderParameterValueTypeLongRange) {
-				const int *pval = (int *) param->Value;
-
-				quality = (pval[0] + pval[1]) / 2;
-			} else if (param->Type == EncoderParameterValueTypeByte) {
-				quality = *(BYTE*)param->Value;
-			} else if (param->Type == EncoderParameterValueTypeShort) {
-				quality = *(short *)param->Value;
-			} else {
-				/* Should we report an error here? */
-				quality = 80;
-			}
-
-			jpeg_set_quality (&cinfo, quality, 0);
-		}
-	}
+	gdip_jpeg_set_encoder_parameters (&cinfo, params);
 
 	jpeg_start_compress (&cinfo, TRUE);
 
@@ -919,6 +1312,213 @@ gdip_save_jpeg_image_to_stream_delegate (PutBytesDelegate putBytesFunc,
 	return gdip_save_jpeg_image_internal (NULL, putBytesFunc, image, params);
 }
 
+typedef struct {
+	GpRowReader				parent;
+	struct jpeg_decompress_struct		cinfo;
+	struct gdip_jpeg_error_mgr		jerr;
+	struct gdip_stdio_jpeg_source_mgr	src;
+	JSAMPLE					*line;
+} JpegRowReader;
+
+static GpStatus
+gdip_jpeg_row_reader_read (GpRowReader *reader, ARGB *row)
+{
+	JpegRowReader	*jpeg = (JpegRowReader *) reader;
+	JSAMPLE		*src = jpeg->line;
+	UINT		x;
+
+	if (sigsetjmp (jpeg->jerr.setjmp_buffer, 1))
+		return OutOfMemory;
+
+	if (jpeg_read_scanlines (&jpeg->cinfo, &jpeg->line, 1) != 1)
+		return OutOfMemory;
+
+	if (jpeg->cinfo.out_color_space == JCS_CMYK) {
+		for (x = 0; x < reader->width; x++, src += 4)
+			row[x] = gdip_jpeg_cmyk_to_argb (src, jpeg->cinfo.saw_Adobe_marker);
+	} else {
+		for (x = 0; x < reader->width; x++, src += 3)
+			row[x] = 0xFF000000 | (src[0] << 16) | (src[1] << 8) | src[2];
+	}
+
+	return Ok;
+}
+
+static void
+gdip_jpeg_row_reader_close (GpRowReader *reader)
+{
+	JpegRowReader *jpeg = (JpegRowReader *) reader;
+
+	jpeg_destroy_decompress (&jpeg->cinfo);
+	GdipFree (jpeg->src.buf);
+	GdipFree (jpeg->line);
+	GdipFree (jpeg);
+}
+
+GpStatus
+gdip_jpeg_row_reader_new (FILE *fp, GpRowReader **reader)
+{
+	JpegRowReader	*jpeg;
+	GpStatus	status = OutOfMemory;
+
+	/* cinfo.mem stays NULL until jpeg_create_decompress, which makes jpeg_destroy_decompress safe */
+	jpeg = gdip_calloc (1, sizeof (JpegRowReader));
+	if (!jpeg)
+		return OutOfMemory;
+
+	jpeg->src.buf = GdipAlloc (JPEG_BUFFER_SIZE * sizeof(JOCTET));
+	if (!jpeg->src.buf)
+		goto error;
+
+	jpeg->src.parent.init_source = _gdip_source_dummy_init;
+	jpeg->src.parent.fill_input_buffer = (boolean(*)(j_decompress_ptr))_gdip_source_stdio_fill_input_buffer;
+	jpeg->src.parent.skip_input_data = _gdip_source_stdio_skip_input_data;
+	jpeg->src.parent.resync_to_restart = jpeg_resync_to_restart;
+	jpeg->src.parent.term_source = _gdip_source_dummy_term;
+	jpeg->src.infp = fp;
+
+	jpeg->cinfo.err = jpeg_std_error ((struct jpeg_error_mgr *) &jpeg->jerr);
+	jpeg->jerr.parent.error_exit = _gdip_jpeg_error_exit;
+	jpeg->jerr.parent.output_message = _gdip_jpeg_output_message;
+
+	if (sigsetjmp (jpeg->jerr.setjmp_buffer, 1))
+		goto error;
+
+	jpeg_create_decompress (&jpeg->cinfo);
+	jpeg->cinfo.src = (struct jpeg_source_mgr *) &jpeg->src;
+	jpeg_read_header (&jpeg->cinfo, TRUE);
+
+	/* same conversions as gdip_load_jpeg_image_internal, but greyscale is expanded to RGB too */
+	switch (jpeg->cinfo.jpeg_color_space) {
+	case JCS_GRAYSCALE:
+	case JCS_RGB:
+	case JCS_YCbCr:
+		jpeg->cinfo.out_color_space = JCS_RGB;
+		break;
+	case JCS_YCCK:
+	case JCS_CMYK:
+		jpeg->cinfo.out_color_space = JCS_CMYK;
+		break;
+	default:
+		/* Unsupported JPEG color space */
+		status = InvalidParameter;
+		goto error;
+	}
+
+	jpeg_start_decompress (&jpeg->cinfo);
+
+	if ((unsigned long long int) jpeg->cinfo.output_width * jpeg->cinfo.output_components > G_MAXINT32)
+		goto error;
+	jpeg->line = GdipAlloc (jpeg->cinfo.output_width * jpeg->cinfo.output_components);
+	if (!jpeg->line)
+		goto error;
+
+	jpeg->parent.width = jpeg->cinfo.output_width;
+	jpeg->parent.height = jpeg->cinfo.output_height;
+	jpeg->parent.has_alpha = FALSE;
+	jpeg->parent.read_row = gdip_jpeg_row_reader_read;
+	jpeg->parent.close = gdip_jpeg_row_reader_close;
+	*reader = (GpRowReader *) jpeg;
+	return Ok;
+
+error:
+	jpeg_destroy_decompress (&jpeg->cinfo);
+	GdipFree (jpeg->src.buf);
+	GdipFree (jpeg->line);
+	GdipFree (jpeg);
+	return status;
+}
+
+typedef struct {
+	GpRowWriter			parent;
+	struct jpeg_compress_struct	cinfo;
+	struct gdip_jpeg_error_mgr	jerr;
+	JSAMPLE				*line;
+} JpegRowWriter;
+
+static GpStatus
+gdip_jpeg_row_writer_write (GpRowWriter *writer, const ARGB *row)
+{
+	JpegRowWriter	*jpeg = (JpegRowWriter *) writer;
+	JSAMPLE		*dest = jpeg->line;
+	UINT		x;
+
+	if (sigsetjmp (jpeg->jerr.setjmp_buffer, 1))
+		return GenericError;
+
+	/* JPEG has no alpha channel */
+	for (x = 0; x < jpeg->cinfo.image_width; x++) {
+		*dest++ = (row[x] >> 16) & 0xFF;
+		*dest++ = (row[x] >> 8) & 0xFF;
+		*dest++ = row[x] & 0xFF;
+	}
+
+	jpeg_write_scanlines (&jpeg->cinfo, &jpeg->line, 1);
+	return Ok;
+}
+
+static GpStatus
+gdip_jpeg_row_writer_close (GpRowWriter *writer)
+{
+	JpegRowWriter	*jpeg = (JpegRowWriter *) writer;
+	GpStatus	status = Ok;
+
+	if (sigsetjmp (jpeg->jerr.setjmp_buffer, 1))
+		status = GenericError;
+	else
+		jpeg_finish_compress (&jpeg->cinfo);
+
+	jpeg_destroy_compress (&jpeg->cinfo);
+	GdipFree (jpeg->line);
+	GdipFree (jpeg);
+	return status;
+}
+
+GpStatus
+gdip_jpeg_row_writer_new (FILE *fp, UINT width, UINT height, BOOL alpha, GDIPCONST EncoderParameters *params, GpRowWriter **writer)
+{
+	JpegRowWriter *jpeg;
+
+	jpeg = gdip_calloc (1, sizeof (JpegRowWriter));
+	if (!jpeg)
+		return OutOfMemory;
+
+	if ((unsigned long long int) width * 3 > G_MAXINT32)
+		goto error;
+	jpeg->line = GdipAlloc (width * 3);
+	if (!jpeg->line)
+		goto error;
+
+	jpeg->cinfo.err = jpeg_std_error ((struct jpeg_error_mgr *) &jpeg->jerr);
+	jpeg->jerr.parent.error_exit = _gdip_jpeg_error_exit;
+	jpeg->jerr.parent.output_message = _gdip_jpeg_output_message;
+
+	if (sigsetjmp (jpeg->jerr.setjmp_buffer, 1))
+		goto error;
+
+	jpeg_create_compress (&jpeg->cinfo);
+	jpeg_stdio_dest (&jpeg->cinfo, fp);
+
+	jpeg->cinfo.image_width = width;
+	jpeg->cinfo.image_height = height;
+	jpeg->cinfo.in_color_space = JCS_RGB;
+	jpeg->cinfo.input_components = 3;
+	jpeg_set_defaults (&jpeg->cinfo);
+	gdip_jpeg_set_encoder_parameters (&jpeg->cinfo, params);
+	jpeg_start_compress (&jpeg->cinfo, TRUE);
+
+	jpeg->parent.write_row = gdip_jpeg_row_writer_write;
+	jpeg->parent.close = gdip_jpeg_row_writer_close;
+	*writer = (GpRowWriter *) jpeg;
+	return Ok;
+
+error:
+	jpeg_destroy_compress (&jpeg->cinfo);
+	GdipFree (jpeg->line);
+	GdipFree (jpeg);
+	return OutOfMemory;
+}
+
 #else
 
 /* No libjpeg */
@@ -933,12 +1533,31 @@ gdip_getcodecinfo_jpeg ()
 }
 
 GpStatus
-gdip_load_jpeg_image_from_file (FILE *fp, const char *filename, GpImage **image)
+gdip_load_jpeg_image_from_file (FILE *fp, const char *filename, UINT minWidth, UINT minHeight, GpImage **image)
+{
+	*image = NULL;
+	return UnknownImageFormat;
+}
+
+GpStatus
+gdip_load_jpeg_image_from_mapping (GpFileMapping *mapping, const char *filename, UINT minWidth, UINT minHeight, GpImage **image)
 {
 	*image = NULL;
 	return UnknownImageFormat;
 }
 
+GpStatus
+gdip_jpeg_row_reader_new (FILE *fp, GpRowReader **reader)
+{
+	return NotImplemented;
+}
+
+GpStatus
+gdip_jpeg_row_writer_new (FILE *fp, UINT width, UINT height, BOOL alpha, GDIPCONST EncoderParameters *params, GpRowWriter **writer)
+{
+	return NotImplemented;
+}
+
 GpStatus 
 gdip_save_jpeg_image_to_file (FILE *fp, GpImage *image, GDIPCONST EncoderParameters *params)
 {
@@ -14,10 +14,18 @@
 #include "bitmap-private.h"
 #include "bmpcodec.h"
 
-GpStatus gdip_load_jpeg_image_from_file (FILE *fp, const char *filename, GpImage **image) GDIP_INTERNAL;
+GpStatus gdip_load_jpeg_image_from_file (FILE *fp, const char *filename, UINT minWidth, UINT minHeight, GpImage **image) GDIP_INTERNAL;
+
+GpStatus gdip_load_jpeg_image_from_mapping (GpFileMapping *mapping, const char *filename, UINT minWidth, UINT minHeight,
+	GpImage **image) GDIP_INTERNAL;
 
 GpStatus gdip_load_jpeg_image_from_stream_delegate (dstream_t *loader, GpImage **image) GDIP_INTERNAL;
 
+GpStatus gdip_jpeg_row_reader_new (FILE *fp, GpRowReader **reader) GDIP_INTERNAL;
+
+GpStatus gdip_jpeg_row_writer_new (FILE *fp, UINT width, UINT height, BOOL alpha, GDIPCONST EncoderParameters *params,
+	GpRowWriter **writer) GDIP_INTERNAL;
+
 GpStatus gdip_save_jpeg_image_to_file (FILE *fp, GpImage *image, GDIPCONST EncoderParameters *params) GDIP_INTERNAL;
 
 GpStatus gdip_save_jpeg_image_to_stream_delegate (PutBytesDelegate putBytesFunc, GpImage *image, 
@@ -33,6 +33,9 @@ GUID gdip_png_image_format_guid = {0xb96b3cafU, 0x0728U, 0x11d3U, {0x9d, 0x7b, 0
 #ifdef HAVE_LIBPNG
 
 #include <png.h>
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
 #include "codecs-private.h"
 #include "pngcodec.h"
 #include <setjmp.h>
@@ -93,6 +96,19 @@ _gdip_png_stream_read_data (png_structp png_ptr, png_bytep data, png_size_t leng
 	}
 }
 
+static void
+_gdip_png_memory_read_data (png_structp png_ptr, png_bytep data, png_size_t length)
+{
+	MemorySource *source = (MemorySource *) png_get_io_ptr (png_ptr);
+
+	/* In png parlance, it is an error to read less than length */
+	if (length > source->size - source->pos)
+		png_error (png_ptr, "Read failed");
+
+	memcpy (data, source->ptr + source->pos, length);
+	source->pos += length;
+}
+
 static void
 _gdip_png_stream_write_data (png_structp png_ptr, png_bytep data, png_size_t length)
 {
@@ -241,8 +257,39 @@ gdip_load_png_properties (png_structp png_ptr, png_infop info_ptr, png_infop end
 	return Ok;
 }
 
+/*
+ * Whether the chunks from the first IDAT on, which png_read_info stops at, are complete and hold image data. The
+ * pixels of those are deferred to their first use, decoding the others at load time keeps their errors there.
+ */
+static BOOL
+gdip_png_can_defer_pixels (MemorySource *memory)
+{
+	int pos = memory->pos - 8;
+	BOOL has_data = FALSE;
+
+	if (pos < 0 || memcmp (memory->ptr + pos + 4, "IDAT", 4) != 0)
+		return FALSE;
+
+	while (memory->size - pos >= 12) {
+		BYTE *chunk = memory->ptr + pos;
+		guint32 length = ((guint32) chunk[0] << 24) | (chunk[1] << 16) | (chunk[2] << 8) | chunk[3];
+
+		if (length > (guint32) (memory->size - pos - 12))
+			return FALSE;
+		if (memcmp (chunk + 4, "IEND", 4) == 0)
+			return has_data;
+		if (memcmp (chunk + 4, "IDAT", 4) == 0 && length > 0)
+			has_data = TRUE;
+
+		pos += length + 12;
+	}
+
+	return FALSE;
+}
+
+/* With @headerOnly everything but the pixels is loaded, scan0 is left NULL */
 static GpStatus 
-gdip_load_png_image_from_file_or_stream (FILE *fp, GetBytesDelegate getBytesFunc, GpImage **image)
+gdip_load_png_image_from_file_or_stream (FILE *fp, GetBytesDelegate getBytesFunc, MemorySource *memory, BOOL headerOnly, GpImage **image)
 {
 	png_structp	png_ptr = NULL;
 	png_infop	info_ptr = NULL;
@@ -280,12 +327,19 @@ gdip_load_png_image_from_file_or_stream (FILE *fp, GetBytesDelegate getBytesFunc
 
 	if (fp != NULL) {
 		png_init_io (png_ptr, fp);
+	} else if (memory != NULL) {
+		png_set_read_fn (png_ptr, (void *) memory, _gdip_png_memory_read_data);
 	} else {
 		png_set_read_fn (png_ptr, (void *) getBytesFunc, _gdip_png_stream_read_data);
 	}
 
 	png_read_info(png_ptr, info_ptr);
 
+	if (headerOnly && !gdip_png_can_defer_pixels (memory)) {
+		status = NotImplemented;
+		goto error;
+	}
+
 	bit_depth = png_get_bit_depth(png_ptr, info_ptr);
 	original_color_type = png_get_color_type(png_ptr, info_ptr);
 	channels = png_get_channels(png_ptr, info_ptr);
@@ -370,25 +424,27 @@ gdip_load_png_image_from_file_or_stream (FILE *fp, GetBytesDelegate getBytesFunc
 			goto error;
 		}
 
-		row_pointers = (png_bytep*)malloc(sizeof(png_bytep) * height);
-		if (!row_pointers) {
-			status = OutOfMemory;
-			goto error;
-		}
+		if (!headerOnly) {
+			row_pointers = (png_bytep*)malloc(sizeof(png_bytep) * height);
+			if (!row_pointers) {
+				status = OutOfMemory;
+				goto error;
+			}
 
-		rawdata = GdipAlloc(size);
-		if (!rawdata) {
-			status = OutOfMemory;
-			free(row_pointers);
-			goto error;
-		}
+			rawdata = GdipAlloc(size);
+			if (!rawdata) {
+				status = OutOfMemory;
+				free(row_pointers);
+				goto error;
+			}
 
-		for (i=0; i < height; i++) {
-			row_pointers[i] = rawdata + i * dest_stride;
-		}
+			for (i=0; i < height; i++) {
+				row_pointers[i] = rawdata + i * dest_stride;
+			}
 
-		png_read_image(png_ptr, row_pointers);
-		free(row_pointers);
+			png_read_image(png_ptr, row_pointers);
+			free(row_pointers);
+		}
 
 		/* Copy palette. */
 		num_colours = 1 << bit_depth;
@@ -520,33 +576,35 @@ gdip_load_png_image_from_file_or_stream (FILE *fp, GetBytesDelegate getBytesFunc
 		stride = (width * 4);
 		gdip_align_stride (stride);
 
-		/* Copy image data. */
-		row_pointers = (png_bytep*)malloc(sizeof(png_bytep) * height);
-		if (!row_pointers) {
-			status = OutOfMemory;
-			goto error;
-		}
-
 		unsigned long long int size = (unsigned long long int)stride * height;
 		if (size > G_MAXINT32) {
 			status = OutOfMemory;
 			goto error;
 		}
 
-		rawdata = GdipAlloc (size);
-		if (!rawdata) {
-			status = OutOfMemory;
-			free(row_pointers);
-			goto error;
-		}
+		/* Copy image data. */
+		if (!headerOnly) {
+			row_pointers = (png_bytep*)malloc(sizeof(png_bytep) * height);
+			if (!row_pointers) {
+				status = OutOfMemory;
+				goto error;
+			}
 
-		for (i = 0; i < height; i++) {
-			row_pointers[i] = rawdata + i * stride;
-		}
+			rawdata = GdipAlloc (size);
+			if (!rawdata) {
+				status = OutOfMemory;
+				free(row_pointers);
+				goto error;
+			}
 
-		png_read_image(png_ptr, row_pointers);
+			for (i = 0; i < height; i++) {
+				row_pointers[i] = rawdata + i * stride;
+			}
 
-		free(row_pointers);
+			png_read_image(png_ptr, row_pointers);
+
+			free(row_pointers);
+		}
 
 		result = gdip_bitmap_new_with_frame (&gdip_image_frameDimension_page_guid, TRUE);
 		if (!result) {
@@ -628,13 +686,616 @@ error:
 GpStatus 
 gdip_load_png_image_from_file (FILE *fp, GpImage **image)
 {
-	return gdip_load_png_image_from_file_or_stream (fp, NULL, image);
+	return gdip_load_png_image_from_file_or_stream (fp, NULL, NULL, FALSE, image);
 }
 
 GpStatus
 gdip_load_png_image_from_stream_delegate (GetBytesDelegate getBytesFunc, SeekDelegate seeknFunc, GpImage **image)
 {
-	return gdip_load_png_image_from_file_or_stream (NULL, getBytesFunc, image);
+	return gdip_load_png_image_from_file_or_stream (NULL, getBytesFunc, NULL, FALSE, image);
+}
+
+GpStatus
+gdip_load_png_image_from_memory (MemorySource *source, GpImage **image)
+{
+	return gdip_load_png_image_from_file_or_stream (NULL, NULL, source, FALSE, image);
+}
+
+/* Only the chunks before the image data are read here when possible, the pixels are decoded from the file on first use */
+GpStatus
+gdip_load_png_image_from_mapping (GpFileMapping *mapping, GpImage **image)
+{
+	MemorySource ms = { mapping->ptr, mapping->size, 0 };
+	GpStatus status;
+
+	status = gdip_load_png_image_from_file_or_stream (NULL, NULL, &ms, TRUE, image);
+	if (status == Ok) {
+		if (gdip_file_mapping_defer_load (mapping, *image, gdip_load_png_image_from_memory))
+			return Ok;
+
+		gdip_bitmap_dispose (*image);
+	}
+
+	/* decode everything now, which also gives the error of an image that can't be loaded */
+	ms.pos = 0;
+	return gdip_load_png_image_from_memory (&ms, image);
+}
+
+typedef struct {
+	GpRowReader	parent;
+	png_structp	png_ptr;
+	png_infop	info_ptr;
+	BYTE		*buffer;
+} PngRowReader;
+
+static GpStatus
+gdip_png_row_reader_read (GpRowReader *reader, ARGB *row)
+{
+	PngRowReader	*png = (PngRowReader *) reader;
+	BYTE		*src;
+	UINT		x;
+
+	if (setjmp (png_jmpbuf (png->png_ptr))) {
+		/* png detected error occured */
+		return OutOfMemory;
+	}
+
+	png_read_row (png->png_ptr, png->buffer, NULL);
+
+	/* the transformations set up below always give 8 bits RGBA */
+	for (x = 0, src = png->buffer; x < reader->width; x++, src += 4)
+		row[x] = ((ARGB) src[3] << 24) | (src[0] << 16) | (src[1] << 8) | src[2];
+
+	return Ok;
+}
+
+static void
+gdip_png_row_reader_close (GpRowReader *reader)
+{
+	PngRowReader *png = (PngRowReader *) reader;
+
+	png_destroy_read_struct (&png->png_ptr, &png->info_ptr, NULL);
+	GdipFree (png->buffer);
+	GdipFree (png);
+}
+
+GpStatus
+gdip_png_row_reader_new (FILE *fp, GpRowReader **reader)
+{
+	PngRowReader	*png;
+	GpStatus	status = OutOfMemory;
+	BYTE		color_type;
+
+	png = gdip_calloc (1, sizeof (PngRowReader));
+	if (!png)
+		return OutOfMemory;
+
+	png->png_ptr = png_create_read_struct (PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	if (!png->png_ptr)
+		goto error;
+
+	if (setjmp (png_jmpbuf (png->png_ptr))) {
+		/* png detected error occured */
+		goto error;
+	}
+
+	png->info_ptr = png_create_info_struct (png->png_ptr);
+	if (!png->info_ptr)
+		goto error;
+
+	png_init_io (png->png_ptr, fp);
+	png_read_info (png->png_ptr, png->info_ptr);
+
+	/* the rows of the Adam7 passes can only be combined once the whole image is decoded */
+	if (png_get_interlace_type (png->png_ptr, png->info_ptr) != PNG_INTERLACE_NONE) {
+		status = NotImplemented;
+		goto error;
+	}
+
+	color_type = png_get_color_type (png->png_ptr, png->info_ptr);
+	png->parent.has_alpha = (color_type & PNG_COLOR_MASK_ALPHA) || png_get_valid (png->png_ptr, png->info_ptr, PNG_INFO_tRNS);
+	png->parent.width = png_get_image_width (png->png_ptr, png->info_ptr);
+	png->parent.height = png_get_image_height (png->png_ptr, png->info_ptr);
+
+	png_set_expand (png->png_ptr);
+	png_set_strip_16 (png->png_ptr);
+	png_set_gray_to_rgb (png->png_ptr);
+	png_set_filler (png->png_ptr, 0xFF, PNG_FILLER_AFTER);
+	png_read_update_info (png->png_ptr, png->info_ptr);
+
+	if ((unsigned long long int) png->parent.width * 4 > G_MAXINT32)
+		goto error;
+	png->buffer = GdipAlloc (png->parent.width * 4);
+	if (!png->buffer)
+		goto error;
+
+	png->parent.read_row = gdip_png_row_reader_read;
+	png->parent.close = gdip_png_row_reader_close;
+	*reader = (GpRowReader *) png;
+	return Ok;
+
+error:
+	if (png->png_ptr)
+		png_destroy_read_struct (&png->png_ptr, png->info_ptr ? &png->info_ptr : NULL, NULL);
+	GdipFree (png->buffer);
+	GdipFree (png);
+	return status;
+}
+
+typedef struct {
+	int	level;		/* zlib level, -1 for the default */
+	int	filters;	/* PngFilter mask, 0 when not given */
+	BOOL	parallel;
+} PngEncoderOptions;
+
+static BOOL
+gdip_png_get_long_parameter (GDIPCONST EncoderParameters *params, GUID *guid, int *value)
+{
+	const EncoderParameter *param;
+
+	if (!params)
+		return FALSE;
+
+	param = gdip_find_encoder_parameter (params, guid);
+	if (!param || param->Type != EncoderParameterValueTypeLong || param->NumberOfValues < 1)
+		return FALSE;
+
+	*value = *(int *) param->Value;
+	return TRUE;
+}
+
+static GpStatus
+gdip_png_get_encoder_options (GDIPCONST EncoderParameters *params, PngEncoderOptions *options)
+{
+	int value;
+
+	options->level = -1;
+	options->filters = 0;
+	options->parallel = FALSE;
+
+	if (gdip_png_get_long_parameter (params, &GdipEncoderPngCompressionLevel, &value)) {
+		if (value < 0 || value > 9)
+			return InvalidParameter;
+		options->level = value;
+	}
+	if (gdip_png_get_long_parameter (params, &GdipEncoderPngFilter, &value)) {
+		if (value <= 0 || (value & ~PngFilterAdaptive))
+			return InvalidParameter;
+		options->filters = value;
+	}
+	if (gdip_png_get_long_parameter (params, &GdipEncoderPngParallel, &value))
+		options->parallel = value != 0;
+
+	return Ok;
+}
+
+static void
+gdip_png_apply_encoder_options (png_structp png_ptr, PngEncoderOptions *options, int default_filters)
+{
+	int filters = options->filters ? options->filters : default_filters;
+
+	/* PngFilter values are the libpng PNG_FILTER_* flags shifted down */
+	if (filters)
+		png_set_filter (png_ptr, 0, filters << 3);
+	if (options->level >= 0)
+		png_set_compression_level (png_ptr, options->level);
+}
+
+#ifdef HAVE_LIBZ
+
+/* Rows compressed by one thread, as a raw deflate stream ending on a byte boundary */
+typedef struct {
+	BYTE	*data;
+	size_t	size;
+	uLong	adler;
+	uLong	length;
+	int	y_end;
+} PngDeflatedStrip;
+
+typedef struct {
+	ActiveBitmapData	*bitmap;
+	int			color_type;
+	size_t			row_bytes;
+	int			bpp;
+	int			level;
+	int			filters;
+	PngDeflatedStrip	**strips;	/* indexed by the first row of the strip */
+} PngParallelEncoder;
+
+/* Packs a row of the bitmap in PNG byte order */
+static void
+gdip_png_pack_row (PngParallelEncoder *encoder, int y, BYTE *dest)
+{
+	ActiveBitmapData *bitmap = encoder->bitmap;
+	const ARGB *src = (const ARGB *) (bitmap->scan0 + y * bitmap->stride);
+	int x;
+
+	switch (encoder->color_type) {
+	case PNG_COLOR_TYPE_PALETTE:
+		memcpy (dest, bitmap->scan0 + y * bitmap->stride, encoder->row_bytes);
+		break;
+	case PNG_COLOR_TYPE_RGB:
+		for (x = 0; x < bitmap->width; x++) {
+			*dest++ = (src[x] >> 16) & 0xFF;
+			*dest++ = (src[x] >> 8) & 0xFF;
+			*dest++ = src[x] & 0xFF;
+		}
+		break;
+	default:
+		for (x = 0; x < bitmap->width; x++) {
+			*dest++ = (src[x] >> 16) & 0xFF;
+			*dest++ = (src[x] >> 8) & 0xFF;
+			*dest++ = src[x] & 0xFF;
+			*dest++ = src[x] >> 24;
+		}
+		break;
+	}
+}
+
+static BYTE
+gdip_png_paeth (BYTE a, BYTE b, BYTE c)
+{
+	int p = a + b - c;
+	int pa = abs (p - a);
+	int pb = abs (p - b);
+	int pc = abs (p - c);
+
+	if (pa <= pb && pa <= pc)
+		return a;
+	return pb <= pc ? b : c;
+}
+
+/* Filters row with the given PNG filter type, prefixing it with the type byte. Returns the sum of the
+ * filtered bytes taken as signed values, the usual estimate of how well the row compresses */
+static size_t
+gdip_png_filter_row (int type, const BYTE *row, const BYTE *prev, size_t row_bytes, int bpp, BYTE *out)
+{
+	size_t i, sum = 0;
+
+	*out++ = type;
+	for (i = 0; i < row_bytes; i++) {
+		BYTE left = i >= bpp ? row[i - bpp] : 0;
+		BYTE up_left = i >= bpp ? prev[i - bpp] : 0;
+		BYTE value;
+
+		switch (type) {
+		case 1:
+			value = row[i] - left;
+			break;
+		case 2:
+			value = row[i] - prev[i];
+			break;
+		case 3:
+			value = row[i] - ((left + prev[i]) >> 1);
+			break;
+		case 4:
+			value = row[i] - gdip_png_paeth (left, prev[i], up_left);
+			break;
+		default:
+			value = row[i];
+			break;
+		}
+
+		out[i] = value;
+		sum += abs ((signed char) value);
+	}
+	return sum;
+}
+
+static BOOL
+gdip_png_deflate (z_stream *stream, PngDeflatedStrip *strip, int flush)
+{
+	int result;
+
+	do {
+		if (stream->avail_out == 0) {
+			size_t capacity = strip->size * 2 + 4096;
+			BYTE *data;
+
+			if (capacity > G_MAXINT32)
+				return FALSE;
+			data = gdip_realloc (strip->data, capacity);
+			if (!data)
+				return FALSE;
+			strip->data = data;
+			stream->next_out = data + strip->size;
+			stream->avail_out = capacity - strip->size;
+		}
+
+		result = deflate (stream, flush);
+		strip->size = stream->next_out - strip->data;
+		if (result == Z_STREAM_ERROR)
+			return FALSE;
+	} while (stream->avail_out == 0 || (flush == Z_FINISH && result != Z_STREAM_END));
+
+	return TRUE;
+}
+
+static void
+gdip_png_deflate_strip (int y_start, int y_end, void *user_data)
+{
+	PngParallelEncoder *encoder = (PngParallelEncoder *) user_data;
+	PngDeflatedStrip *strip;
+	BYTE *prev, *row, *best, *candidate;
+	z_stream stream;
+	BOOL ok = TRUE;
+	int y, type;
+
+	strip = gdip_calloc (1, sizeof (PngDeflatedStrip));
+	prev = gdip_calloc (1, encoder->row_bytes);
+	row = GdipAlloc (encoder->row_bytes);
+	best = GdipAlloc (encoder->row_bytes + 1);
+	candidate = GdipAlloc (encoder->row_bytes + 1);
+	if (!strip || !prev || !row || !best || !candidate)
+		goto error;
+
+	memset (&stream, 0, sizeof (stream));
+	if (deflateInit2 (&stream, encoder->level, Z_DEFLATED, -MAX_WBITS, 8,
+			encoder->filters == PngFilterNone ? Z_DEFAULT_STRATEGY : Z_FILTERED) != Z_OK)
+		goto error;
+
+	/* filters look at the row above, even when it belongs to another strip */
+	if (y_start > 0)
+		gdip_png_pack_row (encoder, y_start - 1, prev);
+
+	strip->adler = adler32 (0, NULL, 0);
+	for (y = y_start; y < y_end && ok; y++) {
+		size_t best_sum = (size_t) -1;
+		BYTE *swap;
+
+		gdip_png_pack_row (encoder, y, row);
+		for (type = 0; type < 5; type++) {
+			size_t sum;
+
+			if (!(encoder->filters & (1 << type)))
+				continue;
+
+			sum = gdip_png_filter_row (type, row, prev, encoder->row_bytes, encoder->bpp, candidate);
+			if (sum < best_sum) {
+				best_sum = sum;
+				swap = best;
+				best = candidate;
+				candidate = swap;
+			}
+		}
+
+		strip->adler = adler32 (strip->adler, best, encoder->row_bytes + 1);
+		strip->length += encoder->row_bytes + 1;
+		stream.next_in = best;
+		stream.avail_in = encoder->row_bytes + 1;
+		ok = gdip_png_deflate (&stream, strip, Z_NO_FLUSH);
+
+		swap = prev;
+		prev = row;
+		row = swap;
+	}
+
+	/* only the last strip ends the deflate stream, the others are just byte aligned */
+	if (ok)
+		ok = gdip_png_deflate (&stream, strip, y_end == encoder->bitmap->height ? Z_FINISH : Z_SYNC_FLUSH);
+	deflateEnd (&stream);
+	if (!ok)
+		goto error;
+
+	strip->y_end = y_end;
+	encoder->strips[y_start] = strip;
+	GdipFree (prev);
+	GdipFree (row);
+	GdipFree (best);
+	GdipFree (candidate);
+	return;
+
+error:
+	if (strip)
+		GdipFree (strip->data);
+	GdipFree (strip);
+	GdipFree (prev);
+	GdipFree (row);
+	GdipFree (best);
+	GdipFree (candidate);
+}
+
+static void
+gdip_png_write_idat (png_structp png_ptr, const BYTE *data, size_t size)
+{
+	static png_byte idat[5] = { 'I', 'D', 'A', 'T', '\0' };
+
+	while (size > 0) {
+		size_t length = MIN (size, 1 << 30);
+
+		png_write_chunk (png_ptr, idat, (png_bytep) data, length);
+		data += length;
+		size -= length;
+	}
+}
+
+/*
+ * Writes the image data as strips deflated in parallel (like pigz does), then the end of the file. The
+ * strips are stitched into a single zlib stream: a zlib header, the raw deflate data of every strip and
+ * the combined adler32 of the filtered rows.
+ */
+static GpStatus
+gdip_png_write_parallel (png_structp png_ptr, ActiveBitmapData *bitmap, int color_type, int bit_depth, PngEncoderOptions *options)
+{
+	static png_byte iend[5] = { 'I', 'E', 'N', 'D', '\0' };
+	PngParallelEncoder encoder;
+	BYTE header[2];
+	BYTE trailer[4];
+	uLong adler;
+	int channels, y, level_flags;
+	GpStatus status = Ok;
+
+	channels = color_type == PNG_COLOR_TYPE_RGB_ALPHA ? 4 : color_type == PNG_COLOR_TYPE_RGB ? 3 : 1;
+	encoder.bitmap = bitmap;
+	encoder.color_type = color_type;
+	encoder.row_bytes = ((size_t) bitmap->width * channels * bit_depth + 7) / 8;
+	encoder.bpp = MAX (1, channels * bit_depth / 8);
+	encoder.level = options->level >= 0 ? options->level : Z_DEFAULT_COMPRESSION;
+	encoder.filters = options->filters ? options->filters : PngFilterNone;
+	encoder.strips = gdip_calloc (bitmap->height, sizeof (PngDeflatedStrip *));
+	if (!encoder.strips)
+		return OutOfMemory;
+
+	gdip_process_row_bands (bitmap->height, encoder.row_bytes, gdip_png_deflate_strip, &encoder);
+
+	for (y = 0; y < bitmap->height; y = encoder.strips[y]->y_end) {
+		if (!encoder.strips[y]) {
+			status = OutOfMemory;
+			goto cleanup;
+		}
+	}
+
+	if (setjmp (png_jmpbuf (png_ptr))) {
+		/* png detected error occured */
+		status = GenericError;
+		goto cleanup;
+	}
+
+	/* zlib header for a 32K window, with the compression level hint zlib itself would use */
+	if (encoder.level == Z_DEFAULT_COMPRESSION || encoder.level == 6)
+		level_flags = 2;
+	else if (encoder.level < 2)
+		level_flags = 0;
+	else
+		level_flags = encoder.level < 6 ? 1 : 3;
+	header[0] = 0x78;
+	header[1] = level_flags << 6;
+	header[1] += 31 - ((header[0] << 8) + header[1]) % 31;
+	gdip_png_write_idat (png_ptr, header, sizeof (header));
+
+	adler = adler32 (0, NULL, 0);
+	for (y = 0; y < bitmap->height; y = encoder.strips[y]->y_end) {
+		PngDeflatedStrip *strip = encoder.strips[y];
+
+		gdip_png_write_idat (png_ptr, strip->data, strip->size);
+		adler = adler32_combine (adler, strip->adler, strip->length);
+	}
+
+	trailer[0] = adler >> 24;
+	trailer[1] = adler >> 16;
+	trailer[2] = adler >> 8;
+	trailer[3] = adler;
+	gdip_png_write_idat (png_ptr, trailer, sizeof (trailer));
+	png_write_chunk (png_ptr, iend, NULL, 0);
+
+cleanup:
+	for (y = 0; y < bitmap->height; y++) {
+		if (encoder.strips[y]) {
+			GdipFree (encoder.strips[y]->data);
+			GdipFree (encoder.strips[y]);
+		}
+	}
+	GdipFree (encoder.strips);
+	return status;
+}
+
+#endif /* HAVE_LIBZ */
+
+typedef struct {
+	GpRowWriter	parent;
+	png_structp	png_ptr;
+	png_infop	info_ptr;
+	UINT		width;
+	BOOL		alpha;
+	BYTE		*buffer;
+} PngRowWriter;
+
+static GpStatus
+gdip_png_row_writer_write (GpRowWriter *writer, const ARGB *row)
+{
+	PngRowWriter	*png = (PngRowWriter *) writer;
+	BYTE		*dest = png->buffer;
+	UINT		x;
+
+	if (setjmp (png_jmpbuf (png->png_ptr))) {
+		/* png detected error occured */
+		return GenericError;
+	}
+
+	for (x = 0; x < png->width; x++) {
+		*dest++ = (row[x] >> 16) & 0xFF;
+		*dest++ = (row[x] >> 8) & 0xFF;
+		*dest++ = row[x] & 0xFF;
+		if (png->alpha)
+			*dest++ = row[x] >> 24;
+	}
+
+	png_write_row (png->png_ptr, png->buffer);
+	return Ok;
+}
+
+static GpStatus
+gdip_png_row_writer_close (GpRowWriter *writer)
+{
+	PngRowWriter	*png = (PngRowWriter *) writer;
+	GpStatus	status = Ok;
+
+	if (setjmp (png_jmpbuf (png->png_ptr))) {
+		/* png detected error occured */
+		status = GenericError;
+	} else {
+		png_write_end (png->png_ptr, NULL);
+	}
+
+	png_destroy_write_struct (&png->png_ptr, &png->info_ptr);
+	GdipFree (png->buffer);
+	GdipFree (png);
+	return status;
+}
+
+GpStatus
+gdip_png_row_writer_new (FILE *fp, UINT width, UINT height, BOOL alpha, GDIPCONST EncoderParameters *params, GpRowWriter **writer)
+{
+	PngRowWriter		*png;
+	PngEncoderOptions	options;
+	GpStatus		status;
+
+	status = gdip_png_get_encoder_options (params, &options);
+	if (status != Ok)
+		return status;
+
+	png = gdip_calloc (1, sizeof (PngRowWriter));
+	if (!png)
+		return OutOfMemory;
+
+	png->width = width;
+	png->alpha = alpha;
+	if ((unsigned long long int) width * 4 > G_MAXINT32)
+		goto error;
+	png->buffer = GdipAlloc (width * (alpha ? 4 : 3));
+	if (!png->buffer)
+		goto error;
+
+	png->png_ptr = png_create_write_struct (PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	if (!png->png_ptr)
+		goto error;
+
+	if (setjmp (png_jmpbuf (png->png_ptr))) {
+		/* png detected error occured */
+		goto error;
+	}
+
+	png->info_ptr = png_create_info_struct (png->png_ptr);
+	if (!png->info_ptr)
+		goto error;
+
+	png_init_io (png->png_ptr, fp);
+	png_set_IHDR (png->png_ptr, png->info_ptr, width, height, 8, alpha ? PNG_COLOR_TYPE_RGB_ALPHA : PNG_COLOR_TYPE_RGB,
+		PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+	gdip_png_apply_encoder_options (png->png_ptr, &options, 0);
+	png_write_info (png->png_ptr, png->info_ptr);
+
+	png->parent.write_row = gdip_png_row_writer_write;
+	png->parent.close = gdip_png_row_writer_close;
+	*writer = (GpRowWriter *) png;
+	return Ok;
+
+error:
+	if (png->png_ptr)
+		png_destroy_write_struct (&png->png_ptr, png->info_ptr ? &png->info_ptr : NULL);
+	GdipFree (png->buffer);
+	GdipFree (png);
+	return OutOfMemory;
 }
 
 static GpStatus 
@@ -646,6 +1307,28 @@ gdip_save_png_image_to_file_or_stream (FILE *fp, PutBytesDelegate putBytesFunc,
 	int		i;
 	int		bit_depth;
 	int		color_type;
+	PngEncoderOptions options;
+
+	status = gdip_png_get_encoder_options (params, &options);
+	if (status != Ok)
+		return status;
+
+	/* 16 bits per channel are saved with 8, like the other encoders do */
+	switch (image->active_bitmap->pixel_format) {
+	case PixelFormat48bppRGB:
+	case PixelFormat64bppARGB:
+	case PixelFormat64bppPARGB: {
+		GpBitmap *converted = gdip_convert_wide_to_rgb (image);
+		if (!converted)
+			return OutOfMemory;
+
+		status = gdip_save_png_image_to_file_or_stream (fp, putBytesFunc, converted, params);
+		gdip_bitmap_dispose (converted);
+		return status;
+	}
+	default:
+		break;
+	}
 
 	png_ptr = png_create_write_struct (PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
 	if (!png_ptr) {
@@ -700,9 +1383,6 @@ gdip_save_png_image_to_file_or_stream (FILE *fp, PutBytesDelegate putBytesFunc,
 			break;
 
 		/* We're not going to even try to save these images, for now */
-		case PixelFormat64bppARGB:
-		case PixelFormat64bppPARGB:
-		case PixelFormat48bppRGB:
 		case PixelFormat16bppARGB1555:
 		case PixelFormat16bppGrayScale:
 		case PixelFormat16bppRGB555:
@@ -741,10 +1421,21 @@ gdip_save_png_image_to_file_or_stream (FILE *fp, PutBytesDelegate putBytesFunc,
 		}
 	}
 
-	png_set_filter (png_ptr, 0, PNG_NO_FILTERS);
+	gdip_png_apply_encoder_options (png_ptr, &options, PngFilterNone);
 	png_set_sRGB_gAMA_and_cHRM (png_ptr, info_ptr, PNG_sRGB_INTENT_PERCEPTUAL);
 	png_write_info (png_ptr, info_ptr);
 
+#ifdef HAVE_LIBZ
+	if (options.parallel) {
+		status = gdip_png_write_parallel (png_ptr, image->active_bitmap, color_type, bit_depth, &options);
+		if (status != Ok)
+			goto error;
+
+		png_destroy_write_struct (&png_ptr, &info_ptr);
+		return Ok;
+	}
+#endif
+
 	png_set_bgr(png_ptr);
 
 	if (gdip_is_an_indexed_pixelformat (image->active_bitmap->pixel_format)) {
@@ -844,6 +1535,32 @@ gdip_load_png_image_from_stream_delegate (GetBytesDelegate getBytesFunc, SeekDel
 	return UnknownImageFormat;
 }
 
+GpStatus
+gdip_load_png_image_from_memory (MemorySource *source, GpImage **image)
+{
+	*image = NULL;
+	return UnknownImageFormat;
+}
+
+GpStatus
+gdip_load_png_image_from_mapping (GpFileMapping *mapping, GpImage **image)
+{
+	*image = NULL;
+	return UnknownImageFormat;
+}
+
+GpStatus
+gdip_png_row_reader_new (FILE *fp, GpRowReader **reader)
+{
+	return NotImplemented;
+}
+
+GpStatus
+gdip_png_row_writer_new (FILE *fp, UINT width, UINT height, BOOL alpha, GDIPCONST EncoderParameters *params, GpRowWriter **writer)
+{
+	return NotImplemented;
+}
+
 
 GpStatus 
 gdip_save_png_image_to_file (FILE *fp, GpImage *image, GDIPCONST EncoderParameters *params)
@@ -19,6 +19,14 @@ GpStatus gdip_load_png_image_from_file (FILE *fp, GpImage **image) GDIP_INTERNAL
 GpStatus gdip_load_png_image_from_stream_delegate (GetBytesDelegate getBytesFunc, SeekDelegate seeknFunc, 
 	GpImage **image) GDIP_INTERNAL;
 
+GpStatus gdip_load_png_image_from_memory (MemorySource *source, GpImage **image) GDIP_INTERNAL;
+GpStatus gdip_load_png_image_from_mapping (GpFileMapping *mapping, GpImage **image) GDIP_INTERNAL;
+
+GpStatus gdip_png_row_reader_new (FILE *fp, GpRowReader **reader) GDIP_INTERNAL;
+
+GpStatus gdip_png_row_writer_new (FILE *fp, UINT width, UINT height, BOOL alpha, GDIPCONST EncoderParameters *params,
+	GpRowWriter **writer) GDIP_INTERNAL;
+
 GpStatus gdip_save_png_image_to_file (FILE *fp, GpImage *image, GDIPCONST EncoderParameters *params) GDIP_INTERNAL;
 
 GpStatus gdip_save_png_image_to_stream_delegate (PutBytesDelegate putBytesFunc, GpImage *image,
@@ -34,4 +42,22 @@ typedef struct
   EncoderParameter imageItems;
 } PngEncoderParameters;
 
+/*
+ * libgdiplus specific PNG encoder parameters, all of them EncoderParameterValueTypeLong:
+ *
+ * GdipEncoderPngCompressionLevel {55273c16-a11e-4eb0-8fd8-2f05e75ec10f}: zlib level, 0 (none) to 9 (smallest).
+ * GdipEncoderPngFilter {ce9d2466-11b4-4355-a097-6e5320d14f00}: a combination of PngFilter values. When several
+ *	filters are given, each row uses the one that looks the most compressible. Defaults to PngFilterNone.
+ * GdipEncoderPngParallel {638a7a4d-570b-46e7-810b-054787dd4169}: non zero to deflate horizontal strips of large
+ *	images on several threads. The file is slightly larger as the strips don't share their history.
+ */
+typedef enum {
+	PngFilterNone		= 0x01,
+	PngFilterSub		= 0x02,
+	PngFilterUp		= 0x04,
+	PngFilterAverage	= 0x08,
+	PngFilterPaeth		= 0x10,
+	PngFilterAdaptive	= 0x1F
+} PngFilter;
+
 #endif /* _PNGCODEC_H */
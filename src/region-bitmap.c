@@ -26,8 +26,10 @@
 
 #ifdef WORDS_BIGENDIAN
 #define is_bit_set(w, k) ((w) & (1 << (7 - (k))))
+#define bits_from(k) ((BYTE) (0xFF >> (k)))
 #else
 #define is_bit_set(w, k) ((w) & (1 << (k)))
+#define bits_from(k) ((BYTE) (0xFF << (k)))
 #endif
 
 // #define DEBUG_REGION
@@ -218,11 +220,50 @@ alloc_bitmap_with_buffer (int x, int y, int width, int height, BYTE *buffer)
 	result->Height = height;
 	result->Mask = buffer;
 	result->reduced = FALSE; /* bitmap size isn't optimal wrt contents */
+	result->Spans = NULL;
 
 	return result;
 }
 
 
+/*
+ * alloc_bitmap_with_spans:
+ * @spans: a GpRegionSpans
+ *
+ * Allocate and return a new GpRegionBitmap structure using the supplied
+ * @spans, or an empty bitmap if @spans is empty.
+ *
+ * Notes:
+ * - The allocated structure must be freed using gdip_region_bitmap_free.
+ * - The bitmap takes ownership of @spans, which is freed on failure.
+ */
+static GpRegionBitmap*
+alloc_bitmap_with_spans (GpRegionSpans *spans)
+{
+	GpRegionBitmap *result;
+	GpRect rect;
+
+	if (!spans)
+		return NULL;
+
+	if (spans->band_count == 0) {
+		gdip_region_spans_free (spans);
+		return alloc_bitmap_with_buffer (0, 0, 0, 0, NULL);
+	}
+
+	gdip_region_spans_get_extents (spans, &rect);
+	result = alloc_bitmap_with_buffer (rect.X, rect.Y, rect.Width, rect.Height, NULL);
+	if (!result) {
+		gdip_region_spans_free (spans);
+		return NULL;
+	}
+
+	result->Spans = spans;
+	result->reduced = TRUE; /* the extents are exact */
+	return result;
+}
+
+
 /*
  * alloc_bitmap:
  * @x: an integer representing the X coordinate of the bitmap
@@ -309,6 +350,9 @@ gdip_region_bitmap_clone (GpRegionBitmap *bitmap)
 	BYTE *buffer;
 	int size = (bitmap->Width * bitmap->Height >> 3); /* 1 bit per pixel */
 
+	if (bitmap->Spans)
+		return alloc_bitmap_with_spans (gdip_region_spans_clone (bitmap->Spans));
+
 	if (size > 0) {
 		buffer = alloc_bitmap_memory (size, FALSE);
 		if (buffer)
@@ -339,6 +383,99 @@ empty_bitmap (GpRegionBitmap *bitmap)
 		GdipFree (bitmap->Mask);
 		bitmap->Mask = NULL;
 	}
+
+	if (bitmap->Spans) {
+		gdip_region_spans_free (bitmap->Spans);
+		bitmap->Spans = NULL;
+	}
+}
+
+
+/*
+ * mask_to_spans:
+ * @bitmap: a GpRegionBitmap using a mask (or empty)
+ *
+ * Return a new GpRegionSpans containing the visible pixels of the @bitmap
+ * mask, or NULL if the memory couldn't be allocated.
+ */
+static GpRegionSpans*
+mask_to_spans (GpRegionBitmap *bitmap)
+{
+	GpRegionSpans *spans = gdip_region_spans_new ();
+	GpRegionSpan *line;
+	int width_byte = bitmap->Width >> 3;
+	int x, y;
+
+	if (!spans || !bitmap->Mask)
+		return spans;
+
+	/* at most one span every two pixels */
+	line = GdipAlloc ((bitmap->Width / 2 + 1) * sizeof (GpRegionSpan));
+	if (!line) {
+		gdip_region_spans_free (spans);
+		return NULL;
+	}
+
+	for (y = 0; y < bitmap->Height; y++) {
+		BYTE *mask = bitmap->Mask + y * width_byte;
+		int count = 0;
+		int start = -1;
+
+		for (x = 0; x < bitmap->Width; x++) {
+			BYTE b = mask [x >> 3];
+			int k = (x & 7);
+
+			/* skip whole bytes that do not change the state */
+			if ((k == 0) && (b == ((start == -1) ? 0x00 : 0xFF))) {
+				x += 7;
+				continue;
+			}
+
+			if (is_bit_set (b, k)) {
+				if (start == -1)
+					start = x;
+			} else if (start != -1) {
+				line [count].x1 = bitmap->X + start;
+				line [count].x2 = bitmap->X + x;
+				count++;
+				start = -1;
+			}
+		}
+		if (start != -1) {
+			line [count].x1 = bitmap->X + start;
+			line [count].x2 = bitmap->X + bitmap->Width;
+			count++;
+		}
+
+		if (!gdip_region_spans_add_band (spans, bitmap->Y + y, bitmap->Y + y + 1, line, count)) {
+			GdipFree (line);
+			gdip_region_spans_free (spans);
+			return NULL;
+		}
+	}
+
+	GdipFree (line);
+	return spans;
+}
+
+
+/*
+ * get_spans:
+ * @bitmap: a GpRegionBitmap
+ * @allocated: set to TRUE if the returned spans must be freed by the caller
+ *
+ * Return the spans of @bitmap, converting its mask if needed.
+ */
+static GpRegionSpans*
+get_spans (GpRegionBitmap *bitmap, BOOL *allocated)
+{
+	if (bitmap->Spans) {
+		*allocated = FALSE;
+		return bitmap->Spans;
+	}
+
+	*allocated = TRUE;
+	return mask_to_spans (bitmap);
 }
 
 
@@ -361,7 +498,8 @@ gdip_region_bitmap_free (GpRegionBitmap *bitmap)
  * @tree: a GpPathTree
  *
  * Return a new GpRegionBitmap containing the bitmap recomposed from the 
- * @tree.
+ * @tree. The cached bitmaps of the subtrees are used, and consumed, instead
+ * of rasterizing them again.
  *
  * Note: the allocated structure must be freed using gdip_region_bitmap_free.
  */
@@ -373,6 +511,13 @@ gdip_region_bitmap_from_tree (GpPathTree *tree)
 	if (!tree)
 		return NULL;
 
+	/* the subtree was already rasterized */
+	if (tree->bitmap) {
+		result = tree->bitmap;
+		tree->bitmap = NULL;
+		return result;
+	}
+
 	/* each item has... */
 	if (tree->path) {
 		/* (a) only a path (the most common case) */
@@ -433,10 +578,11 @@ gdip_region_bitmap_invalidate (GpRegion *region)
 
 /*
  * gdip_region_bitmap_to_cairo_surface
- * @bitmap: a GpRegionBitmap
+ * @bitmap: a GpRegionBitmap using a mask
  *
  * Create a cairo mask surface for the given region bitmap. Caller is
  * responsible for calling cairo_surface_destroy on the returned surface.
+ * Bitmaps using spans have no mask, use gdip_region_bitmap_get_scans.
  */
 cairo_surface_t *
 gdip_region_bitmap_to_cairo_surface (GpRegionBitmap *bitmap)
@@ -444,34 +590,91 @@ gdip_region_bitmap_to_cairo_surface (GpRegionBitmap *bitmap)
 	return cairo_image_surface_create_for_data (bitmap->Mask, CAIRO_FORMAT_A1, bitmap->Width, bitmap->Height, bitmap->Width >> 3);
 }
 
+/* index of the first pixel whose top left corner is at or after @value */
+static int
+first_pixel (float value)
+{
+	if (value < REGION_INFINITE_POSITION)
+		return REGION_INFINITE_POSITION;
+	if (value > REGION_INFINITE_POSITION + REGION_INFINITE_LENGTH)
+		return REGION_INFINITE_POSITION + REGION_INFINITE_LENGTH;
+	return (int) ceilf (value);
+}
+
+/*
+ * set_line:
+ * @data: a GpRegionBitmap using a mask
+ * @y: the line
+ * @line: the visible spans of the line
+ * @count: the number of spans
+ *
+ * Set the mask bits of the visible pixels, a byte at a time.
+ */
+static BOOL
+set_line (void *data, int y, const GpRegionSpan *line, int count)
+{
+	GpRegionBitmap *bitmap = (GpRegionBitmap *) data;
+	BYTE *row;
+	int i;
+
+	if ((y < bitmap->Y) || (y >= bitmap->Y + bitmap->Height))
+		return TRUE;
+
+	row = bitmap->Mask + (y - bitmap->Y) * (bitmap->Width >> 3);
+	for (i = 0; i < count; i++) {
+		int x1 = max (line [i].x1, bitmap->X) - bitmap->X;
+		int x2 = min (line [i].x2, bitmap->X + bitmap->Width) - bitmap->X;
+		BYTE first, last;
+
+		if (x1 >= x2)
+			continue;
+
+		first = bits_from (x1 & 7);
+		last = (BYTE) ~bits_from (((x2 - 1) & 7) + 1);
+		if ((x1 >> 3) == ((x2 - 1) >> 3)) {
+			row [x1 >> 3] |= first & last;
+		} else {
+			row [x1 >> 3] |= first;
+			memset (row + (x1 >> 3) + 1, 0xFF, ((x2 - 1) >> 3) - (x1 >> 3) - 1);
+			row [(x2 - 1) >> 3] |= last;
+		}
+	}
+	return TRUE;
+}
+
 /*
  * gdip_region_bitmap_from_path:
  * @path: a GpPath
  *
  * Return a new GpRegionBitmap containing the bitmap representing the @path.
  * NULL will be returned if the bitmap cannot be created (e.g. too big).
+ * The path is rasterized straight into the mask, see
+ * gdip_region_rasterize_path.
  *
  * Note: the allocated structure must be freed using gdip_region_bitmap_free.
  */
 GpRegionBitmap*
 gdip_region_bitmap_from_path (GpPath *path)
 {
+	GpRectF boundsF;
 	GpRect bounds;
 	GpRegionBitmap *bitmap;
-	int i, idx;
-	int length = path->count;
 	unsigned long long int size;
-	cairo_surface_t *surface = NULL;
-	cairo_t *cr = NULL;
 
 	/* empty path == empty bitmap */
-	if (length == 0)
+	if (path->count == 0)
 		return alloc_bitmap_with_buffer (0, 0, 0, 0, NULL);
 
-	/* get the limits of the bitmap we need to allocate */
-	if (GdipGetPathWorldBoundsI (path, &bounds, NULL, NULL) != Ok)
+	/* get the limits of the bitmap we need to allocate, the pixels whose
+	   top left corner is inside the path */
+	if (GdipGetPathWorldBounds (path, &boundsF, NULL, NULL) != Ok)
 		return NULL;
 
+	bounds.X = first_pixel (boundsF.X);
+	bounds.Y = first_pixel (boundsF.Y);
+	bounds.Width = first_pixel (boundsF.X + boundsF.Width) - bounds.X;
+	bounds.Height = first_pixel (boundsF.Y + boundsF.Height) - bounds.Y;
+
 	/* ensure X and Width are multiple of 8 */
 	rect_adjust_horizontal (&bounds.X, &bounds.Width);
 
@@ -479,62 +682,23 @@ gdip_region_bitmap_from_path (GpPath *path)
 	if ((bounds.Width == 0) || (bounds.Height == 0))
 		return alloc_bitmap_with_buffer (bounds.X, bounds.Y, bounds.Width, bounds.Height, NULL);
 
-	/* replay the path list and the operations to reconstruct the bitmap */
 	size = (unsigned long long int)(bounds.Width >> 3) * bounds.Height;
-	if ((size < 1) || (size > REGION_MAX_BITMAP_SIZE)) {
-		g_warning ("Path conversion requested %llu bytes (%d x %d). Maximum size is %d bytes.",
-			size, bounds.Width, bounds.Height, REGION_MAX_BITMAP_SIZE);
+	if (size < 1)
 		return NULL;
-	}
+
+	/* too big for a mask, only keep the spans of visible pixels */
+	if (size > REGION_MAX_BITMAP_SIZE)
+		return alloc_bitmap_with_spans (gdip_region_spans_from_path (path));
 
 	bitmap = alloc_bitmap (bounds.X, bounds.Y, bounds.Width, bounds.Height);
 	if (bitmap == NULL)
 		return NULL;
 
-	surface = gdip_region_bitmap_to_cairo_surface (bitmap);
-	cr = cairo_create (surface);
-
-	idx = 0;
-	for (i = 0; i < length; ++i) {
-		GpPointF pt = path->points[i];
-		BYTE type = path->types[i];
-		GpPointF pts [3];
-		/* mask the bits so that we get only the type value not the other flags */
-		switch (type & PathPointTypePathTypeMask) {
-		case PathPointTypeStart:
-			cairo_move_to (cr, pt.X - bounds.X, pt.Y - bounds.Y);
-			break;
-		case PathPointTypeLine:
-			cairo_line_to (cr, pt.X - bounds.X, pt.Y - bounds.Y);
-			break;
-		case PathPointTypeBezier:
-			/* make sure we only add at most 3 points to pts */
-			if (idx < 3) {
-				pts [idx] = pt;
-				idx ++;
-			}
-			/* once we've added 3 pts, we can draw the curve */
-			if (idx == 3) {
-				cairo_curve_to (cr, pts [0].X - bounds.X, pts [0].Y - bounds.Y, 
-					pts [1].X - bounds.X, pts [1].Y - bounds.Y, 
-					pts [2].X - bounds.X, pts [2].Y - bounds.Y);
-				idx = 0;
-			}
-			break;
-		}
-
-		/* close the subpath */
-		if (type & PathPointTypeCloseSubpath)
-			cairo_close_path (cr);
+	if (!bitmap->Mask || !gdip_region_rasterize_path (path, set_line, bitmap)) {
+		gdip_region_bitmap_free (bitmap);
+		return NULL;
 	}
 
-	cairo_clip (cr);
-	cairo_set_source_rgba (cr, 1, 1, 1, 1);
-	cairo_paint (cr);
-	cairo_destroy (cr);
-
-	cairo_surface_destroy (surface);
-
 	return bitmap;
 }
 
@@ -558,6 +722,11 @@ gdip_region_bitmap_get_smallest_rect (GpRegionBitmap *bitmap, GpRect *rect)
 	int x = 0, y = 0;
 	int k;
 
+	if (bitmap->Spans) {
+		gdip_region_spans_get_extents (bitmap->Spans, rect);
+		return;
+	}
+
 	while (i < original_size) {
 		if (bitmap->Mask [i] != 0) {
 			for (k = 0; k < 8; k++) {
@@ -753,6 +922,9 @@ gdip_region_bitmap_is_point_visible (GpRegionBitmap *bitmap, int x, int y)
 	if ((y < bitmap->Y) || (y >= bitmap->Y + bitmap->Height))
 		return FALSE;
 
+	if (bitmap->Spans)
+		return gdip_region_spans_is_point_visible (bitmap->Spans, x, y);
+
 	return is_point_visible (bitmap, x, y);
 }
 
@@ -783,6 +955,9 @@ gdip_region_bitmap_is_rect_visible (GpRegionBitmap *bitmap, GpRect *rect)
 	if (bitmap->Y + bitmap->Height <= rect->Y)
 		return FALSE;
 
+	if (bitmap->Spans)
+		return gdip_region_spans_is_rect_visible (bitmap->Spans, rect);
+
 	/* TODO - optimize */
 	for (y = rect->Y; y < rect->Y + rect->Height; y++) {
 		for (x = rect->X; x < rect->X + rect->Width; x++) {
@@ -795,48 +970,6 @@ gdip_region_bitmap_is_rect_visible (GpRegionBitmap *bitmap, GpRect *rect)
 }
 
 
-/*
- * get_buffer_pos:
- * @shape: a GpRegionBitmap
- * @x: the horizontal position
- * @y: the vertical position
- *
- * Return the index, inside the @shape buffer, corresponding to the @x,@y 
- * point.
- */
-static int
-get_buffer_pos (GpRegionBitmap *shape, int x, int y)
-{
-	/* check for out of bounds */
-	if ((x < shape->X) || (x >= shape->X + shape->Width))
-		return -1;
-	if ((y < shape->Y) || (y >= shape->Y + shape->Height))
-		return -1;
-
-	x -= shape->X;
-	y -= shape->Y;
-	return ((y * shape->Width + x) >> 3);
-}
-
-
-/*
- * get_byte:
- * @shape: a GpRegionBitmap
- * @x: the horizontal position
- * @y: the vertical position
- *
- * Return the byte, from the @shape buffer, corresponding to the @x,@y point.
- * Note that this byte contains 8 pixels.
- */
-static int
-get_byte (GpRegionBitmap *shape, int x, int y)
-{
-	/* out of bounds == empty (no pixel) */
-	int pos = get_buffer_pos (shape, x, y);
-	return (pos == -1) ? 0 : shape->Mask [pos];
-}
-
-
 /*
  * Process a single line for gdip_region_bitmap_get_scans.
  */
@@ -844,14 +977,14 @@ static BOOL
 process_line (GpRegionBitmap *bitmap, int y, int *x, int *w)
 {
 	int pos = *x;
-	*x = -1;
-	*w = -1;
+	BOOL started = FALSE;	/* -1 is a valid position */
 
 	while (pos < bitmap->X + bitmap->Width) {
 		BOOL visible = gdip_region_bitmap_is_point_visible (bitmap, pos, y);
-		if (*x == -1) {
+		if (!started) {
 			if (visible) {
-				*x += pos + 1;
+				*x = pos;
+				started = TRUE;
 			}
 		} else {
 			if (!visible) {
@@ -863,7 +996,7 @@ process_line (GpRegionBitmap *bitmap, int y, int *x, int *w)
 	}
 
 	/* end of line - have we started a rect ? */
-	if (*x != -1) {
+	if (started) {
 		*w = pos - *x;
 		return TRUE;
 	}
@@ -883,6 +1016,9 @@ process_line (GpRegionBitmap *bitmap, int y, int *x, int *w)
 int
 gdip_region_bitmap_get_scans (GpRegionBitmap *bitmap, GpRectF *rect)
 {
+	if (bitmap && bitmap->Spans)
+		return gdip_region_spans_get_scans (bitmap->Spans, rect);
+
 	if (!bitmap || !bitmap->Mask)
 		return 0;
 
@@ -933,7 +1069,117 @@ gdip_region_bitmap_get_scans (GpRegionBitmap *bitmap, GpRectF *rect)
 
 /*
  * Binary operators helper functions
+ *
+ * Bitmaps always start on a multiple of 32 pixels and have a width that is
+ * a multiple of 32 pixels, so the lines of two bitmaps overlap on whole
+ * 32 bits words. The masks are processed 64 bits at a time, the memcpy
+ * calls compile to plain (unaligned) loads and stores.
+ */
+
+
+static inline guint64
+load_word (const BYTE *p)
+{
+	guint64 word;
+	memcpy (&word, p, sizeof (guint64));
+	return word;
+}
+
+
+static inline void
+store_word (BYTE *p, guint64 word)
+{
+	memcpy (p, &word, sizeof (guint64));
+}
+
+
+/*
+ * get_line:
+ * @shape: a GpRegionBitmap
+ * @x: the horizontal position, a multiple of 8
+ * @y: the vertical position
+ *
+ * Return a pointer to the byte of the @shape buffer containing the @x,@y
+ * point. No bounds check are done.
+ */
+static BYTE*
+get_line (GpRegionBitmap *shape, int x, int y)
+{
+	return shape->Mask + (y - shape->Y) * (shape->Width >> 3) + ((x - shape->X) >> 3);
+}
+
+
+/*
+ * is_span_empty:
+ * @span: a pointer to the first byte of the span
+ * @bytes: the length of the span in bytes
+ *
+ * Return TRUE if no pixel is set in the span.
+ */
+static BOOL
+is_span_empty (const BYTE *span, int bytes)
+{
+	int i = 0;
+
+	for (; i + 8 <= bytes; i += 8) {
+		if (load_word (span + i))
+			return FALSE;
+	}
+	for (; i < bytes; i++) {
+		if (span [i])
+			return FALSE;
+	}
+	return TRUE;
+}
+
+
+/*
+ * combine_span:
+ * @dest: a pointer to the first byte of the destination span
+ * @src: a pointer to the first byte of the source span
+ * @bytes: the length of the spans in bytes
+ * @combineMode: the binary operator to apply
+ *
+ * Combine @src into @dest. CombineModeReplace copies @src and
+ * CombineModeExclude removes @src pixels from @dest.
  */
+static void
+combine_span (BYTE *dest, const BYTE *src, int bytes, CombineMode combineMode)
+{
+	int i = 0;
+
+	switch (combineMode) {
+	case CombineModeReplace:
+		memcpy (dest, src, bytes);
+		return;
+	case CombineModeUnion:
+		for (; i + 8 <= bytes; i += 8)
+			store_word (dest + i, load_word (dest + i) | load_word (src + i));
+		for (; i < bytes; i++)
+			dest [i] |= src [i];
+		return;
+	case CombineModeIntersect:
+		for (; i + 8 <= bytes; i += 8)
+			store_word (dest + i, load_word (dest + i) & load_word (src + i));
+		for (; i < bytes; i++)
+			dest [i] &= src [i];
+		return;
+	case CombineModeExclude:
+		for (; i + 8 <= bytes; i += 8)
+			store_word (dest + i, load_word (dest + i) & ~load_word (src + i));
+		for (; i < bytes; i++)
+			dest [i] &= ~src [i];
+		return;
+	case CombineModeXor:
+		for (; i + 8 <= bytes; i += 8)
+			store_word (dest + i, load_word (dest + i) ^ load_word (src + i));
+		for (; i < bytes; i++)
+			dest [i] ^= src [i];
+		return;
+	default:
+		return;
+	}
+}
 
 
 /* 
@@ -955,6 +1201,81 @@ bitmap_intersect (GpRegionBitmap *shape1, GpRegionBitmap *shape2)
 }
 
 
+/*
+ * combine_bitmap:
+ * @op: the destination GpRegionBitmap
+ * @shape: a GpRegionBitmap
+ * @combineMode: the binary operator to apply
+ *
+ * Combine, line by line, the part of @shape that lies inside @op into @op.
+ * Nothing outside the shared rectangle is touched, so the operators that
+ * can change pixels there (i.e. intersection) must only be used when @shape
+ * covers all of @op.
+ */
+static void
+combine_bitmap (GpRegionBitmap *op, GpRegionBitmap *shape, CombineMode combineMode)
+{
+	GpRect rect;
+	int bytes, y;
+
+	if (!op->Mask || !shape->Mask || !bitmap_intersect (op, shape))
+		return;
+
+	rect_intersect (op, shape, &rect);
+	bytes = rect.Width >> 3;
+
+	/* same geometry, the masks can be processed as a single span */
+	if ((op->X == shape->X) && (op->Width == shape->Width)) {
+		combine_span (get_line (op, rect.X, rect.Y), get_line (shape, rect.X, rect.Y), bytes * rect.Height, combineMode);
+		return;
+	}
+
+	for (y = rect.Y; y < rect.Y + rect.Height; y++)
+		combine_span (get_line (op, rect.X, y), get_line (shape, rect.X, y), bytes, combineMode);
+}
+
+
+/*
+ * is_mask_operand:
+ * @shape: a GpRegionBitmap
+ *
+ * Return TRUE if @shape can be used by the operators working on masks, i.e.
+ * it doesn't use spans and its mask wasn't moved away from a multiple of 32
+ * pixels by a translation. Other bitmaps are combined as spans.
+ */
+static BOOL
+is_mask_operand (GpRegionBitmap *shape)
+{
+	return !shape->Spans && (!shape->Mask || ((shape->X & 31) == 0));
+}
+
+
+/*
+ * is_line_outside_empty:
+ * @shape: a GpRegionBitmap
+ * @y: the vertical position
+ * @x1: the start of the excluded range
+ * @x2: the end of the excluded range
+ *
+ * Return TRUE if no pixel of the @y line of @shape is set outside [@x1, @x2[.
+ */
+static BOOL
+is_line_outside_empty (GpRegionBitmap *shape, int y, int x1, int x2)
+{
+	int start = shape->X;
+	int end = shape->X + shape->Width;
+
+	if (x2 <= x1)
+		return is_span_empty (get_line (shape, start, y), (end - start) >> 3);
+
+	if ((x1 > start) && !is_span_empty (get_line (shape, start, y), (x1 - start) >> 3))
+		return FALSE;
+	if ((x2 < end) && !is_span_empty (get_line (shape, x2, y), (end - x2) >> 3))
+		return FALSE;
+	return TRUE;
+}
+
+
 /* 
  * gdip_region_bitmap_compare:
  * @shape1: a GpRegionBitmap
@@ -967,17 +1288,46 @@ BOOL
 gdip_region_bitmap_compare (GpRegionBitmap *shape1, GpRegionBitmap *shape2)
 {
 	GpRect rect;
-	int x, y;
+	int x1, x2, y;
 
 	/* if the rectangles containing shape1 and shape2 DO NOT
 	   intersect, then there is no possible intersection */
 	if (!bitmap_intersect (shape1, shape2))
 		return FALSE;
 
+	if (!is_mask_operand (shape1) || !is_mask_operand (shape2)) {
+		BOOL allocated1, allocated2, equal;
+		GpRegionSpans *spans1 = get_spans (shape1, &allocated1);
+		GpRegionSpans *spans2 = get_spans (shape2, &allocated2);
+
+		equal = spans1 && spans2 && gdip_region_spans_equal (spans1, spans2);
+		if (allocated1)
+			gdip_region_spans_free (spans1);
+		if (allocated2)
+			gdip_region_spans_free (spans2);
+		return equal;
+	}
+
+	/* horizontal range shared by both shapes (may be empty) */
+	x1 = (shape1->X > shape2->X) ? shape1->X : shape2->X;
+	x2 = (shape1->X + shape1->Width < shape2->X + shape2->Width) ? shape1->X + shape1->Width : shape2->X + shape2->Width;
+
 	rect_union (shape1, shape2, &rect);
 	for (y = rect.Y; y < rect.Y + rect.Height; y++) {
-		for (x = rect.X; x < rect.X + rect.Width; x += 8) {
-			if (get_byte (shape1, x, y) != get_byte (shape2, x, y))
+		BOOL in1 = shape1->Mask && (y >= shape1->Y) && (y < shape1->Y + shape1->Height);
+		BOOL in2 = shape2->Mask && (y >= shape2->Y) && (y < shape2->Y + shape2->Height);
+
+		if (in1 && in2) {
+			/* the pixels outside the shared range must be empty and the shared ones identical */
+			if (!is_line_outside_empty (shape1, y, x1, x2) || !is_line_outside_empty (shape2, y, x1, x2))
+				return FALSE;
+			if ((x2 > x1) && memcmp (get_line (shape1, x1, y), get_line (shape2, x1, y), (x2 - x1) >> 3))
+				return FALSE;
+		} else if (in1) {
+			if (!is_span_empty (get_line (shape1, shape1->X, y), shape1->Width >> 3))
+				return FALSE;
+		} else if (in2) {
+			if (!is_span_empty (get_line (shape2, shape2->X, y), shape2->Width >> 3))
 				return FALSE;
 		}
 	}
@@ -1007,14 +1357,12 @@ static GpRegionBitmap*
 gdip_region_bitmap_union (GpRegionBitmap *shape1, GpRegionBitmap *shape2)
 {
 	GpRegionBitmap *op = alloc_merged_bitmap (shape1, shape2);
-	int x, y;
+	if (!op)
+		return NULL;
 
-	for (y = op->Y; y < op->Y + op->Height; y++) {
-		int p = get_buffer_pos (op, op->X, y);
-		for (x = op->X; x < op->X + op->Width; x += 8) {
-			op->Mask [p++] = get_byte (shape1, x, y) | get_byte (shape2, x, y);
-		}
-	}
+	/* the merged bitmap is cleared, the lines not covered by a shape stay empty */
+	combine_bitmap (op, shape1, CombineModeReplace);
+	combine_bitmap (op, shape2, CombineModeUnion);
 
 	/* no need to call reduce_bitmap (it will never shrink, 
 	   unless the original bitmap were oversized) */
@@ -1034,7 +1382,6 @@ static GpRegionBitmap*
 gdip_region_bitmap_intersection (GpRegionBitmap *shape1, GpRegionBitmap *shape2)
 {
 	GpRegionBitmap *op;
-	int x, y;
 
 	/* if the rectangles containing shape1 and shape2 DO NOT
 	   intersect, then there is no possible intersection */
@@ -1044,13 +1391,12 @@ gdip_region_bitmap_intersection (GpRegionBitmap *shape1, GpRegionBitmap *shape2)
 	/* the bitmap size cannot be bigger than a rectangle intersection of
 	   both bitmaps */
 	op = alloc_intersected_bitmap (shape1, shape2);
+	if (!op)
+		return NULL;
 
-	for (y = op->Y; y < op->Y + op->Height; y++) {
-		int p = get_buffer_pos (op, op->X, y);
-		for (x = op->X; x < op->X + op->Width; x += 8) {
-			op->Mask [p++] = get_byte (shape1, x, y) & get_byte (shape2, x, y);
-		}
-	}
+	/* both shapes cover all of op */
+	combine_bitmap (op, shape1, CombineModeReplace);
+	combine_bitmap (op, shape2, CombineModeIntersect);
 
 	/* reduce bitmap size - if it make sense */
 	gdip_region_bitmap_shrink (op, FALSE);
@@ -1069,7 +1415,6 @@ static GpRegionBitmap*
 gdip_region_bitmap_exclude (GpRegionBitmap *shape1, GpRegionBitmap *shape2)
 {
 	GpRegionBitmap *op;
-	int x, y;
 
 	/* if the rectangles containing shape1 and shape2 DO NOT
 	   intersect, then the result is identical shape1 */
@@ -1077,15 +1422,11 @@ gdip_region_bitmap_exclude (GpRegionBitmap *shape1, GpRegionBitmap *shape2)
 		return gdip_region_bitmap_clone (shape1);
 
 	/* the new bitmap size cannot be bigger than shape1 */
-	op = alloc_bitmap (shape1->X, shape1->Y, shape1->Width, shape1->Height);
+	op = gdip_region_bitmap_clone (shape1);
+	if (!op)
+		return NULL;
 
-	for (y = op->Y; y < op->Y + op->Height; y++) {
-		int p = get_buffer_pos (op, op->X, y);
-		for (x = op->X; x < op->X + op->Width; x += 8) {
-			BYTE b1 = get_byte (shape1, x, y);
-			op->Mask [p++] = b1 - (b1 & get_byte (shape2, x, y));
-		}
-	}
+	combine_bitmap (op, shape2, CombineModeExclude);
 
 	/* reduce bitmap size - if it make sense */
 	gdip_region_bitmap_shrink (op, FALSE);
@@ -1103,28 +1444,8 @@ gdip_region_bitmap_exclude (GpRegionBitmap *shape1, GpRegionBitmap *shape2)
 static GpRegionBitmap*
 gdip_region_bitmap_complement (GpRegionBitmap *shape1, GpRegionBitmap *shape2)
 {
-	GpRegionBitmap *op;
-	int x, y;
-
-	/* if the rectangles containing shape1 and shape2 DO NOT
-	   intersect, then the result is identical shape2 */
-	if (!bitmap_intersect (shape1, shape2))
-		return gdip_region_bitmap_clone (shape2);
-
-	/* the new bitmap size cannot be bigger than shape2 */
-	op = alloc_bitmap (shape2->X, shape2->Y, shape2->Width, shape2->Height);
-
-	for (y = op->Y; y < op->Y + op->Height; y++) {
-		int p = get_buffer_pos (op, op->X, y);
-		for (x = op->X; x < op->X + op->Width; x += 8) {
-			BYTE b2 = get_byte (shape2, x, y);
-			op->Mask [p++] = b2 - (b2 & get_byte (shape1, x, y));
-		}
-	}
-
-	/* reduce bitmap size - if it make sense */
-	gdip_region_bitmap_shrink (op, FALSE);
-	return op;
+	/* the same as excluding shape1 from shape2 */
+	return gdip_region_bitmap_exclude (shape2, shape1);
 }
 
 
@@ -1140,7 +1461,6 @@ static GpRegionBitmap*
 gdip_region_bitmap_xor (GpRegionBitmap *shape1, GpRegionBitmap *shape2)
 {
 	GpRegionBitmap *op;
-	int x, y;
 
 	/* if the rectangles containing shape1 and shape2 DO NOT intersect,
 	   then the result is identical an union of shape1 and shape2. Code is
@@ -1150,13 +1470,11 @@ gdip_region_bitmap_xor (GpRegionBitmap *shape1, GpRegionBitmap *shape2)
 
 	/* the new bitmap is potentially as big as the two merged bitmaps */
 	op = alloc_merged_bitmap (shape1, shape2);
+	if (!op)
+		return NULL;
 
-	for (y = op->Y; y < op->Y + op->Height; y++) {
-		int p = get_buffer_pos (op, op->X, y);
-		for (x = op->X; x < op->X + op->Width; x += 8) {
-			op->Mask [p++] = get_byte (shape1, x, y) ^ get_byte (shape2, x, y);
-		}
-	}
+	combine_bitmap (op, shape1, CombineModeReplace);
+	combine_bitmap (op, shape2, CombineModeXor);
 
 	/* reduce bitmap size - if it make sense */
 	gdip_region_bitmap_shrink (op, FALSE);
@@ -1164,6 +1482,80 @@ gdip_region_bitmap_xor (GpRegionBitmap *shape1, GpRegionBitmap *shape2)
 }
 
 
+/*
+ * is_mask_result_possible:
+ * @shape1: a GpRegionBitmap using a mask (or empty)
+ * @shape2: a GpRegionBitmap using a mask (or empty)
+ * @combineMode: the binary operator to apply between the two shapes
+ *
+ * Return FALSE if the result of @combineMode could need a mask bigger than
+ * REGION_MAX_BITMAP_SIZE. Only union and xor produce masks bigger than both
+ * operands.
+ */
+static BOOL
+is_mask_result_possible (GpRegionBitmap *shape1, GpRegionBitmap *shape2, CombineMode combineMode)
+{
+	unsigned long long int size;
+	GpRect rect;
+
+	if ((combineMode != CombineModeUnion) && (combineMode != CombineModeXor))
+		return TRUE;
+
+	rect_union (shape1, shape2, &rect);
+	rect_adjust_horizontal (&rect.X, &rect.Width);
+	size = (unsigned long long int)(rect.Width >> 3) * rect.Height;
+	return (size <= REGION_MAX_BITMAP_SIZE);
+}
+
+
+/*
+ * gdip_region_bitmap_combine_spans:
+ * @shape1: a GpRegionBitmap
+ * @shape2: a GpRegionBitmap
+ * @combineMode: the binary operator to apply between the two shapes
+ *
+ * Return a new GpRegionBitmap, using spans, that contains the result of
+ * @combineMode applied to @shape1 and @shape2. Masks are converted first.
+ */
+static GpRegionBitmap*
+gdip_region_bitmap_combine_spans (GpRegionBitmap *shape1, GpRegionBitmap *shape2, CombineMode combineMode)
+{
+	BOOL allocated1, allocated2;
+	GpRegionSpans *spans1 = get_spans (shape1, &allocated1);
+	GpRegionSpans *spans2 = get_spans (shape2, &allocated2);
+	GpRegionSpans *result = NULL;
+
+	if (spans1 && spans2)
+		result = gdip_region_spans_combine (spans1, spans2, combineMode);
+
+	if (allocated1)
+		gdip_region_spans_free (spans1);
+	if (allocated2)
+		gdip_region_spans_free (spans2);
+
+	return alloc_bitmap_with_spans (result);
+}
+
+
+/*
+ * gdip_region_bitmap_translate:
+ * @bitmap: a GpRegionBitmap
+ * @dx: the horizontal offset
+ * @dy: the vertical offset
+ *
+ * Move the @bitmap by @dx,@dy pixels.
+ */
+void
+gdip_region_bitmap_translate (GpRegionBitmap *bitmap, int dx, int dy)
+{
+	bitmap->X += dx;
+	bitmap->Y += dy;
+
+	if (bitmap->Spans)
+		gdip_region_spans_translate (bitmap->Spans, dx, dy);
+}
+
+
 /*
  * gdip_region_bitmap_combine:
  * @shape1: a GpRegionBitmap
@@ -1179,6 +1571,9 @@ gdip_region_bitmap_combine (GpRegionBitmap *bitmap1, GpRegionBitmap* bitmap2, Co
 	if (!bitmap1 || !bitmap2)
 		return NULL;
 
+	if (!is_mask_operand (bitmap1) || !is_mask_operand (bitmap2) || !is_mask_result_possible (bitmap1, bitmap2, combineMode))
+		return gdip_region_bitmap_combine_spans (bitmap1, bitmap2, combineMode);
+
 	switch (combineMode) {
 	case CombineModeComplement:
 		return gdip_region_bitmap_complement (bitmap1, bitmap2);
@@ -33,24 +33,57 @@
 /*
  * REGION_MAX_BITMAP_SIZE defines the size limit of the region bitmap we keep
  * in memory. The current value is 2 megabits which should be enough for any 
- * on-screen region. Before changing this value remember that a "real", but 
- * temporary, ARGB32 bitmap (32 times bigger, i.e. 8MB) may be allocated when 
- * converting the path into the region bitmap.
+ * on-screen region. Paths are rasterized directly into the mask, larger
+ * regions are kept as spans.
  */
 #define REGION_MAX_BITMAP_SIZE		(2 * 1024 * 1024 >> 3)
 
 #define SHAPE_SIZE(shape)		(((shape)->Width * (shape)->Height) >> 3)
 
 
+/*
+ * Sparse representation (region-spans.c): the lines of a band share the same
+ * spans of visible pixels.
+ */
+typedef struct {
+	int x1;		/* first visible pixel */
+	int x2;		/* first pixel after the span */
+} GpRegionSpan;
+
+typedef struct {
+	int y1;		/* first line of the band */
+	int y2;		/* first line after the band */
+	int first;	/* index of the first span of the band */
+	int count;	/* number of spans, never 0 */
+} GpRegionBand;
+
 typedef struct {
+	GpRegionBand *bands;
+	int band_count;
+	int band_size;
+	GpRegionSpan *spans;
+	int span_count;
+	int span_size;
+} GpRegionSpans;
+
+/*
+ * A region bitmap is either a 1bpp Mask or, when the mask would be too big,
+ * Spans. Both are NULL for empty bitmaps. X, Y, Width and Height are the
+ * bounds of the mask (X and Width are then multiples of 32) or of the spans.
+ */
+typedef struct _GpRegionBitmap {
 	int X;
 	int Y;
 	int Width;
 	int Height;
 	unsigned char *Mask;
 	BOOL reduced;
+	GpRegionSpans *Spans;
 } GpRegionBitmap;
 
+/* receives the visible spans of the line y, sorted and not overlapping */
+typedef BOOL (*GpRegionLineFunc) (void *data, int y, const GpRegionSpan *line, int count);
+
 
 void gdip_region_bitmap_ensure (GpRegion *region) GDIP_INTERNAL;
 GpRegionBitmap* gdip_region_bitmap_from_path (GpPath *path) GDIP_INTERNAL;
@@ -71,5 +104,21 @@ void gdip_region_bitmap_shrink (GpRegionBitmap *bitmap, BOOL always_shrink) GDIP
 cairo_surface_t *gdip_region_bitmap_to_cairo_surface (GpRegionBitmap *bitmap) GDIP_INTERNAL;
 
 GpRegionBitmap* gdip_region_bitmap_combine (GpRegionBitmap *bitmap1, GpRegionBitmap* bitmap2, CombineMode combineMode) GDIP_INTERNAL;
+void gdip_region_bitmap_translate (GpRegionBitmap *bitmap, int dx, int dy) GDIP_INTERNAL;
+
+GpRegionSpans* gdip_region_spans_new (void) GDIP_INTERNAL;
+void gdip_region_spans_free (GpRegionSpans *spans) GDIP_INTERNAL;
+GpRegionSpans* gdip_region_spans_clone (GpRegionSpans *spans) GDIP_INTERNAL;
+BOOL gdip_region_spans_add_band (GpRegionSpans *spans, int y1, int y2, const GpRegionSpan *line, int count) GDIP_INTERNAL;
+GpRegionSpans* gdip_region_spans_from_path (GpPath *path) GDIP_INTERNAL;
+BOOL gdip_region_rasterize_path (GpPath *path, GpRegionLineFunc func, void *data) GDIP_INTERNAL;
+GpRegionSpans* gdip_region_spans_combine (GpRegionSpans *spans1, GpRegionSpans *spans2, CombineMode combineMode) GDIP_INTERNAL;
+
+void gdip_region_spans_get_extents (GpRegionSpans *spans, GpRect *rect) GDIP_INTERNAL;
+BOOL gdip_region_spans_is_point_visible (GpRegionSpans *spans, int x, int y) GDIP_INTERNAL;
+BOOL gdip_region_spans_is_rect_visible (GpRegionSpans *spans, GpRect *rect) GDIP_INTERNAL;
+int gdip_region_spans_get_scans (GpRegionSpans *spans, GpRectF *rect) GDIP_INTERNAL;
+BOOL gdip_region_spans_equal (GpRegionSpans *spans1, GpRegionSpans *spans2) GDIP_INTERNAL;
+void gdip_region_spans_translate (GpRegionSpans *spans, int dx, int dy) GDIP_INTERNAL;
 
 #endif
@@ -21,8 +21,23 @@
  */
 
 #include "region-path-tree.h"
+#include "region-bitmap.h"
 #include "graphics-path-private.h"
 
+/*
+ * gdip_region_alloc_tree:
+ *
+ * Allocate an empty GpPathTree, i.e. without path, branches or cached bitmap.
+ */
+GpPathTree*
+gdip_region_alloc_tree (void)
+{
+	GpPathTree *tree = (GpPathTree *) GdipAlloc (sizeof (GpPathTree));
+	if (tree)
+		memset (tree, 0, sizeof (GpPathTree));
+	return tree;
+}
+
 /*
  * gdip_region_clear_tree:
  * @tree: a GpPathTree to clear
@@ -35,6 +50,11 @@ gdip_region_clear_tree (GpPathTree *tree)
 	if (!tree)
 		return;
 
+	if (tree->bitmap) {
+		gdip_region_bitmap_free (tree->bitmap);
+		tree->bitmap = NULL;
+	}
+
 	if (tree->path) {
 		GdipDeletePath (tree->path);
 		tree->path = NULL;
@@ -64,6 +84,14 @@ gdip_region_copy_tree (GpPathTree *source, GpPathTree *dest)
 		return Ok;
 
 	g_assert (dest);
+	if (source->bitmap) {
+		dest->bitmap = gdip_region_bitmap_clone (source->bitmap);
+		if (!dest->bitmap)
+			return OutOfMemory;
+	} else {
+		dest->bitmap = NULL;
+	}
+
 	if (source->path) {
 		status = GdipClonePath (source->path, &dest->path);
 		if (status != Ok)
@@ -74,7 +102,7 @@ gdip_region_copy_tree (GpPathTree *source, GpPathTree *dest)
 	} else {
 		dest->path = NULL;
 		dest->mode = source->mode;
-		dest->branch1 = (GpPathTree *) GdipAlloc (sizeof (GpPathTree));
+		dest->branch1 = gdip_region_alloc_tree ();
 		if (!dest->branch1)
 			return OutOfMemory;
 
@@ -82,7 +110,7 @@ gdip_region_copy_tree (GpPathTree *source, GpPathTree *dest)
 		if (status != Ok)
 			return status;
 
-		dest->branch2 = (GpPathTree *) GdipAlloc (sizeof (GpPathTree));
+		dest->branch2 = gdip_region_alloc_tree ();
 		if (!dest->branch2)
 			return OutOfMemory;
 
@@ -180,7 +208,7 @@ gdip_region_deserialize_tree (BYTE *data, int size, GpPathTree *tree)
 		data += len;
 		size -= len;
 		/* deserialize a tree from the memory blob */
-		tree->branch1 = (GpPathTree*) GdipAlloc (sizeof (GpPathTree));
+		tree->branch1 = gdip_region_alloc_tree ();
 		if (!tree->branch1)
 			return FALSE;
 
@@ -192,7 +220,7 @@ gdip_region_deserialize_tree (BYTE *data, int size, GpPathTree *tree)
 		memcpy (&branch_size, data, len);
 		data += len;
 		size -= len;
-		tree->branch2 = (GpPathTree*) GdipAlloc (sizeof (GpPathTree));
+		tree->branch2 = gdip_region_alloc_tree ();
 		if (!tree->branch2)
 			return FALSE;
 
@@ -287,11 +315,16 @@ gdip_region_serialize_tree (GpPathTree *tree, BYTE *buffer, UINT bufferSize, UIN
  * @tree: a GpPathTree
  * @matrix: the GpMatrix to apply to the tree
  *
- * Recursively apply the @matrix to the @tree.
+ * Recursively apply the @matrix to the @tree. The cached bitmaps are dropped.
  */
 GpStatus
 gdip_region_transform_tree (GpPathTree *tree, GpMatrix *matrix)
 {
+	if (tree->bitmap) {
+		gdip_region_bitmap_free (tree->bitmap);
+		tree->bitmap = NULL;
+	}
+
 	if (tree->path) {
 		return GdipTransformPath (tree->path, matrix);
 	} else {
@@ -311,11 +344,21 @@ gdip_region_transform_tree (GpPathTree *tree, GpMatrix *matrix)
  * @dy: the delta y to apply to each point 
  *
  * Recursively apply the @dx, @dy translation to each point, of each path, 
- * in the @tree.
+ * in the @tree. The cached bitmaps are moved too, unless the translation
+ * isn't a whole number of pixels.
  */
 void
 gdip_region_translate_tree (GpPathTree *tree, float dx, float dy)
 {
+	if (tree->bitmap) {
+		if ((dx == (int) dx) && (dy == (int) dy)) {
+			gdip_region_bitmap_translate (tree->bitmap, (int) dx, (int) dy);
+		} else {
+			gdip_region_bitmap_free (tree->bitmap);
+			tree->bitmap = NULL;
+		}
+	}
+
 	if (tree->path) {
 		int i;
 		for (i = 0; i < tree->path->count; i++) {
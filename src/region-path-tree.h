@@ -31,13 +31,21 @@
 #define REGION_TAG_PATH		1
 #define REGION_TAG_TREE		2
 
+/*
+ * A tree is either a path or two branches combined with mode. The bitmap of
+ * a branch is the cached result of that subtree (or NULL), it's consumed when
+ * the whole tree gets rasterized. The result of the root tree is kept in the
+ * region itself.
+ */
 typedef struct GpPathTree {
 	CombineMode		mode;
 	GpPath*			path;
 	struct GpPathTree*	branch1;
 	struct GpPathTree*	branch2;
+	struct _GpRegionBitmap*	bitmap;
 } GpPathTree;
 
+GpPathTree* gdip_region_alloc_tree (void) GDIP_INTERNAL;
 void gdip_region_clear_tree (GpPathTree *tree) GDIP_INTERNAL;
 GpStatus gdip_region_copy_tree (GpPathTree *source, GpPathTree *dest) GDIP_INTERNAL;
 
@@ -70,6 +70,7 @@ struct _Region {
     GpRectF*	rects;
     GpPathTree*	tree;
     GpRegionBitmap*	bitmap;
+    BOOL		banded;		/* rects are sorted y-x bands, see gdip_combine_rects */
 };
 
 BOOL gdip_is_InfiniteRegion (const GpRegion *region) GDIP_INTERNAL;
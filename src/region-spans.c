@@ -0,0 +1,713 @@
+/*
+ * region-spans.c
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+ * NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Sparse representation of region bitmaps, used when a 1bpp mask would be too large.
+ *
+ * The region is a list of horizontal bands, sorted from top to bottom. All the lines of a band
+ * share the same sorted list of spans (runs of visible pixels). Bands never overlap, never have
+ * zero spans and two touching bands never have the same spans (they get merged instead), so two
+ * identical regions always have identical bands and spans. Memory and time depend on the number
+ * of edges of the shape, not on its area.
+ *
+ * The path rasterizer at the end of the file also fills the 1bpp masks, one line at a time.
+ */
+
+#include "region-private.h"
+#include "graphics-path-private.h"
+
+#include <limits.h>
+
+/* same as GDI+ FlatnessDefault */
+#define REGION_SPANS_FLATNESS	0.25f
+
+GpRegionSpans*
+gdip_region_spans_new (void)
+{
+	GpRegionSpans *spans = (GpRegionSpans*) GdipAlloc (sizeof (GpRegionSpans));
+	if (!spans)
+		return NULL;
+
+	memset (spans, 0, sizeof (GpRegionSpans));
+	return spans;
+}
+
+void
+gdip_region_spans_free (GpRegionSpans *spans)
+{
+	if (!spans)
+		return;
+
+	if (spans->bands)
+		GdipFree (spans->bands);
+	if (spans->spans)
+		GdipFree (spans->spans);
+	GdipFree (spans);
+}
+
+GpRegionSpans*
+gdip_region_spans_clone (GpRegionSpans *spans)
+{
+	GpRegionSpans *result = gdip_region_spans_new ();
+	if (!result)
+		return NULL;
+
+	if (spans->band_count > 0) {
+		result->bands = GdipAlloc (spans->band_count * sizeof (GpRegionBand));
+		result->spans = GdipAlloc (spans->span_count * sizeof (GpRegionSpan));
+		if (!result->bands || !result->spans) {
+			gdip_region_spans_free (result);
+			return NULL;
+		}
+
+		memcpy (result->bands, spans->bands, spans->band_count * sizeof (GpRegionBand));
+		memcpy (result->spans, spans->spans, spans->span_count * sizeof (GpRegionSpan));
+		result->band_count = result->band_size = spans->band_count;
+		result->span_count = result->span_size = spans->span_count;
+	}
+
+	return result;
+}
+
+/*
+ * gdip_region_spans_add_band:
+ * @spans: a GpRegionSpans
+ * @y1: the first line of the band
+ * @y2: the first line after the band
+ * @line: the sorted spans of each line of the band
+ * @count: the number of spans in @line
+ *
+ * Append the lines [@y1, @y2[ after the existing bands. Empty lines are
+ * skipped and lines identical to the last band extend it.
+ */
+BOOL
+gdip_region_spans_add_band (GpRegionSpans *spans, int y1, int y2, const GpRegionSpan *line, int count)
+{
+	GpRegionBand *band;
+
+	if ((count == 0) || (y2 <= y1))
+		return TRUE;
+
+	if (spans->band_count > 0) {
+		band = &spans->bands [spans->band_count - 1];
+		if ((band->y2 == y1) && (band->count == count) &&
+		    (memcmp (&spans->spans [band->first], line, count * sizeof (GpRegionSpan)) == 0)) {
+			band->y2 = y2;
+			return TRUE;
+		}
+	}
+
+	if (spans->band_count == spans->band_size) {
+		int size = spans->band_size ? spans->band_size * 2 : 16;
+		GpRegionBand *bands = gdip_realloc (spans->bands, size * sizeof (GpRegionBand));
+		if (!bands)
+			return FALSE;
+		spans->bands = bands;
+		spans->band_size = size;
+	}
+
+	if (spans->span_count + count > spans->span_size) {
+		int size = spans->span_size ? spans->span_size * 2 : 32;
+		GpRegionSpan *items;
+
+		while (size < spans->span_count + count)
+			size *= 2;
+		items = gdip_realloc (spans->spans, size * sizeof (GpRegionSpan));
+		if (!items)
+			return FALSE;
+		spans->spans = items;
+		spans->span_size = size;
+	}
+
+	band = &spans->bands [spans->band_count++];
+	band->y1 = y1;
+	band->y2 = y2;
+	band->first = spans->span_count;
+	band->count = count;
+	memcpy (&spans->spans [spans->span_count], line, count * sizeof (GpRegionSpan));
+	spans->span_count += count;
+
+	return TRUE;
+}
+
+/*
+ * gdip_region_spans_get_extents:
+ * @spans: a GpRegionSpans
+ * @rect: a pointer to a GpRect
+ *
+ * Return the smallest rectangle containing all the visible pixels.
+ */
+void
+gdip_region_spans_get_extents (GpRegionSpans *spans, GpRect *rect)
+{
+	int i, x1 = INT_MAX, x2 = INT_MIN;
+
+	if (!spans || (spans->band_count == 0)) {
+		rect->X = rect->Y = rect->Width = rect->Height = 0;
+		return;
+	}
+
+	for (i = 0; i < spans->band_count; i++) {
+		GpRegionBand *band = &spans->bands [i];
+		if (spans->spans [band->first].x1 < x1)
+			x1 = spans->spans [band->first].x1;
+		if (spans->spans [band->first + band->count - 1].x2 > x2)
+			x2 = spans->spans [band->first + band->count - 1].x2;
+	}
+
+	rect->X = x1;
+	rect->Y = spans->bands [0].y1;
+	rect->Width = x2 - x1;
+	rect->Height = spans->bands [spans->band_count - 1].y2 - rect->Y;
+}
+
+/*
+ * find_band:
+ *
+ * Return the index of the first band that ends after line @y, or band_count.
+ */
+static int
+find_band (GpRegionSpans *spans, int y)
+{
+	int low = 0, high = spans->band_count;
+
+	while (low < high) {
+		int middle = (low + high) / 2;
+		if (spans->bands [middle].y2 <= y)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low;
+}
+
+/*
+ * find_span:
+ *
+ * Return the index, inside @band, of the first span that ends after @x, or
+ * the band count.
+ */
+static int
+find_span (GpRegionSpans *spans, GpRegionBand *band, int x)
+{
+	int low = 0, high = band->count;
+
+	while (low < high) {
+		int middle = (low + high) / 2;
+		if (spans->spans [band->first + middle].x2 <= x)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low;
+}
+
+BOOL
+gdip_region_spans_is_point_visible (GpRegionSpans *spans, int x, int y)
+{
+	GpRegionBand *band;
+	int i;
+
+	if (!spans)
+		return FALSE;
+
+	i = find_band (spans, y);
+	if ((i == spans->band_count) || (spans->bands [i].y1 > y))
+		return FALSE;
+
+	band = &spans->bands [i];
+	i = find_span (spans, band, x);
+	return (i < band->count) && (spans->spans [band->first + i].x1 <= x);
+}
+
+/*
+ * gdip_region_spans_is_rect_visible:
+ *
+ * Return TRUE is _any_ part of @rect is inside the region.
+ */
+BOOL
+gdip_region_spans_is_rect_visible (GpRegionSpans *spans, GpRect *rect)
+{
+	int i;
+
+	if (!spans || (rect->Width <= 0) || (rect->Height <= 0))
+		return FALSE;
+
+	for (i = find_band (spans, rect->Y); i < spans->band_count; i++) {
+		GpRegionBand *band = &spans->bands [i];
+		int j;
+
+		if (band->y1 >= rect->Y + rect->Height)
+			break;
+
+		/* the first span ending after the left side of the rectangle must start before its right side */
+		j = find_span (spans, band, rect->X);
+		if ((j < band->count) && (spans->spans [band->first + j].x1 < rect->X + rect->Width))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/*
+ * gdip_region_spans_get_scans:
+ *
+ * Convert the bands into an array of GpRectF, one for each span of each band,
+ * and return the number of rectangles. @rect can be NULL to get the count.
+ */
+int
+gdip_region_spans_get_scans (GpRegionSpans *spans, GpRectF *rect)
+{
+	int i, j;
+
+	if (!spans)
+		return 0;
+
+	if (rect) {
+		for (i = 0; i < spans->band_count; i++) {
+			GpRegionBand *band = &spans->bands [i];
+			for (j = 0; j < band->count; j++) {
+				GpRegionSpan *span = &spans->spans [band->first + j];
+				rect->X = span->x1;
+				rect->Y = band->y1;
+				rect->Width = span->x2 - span->x1;
+				rect->Height = band->y2 - band->y1;
+				rect++;
+			}
+		}
+	}
+
+	return spans->span_count;
+}
+
+/*
+ * gdip_region_spans_equal:
+ *
+ * Return TRUE if both regions have the same visible pixels.
+ */
+BOOL
+gdip_region_spans_equal (GpRegionSpans *spans1, GpRegionSpans *spans2)
+{
+	int i;
+
+	if (spans1->band_count != spans2->band_count || spans1->span_count != spans2->span_count)
+		return FALSE;
+
+	/* the representation is canonical but the spans of two regions do not start at the same index */
+	for (i = 0; i < spans1->band_count; i++) {
+		GpRegionBand *band1 = &spans1->bands [i];
+		GpRegionBand *band2 = &spans2->bands [i];
+
+		if ((band1->y1 != band2->y1) || (band1->y2 != band2->y2) || (band1->count != band2->count))
+			return FALSE;
+		if (memcmp (&spans1->spans [band1->first], &spans2->spans [band2->first], band1->count * sizeof (GpRegionSpan)))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+void
+gdip_region_spans_translate (GpRegionSpans *spans, int dx, int dy)
+{
+	int i;
+
+	for (i = 0; i < spans->band_count; i++) {
+		spans->bands [i].y1 += dy;
+		spans->bands [i].y2 += dy;
+	}
+	for (i = 0; i < spans->span_count; i++) {
+		spans->spans [i].x1 += dx;
+		spans->spans [i].x2 += dx;
+	}
+}
+
+/*
+ * Binary operators
+ */
+
+static BOOL
+is_visible (CombineMode combineMode, BOOL in1, BOOL in2)
+{
+	switch (combineMode) {
+	case CombineModeUnion:
+		return in1 || in2;
+	case CombineModeIntersect:
+		return in1 && in2;
+	case CombineModeExclude:
+		return in1 && !in2;
+	case CombineModeComplement:
+		return in2 && !in1;
+	case CombineModeXor:
+		return in1 != in2;
+	default:
+		return FALSE;
+	}
+}
+
+/*
+ * combine_lines:
+ *
+ * Apply @combineMode to two lines of sorted spans and store the sorted result
+ * in @result, which must have room for @count1 + @count2 spans. Return the
+ * number of spans in @result.
+ */
+static int
+combine_lines (const GpRegionSpan *line1, int count1, const GpRegionSpan *line2, int count2, CombineMode combineMode, GpRegionSpan *result)
+{
+	int i1 = 0, i2 = 0, n = 0;
+	int x;
+
+	if (count1 == 0 && count2 == 0)
+		return 0;
+
+	if (count1 == 0)
+		x = line2 [0].x1;
+	else if (count2 == 0)
+		x = line1 [0].x1;
+	else
+		x = (line1 [0].x1 < line2 [0].x1) ? line1 [0].x1 : line2 [0].x1;
+
+	/* walk the pieces of the line where both inputs are constant */
+	while ((i1 < count1) || (i2 < count2)) {
+		BOOL in1 = (i1 < count1) && (line1 [i1].x1 <= x);
+		BOOL in2 = (i2 < count2) && (line2 [i2].x1 <= x);
+		int next = INT_MAX;
+
+		if (i1 < count1)
+			next = in1 ? line1 [i1].x2 : line1 [i1].x1;
+		if ((i2 < count2) && ((in2 ? line2 [i2].x2 : line2 [i2].x1) < next))
+			next = in2 ? line2 [i2].x2 : line2 [i2].x1;
+
+		if (is_visible (combineMode, in1, in2)) {
+			if ((n > 0) && (result [n - 1].x2 == x)) {
+				result [n - 1].x2 = next;
+			} else {
+				result [n].x1 = x;
+				result [n].x2 = next;
+				n++;
+			}
+		}
+
+		x = next;
+		if ((i1 < count1) && (line1 [i1].x2 <= x))
+			i1++;
+		if ((i2 < count2) && (line2 [i2].x2 <= x))
+			i2++;
+	}
+
+	return n;
+}
+
+/*
+ * gdip_region_spans_combine:
+ * @spans1: a GpRegionSpans, NULL for an empty region
+ * @spans2: a GpRegionSpans, NULL for an empty region
+ * @combineMode: the binary operator to apply
+ *
+ * Return a new GpRegionSpans containing the result of @combineMode applied to
+ * both regions, or NULL if the memory couldn't be allocated.
+ */
+GpRegionSpans*
+gdip_region_spans_combine (GpRegionSpans *spans1, GpRegionSpans *spans2, CombineMode combineMode)
+{
+	GpRegionSpans empty = { NULL, 0, 0, NULL, 0, 0 };
+	GpRegionSpans *result;
+	GpRegionSpan *line;
+	int line_size = 0;
+	int i1 = 0, i2 = 0;
+	int y = INT_MIN;
+
+	if (!spans1)
+		spans1 = &empty;
+	if (!spans2)
+		spans2 = &empty;
+
+	result = gdip_region_spans_new ();
+	if (!result)
+		return NULL;
+
+	/* a line of the result never has more spans than both inputs together */
+	for (i1 = 0; i1 < spans1->band_count; i1++) {
+		if (spans1->bands [i1].count > line_size)
+			line_size = spans1->bands [i1].count;
+	}
+	for (i2 = 0; i2 < spans2->band_count; i2++) {
+		if (spans2->bands [i2].count > line_size)
+			line_size = spans2->bands [i2].count;
+	}
+	line = GdipAlloc ((2 * line_size + 1) * sizeof (GpRegionSpan));
+	if (!line) {
+		gdip_region_spans_free (result);
+		return NULL;
+	}
+
+	/* walk the vertical ranges where both inputs are constant */
+	i1 = i2 = 0;
+	while ((i1 < spans1->band_count) || (i2 < spans2->band_count)) {
+		GpRegionBand *band1 = (i1 < spans1->band_count) ? &spans1->bands [i1] : NULL;
+		GpRegionBand *band2 = (i2 < spans2->band_count) ? &spans2->bands [i2] : NULL;
+		BOOL in1, in2;
+		int next = INT_MAX;
+		int count;
+
+		/* skip the empty lines */
+		if (band1 && (band1->y1 > y) && (!band2 || (band2->y1 > y)))
+			y = (band2 && (band2->y1 < band1->y1)) ? band2->y1 : band1->y1;
+		else if (!band1 && (band2->y1 > y))
+			y = band2->y1;
+
+		in1 = band1 && (band1->y1 <= y);
+		in2 = band2 && (band2->y1 <= y);
+
+		if (band1)
+			next = in1 ? band1->y2 : band1->y1;
+		if (band2 && ((in2 ? band2->y2 : band2->y1) < next))
+			next = in2 ? band2->y2 : band2->y1;
+
+		count = combine_lines (in1 ? &spans1->spans [band1->first] : NULL, in1 ? band1->count : 0,
+			in2 ? &spans2->spans [band2->first] : NULL, in2 ? band2->count : 0, combineMode, line);
+
+		if (!gdip_region_spans_add_band (result, y, next, line, count)) {
+			GdipFree (line);
+			gdip_region_spans_free (result);
+			return NULL;
+		}
+
+		y = next;
+		if (band1 && (band1->y2 <= y))
+			i1++;
+		if (band2 && (band2->y2 <= y))
+			i2++;
+	}
+
+	GdipFree (line);
+	return result;
+}
+
+/*
+ * Path rasterization
+ */
+
+typedef struct {
+	double x;	/* crossing of the first line */
+	double slope;	/* horizontal move for each line */
+	int first;	/* first line crossed */
+	int last;	/* first line not crossed anymore */
+	int winding;	/* +1 going down, -1 going up */
+	double cross;	/* crossing of the current line */
+} SpanEdge;
+
+static int
+compare_edges (const void *a, const void *b)
+{
+	return ((const SpanEdge *) a)->first - ((const SpanEdge *) b)->first;
+}
+
+/* index of the first pixel whose top left corner is at or after @value */
+static int
+clamp_coordinate (double value)
+{
+	if (value < REGION_INFINITE_POSITION)
+		return REGION_INFINITE_POSITION;
+	if (value > REGION_INFINITE_POSITION + REGION_INFINITE_LENGTH)
+		return REGION_INFINITE_POSITION + REGION_INFINITE_LENGTH;
+	return (int) ceil (value);
+}
+
+static void
+add_edge (SpanEdge *edges, int *count, GpPointF *p1, GpPointF *p2)
+{
+	SpanEdge *edge = &edges [*count];
+	GpPointF *top, *bottom;
+
+	if (p1->Y == p2->Y)
+		return;
+
+	if (p1->Y < p2->Y) {
+		top = p1;
+		bottom = p2;
+		edge->winding = 1;
+	} else {
+		top = p2;
+		bottom = p1;
+		edge->winding = -1;
+	}
+
+	/* a line y is crossed when y is inside [top, bottom[ */
+	edge->first = clamp_coordinate (top->Y);
+	edge->last = clamp_coordinate (bottom->Y);
+	if (edge->first >= edge->last)
+		return;
+
+	edge->slope = ((double) bottom->X - top->X) / ((double) bottom->Y - top->Y);
+	edge->x = top->X + (edge->first - top->Y) * edge->slope;
+	(*count)++;
+}
+
+/*
+ * gdip_region_rasterize_path:
+ * @path: a GpPath
+ * @func: called, from top to bottom, for each line holding visible pixels
+ * @data: passed to @func
+ *
+ * Scanline rasterizer used for both the masks and the spans. Like GDI+, the
+ * pixel x,y is visible when the point x,y (its top left corner) is inside
+ * @path, according to its fill mode. Curves are flattened by GdipFlattenPath
+ * and only the lines crossed by an edge are visited, whatever the size of the
+ * path. Returns FALSE if the memory couldn't be allocated or @func failed.
+ */
+BOOL
+gdip_region_rasterize_path (GpPath *path, GpRegionLineFunc func, void *data)
+{
+	BOOL result = FALSE;
+	GpPath *flat = NULL;
+	SpanEdge *edges = NULL;
+	SpanEdge **active = NULL;
+	GpRegionSpan *line = NULL;
+	int edge_count = 0, active_count = 0, next_edge = 0;
+	int i, start, y;
+
+	if (GdipClonePath (path, &flat) != Ok)
+		return FALSE;
+	if (GdipFlattenPath (flat, NULL, REGION_SPANS_FLATNESS) != Ok)
+		goto done;
+
+	if (flat->count == 0) {
+		result = TRUE;
+		goto done;
+	}
+
+	/* every figure is implicitly closed when filled */
+	edges = GdipAlloc (flat->count * sizeof (SpanEdge));
+	active = GdipAlloc (flat->count * sizeof (SpanEdge *));
+	line = GdipAlloc ((flat->count / 2 + 1) * sizeof (GpRegionSpan));
+	if (!edges || !active || !line)
+		goto done;
+
+	start = 0;
+	for (i = 1; i <= flat->count; i++) {
+		if ((i == flat->count) || ((flat->types [i] & PathPointTypePathTypeMask) == PathPointTypeStart)) {
+			int j;
+			for (j = start + 1; j < i; j++)
+				add_edge (edges, &edge_count, &flat->points [j - 1], &flat->points [j]);
+			add_edge (edges, &edge_count, &flat->points [i - 1], &flat->points [start]);
+			start = i;
+		}
+	}
+
+	qsort (edges, edge_count, sizeof (SpanEdge), compare_edges);
+
+	y = (edge_count > 0) ? edges [0].first : 0;
+	while ((next_edge < edge_count) || (active_count > 0)) {
+		int count = 0, winding = 0, x1 = 0;
+
+		/* nothing crosses the lines until the next edge starts */
+		if ((active_count == 0) && (edges [next_edge].first > y))
+			y = edges [next_edge].first;
+
+		while ((next_edge < edge_count) && (edges [next_edge].first == y))
+			active [active_count++] = &edges [next_edge++];
+
+		for (i = 0; i < active_count; i++)
+			active [i]->cross = active [i]->x + (y - active [i]->first) * active [i]->slope;
+
+		/* the crossings move little from one line to the next, an insertion sort is enough */
+		for (i = 1; i < active_count; i++) {
+			SpanEdge *edge = active [i];
+			int j = i - 1;
+			while ((j >= 0) && (active [j]->cross > edge->cross)) {
+				active [j + 1] = active [j];
+				j--;
+			}
+			active [j + 1] = edge;
+		}
+
+		for (i = 0; i < active_count; i++) {
+			BOOL was_inside = (flat->fill_mode == FillModeAlternate) ? (winding & 1) : (winding != 0);
+			BOOL inside;
+
+			winding += (flat->fill_mode == FillModeAlternate) ? 1 : active [i]->winding;
+			inside = (flat->fill_mode == FillModeAlternate) ? (winding & 1) : (winding != 0);
+
+			if (!was_inside && inside) {
+				x1 = clamp_coordinate (active [i]->cross);
+			} else if (was_inside && !inside) {
+				int x2 = clamp_coordinate (active [i]->cross);
+				if (x2 > x1) {
+					if ((count > 0) && (line [count - 1].x2 >= x1)) {
+						line [count - 1].x2 = x2;
+					} else {
+						line [count].x1 = x1;
+						line [count].x2 = x2;
+						count++;
+					}
+				}
+			}
+		}
+
+		if ((count > 0) && !func (data, y, line, count))
+			goto done;
+
+		/* move to the next line */
+		y++;
+		for (i = 0; i < active_count; ) {
+			if (active [i]->last <= y)
+				active [i] = active [--active_count];
+			else
+				i++;
+		}
+	}
+	result = TRUE;
+
+done:
+	if (edges)
+		GdipFree (edges);
+	if (active)
+		GdipFree (active);
+	if (line)
+		GdipFree (line);
+	GdipDeletePath (flat);
+	return result;
+}
+
+static BOOL
+add_line (void *data, int y, const GpRegionSpan *line, int count)
+{
+	return gdip_region_spans_add_band ((GpRegionSpans *) data, y, y + 1, line, count);
+}
+
+/*
+ * gdip_region_spans_from_path:
+ * @path: a GpPath
+ *
+ * Return a new GpRegionSpans containing the pixels of the filled @path, or
+ * NULL if the memory couldn't be allocated.
+ */
+GpRegionSpans*
+gdip_region_spans_from_path (GpPath *path)
+{
+	GpRegionSpans *result = gdip_region_spans_new ();
+
+	if (result && !gdip_region_rasterize_path (path, add_line, result)) {
+		gdip_region_spans_free (result);
+		result = NULL;
+	}
+	return result;
+}
@@ -39,6 +39,7 @@ gdip_region_init (GpRegion *result)
 	result->rects = NULL;
 	result->tree = NULL;
 	result->bitmap = NULL;
+	result->banded = FALSE;
 }
 
 GpRegion *
@@ -53,38 +54,6 @@ gdip_region_new ()
 	return result;
 }
 
-static int
-gdip_compare_rectf (const void *a, const void *b) {
-	const GpRectF *r1 = (GpRectF*)a;
-	const GpRectF *r2 = (GpRectF*)b;
-	if (r1->Y == r2->Y && r1->X == r2->X)
-		return 0;
-	if (r1->Y > r2->Y || (r1->Y == r2->Y && r1->X > r2->X))
-		return 1;
-	return -1;
-}
-
-static void
-gdip_sort_rect_array (GpRectF* array, int length) {
-	qsort (array, length, sizeof (GpRectF), gdip_compare_rectf);
-}
-
-// Not a mistake in the name, it is for re-sorting nearly-sorted data.
-// Insertion sort.
-static void
-gdip_sort_rect_array_sorted (GpRectF* array, int length) {
-	GpRectF rect;
-	GpRectF *i, *j;
-
-	for (i = array + 1; i < array + length; i++) {
-		rect = *i;
-		for (j = i - 1; j >= array && gdip_compare_rectf (j, &rect) > 0; j--) {
-			*(j + 1) = *j;
-		}
-		*(j + 1) = rect;
-	}
-}
-
 static GpStatus
 gdip_extend_rect_array (GpRectF** srcarray, int* elements, int* capacity) {
 	GpRectF *array;
@@ -120,23 +89,6 @@ gdip_extend_rect_array (GpRectF** srcarray, int* elements, int* capacity) {
 	return Ok;
 }
 
-static GpStatus
-gdip_trim_rect_array (GpRectF** srcarray, int elements) {
-	GpRectF *array;
-
-	array = GdipAlloc (sizeof (GpRectF) * elements);
-	if (!array)
-		return OutOfMemory;
-
-	memcpy (array, *srcarray, sizeof (GpRectF) * elements);
-
-	if (*srcarray)
-		GdipFree (*srcarray);
-
-	*srcarray = array;
-	return Ok;
-}
-
 static GpStatus
 gdip_add_rect_to_array (GpRectF** srcarray, int* elements, int* capacity, const GpRectF* rect)
 {
@@ -156,47 +108,6 @@ gdip_add_rect_to_array (GpRectF** srcarray, int* elements, int* capacity, const
 	return Ok;
 }
 
-static GpRectF*
-gdip_binsearch_rect_array (GpRectF* array, int elements, const GpRectF* search, int* index)
-{
-	GpRectF *next;
-	int upper = elements, lower = 0, mid;
-
-	while (upper > lower) {
-		mid = (upper + lower) / 2;
-		next = array + mid;
-		if (gdip_compare_rectf (search, next) > 0) {
-			lower = mid + 1;
-		} else {
-			upper = mid;
-		}
-	}
-	next = array + lower;
-	if (index)
-		*index = lower;
-	return next;
-}
-
-static GpStatus
-gdip_add_rect_to_array_sorted (GpRectF** srcarray, int* elements, int* capacity, const GpRectF* rect)
-{
-	GpRectF *next;
-	GpStatus status;
-	int insertAt;
-
-	status = gdip_extend_rect_array (srcarray, elements, capacity);
-	if (status != Ok)
-		return status;
-
-	next = gdip_binsearch_rect_array (*srcarray, *elements, rect, &insertAt);
-	memmove (next + 1, next, sizeof (GpRectF) * (*elements - insertAt));
-	memcpy (next, rect, sizeof (GpRectF));
-
-	*elements = *elements + 1;
-
-	return Ok;
-}
-
 static BOOL
 gdip_is_Point_in_RectF_Visible (float x, float y, GpRectF* rect)
 {
@@ -361,66 +272,6 @@ gdip_is_InfiniteRegion (const GpRegion *region)
 	return FALSE;
 }
 
-static BOOL
-gdip_intersects (const GpRectF *rect1, const GpRectF *rect2)
-{
-	return (rect1->X < rect2->X + rect2->Width &&
-		rect1->X + rect1->Width > rect2->X &&
-		rect1->Y < rect2->Y + rect2->Height &&
-		rect1->Y + rect1->Height > rect2->Y);
-}
-
-static BOOL
-gdip_intersects_or_touches (GpRectF *rect1, GpRectF *rect2)
-{
-	return (rect1->X <= rect2->X + rect2->Width &&
-		rect1->X + rect1->Width >= rect2->X &&
-		rect1->Y <= rect2->Y + rect2->Height &&
-		rect1->Y + rect1->Height >= rect2->Y);
-}
-
-/* Is source contained in target ? */
-static BOOL
-gdip_contains (GpRectF *rect1, GpRectF *rect2)
-{
-	return (rect1->X >= rect2->X &&
-		rect1->X + rect1->Width <= rect2->X + rect2->Width &&
-		rect1->Y >= rect2->Y &&
-		rect1->Y + rect1->Height <= rect2->Y + rect2->Height);
-}
-
-static BOOL
-gdip_add_rect_to_array_notcontained (GpRectF** srcarray, int* elements, int* capacity,  GpRectF* rect)
-{
-	int i;
-	GpRectF* rectarray = *srcarray;
-
-	if (rect->Height <= 0 || rect->Width <= 0)
-		return FALSE;
-
-	for (i = 0; i < *elements; i++, rectarray++) {
-		if (gdip_contains (rect, rectarray) == TRUE) {
-			return FALSE;
-		}
-	}
-
-	gdip_add_rect_to_array (srcarray, elements, capacity, rect);
-	return TRUE;
-}
-
-
-static BOOL
-gdip_equals (GpRectF *rect1, GpRectF *rect2)
-{
-	if (!rect1)
-		return (rect2 == NULL);
-
-	return (rect1->X == rect2->X &&
-		rect1->Width == rect2->Width &&
-		rect1->Y == rect2->Y &&
-		rect1->Height == rect2->Height);
-}
-
 BOOL
 gdip_is_Point_in_RectF_inclusive (float x, float y, GpRectF* rect)
 {
@@ -431,41 +282,6 @@ gdip_is_Point_in_RectF_inclusive (float x, float y, GpRectF* rect)
 		return FALSE;
 }
 
-/* Finds a rect that has the lowest x and y after the src rect provided */
-static BOOL
-gdip_getlowestrect (GpRectF *rects, int cnt, GpRectF* src, GpRectF* rslt)
-{
-	int i;
-	GpRectF *current;
-	GpRectF *lowest = NULL;
-
-	for (i = 0, current = rects; i < cnt; i++, current++) {
-		if (current->Width <= 0 || current->Height <= 0)
-			continue;
-
-		if (current->Y > src->Y ||
-			(current->Y == src->Y && current->X > src->X)) {
-			if (lowest == NULL) {
-				lowest = current;
-			}
-			else {
-				if (current->Y < lowest->Y ||
-					(current->Y == lowest->Y && current->X < lowest->X)) {
-						lowest = current;
-				}
-			}
-		}
-	}
-
-	if (lowest == NULL) {
-		return FALSE;
-	}
-
-	rslt->X = lowest->X; rslt->Y = lowest->Y;
-	rslt->Width = lowest->Width; rslt->Height = lowest->Height;
-	return TRUE;
-}
-
 void 
 gdip_clear_region (GpRegion *region)
 {
@@ -488,6 +304,7 @@ gdip_clear_region (GpRegion *region)
 	}
 
 	region->cnt = 0;
+	region->banded = FALSE;
 }
 
 GpStatus
@@ -496,6 +313,7 @@ gdip_copy_region (GpRegion *source, GpRegion *dest)
 	GpStatus status;
 
 	dest->type = source->type;
+	dest->banded = source->banded;
 
 	if (source->rects) {
 		dest->cnt = source->cnt;
@@ -510,7 +328,7 @@ gdip_copy_region (GpRegion *source, GpRegion *dest)
 	}
 
 	if (source->tree) {
-		dest->tree = (GpPathTree *) GdipAlloc (sizeof (GpPathTree));
+		dest->tree = gdip_region_alloc_tree ();
 		if (!dest->tree)
 			return OutOfMemory;
 
@@ -540,7 +358,7 @@ gdip_region_convert_to_path (GpRegion *region)
 	if (!region || (region->type == RegionTypePath))
 		return Ok;
 
-	region->tree = (GpPathTree *) GdipAlloc (sizeof (GpPathTree));
+	region->tree = gdip_region_alloc_tree ();
 	if (!region->tree)
 		return OutOfMemory;
 
@@ -582,7 +400,7 @@ static GpStatus
 gdip_region_create_from_path (GpRegion *region, GpPath *path)
 {
 	region->type = RegionTypePath;
-	region->tree = (GpPathTree *) GdipAlloc (sizeof (GpPathTree));
+	region->tree = gdip_region_alloc_tree ();
 	if (!region->tree)
 		return OutOfMemory;
 
@@ -726,7 +544,7 @@ GdipCreateRegionRgnData (GDIPCONST BYTE *regionData, INT size, GpRegion **region
 			return InvalidParameter;
 		}
 
-		result->tree = (GpPathTree*) GdipAlloc (sizeof (GpPathTree));
+		result->tree = gdip_region_alloc_tree ();
 		if (!result->tree) {
 			GdipFree (result);
 			return OutOfMemory;
@@ -830,502 +648,386 @@ GdipSetEmpty (GpRegion *region)
 	return Ok;
 }
 
-/* Exclude */
-static GpStatus
-gdip_combine_exclude (GpRegion *region, GpRectF *rtrg, int cntt)
+/*
+ * Rectangle based regions are combined as y-x bands, the layout of the GDI+
+ * scans: the rectangles are sorted from top to bottom, the rectangles of a
+ * band share the same Y and Height and are sorted from left to right without
+ * overlapping. Combining two banded lists is a linear merge of their bands
+ * and the lookups are binary searches.
+ */
+
+/* TRUE if @rects are banded (identical bands don't need to be merged) */
+static BOOL
+gdip_is_banded (const GpRectF *rects, int count)
 {
-	GpRectF *allsrcrects = NULL, *rects = NULL;
-	GpRectF *alltrgrects = NULL, *rect, *rectop, *recttrg;
-	int allsrccnt = 0, allsrccap, cnt = 0, cap, i, n, alltrgcnt = 0, alltrgcap;
-	GpRectF current, rslt, newrect;
-	BOOL storecomplete;
-	GpStatus status;
+	int i;
 
-	/* Create the list of source rectangles to process, it will contain splitted ones later */
-	allsrccap = region->cnt * 2;
-	cap = allsrccap;
-	for (i = 0, rect = region->rects; i < region->cnt; i++, rect++) {
-		status = gdip_add_rect_to_array (&allsrcrects, &allsrccnt, &allsrccap, rect);
-		if (status != Ok) {
-			if (allsrcrects) {
-				GdipFree (allsrcrects);
-			}
+	for (i = 0; i < count; i++) {
+		const GpRectF *rect = rects + i;
+		const GpRectF *previous = rect - 1;
 
-			return status;
-		}
-	}
+		if (rect->Width <= 0 || rect->Height <= 0)
+			return FALSE;
+		if (i == 0)
+			continue;
 
-	/* Create the list of target rectangles to process, it will contain splitted ones later */
-	alltrgcap = cntt;
-	for (i = 0, rect = rtrg; i < cntt; i++, rect++) {
-		/* normalize */
-		GpRectF normal;
-		gdip_normalize_rectangle (rect, &normal);
-		status = gdip_add_rect_to_array (&alltrgrects, &alltrgcnt, &alltrgcap, &normal);
-		if (status != Ok) {
-			if (alltrgrects) {
-				GdipFree (alltrgrects);
-			}
-			if (allsrcrects) {
-				GdipFree(allsrcrects);
-			}
-			return status;
+		if (rect->Y == previous->Y) {
+			if (rect->Height != previous->Height || rect->X < previous->X + previous->Width)
+				return FALSE;
+		} else if (rect->Y < previous->Y + previous->Height) {
+			return FALSE;
 		}
 	}
 
-	/* Init current with the first element in the array */
-	current.X = REGION_INFINITE_POSITION - 1;
-	current.Y = REGION_INFINITE_POSITION - 1;
-	current.Width = 0; current.Height = 0;
+	return TRUE;
+}
 
-	while (gdip_getlowestrect (allsrcrects, allsrccnt, &current, &rslt)) {
-		current.X = rslt.X; current.Y = rslt.Y;
-		current.Width = rslt.Width; current.Height = rslt.Height;
-		storecomplete = TRUE;
+/* number of rectangles in the band starting at @index */
+static int
+gdip_get_band_size (const GpRectF *rects, int count, int index)
+{
+	int i = index;
 
-		/* Current rect with lowest y and X against the target ones */
-		for (i = 0, recttrg = alltrgrects; i < alltrgcnt; i++, recttrg++) {
+	while (i < count && rects[i].Y == rects[index].Y)
+		i++;
+	return i - index;
+}
 
-			if (gdip_intersects (&current, recttrg) == FALSE
-				|| gdip_equals (&current, recttrg) == TRUE ||
-				recttrg->Height < 0 || recttrg->Width < 0) {
-				continue;
-			}
+/* index of the first band, of the banded @rects, whose bottom is after @y */
+static int
+gdip_find_band (const GpRectF *rects, int count, float y)
+{
+	int lower = 0, upper = count;
 
-			/* Once a rect is splitted, we do not want to take into account anymore */
-			for (rectop = allsrcrects, n = 0; n < allsrccnt; n++, rectop++) {
-				if (gdip_equals (&current, rectop)) {
-					rectop->X = 0; rectop->Y = 0;
-					rectop->Width = 0; rectop->Height = 0;
-					break;
-				}
-			}
+	while (upper > lower) {
+		int mid = (upper + lower) / 2;
+		if (rects[mid].Y + rects[mid].Height > y)
+			upper = mid;
+		else
+			lower = mid + 1;
+	}
+	return lower;
+}
 
-			/* Result rect */
-			newrect.Y = current.Y;
-			if (current.Y >= recttrg->Y) {  /* Our rect intersects in the upper part with another rect */
-				newrect.Height = MIN (recttrg->Y + recttrg->Height - current.Y, current.Height);
-				if (newrect.Height < 0)
-					newrect.Height = current.Height;
+/* index of the first rectangle of the band [@index, @index + @size[ whose right side is after @x */
+static int
+gdip_find_span (const GpRectF *rects, int index, int size, float x)
+{
+	int lower = index, upper = index + size;
 
-				if (current.X >= recttrg->X) { /* Hit from behind */
-					newrect.X = recttrg->X + recttrg->Width;
-					newrect.Width = MAX (current.X + current.Width - newrect.X, 0);
-				}
-				else {
-					newrect.X = current.X;
-					newrect.Width = MAX (recttrg->X - current.X, 0);
-				}
-			}
-			else {
-				newrect.Height = MIN (recttrg->Y - current.Y, current.Height);
-				newrect.X = current.X;
-				newrect.Width = current.Width;
-			}
+	while (upper > lower) {
+		int mid = (upper + lower) / 2;
+		if (rects[mid].X + rects[mid].Width > x)
+			upper = mid;
+		else
+			lower = mid + 1;
+	}
+	return lower;
+}
 
-			gdip_add_rect_to_array_notcontained (&rects, &cnt, &cap, &newrect);
+static BOOL
+gdip_is_Point_in_Bands_Visible (float x, float y, GpRectF *rects, int cnt)
+{
+	int band, size, span;
 
-			/* What's left to process from the source region */
-			if (current.Y >= recttrg->Y) {  /* Our rect intersects in the upper part with another rect */
-				/* A whole part from the top has been taken*/
-				if (recttrg->X <= current.X && recttrg->X + recttrg->Width  >= current.X + current.Width)
-					rslt.Y = recttrg->Y + recttrg->Height;
-				else
-					rslt.Y = newrect.Y + newrect.Height;
+	band = gdip_find_band (rects, cnt, y);
+	if (band == cnt || rects[band].Y > y)
+		return FALSE;
 
-				rslt.Height = current.Y  + current.Height - rslt.Y;
-			}
-			else {
-				rslt.Y = recttrg->Y;
-				rslt.Height = current.Y + current.Height - recttrg->Y;
-			}
+	size = gdip_get_band_size (rects, cnt, band);
+	span = gdip_find_span (rects, band, size, x);
+	return (span < band + size) && (rects[span].X <= x);
+}
 
-			rslt.X = current.X;
-			rslt.Width = current.Width;
+static BOOL
+gdip_is_Rect_in_Bands_Visible (float x, float y, float width, float height, GpRectF *rects, int cnt)
+{
+	int band, size, span;
 
-			if (rslt.Height > 0 && rslt.Width > 0) {
-				status = gdip_add_rect_to_array (&allsrcrects, &allsrccnt, &allsrccap, &rslt);
-				if (status != Ok) {
-					GdipFree (allsrcrects);
-					GdipFree (alltrgrects);
+	for (band = gdip_find_band (rects, cnt, y); band < cnt && rects[band].Y < y + height; band += size) {
+		size = gdip_get_band_size (rects, cnt, band);
+		span = gdip_find_span (rects, band, size, x);
+		if ((span < band + size) && (rects[span].X < x + width))
+			return TRUE;
+	}
 
-					return status;
-				}
-			}
+	return FALSE;
+}
 
-			/* Special case where our rect is hit and split in two parts IIIUIII */
-			if (recttrg->X >= current.X && recttrg->X + recttrg->Width  <= current.X + current.Width) {
-				/* Generate extra right rect, keep previous values of Y and Height */
-				newrect.Width = current.X + current.Width - (recttrg->X + recttrg->Width);
-				newrect.X = recttrg->X + recttrg->Width;
-				gdip_add_rect_to_array_notcontained (&rects, &cnt, &cap, &newrect);
-			}
+/*
+ * Combine the spans of two bands into @spans (pairs of left and right sides),
+ * which must have room for @cnt1 + @cnt2 spans. Touching spans are merged.
+ * Returns the number of spans.
+ */
+static int
+gdip_combine_band_spans (const GpRectF *band1, int cnt1, const GpRectF *band2, int cnt2, CombineMode combineMode, float *spans)
+{
+	int i = 0, j = 0, count = 0;
+	BOOL inside1 = FALSE, inside2 = FALSE, inside = FALSE;
+	float start = 0;
+
+	while (i < cnt1 || j < cnt2) {
+		float x1 = 0, x2 = 0, x;
+		BOOL now;
+
+		if (i < cnt1)
+			x1 = inside1 ? band1[i].X + band1[i].Width : band1[i].X;
+		if (j < cnt2)
+			x2 = inside2 ? band2[j].X + band2[j].Width : band2[j].X;
+
+		if (j >= cnt2 || (i < cnt1 && x1 <= x2))
+			x = x1;
+		else
+			x = x2;
+
+		/* cross all the sides at x before looking at the result */
+		if (i < cnt1 && x1 == x) {
+			if (inside1)
+				i++;
+			inside1 = !inside1;
+		}
+		if (j < cnt2 && x2 == x) {
+			if (inside2)
+				j++;
+			inside2 = !inside2;
+		}
 
-			storecomplete = FALSE;
+		switch (combineMode) {
+		case CombineModeIntersect:
+			now = inside1 && inside2;
+			break;
+		case CombineModeExclude:
+			now = inside1 && !inside2;
+			break;
+		case CombineModeXor:
+			now = inside1 != inside2;
+			break;
+		default:
+			now = inside1 || inside2;
 			break;
 		}
 
-		/* don't include a rectangle identical to the excluded one! */
-		if (storecomplete && !gdip_equals (rtrg, &current)) {
-			gdip_add_rect_to_array_notcontained (&rects, &cnt, &cap, &current);
+		if (now && !inside) {
+			start = x;
+		} else if (!now && inside) {
+			if (count > 0 && spans[2 * count - 1] == start) {
+				spans[2 * count - 1] = x;
+			} else {
+				spans[2 * count] = start;
+				spans[2 * count + 1] = x;
+				count++;
+			}
 		}
+		inside = now;
 	}
 
-	gdip_trim_rect_array (&rects, cnt);
-
-	GdipFree (allsrcrects);
-	GdipFree (alltrgrects);
-	if (region->rects)
-		GdipFree (region->rects);
-
-	region->rects = rects;
-	region->cnt = cnt;
-
-	return Ok;
+	return count;
 }
 
-
-/*
-	Complement: the part of the second region not shared with the first region.
-	Scans the region to be combined and store the rects not present in the region
-*/
+/* Append the band [@y1, @y2[ to @rects, or grow the previous band when it has the same spans. */
 static GpStatus
-gdip_combine_complement (GpRegion *region, GpRectF *rtrg, int cntt)
+gdip_add_band (GpRectF **rects, int *count, int *capacity, int *previous, float *previousBottom, float y1, float y2, const float *spans, int spanCount)
 {
-	GpRegion regsrc;
-	GpRectF* trg, *rect;
-	GpRectF* allsrcrects = NULL;
-	int allsrccnt = 0, i,  trgcnt, allsrccap;
 	GpStatus status;
+	int i;
 
-	/* Create the list of source rectangles to process */
-	allsrccap = cntt;
-	for (i = 0, rect = rtrg; i < cntt; i++, rect++) {
-		/* normalize */
-		GpRectF normal;
-		gdip_normalize_rectangle (rect, &normal);
-		status = gdip_add_rect_to_array (&allsrcrects, &allsrccnt, &allsrccap, &normal);
-		if (status != Ok) {
-			goto error;
-		}
-	}
+	if (*previous >= 0 && *previousBottom == y1 && *count - *previous == spanCount) {
+		GpRectF *band = *rects + *previous;
+		BOOL same = TRUE;
 
-	regsrc.rects = allsrcrects;
-	regsrc.cnt = allsrccnt;
-	trg = region->rects;
-	trgcnt = region->cnt;
+		for (i = 0; i < spanCount && same; i++)
+			same = (band[i].X == spans[2 * i]) && (band[i].Width == spans[2 * i + 1] - spans[2 * i]);
 
-	status = gdip_combine_exclude (&regsrc, trg, trgcnt);
-	if (status != Ok) {
-		goto error;
+		if (same) {
+			for (i = 0; i < spanCount; i++)
+				band[i].Height = y2 - band[i].Y;
+			*previousBottom = y2;
+			return Ok;
+		}
 	}
 
-	if ((regsrc.rects != allsrcrects) || (regsrc.cnt != allsrccnt)) {
-		if (region->rects)
-			GdipFree (region->rects);
-
-		region->rects = regsrc.rects;
-		region->cnt = regsrc.cnt;
+	*previous = *count;
+	*previousBottom = y2;
+	for (i = 0; i < spanCount; i++) {
+		GpRectF rect = {spans[2 * i], y1, spans[2 * i + 1] - spans[2 * i], y2 - y1};
+		status = gdip_add_rect_to_array (rects, count, capacity, &rect);
+		if (status != Ok)
+			return status;
 	}
 
 	return Ok;
-
-error:
-	if (allsrcrects)
-		GdipFree (allsrcrects);
-	
-	return status;
 }
 
-
-/* Union */
+/*
+ * Combine the banded @rects1 and @rects2, walking their bands from top to
+ * bottom. The result is banded too, with touching spans and identical
+ * touching bands merged.
+ */
 static GpStatus
-gdip_combine_union (GpRegion *region, GpRectF *rtrg, int cnttrg)
+gdip_combine_bands (const GpRectF *rects1, int cnt1, const GpRectF *rects2, int cnt2, CombineMode combineMode, GpRectF **result, int *resultCount)
 {
-	GpRectF *allrects = NULL, *rects = NULL;
-	GpRectF *recttrg, *rect, *rectop, *current;
-	int allcnt = 0, allcap, cnt = 0, cap = 0, currentIndex = -1, i, n;
-	GpRectF rslt, newrect;
-	BOOL storecomplete, contained, needsort;
-	GpStatus status;
-
-	/* All the src and trg rects in a single array*/
-	allcap = (region->cnt + cnttrg) * 2;
-	cap = allcap;
-	for (i = 0, rect = region->rects; i < region->cnt; i++, rect++) {
-		status = gdip_add_rect_to_array (&allrects, &allcnt, &allcap, rect);
-		if (status != Ok) {
-			if (allrects)
-				GdipFree (allrects);
-
-			return status;
-		}
-	}
-
-	for (i = 0, rect = rtrg; i < cnttrg; i++, rect++) {
-		/* normalize */
-		GpRectF normal;
-		gdip_normalize_rectangle (rect, &normal);
-		gdip_add_rect_to_array (&allrects, &allcnt, &allcap, &normal);
-	}
+	GpRectF *rects = NULL;
+	float *spans;
+	int count = 0, capacity = cnt1 + cnt2, previous = -1;
+	int i = 0, j = 0, size1, size2;
+	float previousBottom = 0, y;
+	GpStatus status = Ok;
 
-	if (allcnt == 0) {
-		GdipFree (allrects);
+	*result = NULL;
+	*resultCount = 0;
+	if (cnt1 + cnt2 == 0)
 		return Ok;
-	}
-
-	gdip_sort_rect_array(allrects, allcnt);
 
-	for (currentIndex = 0; currentIndex < allcnt; currentIndex++) {
-		current = allrects + currentIndex;
+	spans = GdipAlloc (2 * (cnt1 + cnt2) * sizeof (float));
+	if (!spans)
+		return OutOfMemory;
 
-		if (current->Width <= 0 || current->Height <= 0) {
-			continue;
-		}
+	size1 = gdip_get_band_size (rects1, cnt1, 0);
+	size2 = gdip_get_band_size (rects2, cnt2, 0);
+	if (cnt1 == 0)
+		y = rects2[0].Y;
+	else if (cnt2 == 0)
+		y = rects1[0].Y;
+	else
+		y = MIN (rects1[0].Y, rects2[0].Y);
 
-		storecomplete = TRUE;
+	while (i < cnt1 || j < cnt2) {
+		BOOL inside1 = (i < cnt1) && (rects1[i].Y <= y);
+		BOOL inside2 = (j < cnt2) && (rects2[j].Y <= y);
+		float bottom = 0, bottom2;
+		int spanCount;
 
-		/* Current rect with lowest y and X againt the stored ones */
-		for (i = currentIndex + 1; i < allcnt; i++) {
-			recttrg = allrects + i;
+		/* nothing else can be visible */
+		if ((combineMode == CombineModeIntersect && (i >= cnt1 || j >= cnt2)) || (combineMode == CombineModeExclude && i >= cnt1))
+			break;
 
-			needsort = FALSE;
+		/* the current band ends when either list starts or ends a band */
+		if (i < cnt1)
+			bottom = inside1 ? rects1[i].Y + rects1[i].Height : rects1[i].Y;
+		if (j < cnt2) {
+			bottom2 = inside2 ? rects2[j].Y + rects2[j].Height : rects2[j].Y;
+			if (i >= cnt1 || bottom2 < bottom)
+				bottom = bottom2;
+		}
 
-			// If it is positioned after the bottom-right corner of current, no useful rectangles can be found (due to sorting).
-			if (recttrg->Y > current->Y + current->Height ||
-				(recttrg->Y == current->Y + current->Height && recttrg->X > current->X + current->Width)) {
+		if (inside1 || inside2) {
+			spanCount = gdip_combine_band_spans (rects1 + i, inside1 ? size1 : 0, rects2 + j, inside2 ? size2 : 0, combineMode, spans);
+			status = gdip_add_band (&rects, &count, &capacity, &previous, &previousBottom, y, bottom, spans, spanCount);
+			if (status != Ok)
 				break;
-			}
-
-			/* If it has lower coordinates or negative / zero size it has been already processed */
-			if (recttrg->Height <= 0 || recttrg->Width <= 0 ||
-				current->Y > recttrg->Y ||
-				(current->Y == recttrg->Y && current->X > recttrg->X)) {
-				continue;
-			}
-
-			if (gdip_intersects_or_touches (current, recttrg) == FALSE
-				|| gdip_equals (current, recttrg) == TRUE) {
-				continue;
-			}
-
-			if (gdip_contains  (recttrg, current) == TRUE) {
-				continue;
-			}
-
-			/* Our rect intersects in the lower part with another rect */
-			newrect.Y = current->Y;
-			newrect.X = current->X;
-			if (current->Y == recttrg->Y) {
-				newrect.Width = MAX (current->X + current->Width, recttrg->X + recttrg->Width) - newrect.X;
-				newrect.Height = MIN (current->Height, recttrg->Height);
-			}
-			else {
-				newrect.Width = current->Width;
-				newrect.Height = recttrg->Y - current->Y;
-			}
-
-			/* If it's contained inside, get the > height */
-			if (recttrg->X == current->X && (recttrg->Width == current->Width ||
-				(recttrg->Y == current->Y && recttrg->Width > current->Width))) {
-
-				newrect.Height = recttrg->Y + recttrg->Height - current->Y;
-			} else if (recttrg->X >= current->X && recttrg->X + recttrg->Width <= current->X + current->Width) {
-				newrect.Height = current->Height;
-			}
-
-			gdip_add_rect_to_array_notcontained (&rects, &cnt, &cap, &newrect);
-
-			/* Push what's left from the current the rect in the list of rects to process
-			 if it's already not contained in other rects except the current (we just split from there) */
-			rslt.X = current->X;
-			rslt.Y = newrect.Y + newrect.Height;
-			rslt.Width = current->Width;
-			rslt.Height = current->Height - newrect.Height;
-
-			if (rslt.Height > 0 && rslt.Width > 0) {
-				contained = FALSE;
-				for (rectop = allrects + currentIndex + 1, n = currentIndex + 1; n < allcnt; n++, rectop++) {
-					// Rectangles before currentIndex have been processed and will be empty. They cannot contain anything.
-					if (gdip_contains (&rslt, rectop)) {
-						contained = TRUE;
-						break;
-					} else if (gdip_compare_rectf (rectop, &rslt) > 0) {
-						break; // Not going to find one containing it after this.
-					}
-				}
-
-				if (contained == FALSE) {
-					status = gdip_add_rect_to_array_sorted (&allrects, &allcnt, &allcap,  &rslt);
-					if (status != Ok) {
-						GdipFree (allrects);
-						return status;
-					}
-
-					// Must get recttrg in the new array in case adding rslt above had to increase the array capacity.
-					recttrg = allrects + i;
-				}
-			}
-
-			/* If both we at the same Y when take into account the X also to process the following
-			   that exceeds the X also */
-			if (recttrg->Y == current->Y) {
-				recttrg->Height -= newrect.Height;
-				if (recttrg->Height > 0) {
-					recttrg->Y += newrect.Height;
-					needsort = TRUE; // Modified Y, re-sort.
-				}
-			} else if (recttrg->X >= current->X && recttrg->X + recttrg->Width <= current->X + current->Width) {
-				/* If it's contained inside, get the > height  */
-				recttrg->Height = recttrg->Y + recttrg->Height - (newrect.Y + newrect.Height);
-				if (recttrg->Height > 0) {
-					recttrg->Y = newrect.Y + newrect.Height;
-					needsort = TRUE; // Modified Y, re-sort.
-				}
-			}
-
-			if (needsort == TRUE)
-				gdip_sort_rect_array_sorted (allrects, allcnt);
-
-			storecomplete = FALSE;
-			break;
 		}
 
-		if (storecomplete) {
-			gdip_add_rect_to_array_notcontained (&rects, &cnt, &cap, current);
+		y = bottom;
+		if (inside1 && rects1[i].Y + rects1[i].Height <= y) {
+			i += size1;
+			size1 = gdip_get_band_size (rects1, cnt1, i);
+		}
+		if (inside2 && rects2[j].Y + rects2[j].Height <= y) {
+			j += size2;
+			size2 = gdip_get_band_size (rects2, cnt2, j);
 		}
 	}
 
-	GdipFree (allrects);
-	if (region->rects)
-		GdipFree (region->rects);
-
-	gdip_trim_rect_array (&rects, cnt);
-	region->rects = rects;
-	region->cnt = cnt;
+	GdipFree (spans);
+	if (status != Ok) {
+		if (rects)
+			GdipFree (rects);
+		return status;
+	}
 
+	*result = rects;
+	*resultCount = count;
 	return Ok;
 }
 
-/* Intersect */
+/*
+ * Return the banded equivalent of @rects in @bands: @rects itself when it's
+ * already banded, or a new array (@allocated) made of the union of all the
+ * non empty rectangles. @normalize first makes widths and heights positive.
+ */
 static GpStatus
-gdip_combine_intersect (GpRegion *region, GpRectF *rtrg, int cnttrg)
+gdip_get_bands (GpRectF *rects, int cnt, BOOL normalize, GpRectF **bands, int *bandCount, BOOL *allocated)
 {
-	GpRectF *rectsrc;
-	int src, trg;
-	GpRectF rectcur;
-	GpRegion regunion;
-	GpRectF *recttrg;
-	GpStatus status;
+	GpRectF *result = NULL;
+	int count = 0, i;
 
-	regunion.rects = NULL;
-	regunion.cnt = 0;
+	if (!normalize && gdip_is_banded (rects, cnt)) {
+		*bands = rects;
+		*bandCount = cnt;
+		*allocated = FALSE;
+		return Ok;
+	}
 
-	for (rectsrc = region->rects, src = 0; src < region->cnt; src++, rectsrc++) {
-		for (recttrg = rtrg, trg = 0; trg < cnttrg; trg++, recttrg++) {
-			/* normalize */
-			GpRectF normal;
-			gdip_normalize_rectangle (recttrg, &normal);
+	for (i = 0; i < cnt; i++) {
+		GpRectF rect, *merged;
+		int mergedCount;
+		GpStatus status;
 
-			/* Intersects With */
-			if ((rectsrc->X >= normal.X + normal.Width) || (rectsrc->X + rectsrc->Width <= normal.X) ||
-				(rectsrc->Y >= normal.Y + normal.Height) || (rectsrc->Y + rectsrc->Height <= normal.Y)) {
-				continue;
-			}
-			/* Area that intersects */
-			rectcur.X = rectsrc->X > normal.X ? rectsrc->X : normal.X;
-			rectcur.Y = rectsrc->Y > normal.Y ? rectsrc->Y : normal.Y;
-			rectcur.Width = rectsrc->X + rectsrc->Width < normal.X + normal.Width ?
-				rectsrc->X + rectsrc->Width - rectcur.X : normal.X + normal.Width - rectcur.X;
+		if (normalize)
+			gdip_normalize_rectangle (&rects[i], &rect);
+		else
+			rect = rects[i];
+		if (rect.Width <= 0 || rect.Height <= 0)
+			continue;
 
-			rectcur.Height = rectsrc->Y + rectsrc->Height < normal.Y + normal.Height ?
-				rectsrc->Y + rectsrc->Height - rectcur.Y : normal.Y + normal.Height - rectcur.Y;
+		status = gdip_combine_bands (result, count, &rect, 1, CombineModeUnion, &merged, &mergedCount);
+		if (result)
+			GdipFree (result);
+		if (status != Ok)
+			return status;
 
-			/* Combine with previous areas that intersect with rect */
-			status = gdip_combine_union (&regunion, &rectcur, 1);
-			if (status != Ok)
-				return status;
-		}
+		result = merged;
+		count = mergedCount;
 	}
 
-	if (region->rects)
-		GdipFree (region->rects);
-
-	region->rects = regunion.rects;
-	region->cnt = regunion.cnt;
-
+	*bands = result;
+	*bandCount = count;
+	*allocated = TRUE;
 	return Ok;
 }
 
-/* Xor */
+/*
+ * Combine the rectangles of @region with the @rtrg rectangles. Complement is
+ * the exclusion of @region from @rtrg.
+ */
 static GpStatus
-gdip_combine_xor (GpRegion *region, GpRectF *recttrg, int cnttrg)
+gdip_combine_rects (GpRegion *region, GpRectF *rtrg, int cnttrg, CombineMode combineMode)
 {
-	GpRegion *rgnsrc = NULL;  /* All rectangles of both regions*/
-	GpRegion *rgntrg = NULL;  /* Only the ones that intersect*/
-	GpRectF *allrects = NULL, *rect;
-	int allcnt = 0, allcap, i;
+	GpRectF *bands1, *bands2, *rects;
+	int count1, count2, count;
+	BOOL allocated1, allocated2;
 	GpStatus status;
 
-	/* All the src and trg rects in a single array*/
-	allcap = region->cnt + cnttrg;
-	for (i = 0, rect = region->rects; i < region->cnt; i++, rect++) {
-		status = gdip_add_rect_to_array (&allrects, &allcnt, &allcap, rect);
-		if (status != Ok)
-			goto error;
-	}
-
-	for (i = 0, rect = recttrg; i < cnttrg; i++, rect++) {
-		/* normalize */
-		GpRectF normal;
-		gdip_normalize_rectangle (rect, &normal);
-		gdip_add_rect_to_array (&allrects, &allcnt, &allcap, &normal);
-	}
+	status = gdip_get_bands (region->rects, region->cnt, FALSE, &bands1, &count1, &allocated1);
+	if (status != Ok)
+		return status;
 
-	rgnsrc = (GpRegion *) GdipAlloc (sizeof (GpRegion));
-	if (!rgnsrc) {
-		status = OutOfMemory;
-		goto error;
+	status = gdip_get_bands (rtrg, cnttrg, TRUE, &bands2, &count2, &allocated2);
+	if (status != Ok) {
+		if (allocated1 && bands1)
+			GdipFree (bands1);
+		return status;
 	}
 
-	rgnsrc->type = RegionTypeRect;
-	rgnsrc->cnt = allcnt;
-	rgnsrc->rects = allrects;
-
-	status = GdipCloneRegion (region, &rgntrg);
-	if (status != Ok)
-		goto error;
+	if (combineMode == CombineModeComplement)
+		status = gdip_combine_bands (bands2, count2, bands1, count1, CombineModeExclude, &rects, &count);
+	else
+		status = gdip_combine_bands (bands1, count1, bands2, count2, combineMode, &rects, &count);
 
-	status = gdip_combine_intersect (rgntrg, recttrg, cnttrg);
+	if (allocated1 && bands1)
+		GdipFree (bands1);
+	if (allocated2 && bands2)
+		GdipFree (bands2);
 	if (status != Ok)
-		goto error;
-
-	/* exclude the intersecting rectangles (if any) */
-	if (rgntrg->cnt > 0) {
-		status = gdip_combine_exclude (rgnsrc, rgntrg->rects, rgntrg->cnt);
-		if (status != Ok)
-			goto error;
-	}
+		return status;
 
 	if (region->rects)
 		GdipFree (region->rects);
 
-	region->rects = rgnsrc->rects;
-	region->cnt = rgnsrc->cnt;
-
-	GdipFree (rgnsrc);
-	GdipDeleteRegion (rgntrg);
-
+	region->rects = rects;
+	region->cnt = count;
+	region->banded = TRUE;
 	return Ok;
-
-error:
-	if (allrects)
-		GdipFree (allrects);
-
-	GdipFree (rgnsrc);
-	GdipDeleteRegion (rgntrg);
-
-	return status;
 }
 
 GpStatus WINGDIPAPI
@@ -1411,18 +1113,15 @@ GdipCombineRegionRect (GpRegion *region, GDIPCONST GpRectF *rect, CombineMode co
 	case RegionTypeInfinite: {
 		region->type = RegionTypeRect;
 		switch (combineMode) {
-		case CombineModeExclude:
-			return gdip_combine_exclude (region, &normalized, 1);
+		case CombineModeReplace: /* Used by Graphics clipping */
+			region->banded = FALSE;
+			return gdip_add_rect_to_array (&region->rects, &region->cnt, NULL, &normalized);
 		case CombineModeComplement:
-			return gdip_combine_complement (region, &normalized, 1);
+		case CombineModeExclude:
 		case CombineModeIntersect:
-			return gdip_combine_intersect (region, &normalized, 1);
 		case CombineModeUnion:
-			return gdip_combine_union (region, &normalized, 1);
 		case CombineModeXor:
-			return gdip_combine_xor (region, &normalized, 1);
-		case CombineModeReplace: /* Used by Graphics clipping */
-			return gdip_add_rect_to_array (&region->rects, &region->cnt, NULL, &normalized);
+			return gdip_combine_rects (region, &normalized, 1, combineMode);
 		default:
 			return NotImplemented;
 		}
@@ -1506,10 +1205,42 @@ gdip_combine_exclude_from_infinite (GpRegion *region, GpPath *path)
 	return TRUE;
 }
 
+/*
+ * gdip_region_grow_tree:
+ * @region: a path based GpRegion
+ * @branch: the GpPathTree to combine into @region
+ * @combineMode: the operation
+ *
+ * Combine @branch into the tree of @region without rasterizing anything: the
+ * current tree becomes the first branch of a new tree, keeping the bitmap of
+ * @region as its cached result. The whole tree is rasterized once a query
+ * needs the bitmap, see gdip_region_bitmap_ensure. @region takes ownership
+ * of @branch, which is freed on failure.
+ */
+static GpStatus
+gdip_region_grow_tree (GpRegion *region, GpPathTree *branch, CombineMode combineMode)
+{
+	GpPathTree *tree = gdip_region_alloc_tree ();
+	if (!tree) {
+		gdip_region_clear_tree (branch);
+		GdipFree (branch);
+		return OutOfMemory;
+	}
+
+	tree->mode = combineMode;
+	tree->branch1 = region->tree;
+	tree->branch2 = branch;
+
+	tree->branch1->bitmap = region->bitmap;
+	region->bitmap = NULL;
+	region->tree = tree;
+	return Ok;
+}
+
 GpStatus WINGDIPAPI
 GdipCombineRegionPath (GpRegion *region, GpPath *path, CombineMode combineMode)
 {
-	GpRegionBitmap *path_bitmap, *result;
+	GpPathTree *branch;
 	GpStatus status;
 
 	if (!region || !path)
@@ -1592,108 +1323,46 @@ GdipCombineRegionPath (GpRegion *region, GpPath *path, CombineMode combineMode)
 			return status;
 	}
 
-	/* make sure the region's bitmap is available */
-	gdip_region_bitmap_ensure (region);
-	if (!region->bitmap)
+	/* add a copy of path into the region tree, it's rasterized when required */
+	branch = gdip_region_alloc_tree ();
+	if (!branch)
 		return OutOfMemory;
 
-	/* create a bitmap for the path to combine into the region */
-	path_bitmap = gdip_region_bitmap_from_path (path);
-
-	result = gdip_region_bitmap_combine (region->bitmap, path_bitmap, combineMode);
-	gdip_region_bitmap_free (path_bitmap);
-	if (!result)
-		return NotImplemented;
-
-	gdip_region_bitmap_free (region->bitmap);
-	region->bitmap = result;
-
-	/* add a copy of path into region1 tree */
-	if (region->tree->path) {
-		/* move the existing path into a new tree (branch1) ... */
-		region->tree->branch1 = (GpPathTree*) GdipAlloc (sizeof (GpPathTree));
-		if (!region->tree->branch1)
-			return OutOfMemory;
-
-		region->tree->branch1->path = region->tree->path;
-		region->tree->branch2 = (GpPathTree*) GdipAlloc (sizeof (GpPathTree));
-		if (!region->tree->branch2)
-			return OutOfMemory;
-	} else {
-		/* move the current base tree into branch1 of a new tree ... */
-		GpPathTree* tmp = (GpPathTree*) GdipAlloc (sizeof (GpPathTree));
-		if (!tmp)
-			return OutOfMemory;
-
-		tmp->branch1 = region->tree;
-		tmp->branch2 = (GpPathTree*) GdipAlloc (sizeof (GpPathTree));
-		if (!tmp->branch2) {
-			GdipFree (tmp);
-			return OutOfMemory;
-		}
-
-		region->tree = tmp;
+	status = GdipClonePath (path, &branch->path);
+	if (status != Ok) {
+		GdipFree (branch);
+		return status;
 	}
-	/* ... and clone the specified path into branch2 */
-	region->tree->mode = combineMode;
-	region->tree->path = NULL;
 
-	return GdipClonePath (path, &region->tree->branch2->path);
+	return gdip_region_grow_tree (region, branch, combineMode);
 }
 
 
 static GpStatus
 gdip_combine_pathbased_region (GpRegion *region1, GpRegion *region2, CombineMode combineMode)
 {
-	GpRegionBitmap *result;
+	GpStatus status;
+	GpPathTree *branch;
 
-	/* if not available, construct the bitmaps for both regions */
-	gdip_region_bitmap_ensure (region1);
-	gdip_region_bitmap_ensure (region2);
-	if (!region1->bitmap || !region2->bitmap)
+	/* add a copy of region2 tree (and of its bitmap, if any) into region1 tree,
+	   it's copied first as both regions can be the same */
+	branch = gdip_region_alloc_tree ();
+	if (!branch)
 		return OutOfMemory;
 
-	result = gdip_region_bitmap_combine (region1->bitmap, region2->bitmap, combineMode);
-	if (!result)
-		return NotImplemented;
-	gdip_region_bitmap_free (region1->bitmap);
-	region1->bitmap = result;
-
-	/* re-structure region1 to allow adding a copy of region2 inside it */
-	if (region1->tree->path) {
-		region1->tree->branch1 = (GpPathTree*) GdipAlloc (sizeof (GpPathTree));
-		if (!region1->tree->branch1)
-			return OutOfMemory;
-
-		region1->tree->branch1->path = region1->tree->path;
-		region1->tree->branch2 = (GpPathTree*) GdipAlloc (sizeof (GpPathTree));
-		if (!region1->tree->branch2)
-			return OutOfMemory;
-	} else {
-		/* move the current base tree into branch1 of a new tree ... */
-		GpPathTree* tmp = (GpPathTree*) GdipAlloc (sizeof (GpPathTree));
-		if (!tmp)
-			return OutOfMemory;
-
-		tmp->branch1 = region1->tree;
-		tmp->branch2 = (GpPathTree*) GdipAlloc (sizeof (GpPathTree));
-		if (!tmp->branch2) {
-			GdipFree (tmp);
-			return OutOfMemory;
-		}
-
-		region1->tree = tmp;
+	status = gdip_region_copy_tree (region2->tree, branch);
+	if ((status == Ok) && region2->bitmap) {
+		branch->bitmap = gdip_region_bitmap_clone (region2->bitmap);
+		if (!branch->bitmap)
+			status = OutOfMemory;
 	}
-
-	region1->tree->mode = combineMode;
-	region1->tree->path = NULL;
-
-	/* add a copy of region2 tree into region1 tree */
-	if (region2->tree->path) {
-		return GdipClonePath (region2->tree->path, &region1->tree->branch2->path);
-	} else {
-		return gdip_region_copy_tree (region2->tree, region1->tree->branch2);
+	if (status != Ok) {
+		gdip_region_clear_tree (branch);
+		GdipFree (branch);
+		return status;
 	}
+
+	return gdip_region_grow_tree (region1, branch, combineMode);
 }
 
 
@@ -1827,16 +1496,12 @@ GdipCombineRegionRegion (GpRegion *region, GpRegion *region2, CombineMode combin
 	 */
 	region->type = RegionTypeRect;
 	switch (combineMode) {
-	case CombineModeExclude:
-		return gdip_combine_exclude (region, region2->rects, region2->cnt);
 	case CombineModeComplement:
-		return gdip_combine_complement (region, region2->rects, region2->cnt);
+	case CombineModeExclude:
 	case CombineModeIntersect:
-		return gdip_combine_intersect (region, region2->rects, region2->cnt);
 	case CombineModeUnion:
-		return gdip_combine_union (region, region2->rects, region2->cnt);
 	case CombineModeXor:
-		return gdip_combine_xor (region, region2->rects, region2->cnt);
+		return gdip_combine_rects (region, region2->rects, region2->cnt, combineMode);
 	default:
 		return NotImplemented;
 	}
@@ -1889,6 +1554,10 @@ GdipIsEmptyRegion (GpRegion *region, GpGraphics *graphics, BOOL *result)
 	if (!region || !graphics || !result)
 		return InvalidParameter;
 
+	/* combined paths are only known to be empty once rasterized */
+	if ((region->type == RegionTypePath) && region->tree && !region->tree->path)
+		gdip_region_bitmap_ensure (region);
+
 	*result = gdip_is_region_empty (region, /* allowNegative */ TRUE);
 	return Ok;
 }
@@ -1914,7 +1583,10 @@ GdipIsVisibleRegionPoint (GpRegion *region, float x, float y, GpGraphics *graphi
 	switch (region->type) {
 	case RegionTypeRect:
 	case RegionTypeInfinite:
-		*result = gdip_is_Point_in_RectFs_Visible (x, y, region->rects, region->cnt);
+		if (region->banded)
+			*result = gdip_is_Point_in_Bands_Visible (x, y, region->rects, region->cnt);
+		else
+			*result = gdip_is_Point_in_RectFs_Visible (x, y, region->rects, region->cnt);
 		break;
 	case RegionTypePath:
 		gdip_region_bitmap_ensure (region);
@@ -1952,7 +1624,10 @@ GdipIsVisibleRegionRect (GpRegion *region, float x, float y, float width, float
 	switch (region->type) {
 	case RegionTypeRect:
 	case RegionTypeInfinite:
-		*result = gdip_is_Rect_in_RectFs_Visible (x, y, width, height, region->rects, region->cnt);
+		if (region->banded)
+			*result = gdip_is_Rect_in_Bands_Visible (x, y, width, height, region->rects, region->cnt);
+		else
+			*result = gdip_is_Rect_in_RectFs_Visible (x, y, width, height, region->rects, region->cnt);
 		break;
 	case RegionTypePath: {
 		GpRect rect = {x, y, width, height};
@@ -2162,6 +1837,12 @@ GdipIsEqualRegion (GpRegion *region, GpRegion *region2, GpGraphics *graphics, BO
 		return Ok;
 	}
 	
+	/* combined paths are only known to be empty once rasterized */
+	if ((region->type == RegionTypePath) && region->tree && !region->tree->path)
+		gdip_region_bitmap_ensure (region);
+	if ((region2->type == RegionTypePath) && region2->tree && !region2->tree->path)
+		gdip_region_bitmap_ensure (region2);
+
 	BOOL region1Infinite = gdip_is_InfiniteRegion (region);
 	BOOL region1Empty = gdip_is_region_empty (region, /* allowNegative */ TRUE);
 	BOOL region2Infinite = gdip_is_InfiniteRegion (region2);
@@ -2237,14 +1918,14 @@ GdipTranslateRegion (GpRegion *region, float dx, float dy)
 			rect->Y += dy;
 		}
 
+		/* rounding may make neighbouring bands overlap */
+		region->banded = region->banded && gdip_is_banded (region->rects, region->cnt);
 		break;
 	}
 	case RegionTypePath:
 		gdip_region_translate_tree (region->tree, dx, dy);
-		if (region->bitmap) {
-			region->bitmap->X += dx;
-			region->bitmap->Y += dy;
-		}
+		if (region->bitmap)
+			gdip_region_bitmap_translate (region->bitmap, dx, dy);
 
 		break;
 	default:
@@ -2275,6 +1956,8 @@ ScaleRegion (GpRegion *region, float sx, float sy)
 		region->rects[i].Height *= sy;
 	}
 
+	/* negative factors reverse the order of the bands */
+	region->banded = region->banded && gdip_is_banded (region->rects, region->cnt);
 	return Ok;
 }
 
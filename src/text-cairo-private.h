@@ -77,6 +77,8 @@ GpStatus cairo_DrawString (GpGraphics *graphics, GDIPCONST WCHAR *stringUnicode,
 	GDIPCONST RectF *rc, GDIPCONST GpStringFormat *format,  RectF *boundingBox, INT *codepointsFitted, INT *linesFilled)
 	GDIP_INTERNAL;*/
 
+void gdip_text_cairo_clear_advance_cache (void) GDIP_INTERNAL;
+
 GpStatus cairo_MeasureCharacterRanges (GpGraphics *graphics, GDIPCONST WCHAR *stringUnicode, INT length, GDIPCONST GpFont *font,
 	GDIPCONST GpRectF *layout, GDIPCONST GpStringFormat *format, INT regionCount, GpRegion **regions) GDIP_INTERNAL;
 
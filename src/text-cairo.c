@@ -61,23 +61,151 @@
 
 #undef DRAWSTRING_DEBUG
 
+/*
+ * Advance widths cache. Measuring a character through cairo_text_extents goes all the way through the scaled font
+ * machinery, which dominates MeasureString for the short strings of grids and lists. The widths are kept per cairo
+ * scaled font, which is unique for a font face, size, transformation and hinting options, in pages of 256 code units.
+ * The Latin page is part of the entry, the other pages are allocated on first use.
+ */
+#define ADVANCE_CACHE_FONTS	8
+#define ADVANCE_PAGE_SIZE	256
+
+typedef struct {
+	guint32			known [ADVANCE_PAGE_SIZE / 32];
+	float			width [ADVANCE_PAGE_SIZE];
+} GpAdvancePage;
+
+typedef struct {
+	cairo_scaled_font_t	*scaled_font;
+	GpAdvancePage		latin;
+	GpAdvancePage		*pages [0x10000 / ADVANCE_PAGE_SIZE];
+} GpAdvanceCache;
+
+static GMutex advance_cache_mutex;
+/* most recently used first */
+static GpAdvanceCache *advance_caches [ADVANCE_CACHE_FONTS];
+static guint64 advance_cache_hits = 0;
+static guint64 advance_cache_misses = 0;
+
+static void
+gdip_advance_cache_free (GpAdvanceCache *cache)
+{
+	int i;
+
+	for (i = 1; i < 0x10000 / ADVANCE_PAGE_SIZE; i++)
+		GdipFree (cache->pages [i]);
+
+	cairo_scaled_font_destroy (cache->scaled_font);
+	GdipFree (cache);
+}
+
+/* must be called with advance_cache_mutex held */
+static GpAdvanceCache *
+gdip_advance_cache_get (cairo_scaled_font_t *scaled_font)
+{
+	GpAdvanceCache *cache;
+	int i;
+
+	for (i = 0; i < ADVANCE_CACHE_FONTS && advance_caches [i]; i++) {
+		if (advance_caches [i]->scaled_font == scaled_font)
+			break;
+	}
+
+	if (i < ADVANCE_CACHE_FONTS && advance_caches [i]) {
+		cache = advance_caches [i];
+	} else {
+		cache = (GpAdvanceCache *) gdip_calloc (1, sizeof (GpAdvanceCache));
+		if (!cache)
+			return NULL;
+
+		cache->scaled_font = cairo_scaled_font_reference (scaled_font);
+		cache->pages [0] = &cache->latin;
+
+		/* evict the least recently used font */
+		if (i == ADVANCE_CACHE_FONTS) {
+			i--;
+			gdip_advance_cache_free (advance_caches [i]);
+		}
+	}
+
+	/* move to front */
+	memmove (advance_caches + 1, advance_caches, i * sizeof (GpAdvanceCache *));
+	advance_caches [0] = cache;
+	return cache;
+}
+
+void
+gdip_text_cairo_clear_advance_cache (void)
+{
+	int i;
+
+	g_mutex_lock (&advance_cache_mutex);
+	if (getenv ("GDIPLUS_TEXT_CACHE_STATS") && advance_cache_hits + advance_cache_misses > 0) {
+		fprintf (stderr, "libgdiplus: %llu character widths measured, %.1f%% from the advance cache\n",
+			(unsigned long long) (advance_cache_hits + advance_cache_misses),
+			100.0 * advance_cache_hits / (advance_cache_hits + advance_cache_misses));
+	}
+
+	for (i = 0; i < ADVANCE_CACHE_FONTS && advance_caches [i]; i++) {
+		gdip_advance_cache_free (advance_caches [i]);
+		advance_caches [i] = NULL;
+	}
+	advance_cache_hits = 0;
+	advance_cache_misses = 0;
+	g_mutex_unlock (&advance_cache_mutex);
+}
+
 static int
 CalculateStringWidths (cairo_t *ct, GDIPCONST GpFont *gdiFont, GDIPCONST gunichar2 *stringUnicode, unsigned long StringDetailElements, GpStringDetailStruct *StringDetails)
 {
 	size_t			i;
 	cairo_text_extents_t	ext;
+	cairo_scaled_font_t	*scaled_font;
+	GpAdvanceCache		*cache = NULL;
 	GpStringDetailStruct	*CurrentDetail;
 	BYTE utf8[5];
 
 	CurrentDetail = StringDetails;
 
+	g_mutex_lock (&advance_cache_mutex);
+
+	/* the scaled font of the context reflects the face, size, transformation and font options we measure with */
+	scaled_font = cairo_get_scaled_font (ct);
+	if (cairo_scaled_font_status (scaled_font) == CAIRO_STATUS_SUCCESS)
+		cache = gdip_advance_cache_get (scaled_font);
+
 	for (i = 0; i < StringDetailElements; i++) {
-		utf8[utf8_encode_ucs2char(*(stringUnicode + i), utf8)] = '\0';
+		gunichar2 c = stringUnicode [i];
+		GpAdvancePage *page = NULL;
+		int index = c % ADVANCE_PAGE_SIZE;
+
+		if (cache) {
+			page = cache->pages [c / ADVANCE_PAGE_SIZE];
+			if (!page)
+				page = cache->pages [c / ADVANCE_PAGE_SIZE] = (GpAdvancePage *) gdip_calloc (1, sizeof (GpAdvancePage));
+
+			if (page && (page->known [index / 32] & (1U << (index % 32)))) {
+				CurrentDetail->Width = page->width [index];
+				CurrentDetail++;
+				advance_cache_hits++;
+				continue;
+			}
+		}
+
+		utf8[utf8_encode_ucs2char(c, utf8)] = '\0';
 		cairo_text_extents(ct, (const char *) utf8, &ext);
 		CurrentDetail->Width = ext.x_advance;
 		CurrentDetail++;
+		advance_cache_misses++;
+
+		if (page) {
+			page->width [index] = ext.x_advance;
+			page->known [index / 32] |= 1U << (index % 32);
+		}
 	}
 
+	g_mutex_unlock (&advance_cache_mutex);
+
 	return StringDetailElements;
 }
 
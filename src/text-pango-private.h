@@ -49,6 +49,11 @@
 PangoLayout* gdip_pango_setup_layout (cairo_t *cr, GDIPCONST WCHAR *stringUnicode, INT length, GDIPCONST GpFont *font,
 	GDIPCONST RectF *rc, RectF *box, PointF *box_offset, GDIPCONST GpStringFormat *format, INT **charsRemoved);
 
+/* returns a layout from gdip_pango_setup_layout to the layout cache */
+void gdip_pango_release_layout (PangoLayout *layout) GDIP_INTERNAL;
+
+void gdip_pango_clear_layout_cache (void) GDIP_INTERNAL;
+
 GpStatus pango_DrawString (GpGraphics *graphics, GDIPCONST WCHAR *stringUnicode, INT length, GDIPCONST GpFont *font,
 	GDIPCONST RectF *rc, GDIPCONST GpStringFormat *format, GpBrush *brush) GDIP_INTERNAL;
 
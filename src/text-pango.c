@@ -175,9 +175,23 @@ gdip_process_string (gchar *text, int length, int removeAccelerators, int trimSp
 	return res;
 }
 
-PangoLayout*
-gdip_pango_setup_layout (cairo_t *cr, GDIPCONST WCHAR *stringUnicode, int length, GDIPCONST GpFont *font,
-	GDIPCONST RectF *rc, RectF *box, PointF *box_offset, GDIPCONST GpStringFormat *format, int **charsRemoved)
+/* vertical text is laid out horizontally in a rotated cairo context */
+static void
+gdip_pango_rotate_vertical (cairo_t *cr, GDIPCONST GpStringFormat *fmt, int FrameWidth, int FrameHeight)
+{
+	if (fmt->formatFlags & StringFormatFlagsDirectionRightToLeft) {
+		cairo_rotate (cr, M_PI/2.0);
+		cairo_translate (cr, 0, -FrameHeight);
+	} else {
+		cairo_rotate (cr, 3.0*M_PI/2.0);
+		cairo_translate (cr, -FrameWidth, 0);
+	}
+}
+
+static PangoLayout*
+gdip_pango_create_layout (cairo_t *cr, GDIPCONST WCHAR *stringUnicode, int length, GDIPCONST GpFont *font,
+	GDIPCONST RectF *rc, RectF *box, PointF *box_offset, GDIPCONST GpStringFormat *format, int **charsRemoved,
+	int *charsRemovedLength)
 {
 	GpStringFormat *fmt;
 	PangoLayout *layout;
@@ -210,6 +224,8 @@ gdip_pango_setup_layout (cairo_t *cr, GDIPCONST WCHAR *stringUnicode, int length
 		return NULL;
 		}
 		memset (*charsRemoved, 0, sizeof (int) * length);
+		if (charsRemovedLength)
+			*charsRemovedLength = length;
 	}
 
 	/* TODO - Digit substitution */
@@ -300,15 +316,8 @@ gdip_pango_setup_layout (cairo_t *cr, GDIPCONST WCHAR *stringUnicode, int length
 #ifdef PANGO_VERSION_CHECK
 #if PANGO_VERSION_CHECK(1,16,0)
 	if (fmt->formatFlags & StringFormatFlagsDirectionVertical) {
-		if (fmt->formatFlags & StringFormatFlagsDirectionRightToLeft) {
-			cairo_rotate (cr, M_PI/2.0);
-			cairo_translate (cr, 0, -FrameHeight);
-			pango_cairo_update_context (cr, context);
-		} else {
-			cairo_rotate (cr, 3.0*M_PI/2.0);
-			cairo_translate (cr, -FrameWidth, 0);
-			pango_cairo_update_context (cr, context);
-		}
+		gdip_pango_rotate_vertical (cr, fmt, FrameWidth, FrameHeight);
+		pango_cairo_update_context (cr, context);
 		/* only since Pango 1.16 */
 		pango_context_set_base_gravity (context, PANGO_GRAVITY_AUTO);
 		pango_context_set_gravity_hint (context, PANGO_GRAVITY_HINT_LINE);
@@ -523,6 +532,286 @@ gdip_pango_setup_layout (cairo_t *cr, GDIPCONST WCHAR *stringUnicode, int length
 	return layout;
 }
 
+/*
+ * Finished layouts are cached since .NET code usually measures a string and then draws it with the same font, format
+ * and rectangle. The key covers everything the layout depends on: the text, the font description and style, the format,
+ * the rectangle size and the transformation and font options of the cairo context. A layout is taken out of the cache
+ * while it is used, so concurrent callers never share one, and put back by gdip_pango_release_layout.
+ */
+#define LAYOUT_CACHE_SIZE	64
+
+typedef struct {
+	guint			hash;
+	WCHAR			*text;
+	int			length;
+	PangoFontDescription	*description;
+	PangoFontMap		*font_map;
+	int			font_style;
+	float			width;
+	float			height;
+	StringFormatFlags	format_flags;
+	StringAlignment		alignment;
+	StringAlignment		line_alignment;
+	StringTrimming		trimming;
+	HotkeyPrefix		hotkey_prefix;
+	float			first_tab_offset;
+	int			num_tab_stops;
+	float			*tab_stops;
+	cairo_matrix_t		matrix;
+	cairo_font_options_t	*font_options;
+} GpLayoutKey;
+
+typedef struct {
+	GpLayoutKey		key;
+	RectF			box;		/* relative to the layout rectangle */
+	PointF			box_offset;
+	int			*chars_removed;
+	int			chars_removed_length;
+} GpLayoutCacheEntry;
+
+static GMutex layout_cache_mutex;
+/* most recently used first */
+static GQueue layout_cache = G_QUEUE_INIT;
+static GQuark layout_cache_quark = 0;
+
+/* the key borrows the caller's buffers, only the font options are created */
+static BOOL
+gdip_layout_key_init (GpLayoutKey *key, cairo_t *cr, GDIPCONST WCHAR *stringUnicode, int length, GDIPCONST GpFont *font,
+	GDIPCONST RectF *rc, GDIPCONST GpStringFormat *fmt)
+{
+	cairo_font_options_t *options;
+	guint hash = 5381;
+	guint32 width_bits;
+	guint32 height_bits;
+	float width;
+	float height;
+	int i;
+
+	if (length < 0)
+		return FALSE;
+
+	for (i = 0; i < length; i++)
+		hash = hash * 33 + stringUnicode [i];
+
+	key->text = (WCHAR *) stringUnicode;
+	key->length = length;
+	key->description = gdip_get_pango_font_description ((GpFont *) font);
+	key->font_map = font->family->collection->pango_font_map;
+	key->font_style = font->style;
+	key->width = rc->Width;
+	key->height = rc->Height;
+	key->format_flags = fmt->formatFlags;
+	key->alignment = fmt->alignment;
+	key->line_alignment = fmt->lineAlignment;
+	key->trimming = fmt->trimming;
+	key->hotkey_prefix = fmt->hotkeyPrefix;
+	key->first_tab_offset = fmt->firstTabOffset;
+	key->num_tab_stops = fmt->numtabStops;
+	key->tab_stops = fmt->tabStops;
+	cairo_get_matrix (cr, &key->matrix);
+
+	/* the options pango_cairo_update_context uses */
+	key->font_options = cairo_font_options_create ();
+	options = cairo_font_options_create ();
+	cairo_surface_get_font_options (cairo_get_target (cr), key->font_options);
+	cairo_get_font_options (cr, options);
+	cairo_font_options_merge (key->font_options, options);
+	cairo_font_options_destroy (options);
+
+	hash ^= pango_font_description_hash (key->description);
+	hash ^= cairo_font_options_hash (key->font_options) * 31;
+	/* the sizes are hashed through their bits, converting them to an integer overflows; adding 0 turns -0 into 0 */
+	width = rc->Width + 0.0f;
+	height = rc->Height + 0.0f;
+	memcpy (&width_bits, &width, sizeof (width_bits));
+	memcpy (&height_bits, &height, sizeof (height_bits));
+	hash ^= (width_bits * 7) ^ (height_bits * 13) ^ (fmt->formatFlags << 8);
+	key->hash = hash;
+	return TRUE;
+}
+
+static BOOL
+gdip_layout_key_equal (const GpLayoutKey *a, const GpLayoutKey *b)
+{
+	return a->hash == b->hash && a->length == b->length && a->font_map == b->font_map && a->font_style == b->font_style &&
+		a->width == b->width && a->height == b->height && a->format_flags == b->format_flags &&
+		a->alignment == b->alignment && a->line_alignment == b->line_alignment && a->trimming == b->trimming &&
+		a->hotkey_prefix == b->hotkey_prefix && a->first_tab_offset == b->first_tab_offset &&
+		a->num_tab_stops == b->num_tab_stops &&
+		memcmp (a->text, b->text, a->length * sizeof (WCHAR)) == 0 &&
+		(a->num_tab_stops == 0 || memcmp (a->tab_stops, b->tab_stops, a->num_tab_stops * sizeof (float)) == 0) &&
+		memcmp (&a->matrix, &b->matrix, sizeof (cairo_matrix_t)) == 0 &&
+		pango_font_description_equal (a->description, b->description) &&
+		cairo_font_options_equal (a->font_options, b->font_options);
+}
+
+static void
+gdip_layout_cache_entry_free (gpointer data)
+{
+	GpLayoutCacheEntry *entry = (GpLayoutCacheEntry *) data;
+
+	GdipFree (entry->key.text);
+	GdipFree (entry->key.tab_stops);
+	pango_font_description_free (entry->key.description);
+	cairo_font_options_destroy (entry->key.font_options);
+	GdipFree (entry->chars_removed);
+	GdipFree (entry);
+}
+
+/* makes the borrowed key owned by a new cache entry, or returns NULL */
+static GpLayoutCacheEntry *
+gdip_layout_cache_entry_new (const GpLayoutKey *key, const RectF *box, const PointF *box_offset, int *chars_removed,
+	int chars_removed_length)
+{
+	GpLayoutCacheEntry *entry = (GpLayoutCacheEntry *) gdip_calloc (1, sizeof (GpLayoutCacheEntry));
+	if (!entry)
+		return NULL;
+
+	entry->key = *key;
+	entry->key.text = GdipAlloc (key->length * sizeof (WCHAR) + 1);
+	entry->key.tab_stops = key->num_tab_stops > 0 ? GdipAlloc (key->num_tab_stops * sizeof (float)) : NULL;
+	entry->chars_removed = chars_removed_length > 0 ? GdipAlloc (chars_removed_length * sizeof (int)) : NULL;
+	entry->key.description = pango_font_description_copy (key->description);
+	entry->key.font_options = cairo_font_options_copy (key->font_options);
+	if (!entry->key.text || (key->num_tab_stops > 0 && !entry->key.tab_stops) ||
+		(chars_removed_length > 0 && !entry->chars_removed)) {
+		gdip_layout_cache_entry_free (entry);
+		return NULL;
+	}
+
+	memcpy (entry->key.text, key->text, key->length * sizeof (WCHAR));
+	if (key->num_tab_stops > 0)
+		memcpy (entry->key.tab_stops, key->tab_stops, key->num_tab_stops * sizeof (float));
+	if (chars_removed_length > 0)
+		memcpy (entry->chars_removed, chars_removed, chars_removed_length * sizeof (int));
+	entry->chars_removed_length = chars_removed_length;
+	entry->box = *box;
+	entry->box_offset = *box_offset;
+	return entry;
+}
+
+/* takes the layout matching the key out of the cache */
+static PangoLayout *
+gdip_layout_cache_take (const GpLayoutKey *key)
+{
+	PangoLayout *layout = NULL;
+	GList *item;
+
+	g_mutex_lock (&layout_cache_mutex);
+	for (item = layout_cache.head; item; item = item->next) {
+		GpLayoutCacheEntry *entry = g_object_get_qdata (G_OBJECT (item->data), layout_cache_quark);
+		if (gdip_layout_key_equal (key, &entry->key)) {
+			layout = (PangoLayout *) item->data;
+			g_queue_delete_link (&layout_cache, item);
+			break;
+		}
+	}
+	g_mutex_unlock (&layout_cache_mutex);
+
+	return layout;
+}
+
+void
+gdip_pango_release_layout (PangoLayout *layout)
+{
+	if (!layout_cache_quark || !g_object_get_qdata (G_OBJECT (layout), layout_cache_quark)) {
+		g_object_unref (layout);
+		return;
+	}
+
+	g_mutex_lock (&layout_cache_mutex);
+	g_queue_push_head (&layout_cache, layout);
+	if (layout_cache.length > LAYOUT_CACHE_SIZE)
+		g_object_unref (g_queue_pop_tail (&layout_cache));
+	g_mutex_unlock (&layout_cache_mutex);
+}
+
+void
+gdip_pango_clear_layout_cache (void)
+{
+	g_mutex_lock (&layout_cache_mutex);
+	while (!g_queue_is_empty (&layout_cache))
+		g_object_unref (g_queue_pop_head (&layout_cache));
+	g_mutex_unlock (&layout_cache_mutex);
+}
+
+PangoLayout*
+gdip_pango_setup_layout (cairo_t *cr, GDIPCONST WCHAR *stringUnicode, int length, GDIPCONST GpFont *font,
+	GDIPCONST RectF *rc, RectF *box, PointF *box_offset, GDIPCONST GpStringFormat *format, int **charsRemoved)
+{
+	GpStringFormat *fmt;
+	GpLayoutCacheEntry *entry;
+	PangoLayout *layout;
+	GpLayoutKey key;
+	int *removed = NULL;
+	int removed_length = 0;
+
+	/* a NULL format is valid, it means get the generic default values */
+	if (!format) {
+		if (GdipStringFormatGetGenericDefault (&fmt) != Ok)
+			return NULL;
+	} else {
+		fmt = (GpStringFormat *) format;
+	}
+
+	if (!gdip_layout_key_init (&key, cr, stringUnicode, length, font, rc, fmt))
+		return gdip_pango_create_layout (cr, stringUnicode, length, font, rc, box, box_offset, format, charsRemoved, NULL);
+
+	if (!layout_cache_quark)
+		layout_cache_quark = g_quark_from_static_string ("gdip-layout-cache");
+
+	layout = gdip_layout_cache_take (&key);
+	if (layout) {
+		entry = g_object_get_qdata (G_OBJECT (layout), layout_cache_quark);
+		cairo_font_options_destroy (key.font_options);
+
+		if (charsRemoved) {
+			*charsRemoved = GdipAlloc (sizeof (int) * max (entry->chars_removed_length, 1));
+			if (!*charsRemoved) {
+				gdip_pango_release_layout (layout);
+				return NULL;
+			}
+			if (entry->chars_removed_length > 0)
+				memcpy (*charsRemoved, entry->chars_removed, sizeof (int) * entry->chars_removed_length);
+		}
+
+#ifdef PANGO_VERSION_CHECK
+#if PANGO_VERSION_CHECK(1,16,0)
+		if (fmt->formatFlags & StringFormatFlagsDirectionVertical) {
+			gdip_pango_rotate_vertical (cr, fmt, MAKE_SAFE_FOR_PANGO (SAFE_FLOAT_TO_UINT32 (rc->Height)),
+				MAKE_SAFE_FOR_PANGO (SAFE_FLOAT_TO_UINT32 (rc->Width)));
+		}
+#endif
+#endif
+
+		*box = entry->box;
+		box->X += rc->X;
+		box->Y += rc->Y;
+		*box_offset = entry->box_offset;
+		pango_cairo_update_layout (cr, layout);
+		return layout;
+	}
+
+	/* the cached entry needs the removed characters even if this caller doesn't */
+	layout = gdip_pango_create_layout (cr, stringUnicode, length, font, rc, box, box_offset, format, &removed, &removed_length);
+	if (layout) {
+		RectF relative = *box;
+
+		relative.X -= rc->X;
+		relative.Y -= rc->Y;
+		entry = gdip_layout_cache_entry_new (&key, &relative, box_offset, removed, removed_length);
+		if (entry)
+			g_object_set_qdata_full (G_OBJECT (layout), layout_cache_quark, entry, gdip_layout_cache_entry_free);
+	}
+	cairo_font_options_destroy (key.font_options);
+
+	if (charsRemoved)
+		*charsRemoved = removed;
+	else
+		GdipFree (removed);
+	return layout;
+}
+
 GpStatus
 pango_DrawString (GpGraphics *graphics, GDIPCONST WCHAR *stringUnicode, INT length, GDIPCONST GpFont *font, GDIPCONST RectF *rc,
 	GDIPCONST GpStringFormat *format, GpBrush *brush)
@@ -557,7 +846,7 @@ pango_DrawString (GpGraphics *graphics, GDIPCONST WCHAR *stringUnicode, INT leng
 	gdip_cairo_move_to (graphics, rc->X + box_offset.X, rc->Y + box_offset.Y, FALSE, TRUE);
 	pango_cairo_show_layout (graphics->ct, layout);
 
-	g_object_unref (layout);
+	gdip_pango_release_layout (layout);
 	cairo_restore (graphics->ct);
 	return Ok;
 }
@@ -666,7 +955,7 @@ pango_MeasureString (GpGraphics *graphics, GDIPCONST WCHAR *stringUnicode, INT l
 
 	GdipFree (charsRemoved);
 
-	g_object_unref (layout);
+	gdip_pango_release_layout (layout);
 	cairo_restore (graphics->ct);
 	return Ok;
 }
@@ -765,7 +1054,7 @@ pango_MeasureCharacterRanges (GpGraphics *graphics, GDIPCONST WCHAR *stringUnico
 	}
 
 cleanup:
-	g_object_unref (layout);
+	gdip_pango_release_layout (layout);
 	cairo_restore (graphics->ct);
 	return status;
 }
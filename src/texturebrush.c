@@ -430,7 +430,6 @@ gdip_texture_setup (GpGraphics *graphics, GpBrush *brush)
 	GpTexture	*texture;
 	GpImage		*img;
 	GpStatus	status = Ok;
-	BOOL		dispose_bitmap;
 
 	if (!graphics || !brush || !graphics->ct)
 		return InvalidParameter;
@@ -445,15 +444,12 @@ gdip_texture_setup (GpGraphics *graphics, GpBrush *brush)
 
 	if (gdip_is_an_indexed_pixelformat (img->active_bitmap->pixel_format)) {
 		/* Unable to create a surface for the bitmap; it is an indexed image.
-		 * Instead, it will first be converted to 32-bit RGB. */
-		img = gdip_convert_indexed_to_rgb (img);
+		 * Instead, its cached 32-bit RGB expansion is used. */
+		img = gdip_bitmap_get_indexed_rgb (img);
 		if (!img)
 			return OutOfMemory;
 		if (gdip_bitmap_ensure_surface (img) == NULL)
 			return OutOfMemory;
-		dispose_bitmap = TRUE;
-	} else {
-		dispose_bitmap = FALSE;
 	}
 
 	ct = graphics->ct;
@@ -490,10 +486,6 @@ gdip_texture_setup (GpGraphics *graphics, GpBrush *brush)
 		}
 	}
 
-	if (dispose_bitmap) {
-		GdipDisposeImage((GpImage *)img);
-	}
-
 	if ((status != Ok) || (gdip_get_pattern_status(texture->pattern) != Ok)) {
 		return GenericError;
 	}
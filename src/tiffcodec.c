@@ -43,6 +43,8 @@ GUID gdip_tif_image_format_guid = {0xb96b3cb1U, 0x0728U, 0x11d3U, {0x9d, 0x7b, 0
 #include <byteswap.h>
 #endif
 
+#include <unistd.h>
+
 #ifndef TIFFTAG_EXIFIFD
 #define	TIFFTAG_EXIFIFD	34665
 #endif
@@ -167,6 +169,75 @@ gdip_tiff_dummy_unmap (thandle_t clientData, tdata_t base, toff_t size)
 {
 }
 
+/* Client functions over a mapped file, libtiff reads strips and tiles straight from the mapping */
+static tsize_t
+gdip_tiff_memoryread (thandle_t clientData, tdata_t buffer, tsize_t size)
+{
+	MemorySource *source = (MemorySource *) clientData;
+
+	if (size > source->size - source->pos)
+		size = source->size - source->pos;
+
+	memcpy (buffer, source->ptr + source->pos, size);
+	source->pos += size;
+	return size;
+}
+
+static tsize_t
+gdip_tiff_write_none (thandle_t clientData, tdata_t buffer, tsize_t size)
+{
+	return 0;
+}
+
+static toff_t
+gdip_tiff_memoryseek (thandle_t clientData, toff_t offSet, int whence)
+{
+	MemorySource *source = (MemorySource *) clientData;
+	gint64 pos;
+
+	switch (whence) {
+	case SEEK_SET:
+		pos = (gint64) offSet;
+		break;
+	case SEEK_CUR:
+		pos = source->pos + (gint64) offSet;
+		break;
+	case SEEK_END:
+		pos = source->size + (gint64) offSet;
+		break;
+	default:
+		return -1;
+	}
+
+	if (pos < 0 || pos > source->size)
+		return -1;
+
+	source->pos = pos;
+	return pos;
+}
+
+static toff_t
+gdip_tiff_memorysize (thandle_t clientData)
+{
+	return ((MemorySource *) clientData)->size;
+}
+
+static int
+gdip_tiff_memorymap (thandle_t clientData, tdata_t *base, toff_t *size)
+{
+	MemorySource *source = (MemorySource *) clientData;
+
+	*base = source->ptr;
+	*size = source->size;
+	return 1;
+}
+
+static void
+gdip_tiff_memoryunmap (thandle_t clientData, tdata_t base, toff_t size)
+{
+	/* the mapping is owned by image.c */
+}
+
 ImageCodecInfo *
 gdip_getcodecinfo_tiff ()
 {
@@ -945,32 +1016,208 @@ gdip_save_tiff_properties (TIFF *tiff, ActiveBitmapData *bitmap_data, int sample
 	return Ok;
 }
 
-/*TODO Handle TIFF Encoder Parameters*/
+/* The encoder parameters, see gdip_tiff_get_encoder_options */
+typedef struct {
+	guint16	compression;
+	guint32	tile_size;	/* 0 to write strips */
+} TiffEncoderOptions;
+
+static GpStatus
+gdip_tiff_get_encoder_options (GDIPCONST EncoderParameters *params, TiffEncoderOptions *options)
+{
+	const EncoderParameter *param;
+
+	options->compression = COMPRESSION_NONE;
+	options->tile_size = 0;
+
+	if (!params)
+		return Ok;
+
+	param = gdip_find_encoder_parameter (params, &GdipEncoderCompression);
+	if (param && param->Type == EncoderParameterValueTypeLong && param->NumberOfValues > 0) {
+		switch (*(LONG *) param->Value) {
+		case EncoderValueCompressionNone:
+		/* the CCITT schemes are for bilevel images, which aren't written */
+		case EncoderValueCompressionCCITT3:
+		case EncoderValueCompressionCCITT4:
+			options->compression = COMPRESSION_NONE;
+			break;
+		case EncoderValueCompressionLZW:
+			options->compression = COMPRESSION_LZW;
+			break;
+		case EncoderValueCompressionRle:
+		case TiffCompressionPackBits:
+			options->compression = COMPRESSION_PACKBITS;
+			break;
+		case TiffCompressionDeflate:
+			options->compression = COMPRESSION_ADOBE_DEFLATE;
+			break;
+		default:
+			return InvalidParameter;
+		}
+
+		if (!TIFFIsCODECConfigured (options->compression))
+			return NotImplemented;
+	}
+
+	param = gdip_find_encoder_parameter (params, &GdipEncoderTiffTileSize);
+	if (param && param->Type == EncoderParameterValueTypeLong && param->NumberOfValues > 0) {
+		LONG tile_size = *(LONG *) param->Value;
+
+		/* TIFF requires tile dimensions to be multiples of 16 */
+		if (tile_size < 0 || tile_size % 16 != 0)
+			return InvalidParameter;
+		options->tile_size = tile_size;
+	}
+
+	return Ok;
+}
+
+static void
+gdip_tiff_set_compression (TIFF *tiff, TiffEncoderOptions *options)
+{
+	TIFFSetField (tiff, TIFFTAG_COMPRESSION, options->compression);
+	/* differencing the samples helps the dictionary based schemes a lot on photographs */
+	if (options->compression == COMPRESSION_LZW || options->compression == COMPRESSION_ADOBE_DEFLATE)
+		TIFFSetField (tiff, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
+}
+
+/*
+ * Converts count pixels of a bitmap row, starting at x, to RGB or RGBA samples. Bitmaps that are
+ * not stored with 32 bits per pixel are first converted to 32bppARGB into row by the converter.
+ */
+static void
+gdip_tiff_pack_pixels (ActiveBitmapData *bitmap_data, const GdipRowConverter *converter, ARGB *row, int x, int y, int count, int samples_per_pixel, BYTE *dest)
+{
+	const ARGB *src;
+	int i;
+
+	if (converter) {
+		converter->convert (converter, bitmap_data->scan0 + y * bitmap_data->stride, x, (BYTE *) row, 0, count);
+		src = row;
+	} else {
+		src = (const ARGB *) (bitmap_data->scan0 + y * bitmap_data->stride) + x;
+	}
+
+	for (i = 0; i < count; i++) {
+		*dest++ = (src[i] >> 16) & 0xFF;
+		*dest++ = (src[i] >> 8) & 0xFF;
+		*dest++ = src[i] & 0xFF;
+		if (samples_per_pixel == 4)
+			*dest++ = src[i] >> 24;
+	}
+}
+
+static GpStatus
+gdip_save_tiff_strips (TIFF *tiff, ActiveBitmapData *bitmap_data, const GdipRowConverter *converter, ARGB *row, int samples_per_pixel)
+{
+	unsigned long long int size;
+	BYTE *pixbuf;
+	int y;
+
+	size = (unsigned long long int) bitmap_data->width * samples_per_pixel;
+	if (size > G_MAXINT32)
+		return OutOfMemory;
+
+	pixbuf = GdipAlloc (size);
+	if (!pixbuf)
+		return OutOfMemory;
+
+	for (y = 0; y < bitmap_data->height; y++) {
+		gdip_tiff_pack_pixels (bitmap_data, converter, row, 0, y, bitmap_data->width, samples_per_pixel, pixbuf);
+		if (TIFFWriteScanline (tiff, pixbuf, y, 0) < 0) {
+			GdipFree (pixbuf);
+			return GenericError;
+		}
+	}
+
+	GdipFree (pixbuf);
+	return Ok;
+}
+
+static GpStatus
+gdip_save_tiff_tiles (TIFF *tiff, ActiveBitmapData *bitmap_data, const GdipRowConverter *converter, ARGB *row, int samples_per_pixel, int tile_size)
+{
+	tsize_t tile_bytes = TIFFTileSize (tiff);
+	BYTE *tile;
+	int x, y, r;
+
+	if (tile_bytes <= 0)
+		return OutOfMemory;
+
+	tile = GdipAlloc (tile_bytes);
+	if (!tile)
+		return OutOfMemory;
+
+	for (y = 0; y < bitmap_data->height; y += tile_size) {
+		for (x = 0; x < bitmap_data->width; x += tile_size) {
+			int rows = MIN (tile_size, bitmap_data->height - y);
+			int columns = MIN (tile_size, bitmap_data->width - x);
+
+			/* the parts of the edge tiles outside of the image are padding */
+			memset (tile, 0, tile_bytes);
+			for (r = 0; r < rows; r++)
+				gdip_tiff_pack_pixels (bitmap_data, converter, row, x, y + r, columns, samples_per_pixel, tile + r * tile_size * samples_per_pixel);
+
+			if (TIFFWriteEncodedTile (tiff, TIFFComputeTile (tiff, x, y, 0, 0), tile, tile_bytes) < 0) {
+				GdipFree (tile);
+				return GenericError;
+			}
+		}
+	}
+
+	GdipFree (tile);
+	return Ok;
+}
+
+/* The formats whose pixels are stored as 32 bit ARGB values and can be packed directly */
+static BOOL
+gdip_tiff_is_argb_storage (ActiveBitmapData *bitmap_data)
+{
+	switch (bitmap_data->pixel_format) {
+	case PixelFormat32bppARGB:
+	case PixelFormat32bppPARGB:
+	case PixelFormat32bppRGB:
+		return TRUE;
+	case PixelFormat24bppRGB:
+		return (bitmap_data->reserved & GBD_TRUE24BPP) == 0;
+	default:
+		return FALSE;
+	}
+}
+
 static GpStatus 
 gdip_save_tiff_image (TIFF* tiff, GpImage *image, GDIPCONST EncoderParameters *params)
 {
 	int		frame;
-	int		x;
-	int		y;
 	int		i;
 	int		num_of_pages;
 	int		page;
 	ActiveBitmapData	*bitmap_data;
-	BYTE		*pixbuf;
 	int		samples_per_pixel;
 	int		bits_per_sample;
-	unsigned long long int size;
+	TiffEncoderOptions	options;
+	GdipRowConverter	converter;
+	ARGB		*row = NULL;
+	GpStatus	status;
 
 	if (tiff == NULL) {
 		return InvalidParameter;
 	}
 
+	status = gdip_tiff_get_encoder_options (params, &options);
+	if (status != Ok) {
+		TIFFClose (tiff);
+		return status;
+	}
+
 	/* Count all pages, we need to know ahead */
 	num_of_pages = 0;
 	for (frame = 0; frame < image->num_of_frames; frame++) {
 		num_of_pages += image->frames[frame].count;
 		for (i = 0; i < image->frames[frame].count; i++) {
 			if (gdip_is_an_indexed_pixelformat (image->frames[frame].bitmap[i].pixel_format)) {
+				TIFFClose (tiff);
 				return NotImplemented; /* FIXME? */
 			}
 		}
@@ -990,6 +1237,24 @@ gdip_save_tiff_image (TIFF* tiff, GpImage *image, GDIPCONST EncoderParameters *p
 				TIFFSetField (tiff, TIFFTAG_PAGENUMBER, page, num_of_pages);
 			}
 
+			/* 16, 48 and 64bpp bitmaps are saved with 8 bits per sample, like the other formats */
+			if (!gdip_tiff_is_argb_storage (bitmap_data)) {
+				ActiveBitmapData	argb;
+
+				memset (&argb, 0, sizeof (ActiveBitmapData));
+				argb.pixel_format = PixelFormat32bppARGB;
+				if (!gdip_row_converter_init (&converter, bitmap_data, &argb)) {
+					status = NotImplemented;
+					goto error;
+				}
+
+				row = GdipAlloc ((unsigned long long int) bitmap_data->width * sizeof (ARGB));
+				if (!row) {
+					status = OutOfMemory;
+					goto error;
+				}
+			}
+
 			if (((bitmap_data->pixel_format & PixelFormatAlpha) != 0) || (bitmap_data->pixel_format == PixelFormat32bppRGB)) {
 				samples_per_pixel = 4;
 				bits_per_sample = 8;
@@ -1003,55 +1268,29 @@ gdip_save_tiff_image (TIFF* tiff, GpImage *image, GDIPCONST EncoderParameters *p
 			TIFFSetField (tiff, TIFFTAG_IMAGEWIDTH, bitmap_data->width);
 			TIFFSetField (tiff, TIFFTAG_IMAGELENGTH, bitmap_data->height);
 			TIFFSetField (tiff, TIFFTAG_BITSPERSAMPLE, bits_per_sample);
-			TIFFSetField (tiff, TIFFTAG_COMPRESSION, COMPRESSION_NONE);
+			gdip_tiff_set_compression (tiff, &options);
 			TIFFSetField (tiff, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
 			TIFFSetField (tiff, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
-			TIFFSetField (tiff, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize (tiff, bitmap_data->stride));
+			if (options.tile_size) {
+				TIFFSetField (tiff, TIFFTAG_TILEWIDTH, options.tile_size);
+				TIFFSetField (tiff, TIFFTAG_TILELENGTH, options.tile_size);
+			} else {
+				/* strips of about 8K, which keeps them small enough to be decoded in parallel */
+				TIFFSetField (tiff, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize (tiff, 0));
+			}
 			TIFFSetField (tiff, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
 
-			size = (unsigned long long int)bitmap_data->width * samples_per_pixel;
-			if (size > G_MAXINT32) {
-				goto error;
+			if (options.tile_size)
+				status = gdip_save_tiff_tiles (tiff, bitmap_data, row ? &converter : NULL, row, samples_per_pixel, options.tile_size);
+			else
+				status = gdip_save_tiff_strips (tiff, bitmap_data, row ? &converter : NULL, row, samples_per_pixel);
+			if (row) {
+				GdipFree (row);
+				row = NULL;
 			}
-
-			pixbuf = GdipAlloc (size);
-			if (pixbuf == NULL) {
+			if (status != Ok)
 				goto error;
-			}
-			if (samples_per_pixel == 4) {
-				for (y = 0; y < bitmap_data->height; y++) {
-					for (x = 0; x < bitmap_data->width; x++) {
-#ifdef WORDS_BIGENDIAN
-						pixbuf[x*4+0] = *((BYTE*)bitmap_data->scan0 + (bitmap_data->stride * y) + (x*4) + 1);
-						pixbuf[x*4+1] = *((BYTE*)bitmap_data->scan0 + (bitmap_data->stride * y) + (x*4) + 2);
-						pixbuf[x*4+2] = *((BYTE*)bitmap_data->scan0 + (bitmap_data->stride * y) + (x*4) + 3);
-						pixbuf[x*4+3] = *((BYTE*)bitmap_data->scan0 + (bitmap_data->stride * y) + (x*4) + 0);
-#else
-						pixbuf[x*4+0] = *((BYTE*)bitmap_data->scan0 + (bitmap_data->stride * y) + (x*4) + 2);
-						pixbuf[x*4+1] = *((BYTE*)bitmap_data->scan0 + (bitmap_data->stride * y) + (x*4) + 1);
-						pixbuf[x*4+2] = *((BYTE*)bitmap_data->scan0 + (bitmap_data->stride * y) + (x*4) + 0);
-						pixbuf[x*4+3] = *((BYTE*)bitmap_data->scan0 + (bitmap_data->stride * y) + (x*4) + 3);
-#endif
-					}
-					TIFFWriteScanline (tiff, pixbuf, y, 0);
-				}
-			} else {
-				for (y = 0; y < bitmap_data->height; y++) {
-					for (x = 0; x < bitmap_data->width; x++) {
-#ifdef WORDS_BIGENDIAN
-						pixbuf[x*3+0] = *((BYTE*)bitmap_data->scan0 + (bitmap_data->stride * y) + (x*4) + 1);
-						pixbuf[x*3+1] = *((BYTE*)bitmap_data->scan0 + (bitmap_data->stride * y) + (x*4) + 2);
-						pixbuf[x*3+2] = *((BYTE*)bitmap_data->scan0 + (bitmap_data->stride * y) + (x*4) + 3);
-#else
-						pixbuf[x*3+0] = *((BYTE*)bitmap_data->scan0 + (bitmap_data->stride * y) + (x*4) + 2);
-						pixbuf[x*3+1] = *((BYTE*)bitmap_data->scan0 + (bitmap_data->stride * y) + (x*4) + 1);
-						pixbuf[x*3+2] = *((BYTE*)bitmap_data->scan0 + (bitmap_data->stride * y) + (x*4) + 0);
-#endif
-					}
-					TIFFWriteScanline (tiff, pixbuf, y, 0);
-				}
-			}
-			GdipFree(pixbuf);
+
 			TIFFWriteDirectory (tiff);
 			page++;
 		}	
@@ -1061,12 +1300,454 @@ gdip_save_tiff_image (TIFF* tiff, GpImage *image, GDIPCONST EncoderParameters *p
 
 error:
 	TIFFClose (tiff);
-	return OutOfMemory;
+	return status;
+}
+
+
+/*
+ * RGB[A] images with 16 bits per sample are kept as 48bpp/64bpp rather than going through
+ * TIFFRGBAImage, which reduces them to 8 bits per sample. Returns FALSE (leaving bitmap_data
+ * untouched) for anything else, in which case the generic path is used.
+ */
+static BOOL
+gdip_load_tiff_wide_page (TIFF *tiff, ActiveBitmapData *bitmap_data)
+{
+	guint16		bits_per_sample, samples_per_pixel, photometric, planar, orientation;
+	guint16		extra_count = 0;
+	guint16		*extra_samples = NULL;
+	guint32		width, height, y;
+	unsigned long long int	size;
+	PixelFormat	format;
+	BYTE		*scan0;
+	int		stride;
+
+	if (!TIFFGetField (tiff, TIFFTAG_BITSPERSAMPLE, &bits_per_sample) || bits_per_sample != 16)
+		return FALSE;
+	if (!TIFFGetField (tiff, TIFFTAG_PHOTOMETRIC, &photometric) || photometric != PHOTOMETRIC_RGB)
+		return FALSE;
+	if (!TIFFGetFieldDefaulted (tiff, TIFFTAG_PLANARCONFIG, &planar) || planar != PLANARCONFIG_CONTIG)
+		return FALSE;
+	if (TIFFGetField (tiff, TIFFTAG_ORIENTATION, &orientation) && orientation != ORIENTATION_TOPLEFT)
+		return FALSE;
+	if (TIFFIsTiled (tiff))
+		return FALSE;
+	if (!TIFFGetField (tiff, TIFFTAG_SAMPLESPERPIXEL, &samples_per_pixel))
+		return FALSE;
+	if (!TIFFGetField (tiff, TIFFTAG_IMAGEWIDTH, &width) || !TIFFGetField (tiff, TIFFTAG_IMAGELENGTH, &height))
+		return FALSE;
+
+	TIFFGetField (tiff, TIFFTAG_EXTRASAMPLES, &extra_count, &extra_samples);
+
+	if (samples_per_pixel == 3) {
+		format = PixelFormat48bppRGB;
+	} else if (samples_per_pixel == 4 && extra_count == 1 && extra_samples) {
+		format = (extra_samples[0] == EXTRASAMPLE_ASSOCALPHA) ? PixelFormat64bppPARGB : PixelFormat64bppARGB;
+	} else {
+		return FALSE;
+	}
+
+	size = (unsigned long long int) width * samples_per_pixel * sizeof (guint16);
+	if (size > G_MAXINT32 || TIFFScanlineSize (tiff) != (tsize_t) size)
+		return FALSE;
+	stride = size;
+	gdip_align_stride (stride);
+
+	size = (unsigned long long int) stride * height;
+	if (size > G_MAXINT32)
+		return FALSE;
+	scan0 = GdipAlloc (size);
+	if (!scan0)
+		return FALSE;
+
+	/* libtiff hands out the samples in host byte order, only red and blue need to be swapped */
+	for (y = 0; y < height; y++) {
+		guint16 *row = (guint16 *) (scan0 + y * stride);
+		guint32 x;
+
+		if (TIFFReadScanline (tiff, row, y, 0) < 0) {
+			GdipFree (scan0);
+			return FALSE;
+		}
+
+		for (x = 0; x < width; x++, row += samples_per_pixel) {
+			guint16 red = row[0];
+			row[0] = row[2];
+			row[2] = red;
+		}
+	}
+
+	bitmap_data->pixel_format = format;
+	bitmap_data->width = width;
+	bitmap_data->height = height;
+	bitmap_data->stride = stride;
+	bitmap_data->scan0 = scan0;
+	bitmap_data->reserved = GBD_OWN_SCAN0;
+	bitmap_data->image_flags |= ImageFlagsColorSpaceRGB | ImageFlagsHasRealPixelSize | ImageFlagsReadOnly;
+	if (samples_per_pixel == 4)
+		bitmap_data->image_flags |= ImageFlagsHasAlpha;
+	else
+		bitmap_data->image_flags &= ~ImageFlagsHasAlpha;
+
+	return TRUE;
+}
+
+/* Decodes the strips or tiles of a page on several threads, each with its own TIFF handle over the mapping */
+typedef struct {
+	MemorySource		*memory;
+	int			page;
+	guint32			width;
+	guint32			height;
+	BYTE			*scan0;
+	int			stride;
+	guint16			samples_per_pixel;
+	guint16			alpha;
+	BOOL			tiled;
+	guint32			chunk_width;
+	guint32			chunk_height;
+	guint32			chunks_across;
+	tsize_t			chunk_size;
+	gint			failed;
+} TiffPageDecoder;
+
+static TIFF*
+gdip_tiff_memory_open (MemorySource *source)
+{
+	return TIFFClientOpen ("<stream>", "r", (thandle_t) source, gdip_tiff_memoryread,
+				gdip_tiff_write_none, gdip_tiff_memoryseek, gdip_tiff_fileclose,
+				gdip_tiff_memorysize, gdip_tiff_memorymap, gdip_tiff_memoryunmap);
+}
+
+/* Stores decoded samples the way TIFFRGBAImage would, i.e. with premultiplied alpha */
+static void
+gdip_tiff_unpack_pixels (TiffPageDecoder *decoder, const BYTE *src, ARGB *dest, guint32 count)
+{
+	guint32 i;
+
+	switch (decoder->samples_per_pixel) {
+	case 1:
+		for (i = 0; i < count; i++, src++)
+			dest[i] = 0xFF000000 | (src[0] << 16) | (src[0] << 8) | src[0];
+		break;
+	case 3:
+		for (i = 0; i < count; i++, src += 3)
+			dest[i] = 0xFF000000 | (src[0] << 16) | (src[1] << 8) | src[2];
+		break;
+	default:
+		for (i = 0; i < count; i++, src += 4) {
+			ARGB a = src[3];
+
+			switch (decoder->alpha) {
+			case EXTRASAMPLE_UNASSALPHA:
+				dest[i] = (a << 24) | (((src[0] * a + 127) / 255) << 16) | (((src[1] * a + 127) / 255) << 8) | ((src[2] * a + 127) / 255);
+				break;
+			case EXTRASAMPLE_UNSPECIFIED:
+				dest[i] = 0xFF000000 | (src[0] << 16) | (src[1] << 8) | src[2];
+				break;
+			default:
+				dest[i] = (a << 24) | (src[0] << 16) | (src[1] << 8) | src[2];
+				break;
+			}
+		}
+		break;
+	}
+}
+
+static void
+gdip_tiff_decode_chunks (int first, int last, void *user_data)
+{
+	TiffPageDecoder *decoder = (TiffPageDecoder *) user_data;
+	MemorySource source = *decoder->memory;
+	TIFF *tiff;
+	BYTE *buffer = NULL;
+	int chunk;
+
+	source.pos = 0;
+	tiff = gdip_tiff_memory_open (&source);
+	if (!tiff || !TIFFSetDirectory (tiff, decoder->page))
+		goto error;
+
+	buffer = GdipAlloc (decoder->chunk_size);
+	if (!buffer)
+		goto error;
+
+	for (chunk = first; chunk < last && !g_atomic_int_get (&decoder->failed); chunk++) {
+		guint32 x = (chunk % decoder->chunks_across) * decoder->chunk_width;
+		guint32 y = (chunk / decoder->chunks_across) * decoder->chunk_height;
+		guint32 columns = MIN (decoder->chunk_width, decoder->width - x);
+		guint32 rows = MIN (decoder->chunk_height, decoder->height - y);
+		tsize_t row_size = (tsize_t) decoder->chunk_width * decoder->samples_per_pixel;
+		tsize_t needed = (tsize_t) (rows - 1) * row_size + (tsize_t) columns * decoder->samples_per_pixel;
+		tsize_t read;
+		guint32 row;
+
+		if (decoder->tiled)
+			read = TIFFReadEncodedTile (tiff, chunk, buffer, decoder->chunk_size);
+		else
+			read = TIFFReadEncodedStrip (tiff, chunk, buffer, decoder->chunk_size);
+		if (read < needed)
+			goto error;
+
+		for (row = 0; row < rows; row++)
+			gdip_tiff_unpack_pixels (decoder, buffer + row * row_size, (ARGB *) (decoder->scan0 + (y + row) * decoder->stride) + x, columns);
+	}
+
+	GdipFree (buffer);
+	TIFFClose (tiff);
+	return;
+
+error:
+	g_atomic_int_set (&decoder->failed, 1);
+	GdipFree (buffer);
+	if (tiff)
+		TIFFClose (tiff);
+}
+
+/*
+ * 8 bits RGB(A) and greyscale pages of a mapped file can be decoded straight from their strips or tiles.
+ * Sets up @decoder for such a page, without decoding anything, or returns FALSE for anything else.
+ */
+static BOOL
+gdip_tiff_page_decoder_init (TIFF *tiff, MemorySource *memory, int page, TiffPageDecoder *decoder)
+{
+	guint16		bits_per_sample, samples_per_pixel, photometric, planar, orientation;
+	guint16		extra_count = 0;
+	guint16		*extra_samples = NULL;
+	guint32		width, height, chunks;
+
+	if (!TIFFGetFieldDefaulted (tiff, TIFFTAG_BITSPERSAMPLE, &bits_per_sample) || bits_per_sample != 8)
+		return FALSE;
+	if (!TIFFGetFieldDefaulted (tiff, TIFFTAG_SAMPLESPERPIXEL, &samples_per_pixel))
+		return FALSE;
+	if (!TIFFGetField (tiff, TIFFTAG_PHOTOMETRIC, &photometric))
+		return FALSE;
+	if (!TIFFGetFieldDefaulted (tiff, TIFFTAG_PLANARCONFIG, &planar) || planar != PLANARCONFIG_CONTIG)
+		return FALSE;
+	if (TIFFGetField (tiff, TIFFTAG_ORIENTATION, &orientation) && orientation != ORIENTATION_TOPLEFT)
+		return FALSE;
+	if (!TIFFGetField (tiff, TIFFTAG_IMAGEWIDTH, &width) || !TIFFGetField (tiff, TIFFTAG_IMAGELENGTH, &height))
+		return FALSE;
+	if (!(photometric == PHOTOMETRIC_RGB && (samples_per_pixel == 3 || samples_per_pixel == 4)) &&
+	    !(photometric == PHOTOMETRIC_MINISBLACK && samples_per_pixel == 1))
+		return FALSE;
+
+	memset (decoder, 0, sizeof (TiffPageDecoder));
+	decoder->memory = memory;
+	decoder->page = page;
+	decoder->width = width;
+	decoder->height = height;
+	decoder->samples_per_pixel = samples_per_pixel;
+
+	/* like TIFFRGBAImage, a fourth sample without any description is taken as associated alpha */
+	decoder->alpha = EXTRASAMPLE_ASSOCALPHA;
+	if (samples_per_pixel == 4 && TIFFGetField (tiff, TIFFTAG_EXTRASAMPLES, &extra_count, &extra_samples) && extra_count > 0) {
+		if (extra_count != 1)
+			return FALSE;
+		decoder->alpha = extra_samples[0];
+	}
+
+	decoder->tiled = TIFFIsTiled (tiff);
+	if (decoder->tiled) {
+		if (!TIFFGetField (tiff, TIFFTAG_TILEWIDTH, &decoder->chunk_width) || !TIFFGetField (tiff, TIFFTAG_TILELENGTH, &decoder->chunk_height))
+			return FALSE;
+		decoder->chunk_size = TIFFTileSize (tiff);
+		chunks = TIFFNumberOfTiles (tiff);
+	} else {
+		decoder->chunk_width = width;
+		if (!TIFFGetFieldDefaulted (tiff, TIFFTAG_ROWSPERSTRIP, &decoder->chunk_height))
+			return FALSE;
+		decoder->chunk_height = MIN (decoder->chunk_height, height);
+		decoder->chunk_size = TIFFStripSize (tiff);
+		chunks = TIFFNumberOfStrips (tiff);
+	}
+	if (decoder->chunk_width == 0 || decoder->chunk_height == 0 || decoder->chunk_size <= 0)
+		return FALSE;
+	decoder->chunks_across = (width + decoder->chunk_width - 1) / decoder->chunk_width;
+	if ((unsigned long long int) decoder->chunks_across * ((height + decoder->chunk_height - 1) / decoder->chunk_height) != chunks)
+		return FALSE;
+
+	return TRUE;
 }
 
+/*
+ * Decodes a page set up by gdip_tiff_page_decoder_init, spread over several threads for large pages.
+ * Returns FALSE (leaving bitmap_data untouched) when a strip or tile can't be decoded, in which case
+ * the generic path is used.
+ */
+static BOOL
+gdip_load_tiff_page_in_parallel (TiffPageDecoder *decoder, ActiveBitmapData *bitmap_data)
+{
+	unsigned long long int	size;
+	guint32		chunks;
+
+	size = (unsigned long long int) decoder->width * sizeof (ARGB);
+	if (size > G_MAXINT32)
+		return FALSE;
+	size *= decoder->height;
+	if (size > G_MAXINT32)
+		return FALSE;
+	decoder->stride = decoder->width * sizeof (ARGB);
+	decoder->scan0 = GdipAlloc (size);
+	if (!decoder->scan0)
+		return FALSE;
+
+	chunks = decoder->chunks_across * ((decoder->height + decoder->chunk_height - 1) / decoder->chunk_height);
+	gdip_process_row_bands (chunks, decoder->chunk_size, gdip_tiff_decode_chunks, decoder);
+
+	if (decoder->failed) {
+		GdipFree (decoder->scan0);
+		return FALSE;
+	}
+
+	bitmap_data->width = decoder->width;
+	bitmap_data->height = decoder->height;
+	bitmap_data->stride = decoder->stride;
+	bitmap_data->scan0 = decoder->scan0;
+	bitmap_data->reserved = GBD_OWN_SCAN0;
+	bitmap_data->image_flags |= ImageFlagsColorSpaceRGB | ImageFlagsHasRealPixelSize | ImageFlagsReadOnly;
+	return TRUE;
+}
 
+/*
+ * Decodes only the strips or tiles of a page, set up by gdip_tiff_page_decoder_init, that intersect @rect
+ * and stores that part of the page in @scan0, see GpDeferredLoadRegionFunc.
+ */
+static GpStatus
+gdip_tiff_decode_region (TiffPageDecoder *decoder, const GpRect *rect, BYTE *scan0, int stride)
+{
+	MemorySource	source = *decoder->memory;
+	TIFF		*tiff;
+	BYTE		*buffer;
+	tsize_t		row_size = (tsize_t) decoder->chunk_width * decoder->samples_per_pixel;
+	guint32		first_column, last_column, first_row, last_row, column, row;
+	GpStatus	status = Ok;
+
+	if (rect->X + rect->Width > decoder->width || rect->Y + rect->Height > decoder->height)
+		return InvalidParameter;
+
+	source.pos = 0;
+	tiff = gdip_tiff_memory_open (&source);
+	if (!tiff)
+		return OutOfMemory;
+	if (!TIFFSetDirectory (tiff, decoder->page)) {
+		TIFFClose (tiff);
+		return OutOfMemory;
+	}
+
+	buffer = GdipAlloc (decoder->chunk_size);
+	if (!buffer) {
+		TIFFClose (tiff);
+		return OutOfMemory;
+	}
+
+	first_column = rect->X / decoder->chunk_width;
+	last_column = (rect->X + rect->Width - 1) / decoder->chunk_width;
+	first_row = rect->Y / decoder->chunk_height;
+	last_row = (rect->Y + rect->Height - 1) / decoder->chunk_height;
+
+	for (row = first_row; row <= last_row && status == Ok; row++) {
+		for (column = first_column; column <= last_column; column++) {
+			guint32 chunk = row * decoder->chunks_across + column;
+			guint32 chunk_x = column * decoder->chunk_width;
+			guint32 chunk_y = row * decoder->chunk_height;
+			/* the part of the strip or tile inside rect */
+			guint32 x0 = MAX (chunk_x, rect->X);
+			guint32 x1 = MIN (MIN (chunk_x + decoder->chunk_width, decoder->width), rect->X + rect->Width);
+			guint32 y0 = MAX (chunk_y, rect->Y);
+			guint32 y1 = MIN (MIN (chunk_y + decoder->chunk_height, decoder->height), rect->Y + rect->Height);
+			/* the rows below rect aren't needed, libtiff can stop decoding before them */
+			tsize_t size = MIN (decoder->chunk_size, (tsize_t) (y1 - chunk_y) * row_size);
+			tsize_t needed = (tsize_t) (y1 - chunk_y - 1) * row_size + (tsize_t) (x1 - chunk_x) * decoder->samples_per_pixel;
+			tsize_t read;
+			guint32 y;
+
+			if (decoder->tiled)
+				read = TIFFReadEncodedTile (tiff, chunk, buffer, size);
+			else
+				read = TIFFReadEncodedStrip (tiff, chunk, buffer, size);
+			if (read < needed) {
+				status = OutOfMemory;
+				break;
+			}
+
+			for (y = y0; y < y1; y++) {
+				gdip_tiff_unpack_pixels (decoder, buffer + (y - chunk_y) * row_size + (x0 - chunk_x) * decoder->samples_per_pixel,
+					(ARGB *) (scan0 + (y - rect->Y) * stride) + (x0 - rect->X), x1 - x0);
+			}
+		}
+	}
+
+	GdipFree (buffer);
+	TIFFClose (tiff);
+	return status;
+}
+
+/*
+ * The only page of a mapped file, its pixels are decoded on first use, or only partly by read only locks. The
+ * file is kept open and mapped again for each decode, the mapping it was loaded from may be stale by then.
+ */
+typedef struct {
+	int		fd;
+	TiffPageDecoder	decoder;
+} TiffDeferredSource;
+
+static GpStatus gdip_load_tiff_image (TIFF *tiff, MemorySource *memory, GpFileMapping *mapping, GpImage **image);
+
+static GpStatus
+gdip_tiff_deferred_load (void *source, UINT minWidth, UINT minHeight, GpImage **image)
+{
+	TiffDeferredSource *deferred = (TiffDeferredSource *) source;
+	GpFileMapping *mapping;
+	MemorySource memory;
+	GpStatus status;
+
+	mapping = gdip_file_mapping_new_from_fd (deferred->fd);
+	if (!mapping)
+		return OutOfMemory;
+
+	/* the directory is parsed again, which is cheap, the decoding itself is the same as if it was done at load time */
+	memory.ptr = mapping->ptr;
+	memory.size = mapping->size;
+	memory.pos = 0;
+	status = gdip_load_tiff_image (gdip_tiff_memory_open (&memory), &memory, NULL, image);
+	gdip_file_mapping_unref (mapping);
+	return status;
+}
+
+static GpStatus
+gdip_tiff_deferred_load_region (void *source, const GpRect *rect, BYTE *scan0, int stride)
+{
+	TiffDeferredSource *deferred = (TiffDeferredSource *) source;
+	TiffPageDecoder decoder = deferred->decoder;
+	GpFileMapping *mapping;
+	MemorySource memory;
+	GpStatus status;
+
+	mapping = gdip_file_mapping_new_from_fd (deferred->fd);
+	if (!mapping)
+		return OutOfMemory;
+
+	/* the layout of the strips or tiles is the one loaded initially, reads past the end of the file fail */
+	memory.ptr = mapping->ptr;
+	memory.size = mapping->size;
+	memory.pos = 0;
+	decoder.memory = &memory;
+	status = gdip_tiff_decode_region (&decoder, rect, scan0, stride);
+	gdip_file_mapping_unref (mapping);
+	return status;
+}
+
+static void
+gdip_tiff_deferred_free (void *source)
+{
+	TiffDeferredSource *deferred = (TiffDeferredSource *) source;
+
+	close (deferred->fd);
+	GdipFree (deferred);
+}
+
+/* With @mapping, which @memory reads, a file with a single page is loaded without its pixels, see TiffDeferredSource */
 static GpStatus 
-gdip_load_tiff_image (TIFF *tiff, GpImage **image)
+gdip_load_tiff_image (TIFF *tiff, MemorySource *memory, GpFileMapping *mapping, GpImage **image)
 {
 	int		i;
 	char		error_message[1024];
@@ -1081,6 +1762,9 @@ gdip_load_tiff_image (TIFF *tiff, GpImage **image)
 	guint32		*pixbuf_ptr;
 	guint16		samples_per_pixel;
 	float		dpi;
+	TiffPageDecoder	decoder;
+	TiffDeferredSource	*deferred;
+	int		fd;
 
 	if (tiff == NULL) {
 		*image = NULL;
@@ -1091,6 +1775,7 @@ gdip_load_tiff_image (TIFF *tiff, GpImage **image)
 	result = NULL;
 	pixbuf_row = NULL;
 	pixbuf = NULL;
+	deferred = NULL;
 	memset (&tiff_image, 0, sizeof (TIFFRGBAImage));
 
 	num_of_pages = TIFFNumberOfDirectories(tiff);
@@ -1151,6 +1836,42 @@ gdip_load_tiff_image (TIFF *tiff, GpImage **image)
 		if (bitmap_data->dpi_horz && bitmap_data->dpi_vert)
 			bitmap_data->image_flags |= ImageFlagsHasRealDPI;
 
+		if (gdip_load_tiff_wide_page (tiff, bitmap_data)) {
+			TIFFRGBAImageEnd (&tiff_image);
+			continue;
+		}
+
+		if (memory && gdip_tiff_page_decoder_init (tiff, memory, page, &decoder)) {
+			/* stride is a (signed) _int_, but the page only has to fit in 2GB once it is decoded as a whole */
+			/* like GDI+ the file is kept open until the pixels are decoded, otherwise they are decoded now */
+			if (mapping && num_of_pages == 1 && (unsigned long long int) decoder.width * sizeof (ARGB) <= G_MAXINT32 &&
+				(fd = dup (mapping->fd)) >= 0) {
+				deferred = GdipAlloc (sizeof (TiffDeferredSource));
+				if (!deferred) {
+					close (fd);
+					goto error;
+				}
+
+				deferred->fd = fd;
+				deferred->decoder = decoder;
+				deferred->decoder.memory = NULL;
+
+				bitmap_data->width = decoder.width;
+				bitmap_data->height = decoder.height;
+				bitmap_data->stride = decoder.width * sizeof (ARGB);
+				bitmap_data->scan0 = NULL;
+				bitmap_data->reserved = 0;
+				bitmap_data->image_flags |= ImageFlagsColorSpaceRGB | ImageFlagsHasRealPixelSize | ImageFlagsReadOnly;
+				TIFFRGBAImageEnd (&tiff_image);
+				continue;
+			}
+
+			if (gdip_load_tiff_page_in_parallel (&decoder, bitmap_data)) {
+				TIFFRGBAImageEnd (&tiff_image);
+				continue;
+			}
+		}
+
 		/* width and height are uint32, but TIFF uses 32 bits offsets (so it's real size limit is 4GB),
 		 * however libtiff uses signed int (int32 not uint32) as offsets so we limit ourselves to 2GB */
 		size = tiff_image.width;
@@ -1209,6 +1930,8 @@ gdip_load_tiff_image (TIFF *tiff, GpImage **image)
 	}
 
 	gdip_bitmap_setactive(result, &gdip_image_frameDimension_page_guid, 0);
+	if (deferred)
+		gdip_bitmap_set_deferred_source (result, gdip_tiff_deferred_load, gdip_tiff_deferred_load_region, gdip_tiff_deferred_free, deferred);
 
 	TIFFClose(tiff);
 
@@ -1225,6 +1948,10 @@ error:
 		GdipFree(pixbuf);
 	}
 
+	if (deferred != NULL) {
+		gdip_tiff_deferred_free (deferred);
+	}
+
 	if (result != NULL) {
 		gdip_bitmap_dispose(result);
 	}
@@ -1243,7 +1970,15 @@ gdip_load_tiff_image_from_file (FILE *fp, GpImage **image)
 	tif = TIFFClientOpen("<stream>", "r", (thandle_t) fp, gdip_tiff_fileread, 
 				gdip_tiff_filewrite, gdip_tiff_fileseek, gdip_tiff_fileclose, 
 				gdip_tiff_filesize, gdip_tiff_filedummy_map, gdip_tiff_filedummy_unmap);
-	return gdip_load_tiff_image (tif, image);
+	return gdip_load_tiff_image (tif, NULL, NULL, image);
+}
+
+GpStatus
+gdip_load_tiff_image_from_mapping (GpFileMapping *mapping, GpImage **image)
+{
+	MemorySource source = { mapping->ptr, mapping->size, 0 };
+
+	return gdip_load_tiff_image (gdip_tiff_memory_open (&source), &source, mapping, image);
 }
 
 GpStatus 
@@ -1280,7 +2015,7 @@ gdip_load_tiff_image_from_stream_delegate (GetBytesDelegate getBytesFunc,
 				gdip_tiff_write, gdip_tiff_seek, gdip_tiff_close, 
 				gdip_tiff_size, gdip_tiff_dummy_map, gdip_tiff_dummy_unmap);
 	
-	return gdip_load_tiff_image (tif, image);
+	return gdip_load_tiff_image (tif, NULL, NULL, image);
 }
 
 GpStatus
@@ -1310,6 +2045,272 @@ gdip_save_tiff_image_to_stream_delegate (GetBytesDelegate getBytesFunc,
 	return gdip_save_tiff_image (tiff, image, params);
 }
 
+/* Rows decoded at once through TIFFRGBAImageGet, the strips or tiles are decoded again for each band */
+#define TIFF_MAX_BAND_ROWS	1024
+
+typedef struct {
+	GpRowReader	parent;
+	TIFF		*tiff;
+	/* 8 bits RGB(A) or greyscale strips are read with TIFFReadScanline, anything else through TIFFRGBAImage */
+	BOOL		scanlines;
+	guint16		samples_per_pixel;
+	TIFFRGBAImage	image;
+	UINT		band_rows;
+	UINT		band_start;
+	UINT		band_count;
+	UINT		row;
+	BYTE		*buffer;
+} TiffRowReader;
+
+static GpStatus
+gdip_tiff_row_reader_read (GpRowReader *reader, ARGB *row)
+{
+	TiffRowReader	*tiff = (TiffRowReader *) reader;
+	UINT		x;
+
+	if (tiff->scanlines) {
+		BYTE *src = tiff->buffer;
+
+		if (TIFFReadScanline (tiff->tiff, tiff->buffer, tiff->row++, 0) < 0)
+			return OutOfMemory;
+
+		switch (tiff->samples_per_pixel) {
+		case 1:
+			for (x = 0; x < reader->width; x++, src++)
+				row[x] = 0xFF000000 | (src[0] << 16) | (src[0] << 8) | src[0];
+			break;
+		case 2:
+			for (x = 0; x < reader->width; x++, src += 2)
+				row[x] = ((ARGB) src[1] << 24) | (src[0] << 16) | (src[0] << 8) | src[0];
+			break;
+		case 3:
+			for (x = 0; x < reader->width; x++, src += 3)
+				row[x] = 0xFF000000 | (src[0] << 16) | (src[1] << 8) | src[2];
+			break;
+		default:
+			for (x = 0; x < reader->width; x++, src += 4)
+				row[x] = ((ARGB) src[3] << 24) | (src[0] << 16) | (src[1] << 8) | src[2];
+			break;
+		}
+	} else {
+		guint32 *src;
+
+		if (tiff->row >= tiff->band_start + tiff->band_count) {
+			tiff->band_start = tiff->row;
+			tiff->band_count = MIN (tiff->band_rows, reader->height - tiff->row);
+			tiff->image.row_offset = tiff->row;
+			tiff->image.col_offset = 0;
+			if (!TIFFRGBAImageGet (&tiff->image, (guint32 *) tiff->buffer, reader->width, tiff->band_count))
+				return OutOfMemory;
+		}
+
+		src = (guint32 *) tiff->buffer + (tiff->row++ - tiff->band_start) * reader->width;
+		for (x = 0; x < reader->width; x++)
+			row[x] = ((ARGB) TIFFGetA (src[x]) << 24) | (TIFFGetR (src[x]) << 16) | (TIFFGetG (src[x]) << 8) | TIFFGetB (src[x]);
+	}
+
+	return Ok;
+}
+
+static void
+gdip_tiff_row_reader_close (GpRowReader *reader)
+{
+	TiffRowReader *tiff = (TiffRowReader *) reader;
+
+	if (!tiff->scanlines)
+		TIFFRGBAImageEnd (&tiff->image);
+	TIFFClose (tiff->tiff);
+	GdipFree (tiff->buffer);
+	GdipFree (tiff);
+}
+
+/* Only the first page is read */
+GpStatus
+gdip_tiff_row_reader_new (FILE *fp, GpRowReader **reader)
+{
+	TiffRowReader	*tiff;
+	char		error_message[1024];
+	guint16		bits_per_sample, photometric, planar, orientation;
+	guint32		width, height, rows;
+	unsigned long long int	size;
+
+	tiff = gdip_calloc (1, sizeof (TiffRowReader));
+	if (!tiff)
+		return OutOfMemory;
+
+	tiff->tiff = TIFFClientOpen ("<stream>", "r", (thandle_t) fp, gdip_tiff_fileread,
+				gdip_tiff_filewrite, gdip_tiff_fileseek, gdip_tiff_fileclose,
+				gdip_tiff_filesize, gdip_tiff_filedummy_map, gdip_tiff_filedummy_unmap);
+	if (!tiff->tiff) {
+		GdipFree (tiff);
+		return OutOfMemory;
+	}
+
+	if (!TIFFGetField (tiff->tiff, TIFFTAG_IMAGEWIDTH, &width) || !TIFFGetField (tiff->tiff, TIFFTAG_IMAGELENGTH, &height))
+		goto error;
+	tiff->parent.width = width;
+	tiff->parent.height = height;
+
+	TIFFGetFieldDefaulted (tiff->tiff, TIFFTAG_BITSPERSAMPLE, &bits_per_sample);
+	TIFFGetFieldDefaulted (tiff->tiff, TIFFTAG_SAMPLESPERPIXEL, &tiff->samples_per_pixel);
+	TIFFGetFieldDefaulted (tiff->tiff, TIFFTAG_PLANARCONFIG, &planar);
+	TIFFGetFieldDefaulted (tiff->tiff, TIFFTAG_ORIENTATION, &orientation);
+	if (!TIFFGetField (tiff->tiff, TIFFTAG_PHOTOMETRIC, &photometric))
+		photometric = PHOTOMETRIC_MINISWHITE;
+
+	tiff->scanlines = !TIFFIsTiled (tiff->tiff) && bits_per_sample == 8 && planar == PLANARCONFIG_CONTIG &&
+		orientation == ORIENTATION_TOPLEFT &&
+		((photometric == PHOTOMETRIC_RGB && (tiff->samples_per_pixel == 3 || tiff->samples_per_pixel == 4)) ||
+		 (photometric == PHOTOMETRIC_MINISBLACK && (tiff->samples_per_pixel == 1 || tiff->samples_per_pixel == 2)));
+
+	if (tiff->scanlines) {
+		tiff->parent.has_alpha = tiff->samples_per_pixel == 2 || tiff->samples_per_pixel == 4;
+		tiff->buffer = GdipAlloc (TIFFScanlineSize (tiff->tiff));
+		if (!tiff->buffer)
+			goto error;
+	} else {
+		if (!TIFFRGBAImageOK (tiff->tiff, error_message) || !TIFFRGBAImageBegin (&tiff->image, tiff->tiff, 0, error_message))
+			goto error;
+
+		tiff->image.req_orientation = ORIENTATION_TOPLEFT;
+		tiff->parent.has_alpha = tiff->image.alpha != 0;
+
+		/* decode whole tiles, or strips, at once */
+		if (TIFFIsTiled (tiff->tiff))
+			TIFFGetField (tiff->tiff, TIFFTAG_TILELENGTH, &rows);
+		else
+			TIFFGetFieldDefaulted (tiff->tiff, TIFFTAG_ROWSPERSTRIP, &rows);
+		tiff->band_rows = CLAMP (rows, 1, TIFF_MAX_BAND_ROWS);
+
+		size = (unsigned long long int) width * tiff->band_rows * sizeof (guint32);
+		if (size > G_MAXINT32) {
+			TIFFRGBAImageEnd (&tiff->image);
+			goto error;
+		}
+		tiff->buffer = GdipAlloc (size);
+		if (!tiff->buffer) {
+			TIFFRGBAImageEnd (&tiff->image);
+			goto error;
+		}
+	}
+
+	tiff->parent.read_row = gdip_tiff_row_reader_read;
+	tiff->parent.close = gdip_tiff_row_reader_close;
+	*reader = (GpRowReader *) tiff;
+	return Ok;
+
+error:
+	TIFFClose (tiff->tiff);
+	GdipFree (tiff->buffer);
+	GdipFree (tiff);
+	return OutOfMemory;
+}
+
+typedef struct {
+	GpRowWriter	parent;
+	TIFF		*tiff;
+	UINT		width;
+	BOOL		alpha;
+	UINT		row;
+	BYTE		*buffer;
+} TiffRowWriter;
+
+static GpStatus
+gdip_tiff_row_writer_write (GpRowWriter *writer, const ARGB *row)
+{
+	TiffRowWriter	*tiff = (TiffRowWriter *) writer;
+	BYTE		*dest = tiff->buffer;
+	UINT		x;
+
+	for (x = 0; x < tiff->width; x++) {
+		*dest++ = (row[x] >> 16) & 0xFF;
+		*dest++ = (row[x] >> 8) & 0xFF;
+		*dest++ = row[x] & 0xFF;
+		if (tiff->alpha)
+			*dest++ = row[x] >> 24;
+	}
+
+	if (TIFFWriteScanline (tiff->tiff, tiff->buffer, tiff->row++, 0) < 0)
+		return GenericError;
+
+	return Ok;
+}
+
+static GpStatus
+gdip_tiff_row_writer_close (GpRowWriter *writer)
+{
+	TiffRowWriter	*tiff = (TiffRowWriter *) writer;
+	GpStatus	status = Ok;
+
+	if (!TIFFFlush (tiff->tiff))
+		status = GenericError;
+
+	TIFFClose (tiff->tiff);
+	GdipFree (tiff->buffer);
+	GdipFree (tiff);
+	return status;
+}
+
+GpStatus
+gdip_tiff_row_writer_new (FILE *fp, UINT width, UINT height, BOOL alpha, GDIPCONST EncoderParameters *params, GpRowWriter **writer)
+{
+	TiffRowWriter	*tiff;
+	int		samples_per_pixel = alpha ? 4 : 3;
+	guint16		extra_samples[] = { EXTRASAMPLE_UNASSALPHA };
+	TiffEncoderOptions	options;
+	GpStatus	status;
+	int		fd;
+
+	/* rows arrive one at a time, so tiles aren't an option here */
+	status = gdip_tiff_get_encoder_options (params, &options);
+	if (status != Ok)
+		return status;
+
+	tiff = gdip_calloc (1, sizeof (TiffRowWriter));
+	if (!tiff)
+		return OutOfMemory;
+
+	tiff->width = width;
+	tiff->alpha = alpha;
+	if ((unsigned long long int) width * samples_per_pixel > G_MAXINT32)
+		goto error;
+	tiff->buffer = GdipAlloc (width * samples_per_pixel);
+	if (!tiff->buffer)
+		goto error;
+
+	/* libtiff closes the descriptor it was given, but the caller owns @fp */
+	fd = dup (fileno (fp));
+	if (fd < 0)
+		goto error;
+	tiff->tiff = TIFFFdOpen (fd, "<stream>", "w");
+	if (!tiff->tiff) {
+		close (fd);
+		goto error;
+	}
+
+	TIFFSetField (tiff->tiff, TIFFTAG_SAMPLESPERPIXEL, samples_per_pixel);
+	TIFFSetField (tiff->tiff, TIFFTAG_IMAGEWIDTH, width);
+	TIFFSetField (tiff->tiff, TIFFTAG_IMAGELENGTH, height);
+	TIFFSetField (tiff->tiff, TIFFTAG_BITSPERSAMPLE, 8);
+	gdip_tiff_set_compression (tiff->tiff, &options);
+	TIFFSetField (tiff->tiff, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+	TIFFSetField (tiff->tiff, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
+	TIFFSetField (tiff->tiff, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize (tiff->tiff, 0));
+	TIFFSetField (tiff->tiff, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	if (alpha)
+		TIFFSetField (tiff->tiff, TIFFTAG_EXTRASAMPLES, 1, extra_samples);
+
+	tiff->parent.write_row = gdip_tiff_row_writer_write;
+	tiff->parent.close = gdip_tiff_row_writer_close;
+	*writer = (GpRowWriter *) tiff;
+	return Ok;
+
+error:
+	GdipFree (tiff->buffer);
+	GdipFree (tiff);
+	return OutOfMemory;
+}
+
 #else
 
 /* no libtiff */
@@ -1329,6 +2330,13 @@ gdip_load_tiff_image_from_file (FILE *fp, GpImage **image)
 	return UnknownImageFormat;
 }
 
+GpStatus
+gdip_load_tiff_image_from_mapping (GpFileMapping *mapping, GpImage **image)
+{
+	*image = NULL;
+	return UnknownImageFormat;
+}
+
 GpStatus
 gdip_load_tiff_image_from_stream_delegate (GetBytesDelegate getBytesFunc,
 					PutBytesDelegate putBytesFunc,
@@ -1358,6 +2366,18 @@ gdip_save_tiff_image_to_stream_delegate (GetBytesDelegate getBytesFunc,
 {
     return UnknownImageFormat;
 }
+
+GpStatus
+gdip_tiff_row_reader_new (FILE *fp, GpRowReader **reader)
+{
+	return NotImplemented;
+}
+
+GpStatus
+gdip_tiff_row_writer_new (FILE *fp, UINT width, UINT height, BOOL alpha, GDIPCONST EncoderParameters *params, GpRowWriter **writer)
+{
+	return NotImplemented;
+}
 #endif
 
 GpStatus
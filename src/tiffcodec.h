@@ -19,6 +19,13 @@ GpStatus gdip_load_tiff_image_from_file (FILE *fp, GpImage **image) GDIP_INTERNA
 GpStatus gdip_load_tiff_image_from_stream_delegate (GetBytesDelegate getBytesFunc, PutBytesDelegate putBytesFunc,
 	SeekDelegate seekFunc, CloseDelegate closeFunc, SizeDelegate sizeFunc, GpImage **image) GDIP_INTERNAL;
 
+GpStatus gdip_load_tiff_image_from_mapping (GpFileMapping *mapping, GpImage **image) GDIP_INTERNAL;
+
+GpStatus gdip_tiff_row_reader_new (FILE *fp, GpRowReader **reader) GDIP_INTERNAL;
+
+GpStatus gdip_tiff_row_writer_new (FILE *fp, UINT width, UINT height, BOOL alpha, GDIPCONST EncoderParameters *params,
+	GpRowWriter **writer) GDIP_INTERNAL;
+
 GpStatus gdip_save_tiff_image_to_file (unsigned char *filename, GpImage *image, GDIPCONST EncoderParameters *params) GDIP_INTERNAL;
 
 GpStatus gdip_save_tiff_image_to_stream_delegate (GetBytesDelegate getBytesFunc, PutBytesDelegate putBytesFunc,
@@ -42,4 +49,16 @@ typedef struct
   LONG saveAsCYMKValue;
 } TiffEncoderParameters;
 
+/*
+ * Besides the GDI+ values, GdipEncoderCompression accepts these libgdiplus specific ones for TIFF.
+ * EncoderValueCompressionRle also selects PackBits, the run length scheme TIFF has for color images.
+ *
+ * GdipEncoderTiffTileSize {93ea0a28-c5b0-422d-a905-6c56917336c1}, EncoderParameterValueTypeLong: writes square
+ *	tiles of that size, a multiple of 16, instead of strips.
+ */
+typedef enum {
+	TiffCompressionDeflate	= 100,
+	TiffCompressionPackBits	= 101
+} TiffCompression;
+
 #endif /* _TIFFCODEC_H */
@@ -0,0 +1,498 @@
+/*
+ * transcode.c
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+ * NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * File to file image conversion that streams rows from a decoder to an encoder.
+ *
+ * PNG, JPEG and TIFF provide row readers and writers, so converting between them only keeps a
+ * few rows in memory, whatever the size of the image. Resizing is done on the fly: a box filter
+ * when shrinking and pixel replication when enlarging, independently for each axis. Any other
+ * format (and the few variants the row readers can't stream, e.g. interlaced PNG) goes through
+ * a whole GpBitmap instead, like GdipLoadImageFromFile and GdipSaveImageToFile would.
+ */
+
+#include "general-private.h"
+#include "bitmap-private.h"
+#include "image-private.h"
+#include "jpegcodec.h"
+#include "pngcodec.h"
+#include "tiffcodec.h"
+
+#include <unistd.h>
+
+/* row reader over a whole decoded bitmap */
+typedef struct {
+	GpRowReader	base;
+	GpImage		*image;
+	BitmapData	data;
+	UINT		row;
+} BitmapRowReader;
+
+/* row writer collecting the rows into a bitmap that is saved on close */
+typedef struct {
+	GpRowWriter			base;
+	GpBitmap			*bitmap;
+	GDIPCONST WCHAR			*file;
+	GDIPCONST CLSID			*encoder;
+	GDIPCONST EncoderParameters	*params;
+	UINT				row;
+} BitmapRowWriter;
+
+static GpStatus
+gdip_bitmap_row_reader_read (GpRowReader *reader, ARGB *row)
+{
+	BitmapRowReader *bitmap_reader = (BitmapRowReader *) reader;
+
+	if (bitmap_reader->row >= reader->height)
+		return InvalidParameter;
+
+	memcpy (row, (BYTE *) bitmap_reader->data.Scan0 + bitmap_reader->row * bitmap_reader->data.Stride, reader->width * sizeof (ARGB));
+	bitmap_reader->row++;
+	return Ok;
+}
+
+static void
+gdip_bitmap_row_reader_close (GpRowReader *reader)
+{
+	BitmapRowReader *bitmap_reader = (BitmapRowReader *) reader;
+
+	GdipBitmapUnlockBits ((GpBitmap *) bitmap_reader->image, &bitmap_reader->data);
+	GdipDisposeImage (bitmap_reader->image);
+	GdipFree (bitmap_reader);
+}
+
+static GpStatus
+gdip_bitmap_row_reader_new (GDIPCONST WCHAR *file, GpRowReader **reader)
+{
+	BitmapRowReader *bitmap_reader;
+	GpImage *image;
+	GpRect rect;
+	GpStatus status;
+
+	status = GdipLoadImageFromFile (file, &image);
+	if (status != Ok)
+		return status;
+
+	/* metafiles would have to be played on a bitmap first, which is exactly what streaming avoids */
+	if (image->type != ImageTypeBitmap) {
+		GdipDisposeImage (image);
+		return NotImplemented;
+	}
+
+	bitmap_reader = GdipAlloc (sizeof (BitmapRowReader));
+	if (!bitmap_reader) {
+		GdipDisposeImage (image);
+		return OutOfMemory;
+	}
+
+	rect.X = 0;
+	rect.Y = 0;
+	rect.Width = image->active_bitmap->width;
+	rect.Height = image->active_bitmap->height;
+	status = GdipBitmapLockBits ((GpBitmap *) image, &rect, ImageLockModeRead, PixelFormat32bppARGB, &bitmap_reader->data);
+	if (status != Ok) {
+		GdipDisposeImage (image);
+		GdipFree (bitmap_reader);
+		return status;
+	}
+
+	bitmap_reader->base.width = rect.Width;
+	bitmap_reader->base.height = rect.Height;
+	bitmap_reader->base.has_alpha = (image->active_bitmap->pixel_format & PixelFormatAlpha) != 0;
+	bitmap_reader->base.read_row = gdip_bitmap_row_reader_read;
+	bitmap_reader->base.close = gdip_bitmap_row_reader_close;
+	bitmap_reader->image = image;
+	bitmap_reader->row = 0;
+
+	*reader = &bitmap_reader->base;
+	return Ok;
+}
+
+static GpStatus
+gdip_bitmap_row_writer_write (GpRowWriter *writer, const ARGB *row)
+{
+	BitmapRowWriter *bitmap_writer = (BitmapRowWriter *) writer;
+	BitmapData data;
+	GpRect rect;
+	GpStatus status;
+
+	rect.X = 0;
+	rect.Y = bitmap_writer->row;
+	rect.Width = bitmap_writer->bitmap->active_bitmap->width;
+	rect.Height = 1;
+	if (rect.Y >= bitmap_writer->bitmap->active_bitmap->height)
+		return InvalidParameter;
+
+	/* LockBits converts to the pixel format of the bitmap */
+	status = GdipBitmapLockBits (bitmap_writer->bitmap, &rect, ImageLockModeWrite, PixelFormat32bppARGB, &data);
+	if (status != Ok)
+		return status;
+
+	memcpy (data.Scan0, row, rect.Width * sizeof (ARGB));
+	bitmap_writer->row++;
+	return GdipBitmapUnlockBits (bitmap_writer->bitmap, &data);
+}
+
+static GpStatus
+gdip_bitmap_row_writer_close (GpRowWriter *writer)
+{
+	BitmapRowWriter *bitmap_writer = (BitmapRowWriter *) writer;
+	GpStatus status;
+
+	status = GdipSaveImageToFile ((GpImage *) bitmap_writer->bitmap, bitmap_writer->file, bitmap_writer->encoder, bitmap_writer->params);
+
+	GdipDisposeImage ((GpImage *) bitmap_writer->bitmap);
+	GdipFree (bitmap_writer);
+	return status;
+}
+
+static GpStatus
+gdip_bitmap_row_writer_new (GDIPCONST WCHAR *file, GDIPCONST CLSID *encoder, UINT width, UINT height, BOOL alpha,
+	GDIPCONST EncoderParameters *params, GpRowWriter **writer)
+{
+	BitmapRowWriter *bitmap_writer;
+	GpStatus status;
+
+	bitmap_writer = GdipAlloc (sizeof (BitmapRowWriter));
+	if (!bitmap_writer)
+		return OutOfMemory;
+
+	status = GdipCreateBitmapFromScan0 (width, height, 0, alpha ? PixelFormat32bppARGB : PixelFormat24bppRGB, NULL, &bitmap_writer->bitmap);
+	if (status != Ok) {
+		GdipFree (bitmap_writer);
+		return status;
+	}
+
+	bitmap_writer->base.write_row = gdip_bitmap_row_writer_write;
+	bitmap_writer->base.close = gdip_bitmap_row_writer_close;
+	bitmap_writer->file = file;
+	bitmap_writer->encoder = encoder;
+	bitmap_writer->params = params;
+	bitmap_writer->row = 0;
+
+	*writer = &bitmap_writer->base;
+	return Ok;
+}
+
+/* Opens a streaming reader for the file, or a bitmap backed one when the decoder can't stream it */
+static GpStatus
+gdip_transcode_open_reader (GDIPCONST WCHAR *file, const char *file_name, FILE **fp, GpRowReader **reader)
+{
+	char format_peek[MAX_CODEC_SIG_LENGTH];
+	int format_peek_sz;
+	ImageFormat format, public_format;
+	GpStatus status;
+
+	*fp = fopen (file_name, "rb");
+	if (!*fp)
+		return OutOfMemory;
+
+	format_peek_sz = fread (format_peek, 1, MAX_CODEC_SIG_LENGTH, *fp);
+	format = get_image_format (format_peek, format_peek_sz, &public_format);
+	fseek (*fp, 0, SEEK_SET);
+
+	switch (format) {
+	case PNG:
+		status = gdip_png_row_reader_new (*fp, reader);
+		break;
+	case JPEG:
+		status = gdip_jpeg_row_reader_new (*fp, reader);
+		break;
+	case TIF:
+		status = gdip_tiff_row_reader_new (*fp, reader);
+		break;
+	case INVALID:
+		status = UnknownImageFormat;
+		break;
+	default:
+		status = NotImplemented;
+		break;
+	}
+
+	if (status == Ok)
+		return Ok;
+
+	fclose (*fp);
+	*fp = NULL;
+
+	if (status != NotImplemented)
+		return status;
+
+	return gdip_bitmap_row_reader_new (file, reader);
+}
+
+/* Opens a streaming writer for the encoder, or a bitmap backed one when the encoder can't stream */
+static GpStatus
+gdip_transcode_open_writer (GDIPCONST WCHAR *file, const char *file_name, GDIPCONST CLSID *encoder, UINT width, UINT height,
+	BOOL alpha, GDIPCONST EncoderParameters *params, FILE **fp, GpRowWriter **writer)
+{
+	ImageFormat format;
+	GpStatus status;
+
+	format = gdip_get_imageformat_from_codec_clsid ((CLSID *) encoder);
+	if (format == INVALID)
+		return UnknownImageFormat;
+
+	if (format == PNG || format == JPEG || format == TIF) {
+		*fp = fopen (file_name, "wb");
+		if (!*fp)
+			return GenericError;
+
+		switch (format) {
+		case PNG:
+			status = gdip_png_row_writer_new (*fp, width, height, alpha, params, writer);
+			break;
+		case JPEG:
+			status = gdip_jpeg_row_writer_new (*fp, width, height, alpha, params, writer);
+			break;
+		default:
+			status = gdip_tiff_row_writer_new (*fp, width, height, alpha, params, writer);
+			break;
+		}
+
+		if (status == Ok)
+			return Ok;
+
+		fclose (*fp);
+		*fp = NULL;
+		unlink (file_name);
+
+		if (status != NotImplemented)
+			return status;
+	}
+
+	return gdip_bitmap_row_writer_new (file, encoder, width, height, alpha, params, writer);
+}
+
+static void
+gdip_transcode_accumulate (guint64 *sum, const ARGB *row, UINT src_width, UINT dst_width)
+{
+	UINT x;
+
+	if (dst_width <= src_width) {
+		/* every source pixel lands in exactly one destination pixel */
+		for (x = 0; x < src_width; x++) {
+			guint64 *pixel = sum + (guint64) x * dst_width / src_width * 4;
+			ARGB color = row[x];
+			guint64 a = color >> 24;
+
+			pixel[0] += a;
+			pixel[1] += a * ((color >> 16) & 0xFF);
+			pixel[2] += a * ((color >> 8) & 0xFF);
+			pixel[3] += a * (color & 0xFF);
+		}
+	} else {
+		for (x = 0; x < dst_width; x++) {
+			guint64 *pixel = sum + x * 4;
+			ARGB color = row[(guint64) x * src_width / dst_width];
+			guint64 a = color >> 24;
+
+			pixel[0] += a;
+			pixel[1] += a * ((color >> 16) & 0xFF);
+			pixel[2] += a * ((color >> 8) & 0xFF);
+			pixel[3] += a * (color & 0xFF);
+		}
+	}
+}
+
+/* Averages the accumulated pixels, weighting the colors by their alpha, and clears the sums */
+static void
+gdip_transcode_resolve (guint64 *sum, const UINT *columns, UINT rows, UINT width, ARGB *row)
+{
+	UINT x;
+
+	for (x = 0; x < width; x++) {
+		guint64 *pixel = sum + x * 4;
+		guint64 count = (guint64) columns[x] * rows;
+		ARGB a = (ARGB) ((pixel[0] + count / 2) / count);
+
+		if (pixel[0] == 0) {
+			row[x] = 0;
+		} else {
+			row[x] = (a << 24) |
+				((ARGB) ((pixel[1] + pixel[0] / 2) / pixel[0]) << 16) |
+				((ARGB) ((pixel[2] + pixel[0] / 2) / pixel[0]) << 8) |
+				(ARGB) ((pixel[3] + pixel[0] / 2) / pixel[0]);
+		}
+
+		pixel[0] = pixel[1] = pixel[2] = pixel[3] = 0;
+	}
+}
+
+static GpStatus
+gdip_transcode_rows (GpRowReader *reader, GpRowWriter *writer, UINT width, UINT height, BOOL alpha)
+{
+	ARGB *src_row = NULL;
+	ARGB *dst_row = NULL;
+	guint64 *sum = NULL;
+	UINT *columns = NULL;
+	UINT rows = 0;
+	UINT src_y, dst_y = 0;
+	UINT x;
+	BOOL resize = reader->width != width || reader->height != height;
+	GpStatus status = Ok;
+
+	src_row = GdipAlloc (reader->width * sizeof (ARGB));
+	if (resize) {
+		dst_row = GdipAlloc (width * sizeof (ARGB));
+		sum = gdip_calloc (width * 4, sizeof (guint64));
+		columns = gdip_calloc (width, sizeof (UINT));
+	}
+	if (!src_row || (resize && (!dst_row || !sum || !columns))) {
+		status = OutOfMemory;
+		goto cleanup;
+	}
+
+	if (resize) {
+		/* how many source pixels of a row end up in each destination pixel */
+		if (width <= reader->width) {
+			for (x = 0; x < reader->width; x++)
+				columns[(guint64) x * width / reader->width]++;
+		} else {
+			for (x = 0; x < width; x++)
+				columns[x] = 1;
+		}
+	}
+
+	for (src_y = 0; src_y < reader->height && status == Ok; src_y++) {
+		status = reader->read_row (reader, src_row);
+		if (status != Ok)
+			break;
+
+		if (!alpha) {
+			for (x = 0; x < reader->width; x++)
+				src_row[x] |= 0xFF000000;
+		}
+
+		if (!resize) {
+			status = writer->write_row (writer, src_row);
+			continue;
+		}
+
+		gdip_transcode_accumulate (sum, src_row, reader->width, width);
+		rows++;
+
+		if (height <= reader->height) {
+			/* flush once the next source row belongs to the next destination row */
+			if (src_y + 1 < reader->height && (guint64) (src_y + 1) * height / reader->height == dst_y)
+				continue;
+
+			gdip_transcode_resolve (sum, columns, rows, width, dst_row);
+			rows = 0;
+			status = writer->write_row (writer, dst_row);
+			dst_y++;
+		} else {
+			UINT end = ((guint64) (src_y + 1) * height + reader->height - 1) / reader->height;
+
+			gdip_transcode_resolve (sum, columns, rows, width, dst_row);
+			rows = 0;
+			for (; dst_y < end && status == Ok; dst_y++)
+				status = writer->write_row (writer, dst_row);
+		}
+	}
+
+cleanup:
+	GdipFree (src_row);
+	GdipFree (dst_row);
+	GdipFree (sum);
+	GdipFree (columns);
+	return status;
+}
+
+GpStatus WINGDIPAPI
+GdipTranscodeImageFile_linux (GDIPCONST WCHAR *source, GDIPCONST WCHAR *destination, GDIPCONST CLSID *encoderClsid,
+	GDIPCONST EncoderParameters *params, PixelFormat format, UINT width, UINT height)
+{
+	char *source_name = NULL;
+	char *destination_name = NULL;
+	FILE *input = NULL;
+	FILE *output = NULL;
+	GpRowReader *reader = NULL;
+	GpRowWriter *writer = NULL;
+	BOOL alpha;
+	GpStatus status;
+
+	if (!gdiplusInitialized)
+		return GdiplusNotInitialized;
+
+	if (!source || !destination || !encoderClsid)
+		return InvalidParameter;
+
+	switch (format) {
+	case 0:
+	case PixelFormat24bppRGB:
+	case PixelFormat32bppRGB:
+	case PixelFormat32bppARGB:
+	case PixelFormat32bppPARGB:
+		break;
+	default:
+		return InvalidParameter;
+	}
+
+	source_name = (char *) utf16_to_utf8 ((const gunichar2 *) source, -1);
+	destination_name = (char *) utf16_to_utf8 ((const gunichar2 *) destination, -1);
+	if (!source_name || !destination_name) {
+		status = InvalidParameter;
+		goto cleanup;
+	}
+
+	status = gdip_transcode_open_reader (source, source_name, &input, &reader);
+	if (status != Ok)
+		goto cleanup;
+
+	/* a missing dimension keeps the aspect ratio, both missing keep the size */
+	if (width == 0 && height == 0) {
+		width = reader->width;
+		height = reader->height;
+	} else if (width == 0) {
+		width = MAX (1, (UINT) (((guint64) reader->width * height + reader->height / 2) / reader->height));
+	} else if (height == 0) {
+		height = MAX (1, (UINT) (((guint64) reader->height * width + reader->width / 2) / reader->width));
+	}
+
+	if (format == 0)
+		alpha = reader->has_alpha;
+	else
+		alpha = format == PixelFormat32bppARGB || format == PixelFormat32bppPARGB;
+
+	status = gdip_transcode_open_writer (destination, destination_name, encoderClsid, width, height, alpha, params, &output, &writer);
+	if (status != Ok)
+		goto cleanup;
+
+	status = gdip_transcode_rows (reader, writer, width, height, alpha);
+
+	/* closing the writer completes the file, so it is needed even after a failure */
+	if (status == Ok)
+		status = writer->close (writer);
+	else
+		writer->close (writer);
+
+cleanup:
+	if (reader)
+		reader->close (reader);
+	if (input)
+		fclose (input);
+	if (output)
+		fclose (output);
+	if (status != Ok && writer)
+		unlink (destination_name);
+	GdipFree (source_name);
+	GdipFree (destination_name);
+	return status;
+}
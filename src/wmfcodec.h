@@ -56,6 +56,8 @@ GpStatus gdip_load_wmf_image_from_file (FILE *fp, GpImage **image) GDIP_INTERNAL
 
 GpStatus gdip_load_wmf_image_from_stream_delegate (dstream_t *loader, GpImage **image) GDIP_INTERNAL;
 
+GpStatus gdip_load_wmf_image_from_memory (MemorySource *source, GpImage **image) GDIP_INTERNAL;
+
 /* no save functions as the WMF "codec" is a decoder only */
 
 ImageCodecInfo* gdip_getcodecinfo_wmf () GDIP_INTERNAL;
@@ -0,0 +1,98 @@
+/*
+ * Micro benchmark for the ARGB premultiplication kernels.
+ *
+ * Every LockBits/UnlockBits cycle on a PixelFormat32bppARGB bitmap that has been drawn reverses the
+ * premultiplication of its cairo surface and then premultiplies it again. The kernel can be forced
+ * through the GDIPLUS_PREMULTIPLY environment variable, e.g.
+ *
+ *	for k in table sse2 avx2; do GDIPLUS_PREMULTIPLY=$k ./benchpremultiply; done
+ *
+ * This is not part of the test suite.
+ */
+
+#include <GdiPlusFlat.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "testhelpers.h"
+
+#define WIDTH		3840
+#define HEIGHT		2160
+#define ITERATIONS	20
+
+static double
+elapsed_ms (const struct timespec *start, const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) * 1000.0 + (end->tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+static void
+run (const char *name, ARGB (*pixel) (int x, int y))
+{
+	GpBitmap *bitmap;
+	GpBitmap *target;
+	GpGraphics *graphics;
+	BitmapData data;
+	Rect rect = {0, 0, WIDTH, HEIGHT};
+	struct timespec start, end;
+	int x, y, i;
+
+	GdipCreateBitmapFromScan0 (WIDTH, HEIGHT, 0, PixelFormat32bppARGB, NULL, &bitmap);
+	for (y = 0; y < HEIGHT; y++)
+		for (x = 0; x < WIDTH; x++)
+			GdipBitmapSetPixel (bitmap, x, y, pixel (x, y));
+
+	/* drawing the bitmap creates its premultiplied surface */
+	GdipCreateBitmapFromScan0 (1, 1, 0, PixelFormat32bppARGB, NULL, &target);
+	GdipGetImageGraphicsContext ((GpImage *) target, &graphics);
+	GdipDrawImageI (graphics, (GpImage *) bitmap, 0, 0);
+
+	clock_gettime (CLOCK_MONOTONIC, &start);
+	for (i = 0; i < ITERATIONS; i++) {
+		GdipBitmapLockBits (bitmap, &rect, ImageLockModeRead | ImageLockModeWrite, PixelFormat32bppARGB, &data);
+		GdipBitmapUnlockBits (bitmap, &data);
+	}
+	clock_gettime (CLOCK_MONOTONIC, &end);
+
+	printf ("%-12s %8.2f ms per LockBits/UnlockBits cycle\n", name, elapsed_ms (&start, &end) / ITERATIONS);
+
+	GdipDeleteGraphics (graphics);
+	GdipDisposeImage ((GpImage *) target);
+	GdipDisposeImage ((GpImage *) bitmap);
+}
+
+static ARGB
+opaque_pixel (int x, int y)
+{
+	return 0xFF000000 | (x * 31 + y * 17);
+}
+
+static ARGB
+translucent_pixel (int x, int y)
+{
+	return ((ARGB) ((x + y) & 0xFF) << 24) | (x * 31 + y * 17);
+}
+
+static ARGB
+mixed_pixel (int x, int y)
+{
+	/* mostly opaque with antialiased edges, typical for icons and charts */
+	return ((x / 64 + y / 64) % 8) == 0 ? translucent_pixel (x, y) : opaque_pixel (x, y);
+}
+
+int
+main (int argc, char **argv)
+{
+	const char *kernel = getenv ("GDIPLUS_PREMULTIPLY");
+
+	STARTUP;
+
+	printf ("kernel: %s\n", kernel && *kernel ? kernel : "default");
+	run ("opaque", opaque_pixel);
+	run ("translucent", translucent_pixel);
+	run ("mixed", mixed_pixel);
+
+	SHUTDOWN;
+	return 0;
+}
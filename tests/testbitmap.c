@@ -164,14 +164,10 @@ static void test_createBitmapFromScan0 ()
 	
 	// No scan0 - PixelFormat64bppARGB.
 	status = GdipCreateBitmapFromScan0 (1, 2, 0, PixelFormat64bppARGB, NULL, &bitmap);
-#if defined(USE_WINDOWS_GDIPLUS)
 	assertEqualInt (status, Ok);
 	verifyBitmap (bitmap, memoryBmpRawFormat, PixelFormat64bppARGB, 1, 2, ImageFlagsHasAlpha, 0, TRUE);
 	verifyPixels (bitmap, emptyPixelsWithAlpha);
 	GdipDisposeImage ((GpImage *) bitmap);
-#else
-	assertEqualInt (status, NotImplemented);
-#endif
 	
 	// Has scan0 - PixelFormat64bppARGB.
 	BYTE bpp64ArgbData[] = {
@@ -192,19 +188,23 @@ static void test_createBitmapFromScan0 ()
 	verifyPixels (bitmap, bpp64ArgbPixels);
 	GdipDisposeImage ((GpImage *) bitmap);
 #else
-	assertEqualInt (status, NotImplemented);
+	// The data is used, with 16 bits per channel narrowed to 8 bits.
+	ARGB bpp64ArgbPixels[] = {
+		0xFE0000FF,
+		0x8000FF00
+	};
+	assertEqualInt (status, Ok);
+	verifyBitmap (bitmap, memoryBmpRawFormat, PixelFormat64bppARGB, 1, 2, ImageFlagsHasAlpha, 0, TRUE);
+	verifyPixels (bitmap, bpp64ArgbPixels);
+	GdipDisposeImage ((GpImage *) bitmap);
 #endif
 
 	// No scan0 - PixelFormat64bppPARGB.
 	status = GdipCreateBitmapFromScan0 (1, 2, 0, PixelFormat64bppPARGB, NULL, &bitmap);
-#if defined(USE_WINDOWS_GDIPLUS)
 	assertEqualInt (status, Ok);
 	verifyBitmap (bitmap, memoryBmpRawFormat, PixelFormat64bppPARGB, 1, 2, ImageFlagsHasAlpha, 0, TRUE);
 	verifyPixels (bitmap, emptyPixelsWithAlpha);
 	GdipDisposeImage ((GpImage *) bitmap);
-#else
-	assertEqualInt (status, NotImplemented);
-#endif
 	
 	// Has scan0 - PixelFormat64bppPARGB.
 	BYTE bpp64PArgbData[] = {
@@ -225,19 +225,23 @@ static void test_createBitmapFromScan0 ()
 	verifyPixels (bitmap, bpp64PArgbPixels);
 	GdipDisposeImage ((GpImage *) bitmap);
 #else
-	assertEqualInt (status, NotImplemented);
+	// The data is used, with 16 bits per channel narrowed to 8 bits.
+	ARGB bpp64PArgbPixels[] = {
+		0xFE0000FF,
+		0x8000FF00
+	};
+	assertEqualInt (status, Ok);
+	verifyBitmap (bitmap, memoryBmpRawFormat, PixelFormat64bppPARGB, 1, 2, ImageFlagsHasAlpha, 0, TRUE);
+	verifyPixels (bitmap, bpp64PArgbPixels);
+	GdipDisposeImage ((GpImage *) bitmap);
 #endif
 
 	// No scan0 - PixelFormat48bppRGB.
 	status = GdipCreateBitmapFromScan0 (1, 2, 0, PixelFormat48bppRGB, NULL, &bitmap);
-#if defined(USE_WINDOWS_GDIPLUS)
 	assertEqualInt (status, Ok);
 	verifyBitmap (bitmap, memoryBmpRawFormat, PixelFormat48bppRGB, 1, 2, 0, 0, TRUE);
 	verifyPixels (bitmap, emptyPixelsWithNoAlpha);
 	GdipDisposeImage ((GpImage *) bitmap);
-#else
-	assertEqualInt (status, NotImplemented);
-#endif
 
 	// Has scan0 - PixelFormat48bppRGB.
 	BYTE bpp48RgbData[] = {
@@ -258,7 +262,15 @@ static void test_createBitmapFromScan0 ()
 	verifyPixels (bitmap, bpp48RgbPixels);
 	GdipDisposeImage ((GpImage *) bitmap);
 #else
-	assertEqualInt (status, NotImplemented);
+	// The data is used, with 16 bits per channel narrowed to 8 bits.
+	ARGB bpp48RgbPixels[] = {
+		0xFF0000FF,
+		0xFF00FF00
+	};
+	assertEqualInt (status, Ok);
+	verifyBitmap (bitmap, memoryBmpRawFormat, PixelFormat48bppRGB, 1, 2, 0, 0, TRUE);
+	verifyPixels (bitmap, bpp48RgbPixels);
+	GdipDisposeImage ((GpImage *) bitmap);
 #endif
 
 	// No scan0 - PixelFormat32bppARGB.
@@ -486,14 +498,10 @@ static void test_createBitmapFromScan0 ()
 	
 	// No scan0 - PixelFormat16bppARGB1555.
 	status = GdipCreateBitmapFromScan0 (1, 2, 0, PixelFormat16bppARGB1555, NULL, &bitmap);
-#if defined(USE_WINDOWS_GDIPLUS)
 	assertEqualInt (status, Ok);
 	verifyBitmap (bitmap, memoryBmpRawFormat, PixelFormat16bppARGB1555, 1, 2, ImageFlagsHasAlpha, 0, TRUE);
 	verifyPixels (bitmap, emptyPixelsWithAlpha);
 	GdipDisposeImage ((GpImage *) bitmap);
-#else
-	assertEqualInt (status, NotImplemented);
-#endif
 
 	// Has scan0 - PixelFormat16bppARGB1555.
 	BYTE bpp16argb555Data[] = {
@@ -502,7 +510,6 @@ static void test_createBitmapFromScan0 ()
 		0x00, 0x7C, 0x00, 0x00
 	};
 	status = GdipCreateBitmapFromScan0 (1, 2, 4, PixelFormat16bppARGB1555, bpp16argb555Data, &bitmap);
-#if defined(USE_WINDOWS_GDIPLUS)
 	ARGB bpp16argb555Pixels[] = {
 		0xFF0000FF,
 		0x0000FF00,
@@ -521,9 +528,6 @@ static void test_createBitmapFromScan0 ()
 	bpp16argb555Data[9] = 0x00;
 	verifyPixels (bitmap, bpp16argb555PixelsModified);
 	GdipDisposeImage ((GpImage *) bitmap);
-#else
-	assertEqualInt (status, NotImplemented);
-#endif
 	
 	// No scan0 - PixelFormat16bppGrayScale.
 	status = GdipCreateBitmapFromScan0 (1, 2, 0, PixelFormat16bppGrayScale, NULL, &bitmap);
@@ -1210,6 +1214,284 @@ static void test_bitmapUnlockBits ()
 	GdipDisposeImage ((GpImage *) image);
 }
 
+static void test_bitmapLockBitsConversions ()
+{
+	GpStatus status;
+	GpBitmap *image;
+	BitmapData data;
+	BYTE indexedScan0[] = {
+		0x12, 0x34, 0x00, 0x00,
+		0x56, 0x78, 0x00, 0x00,
+	};
+	ARGB argbScan0[] = {
+		0x80FF0000, 0xFF00FF00,
+		0x00FFFFFF, 0x40204080,
+	};
+	WORD wideScan0[] = {
+		0x1234, 0x0000, 0x0000, 0xFF00,
+		0x0000, 0xFFFF, 0x0000, 0x8000,
+	};
+	BYTE userBuffer[8];
+	ARGB *pixels;
+	BYTE *bytes;
+	WORD *words;
+	Rect rect = {1, 0, 2, 2};
+
+	// Indexed pixels that don't start on a byte boundary.
+	GdipCreateBitmapFromScan0 (4, 2, 4, PixelFormat4bppIndexed, indexedScan0, &image);
+	status = GdipBitmapLockBits (image, &rect, ImageLockModeRead, PixelFormat32bppARGB, &data);
+	assertEqualInt (status, Ok);
+	pixels = (ARGB *) data.Scan0;
+	assertEqualInt (pixels[0], 0xFF008000);
+	assertEqualInt (pixels[1], 0xFF808000);
+	pixels = (ARGB *) ((BYTE *) data.Scan0 + data.Stride);
+	assertEqualInt (pixels[0], 0xFF008080);
+	assertEqualInt (pixels[1], 0xFF808080);
+	GdipBitmapUnlockBits (image, &data);
+
+	data.Scan0 = userBuffer;
+	status = GdipBitmapLockBits (image, &rect, ImageLockModeRead | ImageLockModeWrite | ImageLockModeUserInputBuf, PixelFormat4bppIndexed, &data);
+	assertEqualInt (status, Ok);
+	assertEqualInt (userBuffer[0], 0x23);
+	assertEqualInt (userBuffer[4], 0x67);
+	GdipBitmapUnlockBits (image, &data);
+	assertEqualInt (indexedScan0[0], 0x12);
+	assertEqualInt (indexedScan0[1], 0x34);
+	GdipDisposeImage ((GpImage *) image);
+
+	// Straight alpha to premultiplied alpha.
+	GdipCreateBitmapFromScan0 (2, 2, 8, PixelFormat32bppARGB, (BYTE *) argbScan0, &image);
+	status = GdipBitmapLockBits (image, NULL, ImageLockModeRead, PixelFormat32bppPARGB, &data);
+	assertEqualInt (status, Ok);
+	pixels = (ARGB *) data.Scan0;
+	assertEqualInt (pixels[0], 0x80800000);
+	assertEqualInt (pixels[1], 0xFF00FF00);
+	pixels = (ARGB *) ((BYTE *) data.Scan0 + data.Stride);
+	assertEqualInt (pixels[0], 0x00000000);
+	GdipBitmapUnlockBits (image, &data);
+	assertEqualInt (argbScan0[0], 0x80FF0000);
+	assertEqualInt (argbScan0[1], 0xFF00FF00);
+
+	// 24bpp is handed out packed.
+	status = GdipBitmapLockBits (image, NULL, ImageLockModeRead, PixelFormat24bppRGB, &data);
+	assertEqualInt (status, Ok);
+	bytes = (BYTE *) data.Scan0;
+	assertEqualInt (bytes[3], 0x00);
+	assertEqualInt (bytes[4], 0xFF);
+	assertEqualInt (bytes[5], 0x00);
+	GdipBitmapUnlockBits (image, &data);
+
+	// 8 bits per channel are widened to the full 16 bit range.
+	status = GdipBitmapLockBits (image, NULL, ImageLockModeRead, PixelFormat64bppARGB, &data);
+	assertEqualInt (status, Ok);
+	words = (WORD *) data.Scan0;
+	assertEqualInt (words[0], 0x0000);
+	assertEqualInt (words[1], 0x0000);
+	assertEqualInt (words[2], 0xFFFF);
+	assertEqualInt (words[3], 0x8080);
+	GdipBitmapUnlockBits (image, &data);
+	GdipDisposeImage ((GpImage *) image);
+
+	// 16 bits per channel are locked without going through 8 bits.
+	GdipCreateBitmapFromScan0 (2, 1, 16, PixelFormat64bppARGB, (BYTE *) wideScan0, &image);
+	status = GdipBitmapLockBits (image, NULL, ImageLockModeRead, PixelFormat64bppARGB, &data);
+	assertEqualInt (status, Ok);
+	assert (data.Scan0 == wideScan0);
+	GdipBitmapUnlockBits (image, &data);
+
+	status = GdipBitmapLockBits (image, NULL, ImageLockModeRead, PixelFormat48bppRGB, &data);
+	assertEqualInt (status, Ok);
+	words = (WORD *) data.Scan0;
+	assertEqualInt (words[0], 0x1234);
+	assertEqualInt (words[4], 0xFFFF);
+	GdipBitmapUnlockBits (image, &data);
+
+	status = GdipBitmapLockBits (image, NULL, ImageLockModeRead, PixelFormat32bppARGB, &data);
+	assertEqualInt (status, Ok);
+	pixels = (ARGB *) data.Scan0;
+	assertEqualInt (pixels[0], 0xFE000012);
+	assertEqualInt (pixels[1], 0x8000FF00);
+	GdipBitmapUnlockBits (image, &data);
+	GdipDisposeImage ((GpImage *) image);
+}
+
+static void test_bitmapPremultipliedSurface ()
+{
+	GpStatus status;
+	GpBitmap *bitmap;
+	GpBitmap *target;
+	GpGraphics *graphics;
+	GpSolidFill *brush;
+	BitmapData data;
+	Rect rect = {1, 1, 2, 2};
+	ARGB color;
+
+	status = GdipCreateBitmapFromScan0 (4, 4, 0, PixelFormat32bppARGB, NULL, &bitmap);
+	assertEqualInt (status, Ok);
+	GdipBitmapSetPixel (bitmap, 0, 0, 0x80FF0000);
+	GdipBitmapSetPixel (bitmap, 3, 3, 0xFF00FF00);
+
+	// Drawing the bitmap creates its premultiplied surface.
+	GdipCreateBitmapFromScan0 (4, 4, 0, PixelFormat32bppARGB, NULL, &target);
+	GdipGetImageGraphicsContext ((GpImage *) target, &graphics);
+	GdipDrawImageI (graphics, (GpImage *) bitmap, 0, 0);
+	GdipDeleteGraphics (graphics);
+
+	// Pixels set on the surface are visible through LockBits.
+	GdipBitmapSetPixel (bitmap, 1, 1, 0xFF0000FF);
+	status = GdipBitmapLockBits (bitmap, &rect, ImageLockModeRead | ImageLockModeWrite, PixelFormat32bppARGB, &data);
+	assertEqualInt (status, Ok);
+	assertEqualInt (((ARGB *) data.Scan0)[0], 0xFF0000FF);
+	((ARGB *) data.Scan0)[1] = 0xFFFFFF00;
+	status = GdipBitmapUnlockBits (bitmap, &data);
+	assertEqualInt (status, Ok);
+
+	// Pixels written through LockBits and pixels outside the locked area are kept.
+	GdipBitmapGetPixel (bitmap, 2, 1, &color);
+	assertEqualInt (color, 0xFFFFFF00);
+	GdipBitmapGetPixel (bitmap, 3, 3, &color);
+	assertEqualInt (color, 0xFF00FF00);
+	GdipBitmapGetPixel (bitmap, 0, 0, &color);
+	assertEqualInt (color >> 24, 0x80);
+
+	// Drawing on the bitmap is visible through LockBits.
+	GdipGetImageGraphicsContext ((GpImage *) bitmap, &graphics);
+	GdipCreateSolidFill (0xFFFF0000, &brush);
+	GdipFillRectangleI (graphics, brush, 0, 3, 1, 1);
+	GdipDeleteBrush ((GpBrush *) brush);
+
+	rect.X = 0;
+	rect.Y = 3;
+	rect.Width = 1;
+	rect.Height = 1;
+	status = GdipBitmapLockBits (bitmap, &rect, ImageLockModeRead, PixelFormat32bppARGB, &data);
+	assertEqualInt (status, Ok);
+	assertEqualInt (((ARGB *) data.Scan0)[0], 0xFFFF0000);
+	status = GdipBitmapUnlockBits (bitmap, &data);
+	assertEqualInt (status, Ok);
+
+	GdipDeleteGraphics (graphics);
+	GdipDisposeImage ((GpImage *) target);
+	GdipDisposeImage ((GpImage *) bitmap);
+}
+
+static void test_wideBitmapSurface ()
+{
+	GpStatus status;
+	GpBitmap *bitmap;
+	GpGraphics *graphics;
+	GpSolidFill *brush;
+	BitmapData data;
+	WORD *words;
+	WORD wideScan0[] = {
+		0x1234, 0x5678, 0x9ABC, 0xFFFF,
+		0x1234, 0x5678, 0x9ABC, 0xFFFF,
+		0x0001, 0x0002, 0x0003, 0x8001
+	};
+
+	GdipCreateBitmapFromScan0 (3, 1, 24, PixelFormat64bppARGB, (BYTE *) wideScan0, &bitmap);
+
+	// Pixels that are not drawn keep their 16 bits per channel, even though a graphics could have changed them.
+	status = GdipGetImageGraphicsContext ((GpImage *) bitmap, &graphics);
+	assertEqualInt (status, Ok);
+	GdipCreateSolidFill (0xFFFF0000, &brush);
+	GdipFillRectangleI (graphics, brush, 1, 0, 1, 1);
+	GdipDeleteBrush ((GpBrush *) brush);
+	GdipDeleteGraphics (graphics);
+
+	status = GdipBitmapLockBits (bitmap, NULL, ImageLockModeRead, PixelFormat64bppARGB, &data);
+	assertEqualInt (status, Ok);
+	words = (WORD *) data.Scan0;
+	assertEqualInt (words[0], 0x1234);
+	assertEqualInt (words[1], 0x5678);
+	assertEqualInt (words[2], 0x9ABC);
+	assertEqualInt (words[3], 0xFFFF);
+	assertEqualInt (words[4], 0x0000);
+	assertEqualInt (words[5], 0x0000);
+	assertEqualInt (words[6], 0xFFFF);
+	assertEqualInt (words[7], 0xFFFF);
+	assertEqualInt (words[8], 0x0001);
+	assertEqualInt (words[11], 0x8001);
+	GdipBitmapUnlockBits (bitmap, &data);
+	GdipDisposeImage ((GpImage *) bitmap);
+
+	GdipCreateBitmapFromScan0 (2, 1, 16, PixelFormat48bppRGB, (BYTE *) wideScan0, &bitmap);
+	status = GdipGetImageGraphicsContext ((GpImage *) bitmap, &graphics);
+	assertEqualInt (status, Ok);
+	GdipCreateSolidFill (0xFF00FF00, &brush);
+	GdipFillRectangleI (graphics, brush, 1, 0, 1, 1);
+	GdipDeleteBrush ((GpBrush *) brush);
+	GdipDeleteGraphics (graphics);
+
+	status = GdipBitmapLockBits (bitmap, NULL, ImageLockModeRead, PixelFormat48bppRGB, &data);
+	assertEqualInt (status, Ok);
+	words = (WORD *) data.Scan0;
+	assertEqualInt (words[0], 0x1234);
+	assertEqualInt (words[1], 0x5678);
+	assertEqualInt (words[2], 0x9ABC);
+	assertEqualInt (words[3], 0x0000);
+	assertEqualInt (words[4], 0xFFFF);
+	assertEqualInt (words[5], 0x0000);
+	GdipBitmapUnlockBits (bitmap, &data);
+	GdipDisposeImage ((GpImage *) bitmap);
+}
+
+static void test_drawIndexedBitmap ()
+{
+	GpStatus status;
+	GpBitmap *bitmap;
+	GpBitmap *target;
+	GpGraphics *graphics;
+	BitmapData data;
+	BYTE buffer[1040];
+	ColorPalette *palette = (ColorPalette *) buffer;
+	Rect rect = {0, 0, 2, 2};
+	ARGB color;
+
+	status = GdipCreateBitmapFromScan0 (2, 2, 0, PixelFormat8bppIndexed, NULL, &bitmap);
+	assertEqualInt (status, Ok);
+
+	palette->Count = 256;
+	palette->Flags = 0;
+	for (int i = 0; i < 256; i++)
+		palette->Entries[i] = 0xFF000000;
+	palette->Entries[0] = 0xFFFF0000;
+	palette->Entries[1] = 0xFF00FF00;
+	status = GdipSetImagePalette ((GpImage *) bitmap, palette);
+	assertEqualInt (status, Ok);
+
+	GdipCreateBitmapFromScan0 (2, 2, 0, PixelFormat32bppARGB, NULL, &target);
+	GdipGetImageGraphicsContext ((GpImage *) target, &graphics);
+
+	GdipDrawImageI (graphics, (GpImage *) bitmap, 0, 0);
+	GdipBitmapGetPixel (target, 0, 0, &color);
+	assertEqualInt (color, 0xFFFF0000);
+
+	// Drawing again after changing the palette uses the new colors.
+	palette->Entries[0] = 0xFF0000FF;
+	status = GdipSetImagePalette ((GpImage *) bitmap, palette);
+	assertEqualInt (status, Ok);
+
+	GdipDrawImageI (graphics, (GpImage *) bitmap, 0, 0);
+	GdipBitmapGetPixel (target, 0, 0, &color);
+	assertEqualInt (color, 0xFF0000FF);
+
+	// Drawing again after writing the pixels uses the new pixels.
+	status = GdipBitmapLockBits (bitmap, &rect, ImageLockModeWrite, PixelFormat8bppIndexed, &data);
+	assertEqualInt (status, Ok);
+	((BYTE *) data.Scan0)[0] = 1;
+	status = GdipBitmapUnlockBits (bitmap, &data);
+	assertEqualInt (status, Ok);
+
+	GdipDrawImageI (graphics, (GpImage *) bitmap, 0, 0);
+	GdipBitmapGetPixel (target, 0, 0, &color);
+	assertEqualInt (color, 0xFF00FF00);
+
+	GdipDeleteGraphics (graphics);
+	GdipDisposeImage ((GpImage *) target);
+	GdipDisposeImage ((GpImage *) bitmap);
+}
+
 static void test_readExifResolution ()
 {
 	REAL resolution;
@@ -1244,6 +1526,10 @@ main(int argc, char**argv)
 	test_bitmapGetPixel ();
 	test_bitmapLockBits ();
 	test_bitmapUnlockBits ();
+	test_bitmapLockBitsConversions ();
+	test_bitmapPremultipliedSurface ();
+	test_wideBitmapSurface ();
+	test_drawIndexedBitmap ();
 	test_readExifResolution ();
 
 	SHUTDOWN;
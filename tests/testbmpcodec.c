@@ -5275,6 +5275,82 @@ static void test_invalidImageData ()
 	createFile (missingFinalLine, OutOfMemory);
 }
 
+static void saveWideFormat (PixelFormat format)
+{
+	GpStatus status;
+	GpBitmap *bitmap;
+	GpImage *saved;
+	ARGB pixels[] = {0xFF000000, 0xFFFFFFFF, 0xFFFF8000, 0xFF12AB34};
+	ARGB color;
+
+	status = GdipCreateBitmapFromScan0 (2, 2, 0, format, NULL, &bitmap);
+	assertEqualInt (status, Ok);
+	for (int i = 0; i < 4; i++)
+		GdipBitmapSetPixel (bitmap, i % 2, i / 2, pixels[i]);
+
+	// BMP has no 16 bits per channel formats, they are saved with 8.
+	status = GdipSaveImageToFile (bitmap, wFile, &bmpEncoderClsid, NULL);
+	assertEqualInt (status, Ok);
+
+	status = GdipLoadImageFromFile (wFile, &saved);
+	assertEqualInt (status, Ok);
+	for (int i = 0; i < 4; i++) {
+		GdipBitmapGetPixel ((GpBitmap *) saved, i % 2, i / 2, &color);
+		assertEqualARGB (color, pixels[i]);
+	}
+
+	GdipDisposeImage (saved);
+	GdipDisposeImage ((GpImage *) bitmap);
+}
+
+static void test_saveWideFormats ()
+{
+	saveWideFormat (PixelFormat48bppRGB);
+	saveWideFormat (PixelFormat64bppARGB);
+	saveWideFormat (PixelFormat64bppPARGB);
+}
+
+static void test_decodeOnFirstUse ()
+{
+	GpStatus status;
+	GpBitmap *bitmap;
+	ARGB color;
+	FILE *f;
+	long size;
+
+	status = GdipCreateBitmapFromScan0 (4, 3, 0, PixelFormat24bppRGB, NULL, &bitmap);
+	assertEqualInt (status, Ok);
+	GdipBitmapSetPixel (bitmap, 2, 1, 0xFF123456);
+	status = GdipSaveImageToFile (bitmap, wFile, &bmpEncoderClsid, NULL);
+	assertEqualInt (status, Ok);
+	GdipDisposeImage ((GpImage *) bitmap);
+
+	status = GdipLoadImageFromFile (wFile, &image);
+	assertEqualInt (status, Ok);
+	status = GdipBitmapGetPixel ((GpBitmap *) image, 2, 1, &color);
+	assertEqualInt (status, Ok);
+	assertEqualARGB (color, 0xFF123456);
+	GdipDisposeImage (image);
+
+	// The pixels are read from the file when they are first used, its errors are returned then.
+	status = GdipLoadImageFromFile (wFile, &image);
+	assertEqualInt (status, Ok);
+	f = fopen (file, "rb+");
+	assert (f);
+	fseek (f, 0, SEEK_END);
+	size = ftell (f);
+	fseek (f, 0, SEEK_SET);
+	for (long i = 0; i < size; i++)
+		fputc ('X', f);
+	fclose (f);
+
+	status = GdipBitmapSetPixel ((GpBitmap *) image, 0, 0, 0xFF000000);
+	assertEqualInt (status, UnknownImageFormat);
+	status = GdipBitmapGetPixel ((GpBitmap *) image, 2, 1, &color);
+	assertEqualInt (status, UnknownImageFormat);
+	GdipDisposeImage (image);
+}
+
 int
 main (int argc, char**argv)
 {
@@ -5319,6 +5395,10 @@ main (int argc, char**argv)
 	test_invalidHeaderSize ();
 	test_invalidImageData ();
 	test_valid ();
+	test_saveWideFormats ();
+#if !defined(USE_WINDOWS_GDIPLUS)
+	test_decodeOnFirstUse ();
+#endif
 
 	deleteFile (file);
 
@@ -198,6 +198,7 @@ static void test_privateAddFontFile ()
 	WCHAR *otfFile;
 	WCHAR *invalidFile;
 	WCHAR *noSuchFile;
+	WCHAR *familyName;
 	INT count;
 	GpFontFamily *families[1];
 	INT numFound;
@@ -208,6 +209,7 @@ static void test_privateAddFontFile ()
 	otfFile = createWchar ("test.otf");
 	invalidFile = createWchar ("test.bmp");
 	noSuchFile = createWchar ("noSuchFile.ttf");
+	familyName = createWchar ("code NEW roman");
 
 	// Valid TTF file.
 	status = GdipPrivateAddFontFile (collection, ttfFile);
@@ -265,6 +267,24 @@ static void test_privateAddFontFile ()
 	assertEqualInt (status, Ok);
 	assertEqualInt (count,  0);
 
+	status = GdipCreateFontFamilyFromName (familyName, collection, &families[0]);
+	assertEqualInt (status, FontFamilyNotFound);
+
+	// Adding a font makes it visible to lookups, names are case insensitive.
+	status = GdipPrivateAddFontFile (collection, ttfFile);
+	assertEqualInt (status, Ok);
+
+	status = GdipCreateFontFamilyFromName (familyName, collection, &families[0]);
+	assertEqualInt (status, Ok);
+	status = GdipGetFamilyName (families[0], name, 0);
+	assertEqualInt (status, Ok);
+	assert (stringsEqual (name, "Code New Roman"));
+	GdipDeleteFontFamily (families[0]);
+
+	status = GdipGetFontCollectionFamilyCount (collection, &count);
+	assertEqualInt (status, Ok);
+	assertEqualInt (count,  1);
+
 	// Negative tests.
 	status = GdipPrivateAddFontFile (NULL, ttfFile);
 	assertEqualInt (status, InvalidParameter);
@@ -280,6 +300,7 @@ static void test_privateAddFontFile ()
 	freeWchar (otfFile);
 	freeWchar (invalidFile);
 	freeWchar (noSuchFile);
+	freeWchar (familyName);
 }
 
 static void test_privateAddMemoryFont ()
@@ -622,6 +643,62 @@ static void test_cloneFont ()
 	GdipDeleteFontFamily (family);
 }
 
+static void test_createManyFonts ()
+{
+	GpStatus status;
+	GpFontFamily *families[3];
+	GpFont *font;
+	GpFont *clonedFont = NULL;
+	GpBitmap *bitmap;
+	GpGraphics *graphics;
+	GpSolidFill *brush;
+	RectF layout = {0, 0, 100, 20};
+	RectF bounds;
+	RectF firstBounds[12];
+	const WCHAR text[] = {'G', 'r', 'i', 'd', 0};
+	int i;
+
+	GdipGetGenericFontFamilySansSerif (&families[0]);
+	GdipGetGenericFontFamilySerif (&families[1]);
+	GdipGetGenericFontFamilyMonospace (&families[2]);
+	GdipCreateBitmapFromScan0 (100, 20, 0, PixelFormat32bppARGB, NULL, &bitmap);
+	GdipGetImageGraphicsContext ((GpImage *) bitmap, &graphics);
+	GdipCreateSolidFill (0xFF000000, &brush);
+
+	// Fonts created per draw call share their faces and measure the same every time.
+	for (i = 0; i < 120; i++) {
+		status = GdipCreateFont (families[i % 3], 12, (i / 3) % 4, UnitPixel, &font);
+		assertEqualInt (status, Ok);
+
+		status = GdipMeasureString (graphics, text, -1, font, &layout, NULL, &bounds, NULL, NULL);
+		assertEqualInt (status, Ok);
+		if (i < 12) {
+			firstBounds[i] = bounds;
+		} else {
+			assertEqualFloat (bounds.Width, firstBounds[i % 12].Width);
+			assertEqualFloat (bounds.Height, firstBounds[i % 12].Height);
+		}
+
+		status = GdipDrawString (graphics, text, -1, font, &layout, NULL, (GpBrush *) brush);
+		assertEqualInt (status, Ok);
+
+		if (i == 5)
+			GdipCloneFont (font, &clonedFont);
+		GdipDeleteFont (font);
+	}
+
+	// A clone outlives the font it was created from.
+	status = GdipDrawString (graphics, text, -1, clonedFont, &layout, NULL, (GpBrush *) brush);
+	assertEqualInt (status, Ok);
+
+	GdipDeleteFont (clonedFont);
+	GdipDeleteBrush ((GpBrush *) brush);
+	GdipDeleteGraphics (graphics);
+	GdipDisposeImage ((GpImage *) bitmap);
+	for (i = 0; i < 3; i++)
+		GdipDeleteFontFamily (families[i]);
+}
+
 static void test_deleteFont ()
 {
 	GpStatus status;
@@ -1203,6 +1280,7 @@ main(int argc, char**argv)
 	test_createFontFromLogfontW ();
 	test_createFont ();
 	test_cloneFont ();
+	test_createManyFonts ();
 	test_deleteFont ();
 	test_getFamily ();
 	test_getFontStyle ();
@@ -497,6 +497,56 @@ static void test_notInitialized ()
 	assertEqualInt (status, GdiplusNotInitialized);
 }
 
+#if !defined(USE_WINDOWS_GDIPLUS) && !defined(WIN32)
+static void useFonts ()
+{
+	GpStatus status;
+	GpFontCollection *collection;
+	GpFontFamily *family;
+	GpFont *font;
+	INT count;
+
+	status = GdipNewInstalledFontCollection (&collection);
+	assertEqualInt (status, Ok);
+	status = GdipGetFontCollectionFamilyCount (collection, &count);
+	assertEqualInt (status, Ok);
+
+	status = GdipGetGenericFontFamilySansSerif (&family);
+	assertEqualInt (status, Ok);
+	status = GdipCreateFont (family, 10, FontStyleRegular, UnitPixel, &font);
+	assertEqualInt (status, Ok);
+
+	GdipDeleteFont (font);
+	GdipDeleteFontFamily (family);
+}
+
+static void test_fontWarmup ()
+{
+	GpStatus status;
+	ULONG_PTR gdiplusToken = 0;
+	GdiplusStartupInput gdiplusStartupInput = {1, NULL, FALSE, FALSE};
+
+	// Fonts can be used while the warm-up thread is still loading them.
+	setenv ("GDIPLUS_FONT_WARMUP", "1", 1);
+	status = GdiplusStartup (&gdiplusToken, &gdiplusStartupInput, NULL);
+	assertEqualInt (status, Ok);
+	useFonts ();
+	GdiplusShutdown (gdiplusToken);
+
+	// Shutting down right away waits for the warm-up thread.
+	status = GdiplusStartup (&gdiplusToken, &gdiplusStartupInput, NULL);
+	assertEqualInt (status, Ok);
+	GdiplusShutdown (gdiplusToken);
+	unsetenv ("GDIPLUS_FONT_WARMUP");
+
+	// Without the warm-up, fontconfig is set up again by the first font call after a restart.
+	status = GdiplusStartup (&gdiplusToken, &gdiplusStartupInput, NULL);
+	assertEqualInt (status, Ok);
+	useFonts ();
+	GdiplusShutdown (gdiplusToken);
+}
+#endif
+
 int
 main (int argc, char**argv)
 {
@@ -507,6 +557,9 @@ main (int argc, char**argv)
 	test_alloc ();
 	test_free ();
 	test_notInitialized ();
+#if !defined(USE_WINDOWS_GDIPLUS) && !defined(WIN32)
+	test_fontWarmup ();
+#endif
 
 	return 0;
 }
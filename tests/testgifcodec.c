@@ -228,6 +228,108 @@ static void test_invalidExtensionRecord ()
   createFile (multipleGraphicsControlBlocks, OutOfMemory);
 }
 
+#if !defined(USE_WINDOWS_GDIPLUS)
+static GUID gifDither = {0x3C5F1D2EU, 0x8A47U, 0x4B9CU, {0xB6, 0xE0, 0x71, 0xD2, 0xF4, 0x9A, 0x8C, 0x53}};
+
+static ARGB fewColors (INT x, INT y)
+{
+  static const ARGB colors[] = {0xFF1E88E5, 0xFFFFFFFF, 0xFF000000, 0xFFE53935, 0xFF43A047};
+  return colors[(x / 3 + y) % 5];
+}
+
+// 200 greys, the darkest ones such as 0x000000 and 0x010101 share their 5-6-5 histogram bin.
+static ARGB greys (INT x, INT y)
+{
+  return 0xFF000000 | (((x + y * 64) % 200) * 0x010101);
+}
+
+static ARGB gradient (INT x, INT y)
+{
+  return 0xFF000000 | ((x * 4) << 16) | ((y * 5) << 8) | 0x80;
+}
+
+// Saves a bitmap that isn't indexed as GIF and returns the largest channel difference
+// and the summed difference after reloading it.
+static INT saveQuantized (PixelFormat format, ARGB (*pixel) (INT x, INT y), INT dither, INT *total)
+{
+  GpStatus status;
+  GpBitmap *bitmap;
+  GpImage *saved;
+  BitmapData data;
+  BitmapData savedData;
+  Rect rect = {0, 0, 64, 48};
+  EncoderParameters params;
+  PixelFormat savedFormat;
+  INT maxDiff = 0;
+  INT x;
+  INT y;
+  INT shift;
+
+  GdipCreateBitmapFromScan0 (64, 48, 0, format, NULL, &bitmap);
+  GdipBitmapLockBits (bitmap, &rect, ImageLockModeWrite, PixelFormat32bppARGB, &data);
+  for (y = 0; y < 48; y++) {
+    ARGB *row = (ARGB *) ((BYTE *) data.Scan0 + y * data.Stride);
+    for (x = 0; x < 64; x++)
+      row[x] = pixel (x, y);
+  }
+  GdipBitmapUnlockBits (bitmap, &data);
+
+  params.Count = 1;
+  params.Parameter[0].Guid = gifDither;
+  params.Parameter[0].NumberOfValues = 1;
+  params.Parameter[0].Type = EncoderParameterValueTypeLong;
+  params.Parameter[0].Value = &dither;
+  status = GdipSaveImageToFile (bitmap, wFile, &gifEncoderClsid, &params);
+  assertEqualInt (status, Ok);
+
+  status = GdipLoadImageFromFile (wFile, &saved);
+  assertEqualInt (status, Ok);
+  GdipGetImagePixelFormat (saved, &savedFormat);
+  assertEqualInt (savedFormat, PixelFormat8bppIndexed);
+
+  *total = 0;
+  GdipBitmapLockBits ((GpBitmap *) saved, &rect, ImageLockModeRead, PixelFormat32bppARGB, &savedData);
+  for (y = 0; y < 48; y++) {
+    ARGB *row = (ARGB *) ((BYTE *) savedData.Scan0 + y * savedData.Stride);
+    for (x = 0; x < 64; x++) {
+      for (shift = 0; shift < 24; shift += 8) {
+        INT diff = abs ((INT) ((row[x] >> shift) & 0xFF) - (INT) ((pixel (x, y) >> shift) & 0xFF));
+        *total += diff;
+        if (diff > maxDiff)
+          maxDiff = diff;
+      }
+    }
+  }
+  GdipBitmapUnlockBits ((GpBitmap *) saved, &savedData);
+
+  GdipDisposeImage (saved);
+  GdipDisposeImage ((GpImage *) bitmap);
+  return maxDiff;
+}
+
+static void test_quantize ()
+{
+  INT total;
+  INT ditheredTotal;
+
+  // Images with few colors keep them exactly.
+  assertEqualInt (saveQuantized (PixelFormat32bppARGB, fewColors, 0, &total), 0);
+  assertEqualInt (saveQuantized (PixelFormat24bppRGB, fewColors, 0, &total), 0);
+  assertEqualInt (saveQuantized (PixelFormat32bppARGB, fewColors, 1, &total), 0);
+  assertEqualInt (saveQuantized (PixelFormat32bppARGB, greys, 0, &total), 0);
+  assertEqualInt (saveQuantized (PixelFormat32bppARGB, greys, 1, &total), 0);
+
+  // 3072 colors are reduced to 256 close ones.
+  assert (saveQuantized (PixelFormat32bppARGB, gradient, 0, &total) <= 24);
+  assert (saveQuantized (PixelFormat24bppRGB, gradient, 0, &total) <= 24);
+  assert (saveQuantized (PixelFormat16bppRGB565, gradient, 0, &total) <= 24);
+
+  // Dithering trades single pixel accuracy for the average color.
+  saveQuantized (PixelFormat32bppARGB, gradient, 1, &ditheredTotal);
+  assert (ditheredTotal <= total * 3);
+}
+#endif
+
 int
 main (int argc, char**argv)
 {
@@ -237,6 +339,9 @@ main (int argc, char**argv)
   test_invalidHeader ();
   test_invalidImageRecord ();
   test_invalidExtensionRecord ();
+#if !defined(USE_WINDOWS_GDIPLUS)
+  test_quantize ();
+#endif
 
   deleteFile (file);
 
@@ -882,6 +882,242 @@ static void test_setImageAttributesCachedBackground()
 	GdipDisposeImageAttributes (attributes);
 }
 
+static void test_drawImageWithAttributes ()
+{
+	GpStatus status;
+	GpImageAttributes *attributes;
+	GpBitmap *source;
+	GpBitmap *target;
+	GpGraphics *graphics;
+	ColorMap remapTable[3] = {
+		{ {0xFFFF0000}, {0xFF00FF00} },
+		{ {0xFF0000FF}, {0xFF818181} },
+		{ {0xFFFF0000}, {0xFF0000FF} }
+	};
+	ARGB sourcePixels[] = {0xFFFF0000, 0xFF0000FF, 0xFF808080, 0xFF818181};
+	ARGB expectedPixels[] = {0xFF00FF00, 0xFFFFFFFF, 0xFF000000, 0xFFFFFFFF};
+
+	GdipCreateBitmapFromScan0 (4, 1, 16, PixelFormat32bppARGB, (BYTE *) sourcePixels, &source);
+	GdipCreateBitmapFromScan0 (4, 1, 0, PixelFormat32bppARGB, NULL, &target);
+	GdipGetImageGraphicsContext ((GpImage *) target, &graphics);
+	GdipCreateImageAttributes (&attributes);
+
+	// Remap (first matching entry wins) followed by threshold.
+	GdipSetImageAttributesRemapTable (attributes, ColorAdjustTypeDefault, TRUE, 3, remapTable);
+	GdipSetImageAttributesThreshold (attributes, ColorAdjustTypeDefault, TRUE, 0.5f);
+
+	status = GdipDrawImageRectRectI (graphics, (GpImage *) source, 0, 0, 4, 1, 0, 0, 4, 1, UnitPixel, attributes, NULL, NULL);
+	assertEqualInt (status, Ok);
+	GdipDeleteGraphics (graphics);
+
+	verifyPixels (target, expectedPixels);
+
+	// The source bitmap is left untouched.
+	verifyPixels (source, sourcePixels);
+
+	GdipDisposeImage ((GpImage *) source);
+	GdipDisposeImage ((GpImage *) target);
+	GdipDisposeImageAttributes (attributes);
+}
+
+static void test_drawImageTiled ()
+{
+	GpStatus status;
+	GpImageAttributes *attributes;
+	GpBitmap *source;
+	GpBitmap *target;
+	GpGraphics *graphics;
+	GpGraphics *sourceGraphics;
+	ARGB sourcePixels[] = {
+		0xFFFF0000, 0xFF00FF00,
+		0xFF0000FF, 0xFFFFFFFF
+	};
+	ARGB flipXYPixels[] = {
+		0xFFFF0000, 0xFF00FF00, 0xFF00FF00, 0xFFFF0000,
+		0xFF0000FF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFF0000FF,
+		0xFF0000FF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFF0000FF,
+		0xFFFF0000, 0xFF00FF00, 0xFF00FF00, 0xFFFF0000
+	};
+	ARGB tilePixels[] = {
+		0xFFFF0000, 0xFF00FF00, 0xFFFF0000, 0xFF00FF00,
+		0xFF0000FF, 0xFFFFFFFF, 0xFF0000FF, 0xFFFFFFFF,
+		0xFFFF0000, 0xFF00FF00, 0xFFFF0000, 0xFF00FF00,
+		0xFF0000FF, 0xFFFFFFFF, 0xFF0000FF, 0xFFFFFFFF
+	};
+	ARGB changedPixels[] = {
+		0xFF000000, 0xFF00FF00, 0xFF00FF00, 0xFF000000,
+		0xFF0000FF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFF0000FF,
+		0xFF0000FF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFF0000FF,
+		0xFF000000, 0xFF00FF00, 0xFF00FF00, 0xFF000000
+	};
+	ARGB clearedPixels[] = {
+		0xFF000000, 0xFF000000, 0xFF000000, 0xFF000000,
+		0xFF000000, 0xFF000000, 0xFF000000, 0xFF000000,
+		0xFF000000, 0xFF000000, 0xFF000000, 0xFF000000,
+		0xFF000000, 0xFF000000, 0xFF000000, 0xFF000000
+	};
+
+	GdipCreateBitmapFromScan0 (2, 2, 8, PixelFormat32bppARGB, (BYTE *) sourcePixels, &source);
+	GdipCreateBitmapFromScan0 (4, 4, 0, PixelFormat32bppARGB, NULL, &target);
+	GdipGetImageGraphicsContext ((GpImage *) target, &graphics);
+	GdipCreateImageAttributes (&attributes);
+
+	GdipSetImageAttributesWrapMode (attributes, WrapModeTileFlipXY, 0, FALSE);
+	status = GdipDrawImageRectRectI (graphics, (GpImage *) source, 0, 0, 4, 4, 0, 0, 2, 2, UnitPixel, attributes, NULL, NULL);
+	assertEqualInt (status, Ok);
+	verifyPixels (target, flipXYPixels);
+
+	GdipSetImageAttributesWrapMode (attributes, WrapModeTile, 0, FALSE);
+	status = GdipDrawImageRectRectI (graphics, (GpImage *) source, 0, 0, 4, 4, 0, 0, 2, 2, UnitPixel, attributes, NULL, NULL);
+	assertEqualInt (status, Ok);
+	verifyPixels (target, tilePixels);
+
+	// The mirrored tile follows the changes of the source.
+	GdipBitmapSetPixel (source, 0, 0, 0xFF000000);
+	GdipSetImageAttributesWrapMode (attributes, WrapModeTileFlipXY, 0, FALSE);
+	status = GdipDrawImageRectRectI (graphics, (GpImage *) source, 0, 0, 4, 4, 0, 0, 2, 2, UnitPixel, attributes, NULL, NULL);
+	assertEqualInt (status, Ok);
+	verifyPixels (target, changedPixels);
+
+	// And what a graphics drew on the source, once it is deleted.
+	GdipGetImageGraphicsContext ((GpImage *) source, &sourceGraphics);
+	GdipGraphicsClear (sourceGraphics, 0xFF000000);
+	GdipDeleteGraphics (sourceGraphics);
+	status = GdipDrawImageRectRectI (graphics, (GpImage *) source, 0, 0, 4, 4, 0, 0, 2, 2, UnitPixel, attributes, NULL, NULL);
+	assertEqualInt (status, Ok);
+	verifyPixels (target, clearedPixels);
+
+	GdipDeleteGraphics (graphics);
+	GdipDisposeImage ((GpImage *) source);
+	GdipDisposeImage ((GpImage *) target);
+	GdipDisposeImageAttributes (attributes);
+}
+
+static GpBitmap *createBitmapWithPixels (PixelFormat format, INT width, ARGB *pixels)
+{
+	GpBitmap *bitmap;
+	BitmapData data;
+	Rect rect = {0, 0, width, 1};
+
+	GdipCreateBitmapFromScan0 (width, 1, 0, format, NULL, &bitmap);
+	GdipBitmapLockBits (bitmap, &rect, ImageLockModeWrite, PixelFormat32bppARGB, &data);
+	memcpy (data.Scan0, pixels, width * sizeof (ARGB));
+	GdipBitmapUnlockBits (bitmap, &data);
+	return bitmap;
+}
+
+static void drawWithAttributes (GpBitmap *source, GpImageAttributes *attributes, INT width, ARGB *expectedPixels)
+{
+	GpStatus status;
+	GpBitmap *target;
+	GpGraphics *graphics;
+
+	GdipCreateBitmapFromScan0 (width, 1, 0, PixelFormat32bppARGB, NULL, &target);
+	GdipGetImageGraphicsContext ((GpImage *) target, &graphics);
+
+	status = GdipDrawImageRectRectI (graphics, (GpImage *) source, 0, 0, width, 1, 0, 0, width, 1, UnitPixel, attributes, NULL, NULL);
+	assertEqualInt (status, Ok);
+	GdipDeleteGraphics (graphics);
+
+	verifyPixels (target, expectedPixels);
+	GdipDisposeImage ((GpImage *) target);
+}
+
+static void test_drawImageWithColorMatrix ()
+{
+	GpImageAttributes *attributes;
+	GpBitmap *source;
+	ColorMatrix swapRedBlue = {{
+		{0, 0, 1, 0, 0},
+		{0, 1, 0, 0, 0},
+		{1, 0, 0, 0, 0},
+		{0, 0, 0, 1, 0},
+		{0, 0, 0, 0, 1}
+	}};
+	PixelFormat formats[] = {
+		PixelFormat32bppARGB, PixelFormat32bppPARGB, PixelFormat32bppRGB, PixelFormat24bppRGB,
+		PixelFormat16bppRGB555, PixelFormat16bppRGB565, PixelFormat16bppARGB1555,
+		PixelFormat48bppRGB, PixelFormat64bppARGB, PixelFormat64bppPARGB
+	};
+	ARGB sourcePixels[] = {0xFFFF0000, 0xFF00FF00, 0xFF0000FF, 0xFFFFFFFF};
+	ARGB expectedPixels[] = {0xFF0000FF, 0xFF00FF00, 0xFFFF0000, 0xFFFFFFFF};
+	BYTE indices[] = {0, 1, 2, 3};
+	ColorPalette *palette = (ColorPalette *) malloc (sizeof (ColorPalette) + 3 * sizeof (ARGB));
+
+	GdipCreateImageAttributes (&attributes);
+	GdipSetImageAttributesColorMatrix (attributes, ColorAdjustTypeDefault, TRUE, &swapRedBlue, NULL, ColorMatrixFlagsDefault);
+
+	// Formats not stored with 32 bits per pixel go through 32bppARGB.
+	for (int i = 0; i < sizeof (formats) / sizeof (formats[0]); i++) {
+		source = createBitmapWithPixels (formats[i], 4, sourcePixels);
+		drawWithAttributes (source, attributes, 4, expectedPixels);
+		GdipDisposeImage ((GpImage *) source);
+	}
+
+	// New colours of indexed bitmaps don't have to be in their palette.
+	palette->Flags = 0;
+	palette->Count = 4;
+	memcpy (palette->Entries, sourcePixels, 4 * sizeof (ARGB));
+	GdipCreateBitmapFromScan0 (4, 1, 4, PixelFormat8bppIndexed, indices, &source);
+	GdipSetImagePalette ((GpImage *) source, palette);
+	drawWithAttributes (source, attributes, 4, expectedPixels);
+	GdipDisposeImage ((GpImage *) source);
+
+	free (palette);
+	GdipDisposeImageAttributes (attributes);
+}
+
+static void test_drawImageWithGamma ()
+{
+	GpImageAttributes *attributes;
+	GpBitmap *source;
+	PixelFormat formats[] = {PixelFormat32bppARGB, PixelFormat32bppPARGB, PixelFormat24bppRGB, PixelFormat48bppRGB};
+	ARGB sourcePixels[] = {0xFF808080, 0xFFFF0000, 0xFF000000};
+	ARGB expectedPixels[] = {0xFF404040, 0xFFFF0000, 0xFF000000};
+
+	GdipCreateImageAttributes (&attributes);
+	GdipSetImageAttributesGamma (attributes, ColorAdjustTypeDefault, TRUE, 2.0f);
+
+	for (int i = 0; i < sizeof (formats) / sizeof (formats[0]); i++) {
+		source = createBitmapWithPixels (formats[i], 3, sourcePixels);
+		drawWithAttributes (source, attributes, 3, expectedPixels);
+		GdipDisposeImage ((GpImage *) source);
+	}
+
+	GdipDisposeImageAttributes (attributes);
+}
+
+static void test_drawImageWithColorKey ()
+{
+	GpImageAttributes *attributes;
+	GpBitmap *source;
+	PixelFormat formats[] = {
+		PixelFormat32bppARGB, PixelFormat32bppPARGB, PixelFormat24bppRGB, PixelFormat32bppRGB,
+		PixelFormat16bppRGB565, PixelFormat16bppARGB1555, PixelFormat48bppRGB, PixelFormat64bppARGB
+	};
+	ARGB sourcePixels[] = {0xFF000000, 0xFFFFFFFF, 0xFF0000FF, 0xFFFF0000};
+	ARGB expectedPixels[] = {0x00000000, 0xFFFFFFFF, 0x00000000, 0xFFFF0000};
+	BYTE bits[] = {0x50};
+	ARGB expectedBits[] = {0x00000000, 0xFFFFFFFF, 0x00000000, 0xFFFFFFFF};
+
+	GdipCreateImageAttributes (&attributes);
+	GdipSetImageAttributesColorKeys (attributes, ColorAdjustTypeDefault, TRUE, 0xFF000000, 0xFF0000FF);
+
+	// Keyed pixels become transparent, even in formats without alpha.
+	for (int i = 0; i < sizeof (formats) / sizeof (formats[0]); i++) {
+		source = createBitmapWithPixels (formats[i], 4, sourcePixels);
+		drawWithAttributes (source, attributes, 4, expectedPixels);
+		GdipDisposeImage ((GpImage *) source);
+	}
+
+	// Black and white.
+	GdipCreateBitmapFromScan0 (4, 1, 4, PixelFormat1bppIndexed, bits, &source);
+	drawWithAttributes (source, attributes, 4, expectedBits);
+	GdipDisposeImage ((GpImage *) source);
+
+	GdipDisposeImageAttributes (attributes);
+}
+
 int
 main (int argc, char**argv)
 {
@@ -904,6 +1140,11 @@ main (int argc, char**argv)
 	test_setImageAttributesICMMode ();
 	test_getImageAttributesAdjustedPalette ();
 	test_setImageAttributesCachedBackground ();
+	test_drawImageWithAttributes ();
+	test_drawImageTiled ();
+	test_drawImageWithColorMatrix ();
+	test_drawImageWithGamma ();
+	test_drawImageWithColorKey ();
 
 	SHUTDOWN;
 	return 0;
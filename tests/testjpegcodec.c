@@ -407,6 +407,261 @@ static void test_units ()
     createFileSuccess (unknownUnit, PixelFormat24bppRGB, 1, 1, ImageFlagsColorSpaceRGB | ImageFlagsHasRealPixelSize | ImageFlagsReadOnly, 2);
 }
 
+static void test_decodeOnAccess ()
+{
+    GpStatus status;
+    GpImage *image;
+    GpImage *other;
+    GpImage *thumbnail;
+    UINT width;
+    UINT height;
+    ARGB color;
+    ARGB otherColor;
+    BitmapData data;
+    Rect rect = {0, 0, 100, 68};
+    WCHAR *jpegFile = createWchar ("test.jpg");
+
+    status = GdipLoadImageFromFile (jpegFile, &image);
+    assertEqualInt (status, Ok);
+    status = GdipLoadImageFromFile (jpegFile, &other);
+    assertEqualInt (status, Ok);
+
+    // The header is available before the pixels are used.
+    GdipGetImageWidth (image, &width);
+    GdipGetImageHeight (image, &height);
+    assertEqualInt (width, 100);
+    assertEqualInt (height, 68);
+
+    status = GdipGetImageThumbnail (image, 20, 10, &thumbnail, NULL, NULL);
+    assertEqualInt (status, Ok);
+    GdipGetImageWidth (thumbnail, &width);
+    GdipGetImageHeight (thumbnail, &height);
+    assertEqualInt (width, 20);
+    assertEqualInt (height, 10);
+    GdipDisposeImage (thumbnail);
+
+    // The thumbnail doesn't replace the full size pixels.
+    status = GdipBitmapLockBits ((GpBitmap *) image, &rect, ImageLockModeRead, PixelFormat24bppRGB, &data);
+    assertEqualInt (status, Ok);
+    assertEqualInt (data.Width, 100);
+    assertEqualInt (data.Height, 68);
+    GdipBitmapUnlockBits ((GpBitmap *) image, &data);
+
+    status = GdipBitmapGetPixel ((GpBitmap *) image, 50, 30, &color);
+    assertEqualInt (status, Ok);
+    status = GdipBitmapGetPixel ((GpBitmap *) other, 50, 30, &otherColor);
+    assertEqualInt (status, Ok);
+    assertEqualInt (color, otherColor);
+
+    GdipDisposeImage (image);
+    GdipDisposeImage (other);
+    freeWchar (jpegFile);
+}
+
+static void test_lockRegion ()
+{
+    GpStatus status;
+    GpImage *image;
+    GpImage *other;
+    BitmapData data;
+    BitmapData otherData;
+    Rect rect = {0, 0, 100, 68};
+    Rect region = {37, 21, 40, 30};
+    ARGB color;
+    ARGB otherColor;
+    INT y;
+    WCHAR *jpegFile = createWchar ("test.jpg");
+
+    status = GdipLoadImageFromFile (jpegFile, &image);
+    assertEqualInt (status, Ok);
+    status = GdipLoadImageFromFile (jpegFile, &other);
+    assertEqualInt (status, Ok);
+
+    // A read only lock of a part of the image gives the same pixels as the whole image.
+    status = GdipBitmapLockBits ((GpBitmap *) image, &region, ImageLockModeRead, PixelFormat32bppARGB, &data);
+    assertEqualInt (status, Ok);
+    assertEqualInt (data.Width, 40);
+    assertEqualInt (data.Height, 30);
+    status = GdipBitmapLockBits ((GpBitmap *) other, &rect, ImageLockModeRead, PixelFormat32bppARGB, &otherData);
+    assertEqualInt (status, Ok);
+    for (y = 0; y < region.Height; y++) {
+        BYTE *row = (BYTE *) data.Scan0 + y * data.Stride;
+        BYTE *otherRow = (BYTE *) otherData.Scan0 + (y + region.Y) * otherData.Stride + region.X * 4;
+        assert (memcmp (row, otherRow, region.Width * 4) == 0);
+    }
+    GdipBitmapUnlockBits ((GpBitmap *) other, &otherData);
+    GdipBitmapUnlockBits ((GpBitmap *) image, &data);
+
+    // The rest of the image is still available afterwards.
+    status = GdipBitmapGetPixel ((GpBitmap *) image, 5, 60, &color);
+    assertEqualInt (status, Ok);
+    status = GdipBitmapGetPixel ((GpBitmap *) other, 5, 60, &otherColor);
+    assertEqualInt (status, Ok);
+    assertEqualInt (color, otherColor);
+
+    GdipDisposeImage (image);
+    GdipDisposeImage (other);
+    freeWchar (jpegFile);
+}
+
+#if !defined(USE_WINDOWS_GDIPLUS)
+static void test_loadScaled ()
+{
+    GpStatus status;
+    GpImage *scaled;
+    UINT width;
+    UINT height;
+    UINT flags;
+    WCHAR *jpegFile = createWchar ("test.jpg");
+
+    // test.jpg is 100x68, a quarter of it still covers 20x10.
+    status = GdipLoadImageFromFileScaled_linux (jpegFile, 20, 10, &scaled);
+    assertEqualInt (status, Ok);
+    GdipGetImageWidth (scaled, &width);
+    GdipGetImageHeight (scaled, &height);
+    assertEqualInt (width, 25);
+    assertEqualInt (height, 17);
+    GdipGetImageFlags (scaled, &flags);
+    assert (!(flags & ImageFlagsHasRealPixelSize));
+    GdipDisposeImage (scaled);
+
+    // Too large to scale down.
+    status = GdipLoadImageFromFileScaled_linux (jpegFile, 60, 10, &scaled);
+    assertEqualInt (status, Ok);
+    GdipGetImageWidth (scaled, &width);
+    GdipGetImageHeight (scaled, &height);
+    assertEqualInt (width, 100);
+    assertEqualInt (height, 68);
+    GdipGetImageFlags (scaled, &flags);
+    assert (flags & ImageFlagsHasRealPixelSize);
+    GdipDisposeImage (scaled);
+
+    freeWchar (jpegFile);
+}
+
+static void test_transcode ()
+{
+    GpStatus status;
+    GpImage *image;
+    UINT width;
+    UINT height;
+    WCHAR *jpegFile = createWchar ("test.jpg");
+    WCHAR *pngFile = createWchar ("transcoded.png");
+    WCHAR *bmpFile = createWchar ("transcoded.bmp");
+
+    // Streamed from JPEG to PNG, the height follows the aspect ratio.
+    status = GdipTranscodeImageFile_linux (jpegFile, pngFile, &pngEncoderClsid, NULL, 0, 50, 0);
+    assertEqualInt (status, Ok);
+    status = GdipLoadImageFromFile (pngFile, &image);
+    assertEqualInt (status, Ok);
+    GdipGetImageWidth (image, &width);
+    GdipGetImageHeight (image, &height);
+    assertEqualInt (width, 50);
+    assertEqualInt (height, 34);
+    GdipDisposeImage (image);
+
+    // BMP has no row writer and is saved from a whole bitmap.
+    status = GdipTranscodeImageFile_linux (pngFile, bmpFile, &bmpEncoderClsid, NULL, PixelFormat24bppRGB, 120, 70);
+    assertEqualInt (status, Ok);
+    status = GdipLoadImageFromFile (bmpFile, &image);
+    assertEqualInt (status, Ok);
+    GdipGetImageWidth (image, &width);
+    GdipGetImageHeight (image, &height);
+    assertEqualInt (width, 120);
+    assertEqualInt (height, 70);
+    GdipDisposeImage (image);
+
+    status = GdipTranscodeImageFile_linux (jpegFile, pngFile, &pngEncoderClsid, NULL, PixelFormat8bppIndexed, 0, 0);
+    assertEqualInt (status, InvalidParameter);
+
+    status = GdipTranscodeImageFile_linux (NULL, pngFile, &pngEncoderClsid, NULL, 0, 0, 0);
+    assertEqualInt (status, InvalidParameter);
+
+    deleteFile ("transcoded.png");
+    deleteFile ("transcoded.bmp");
+    freeWchar (jpegFile);
+    freeWchar (pngFile);
+    freeWchar (bmpFile);
+}
+
+static void test_truncatedBeforeDecode ()
+{
+    GpStatus status;
+    GpImage *image;
+    BitmapData data;
+    Rect rect = {0, 0, 100, 68};
+    Rect region = {37, 21, 40, 30};
+    BYTE buffer[8192];
+    size_t size;
+    UINT width;
+    FILE *src = fopen ("test.jpg", "rb");
+    FILE *dest = fopen (file, "wb");
+    assert (src && dest);
+    while ((size = fread (buffer, 1, sizeof (buffer), src)) > 0)
+        fwrite (buffer, 1, size, dest);
+    fclose (src);
+    fclose (dest);
+
+    status = GdipLoadImageFromFile (wFile, &image);
+    assertEqualInt (status, Ok);
+
+    // The pixels were not decoded yet, the file is read again when they are used, in its current state.
+    dest = fopen (file, "wb");
+    assert (dest);
+    fclose (dest);
+
+    status = GdipBitmapLockBits ((GpBitmap *) image, &region, ImageLockModeRead, PixelFormat32bppARGB, &data);
+    assert (status != Ok);
+    status = GdipBitmapLockBits ((GpBitmap *) image, &rect, ImageLockModeRead, PixelFormat32bppARGB, &data);
+    assert (status != Ok);
+
+    // A failed decode doesn't leave the bitmap locked.
+    status = GdipBitmapLockBits ((GpBitmap *) image, &rect, ImageLockModeRead, PixelFormat32bppARGB, &data);
+    assert (status != Ok && status != WrongState);
+    GdipGetImageWidth (image, &width);
+    assertEqualInt (width, 100);
+
+    GdipDisposeImage (image);
+    deleteFile (file);
+}
+static void test_saveWideFormats ()
+{
+    GpStatus status;
+    GpBitmap *bitmap;
+    GpImage *saved;
+    PixelFormat formats[] = {PixelFormat48bppRGB, PixelFormat64bppARGB, PixelFormat64bppPARGB};
+    PixelFormat savedFormat;
+    ARGB color;
+    UINT width;
+
+    for (int i = 0; i < sizeof (formats) / sizeof (formats[0]); i++) {
+        status = GdipCreateBitmapFromScan0 (16, 8, 0, formats[i], NULL, &bitmap);
+        assertEqualInt (status, Ok);
+        for (int y = 0; y < 8; y++)
+            for (int x = 0; x < 16; x++)
+                GdipBitmapSetPixel (bitmap, x, y, 0xFF3366CC);
+
+        // 16 bits per channel are saved with 8, JPEG is lossy so only check the color roughly.
+        status = GdipSaveImageToFile (bitmap, wFile, &jpegEncoderClsid, NULL);
+        assertEqualInt (status, Ok);
+
+        status = GdipLoadImageFromFile (wFile, &saved);
+        assertEqualInt (status, Ok);
+        GdipGetImagePixelFormat (saved, &savedFormat);
+        assertEqualInt (savedFormat, PixelFormat24bppRGB);
+        GdipGetImageWidth (saved, &width);
+        assertEqualInt (width, 16);
+        GdipBitmapGetPixel ((GpBitmap *) saved, 8, 4, &color);
+        assert (abs ((int) ((color >> 16) & 0xFF) - 0x33) < 8);
+        assert (abs ((int) ((color >> 8) & 0xFF) - 0x66) < 8);
+        assert (abs ((int) (color & 0xFF) - 0xCC) < 8);
+
+        GdipDisposeImage (saved);
+        GdipDisposeImage ((GpImage *) bitmap);
+    }
+}
+#endif
+
 int
 main (int argc, char**argv)
 {
@@ -414,6 +669,14 @@ main (int argc, char**argv)
 
   test_valid ();
   test_units ();
+  test_decodeOnAccess ();
+  test_lockRegion ();
+#if !defined(USE_WINDOWS_GDIPLUS)
+  test_loadScaled ();
+  test_transcode ();
+  test_truncatedBeforeDecode ();
+  test_saveWideFormats ();
+#endif
 
   deleteFile (file);
 
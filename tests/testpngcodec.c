@@ -817,6 +817,175 @@ static void test_invalidImageFormat()
 	createFile (indexed16bpp, OutOfMemory);
 }
 
+#if !defined(USE_WINDOWS_GDIPLUS)
+static GUID pngCompressionLevel = {0x55273C16U, 0xA11EU, 0x4EB0U, {0x8F, 0xD8, 0x2F, 0x05, 0xE7, 0x5E, 0xC1, 0x0F}};
+static GUID pngFilter = {0xCE9D2466U, 0x11B4U, 0x4355U, {0xA0, 0x97, 0x6E, 0x53, 0x20, 0xD1, 0x4F, 0x00}};
+static GUID pngParallel = {0x638A7A4DU, 0x570BU, 0x46E7U, {0x81, 0x0B, 0x05, 0x47, 0x87, 0xDD, 0x41, 0x69}};
+
+static void saveAndCompare (PixelFormat format, INT width, INT height, INT level, INT filter, INT parallel)
+{
+	GpStatus status;
+	GpBitmap *bitmap;
+	GpImage *saved;
+	BitmapData data;
+	BitmapData savedData;
+	Rect rect = {0, 0, width, height};
+	EncoderParameters *params = (EncoderParameters *) malloc (sizeof (EncoderParameters) + 2 * sizeof (EncoderParameter));
+	INT x;
+	INT y;
+
+	GdipCreateBitmapFromScan0 (width, height, 0, format, NULL, &bitmap);
+	GdipBitmapLockBits (bitmap, &rect, ImageLockModeWrite, PixelFormat32bppARGB, &data);
+	for (y = 0; y < height; y++) {
+		ARGB *row = (ARGB *) ((BYTE *) data.Scan0 + y * data.Stride);
+		for (x = 0; x < width; x++)
+			row[x] = ((ARGB) ((x * 7 + y) | 0x80) << 24) | ((x / 8) << 16) | ((x ^ y) << 8) | (y & 0xF0);
+	}
+	GdipBitmapUnlockBits (bitmap, &data);
+
+	params->Count = 3;
+	params->Parameter[0].Guid = pngCompressionLevel;
+	params->Parameter[0].NumberOfValues = 1;
+	params->Parameter[0].Type = EncoderParameterValueTypeLong;
+	params->Parameter[0].Value = &level;
+	params->Parameter[1].Guid = pngFilter;
+	params->Parameter[1].NumberOfValues = 1;
+	params->Parameter[1].Type = EncoderParameterValueTypeLong;
+	params->Parameter[1].Value = &filter;
+	params->Parameter[2].Guid = pngParallel;
+	params->Parameter[2].NumberOfValues = 1;
+	params->Parameter[2].Type = EncoderParameterValueTypeLong;
+	params->Parameter[2].Value = &parallel;
+
+	status = GdipSaveImageToFile (bitmap, wFile, &pngEncoderClsid, params);
+	assertEqualInt (status, Ok);
+
+	status = GdipLoadImageFromFile (wFile, &saved);
+	assertEqualInt (status, Ok);
+
+	GdipBitmapLockBits (bitmap, &rect, ImageLockModeRead, PixelFormat32bppARGB, &data);
+	GdipBitmapLockBits ((GpBitmap *) saved, &rect, ImageLockModeRead, PixelFormat32bppARGB, &savedData);
+	for (y = 0; y < height; y++)
+		assert (memcmp ((BYTE *) data.Scan0 + y * data.Stride, (BYTE *) savedData.Scan0 + y * savedData.Stride, width * 4) == 0);
+	GdipBitmapUnlockBits ((GpBitmap *) saved, &savedData);
+	GdipBitmapUnlockBits (bitmap, &data);
+
+	GdipDisposeImage (saved);
+	GdipDisposeImage ((GpImage *) bitmap);
+	free (params);
+}
+
+static void test_encoderOptions ()
+{
+	GpStatus status;
+	GpBitmap *bitmap;
+	EncoderParameters params;
+	INT level = 10;
+
+	// Large enough to be deflated on several threads.
+	saveAndCompare (PixelFormat32bppARGB, 1100, 1000, 9, 0x1F, 1);
+	saveAndCompare (PixelFormat24bppRGB, 1100, 1000, 1, 0x02 | 0x10, 1);
+	saveAndCompare (PixelFormat32bppARGB, 33, 21, 0, 0x04, 1);
+	saveAndCompare (PixelFormat24bppRGB, 33, 21, 6, 0x08, 0);
+
+	GdipCreateBitmapFromScan0 (10, 10, 0, PixelFormat32bppARGB, NULL, &bitmap);
+	params.Count = 1;
+	params.Parameter[0].Guid = pngCompressionLevel;
+	params.Parameter[0].NumberOfValues = 1;
+	params.Parameter[0].Type = EncoderParameterValueTypeLong;
+	params.Parameter[0].Value = &level;
+	status = GdipSaveImageToFile (bitmap, wFile, &pngEncoderClsid, &params);
+	assertEqualInt (status, InvalidParameter);
+	GdipDisposeImage ((GpImage *) bitmap);
+}
+static void saveWideFormat (PixelFormat format, PixelFormat expectedFormat)
+{
+	GpStatus status;
+	GpBitmap *bitmap;
+	GpImage *saved;
+	PixelFormat savedFormat;
+	ARGB pixels[] = {0xFF000000, 0xFFFFFFFF, 0x80FF8000, 0xFF12AB34};
+	ARGB color;
+
+	status = GdipCreateBitmapFromScan0 (2, 2, 0, format, NULL, &bitmap);
+	assertEqualInt (status, Ok);
+	for (int i = 0; i < 4; i++) {
+		// Only straight alpha round-trips exactly.
+		if (format != PixelFormat64bppARGB)
+			pixels[i] |= 0xFF000000;
+		GdipBitmapSetPixel (bitmap, i % 2, i / 2, pixels[i]);
+	}
+
+	// 16 bits per channel are saved with 8.
+	status = GdipSaveImageToFile (bitmap, wFile, &pngEncoderClsid, NULL);
+	assertEqualInt (status, Ok);
+
+	status = GdipLoadImageFromFile (wFile, &saved);
+	assertEqualInt (status, Ok);
+	GdipGetImagePixelFormat (saved, &savedFormat);
+	assertEqualInt (savedFormat, expectedFormat);
+	for (int i = 0; i < 4; i++) {
+		GdipBitmapGetPixel ((GpBitmap *) saved, i % 2, i / 2, &color);
+		assertEqualARGB (color, pixels[i]);
+	}
+
+	GdipDisposeImage (saved);
+	GdipDisposeImage ((GpImage *) bitmap);
+}
+
+static void test_saveWideFormats ()
+{
+	saveWideFormat (PixelFormat48bppRGB, PixelFormat24bppRGB);
+	saveWideFormat (PixelFormat64bppARGB, PixelFormat32bppARGB);
+	saveWideFormat (PixelFormat64bppPARGB, PixelFormat32bppARGB);
+}
+static void test_decodeOnFirstUse ()
+{
+	GpStatus status;
+	GpBitmap *bitmap;
+	ARGB color;
+	BYTE buffer[4096];
+	size_t size;
+	FILE *f;
+
+	status = GdipCreateBitmapFromScan0 (40, 30, 0, PixelFormat32bppARGB, NULL, &bitmap);
+	assertEqualInt (status, Ok);
+	GdipBitmapSetPixel (bitmap, 20, 10, 0x80123456);
+	status = GdipSaveImageToFile (bitmap, wFile, &pngEncoderClsid, NULL);
+	assertEqualInt (status, Ok);
+	GdipDisposeImage ((GpImage *) bitmap);
+
+	f = fopen (file, "rb");
+	assert (f);
+	size = fread (buffer, 1, sizeof (buffer), f);
+	fclose (f);
+	assert (size < sizeof (buffer));
+
+	status = GdipLoadImageFromFile (wFile, &image);
+	assertEqualInt (status, Ok);
+	status = GdipBitmapGetPixel ((GpBitmap *) image, 20, 10, &color);
+	assertEqualInt (status, Ok);
+	assertEqualARGB (color, 0x80123456);
+	GdipDisposeImage (image);
+
+	// The pixels are read from the file when they are first used, its errors are returned then.
+	status = GdipLoadImageFromFile (wFile, &image);
+	assertEqualInt (status, Ok);
+	f = fopen (file, "wb");
+	assert (f);
+	fwrite (buffer, 1, size - 20, f);
+	fclose (f);
+
+	status = GdipBitmapSetPixel ((GpBitmap *) image, 0, 0, 0xFF000000);
+	assert (status != Ok);
+	GdipDisposeImage (image);
+
+	// Files that are already incomplete fail to load.
+	status = GdipLoadImageFromFile (wFile, &image);
+	assertEqualInt (status, OutOfMemory);
+}
+#endif
+
 int
 main (int argc, char**argv)
 {
@@ -832,6 +1001,11 @@ main (int argc, char**argv)
 	test_invalidHeaderChunk ();
 	test_invalidImageData ();
 	test_invalidImageFormat ();
+#if !defined(USE_WINDOWS_GDIPLUS)
+	test_encoderOptions ();
+	test_saveWideFormats ();
+	test_decodeOnFirstUse ();
+#endif
 
 	deleteFile (file);
 
@@ -3734,13 +3734,8 @@ static void test_getRegionScans ()
 	count = 0xFF;
 	status = GdipGetRegionScans (region, scans, &count, matrix);
 	assertEqualInt (status, Ok);
-#if defined(USE_WINDOWS_GDIPLUS)
 	assertEqualFloat (scans[0].X, 11);
 	assertEqualFloat (scans[0].Y, 21);
-#else
-	assertEqualFloat (scans[0].X, 10);
-	assertEqualFloat (scans[0].Y, 20);
-#endif
 	assertEqualFloat (scans[0].Width, 30);
 	assertEqualFloat (scans[0].Height, 40);
 	assertEqualInt (count, 1);
@@ -3756,24 +3751,11 @@ static void test_getRegionScans ()
 	count = 0xFF;
 	status = GdipGetRegionScans (region, scans, &count, matrix);
 	assertEqualInt (status, Ok);
-	// FIXME: these are incorrect: https://github.com/mono/libgdiplus/issues/430
-#if defined(USE_WINDOWS_GDIPLUS)
 	assertEqualFloat (scans[0].X, 11);
 	assertEqualFloat (scans[0].Y, 21);
 	assertEqualFloat (scans[0].Width, 30);
 	assertEqualFloat (scans[0].Height, 40);
 	assertEqualInt (count, 1);
-#else
-	assertEqualFloat (scans[0].X, 11);
-	assertEqualFloat (scans[0].Y, 20);
-	assertEqualFloat (scans[0].Width, 30);
-	assertEqualFloat (scans[0].Height, 1);
-	assertEqualFloat (scans[1].X, 10);
-	assertEqualFloat (scans[1].Y, 21);
-	assertEqualFloat (scans[1].Width, 31);
-	assertEqualFloat (scans[1].Height, 39);
-	assertEqualInt (count, 2);
-#endif
 	
 	GdipDeletePath (path);
 	GdipDeleteRegion (region);
@@ -3788,14 +3770,8 @@ static void test_getRegionScans ()
 	assertEqualInt (status, Ok);
 	assertEqualFloat (scans[0].X, 11);
 	assertEqualFloat (scans[0].Y, 21);
-	// FIXME: these are incorrect.
-#if defined(USE_WINDOWS_GDIPLUS)
 	assertEqualFloat (scans[0].Width, 31);
 	assertEqualFloat (scans[0].Height, 41);
-#else
-	assertEqualFloat (scans[0].Width, 30);
-	assertEqualFloat (scans[0].Height, 39);
-#endif
 	assertEqualInt (count, 1);
 	
 	GdipDeletePath (path);
@@ -4007,11 +3983,8 @@ static void test_getRegionScansI ()
 	count = 0xFF;
 	status = GdipGetRegionScansI (region, scans, &count, matrix);
 	assertEqualInt (status, Ok);
-	// FIXME: these are incorrect.
-#if defined(USE_WINDOWS_GDIPLUS)
 	assertEqualInt (scans[0].X, 11);
 	assertEqualInt (scans[0].Y, 21);
-#endif
 	assertEqualInt (scans[0].Width, 30);
 	assertEqualInt (scans[0].Height, 40);
 	assertEqualInt (count, 1);
@@ -4027,14 +4000,11 @@ static void test_getRegionScansI ()
 	count = 0xFF;
 	status = GdipGetRegionScansI (region, scans, &count, matrix);
 	assertEqualInt (status, Ok);
-	// FIXME: these are incorrect: https://github.com/mono/libgdiplus/issues/430
-#if defined(USE_WINDOWS_GDIPLUS)
 	assertEqualInt (scans[0].X, 11);
 	assertEqualInt (scans[0].Y, 21);
 	assertEqualInt (scans[0].Width, 30);
 	assertEqualInt (scans[0].Height, 40);
 	assertEqualInt (count, 1);
-#endif
 	
 	GdipDeletePath (path);
 	GdipDeleteRegion (region);
@@ -4047,14 +4017,11 @@ static void test_getRegionScansI ()
 	count = 0xFF;
 	status = GdipGetRegionScansI (region, scans, &count, matrix);
 	assertEqualInt (status, Ok);
-	// FIXME: these are incorrect: https://github.com/mono/libgdiplus/issues/430
-#if defined(USE_WINDOWS_GDIPLUS)
 	assertEqualInt (scans[0].X, 11);
 	assertEqualInt (scans[0].Y, 21);
 	assertEqualInt (scans[0].Width, 31);
 	assertEqualInt (scans[0].Height, 41);
 	assertEqualInt (count, 1);
-#endif
 	
 	GdipDeletePath (path);
 	GdipDeleteRegion (region);
@@ -8443,6 +8410,202 @@ static void test_combineComplement ()
 	GdipDeletePath (negativePath);
 }
 
+static void test_combineFarApartPaths ()
+{
+	GpStatus status;
+	GpRegion *region;
+	BOOL isVisible;
+	RectF rect = {0, 0, 10, 10};
+	RectF farRect = {100000, 100000, 10, 10};
+	RectF tallRect = {5, -100000, 2, 200000};
+	GpPath *path = createPathFromRect (&rect);
+	GpPath *farPath = createPathFromRect (&farRect);
+	GpPath *tallPath = createPathFromRect (&tallRect);
+
+	// The bounds of the result are much too large for a 1bpp bitmap.
+	GdipCreateRegionPath (path, &region);
+	status = GdipCombineRegionPath (region, farPath, CombineModeUnion);
+	assertEqualInt (status, Ok);
+
+	RectF unionScans[] = {
+		{0, 0, 10, 10},
+		{100000, 100000, 10, 10}
+	};
+	verifyRegionScans (region, unionScans, sizeof (unionScans));
+
+	status = GdipIsVisibleRegionPoint (region, 100005, 100005, graphics, &isVisible);
+	assertEqualInt (status, Ok);
+	assert (isVisible);
+
+	status = GdipIsVisibleRegionPoint (region, 50000, 50000, graphics, &isVisible);
+	assertEqualInt (status, Ok);
+	assert (!isVisible);
+
+	status = GdipCombineRegionPath (region, tallPath, CombineModeXor);
+	assertEqualInt (status, Ok);
+
+	RectF xorScans[] = {
+		{5, -100000, 2, 100000},
+		{0, 0, 5, 10},
+		{7, 0, 3, 10},
+		{5, 10, 2, 99990},
+		{100000, 100000, 10, 10}
+	};
+	verifyRegionScans (region, xorScans, sizeof (xorScans));
+
+	status = GdipCombineRegionPath (region, farPath, CombineModeExclude);
+	assertEqualInt (status, Ok);
+
+	status = GdipIsVisibleRegionPoint (region, 100005, 100005, graphics, &isVisible);
+	assertEqualInt (status, Ok);
+	assert (!isVisible);
+
+	status = GdipIsVisibleRegionPoint (region, 6, -50000, graphics, &isVisible);
+	assertEqualInt (status, Ok);
+	assert (isVisible);
+
+	GdipDeleteRegion (region);
+	GdipDeletePath (path);
+	GdipDeletePath (farPath);
+	GdipDeletePath (tallPath);
+}
+
+static void test_combineDeferred ()
+{
+	GpStatus status;
+	GpRegion *region;
+	GpRegion *clone;
+	BOOL isEmpty;
+	RectF rect = {0, 0, 10, 10};
+	RectF rightRect = {20, 0, 10, 10};
+	GpPath *path = createPathFromRect (&rect);
+	GpPath *rightPath = createPathFromRect (&rightRect);
+
+	// The bitmap of the region is kept while more paths are combined.
+	GdipCreateRegionPath (path, &region);
+	RectF scans[] = {
+		{0, 0, 10, 10}
+	};
+	verifyRegionScans (region, scans, sizeof (scans));
+
+	status = GdipCombineRegionPath (region, rightPath, CombineModeUnion);
+	assertEqualInt (status, Ok);
+
+	status = GdipTranslateRegion (region, 5, 0);
+	assertEqualInt (status, Ok);
+
+	RectF translatedScans[] = {
+		{5, 0, 10, 10},
+		{25, 0, 10, 10}
+	};
+	verifyRegionScans (region, translatedScans, sizeof (translatedScans));
+
+	// Combine with a copy, then with itself.
+	GdipCloneRegion (region, &clone);
+	status = GdipCombineRegionPath (clone, path, CombineModeExclude);
+	assertEqualInt (status, Ok);
+
+	status = GdipCombineRegionRegion (region, clone, CombineModeIntersect);
+	assertEqualInt (status, Ok);
+
+	RectF intersectScans[] = {
+		{10, 0, 5, 10},
+		{25, 0, 10, 10}
+	};
+	verifyRegionScans (region, intersectScans, sizeof (intersectScans));
+
+	status = GdipCombineRegionRegion (region, region, CombineModeXor);
+	assertEqualInt (status, Ok);
+
+	status = GdipIsEmptyRegion (region, graphics, &isEmpty);
+	assertEqualInt (status, Ok);
+	assert (isEmpty);
+
+	GdipDeleteRegion (region);
+	GdipDeleteRegion (clone);
+	GdipDeletePath (path);
+	GdipDeletePath (rightPath);
+}
+
+static void test_combineManyRects ()
+{
+	GpStatus status;
+	GpRegion *region;
+	GpMatrix *matrix;
+	BOOL isVisible;
+	INT count;
+	RectF rect = {0, 0, 10, 10};
+
+	GdipCreateMatrix (&matrix);
+
+	// A grid of separate squares stays a band per row.
+	GdipCreateRegionRect (&rect, &region);
+	for (int y = 0; y < 8; y++) {
+		for (int x = 0; x < 8; x++) {
+			RectF square = {x * 20.0f, y * 20.0f, 10, 10};
+			status = GdipCombineRegionRect (region, &square, CombineModeUnion);
+			assertEqualInt (status, Ok);
+		}
+	}
+
+	status = GdipGetRegionScansCount (region, &count, matrix);
+	assertEqualInt (status, Ok);
+	assertEqualInt (count, 64);
+
+	status = GdipIsVisibleRegionPoint (region, 145, 125, graphics, &isVisible);
+	assertEqualInt (status, Ok);
+	assert (isVisible);
+
+	status = GdipIsVisibleRegionPoint (region, 150, 125, graphics, &isVisible);
+	assertEqualInt (status, Ok);
+	assert (!isVisible);
+
+	status = GdipIsVisibleRegionRect (region, 151, 111, 8, 8, graphics, &isVisible);
+	assertEqualInt (status, Ok);
+	assert (!isVisible);
+
+	status = GdipIsVisibleRegionRect (region, 151, 111, 10, 10, graphics, &isVisible);
+	assertEqualInt (status, Ok);
+	assert (isVisible);
+
+	// Filling the gaps merges everything into a single rectangle.
+	RectF rows = {0, 0, 150, 150};
+	status = GdipCombineRegionRect (region, &rows, CombineModeUnion);
+	assertEqualInt (status, Ok);
+
+	RectF scans[] = {
+		{0, 0, 150, 150}
+	};
+	verifyRegionScans (region, scans, sizeof (scans));
+
+	// Cut a hole and move the region.
+	RectF hole = {50, 60, 10, 10};
+	status = GdipCombineRegionRect (region, &hole, CombineModeXor);
+	assertEqualInt (status, Ok);
+
+	status = GdipTranslateRegion (region, 10, 0);
+	assertEqualInt (status, Ok);
+
+	RectF holeScans[] = {
+		{10, 0, 150, 60},
+		{10, 60, 50, 10},
+		{70, 60, 90, 10},
+		{10, 70, 150, 80}
+	};
+	verifyRegionScans (region, holeScans, sizeof (holeScans));
+
+	status = GdipIsVisibleRegionPoint (region, 65, 65, graphics, &isVisible);
+	assertEqualInt (status, Ok);
+	assert (!isVisible);
+
+	status = GdipIsVisibleRegionPoint (region, 70, 65, graphics, &isVisible);
+	assertEqualInt (status, Ok);
+	assert (isVisible);
+
+	GdipDeleteRegion (region);
+	GdipDeleteMatrix (matrix);
+}
+
 static void test_translateRegion ()
 {
 	GpStatus status;
@@ -9447,6 +9610,9 @@ main (int argc, char**argv)
 	test_combineXor ();
 	test_combineExclude ();
 	test_combineComplement ();
+	test_combineFarApartPaths ();
+	test_combineDeferred ();
+	test_combineManyRects ();
 	test_translateRegion ();
 	test_translateRegionI ();
 	test_transformRegion ();
@@ -306,6 +306,162 @@ static void test_measure_string_alignment(void)
 	GdipDeleteRegion (region);
 }
 
+static void measure_width (GpGraphics *graphics, const WCHAR *string, GpFont *font, REAL *width)
+{
+	GpStringFormat *format;
+	GpStatus status;
+	RectF rect = {0, 0, 1000, 100};
+	RectF bounds;
+
+	GdipCreateStringFormat (0, 0, &format);
+	status = GdipMeasureString (graphics, string, -1, font, &rect, format, &bounds, NULL, NULL);
+	expect (Ok, status);
+	*width = bounds.Width;
+	GdipDeleteStringFormat (format);
+}
+
+static void test_measure_string_repeated(void)
+{
+	GpImage *image;
+	GpGraphics *graphics;
+	GpFontFamily *family;
+	GpFont *font;
+	GpFont *largeFont;
+	REAL first, second, large;
+	int i;
+	const WCHAR latin[] = { 'W', 'i', 'd', 't', 'h', 's', ' ', 'o', 'f', ' ', 'c', 'e', 'l', 'l', 's', 0 };
+	const WCHAR mixed[] = { 'A', L'\u00e9', L'\u0416', L'\u03a9', L'\u4e2d', L'\u2003', 'z', 0 };
+
+	GdipGetGenericFontFamilySansSerif (&family);
+	GdipCreateFont (family, 10, FontStyleRegular, UnitPixel, &font);
+	GdipCreateFont (family, 20, FontStyleRegular, UnitPixel, &largeFont);
+	GdipCreateBitmapFromScan0 (400, 400, 0, PixelFormat32bppRGB, NULL, (GpBitmap **) &image);
+	GdipGetImageGraphicsContext (image, &graphics);
+
+	// Measuring the same text again gives the same result, whatever was measured in between.
+	measure_width (graphics, latin, font, &first);
+	ok (first > 0, "Expected a width, got %f\n", first);
+	for (i = 0; i < 3; i++) {
+		measure_width (graphics, latin, largeFont, &large);
+		measure_width (graphics, latin, font, &second);
+		expectf (first, second);
+	}
+	ok (large > first, "Expected %f to be larger than %f\n", large, first);
+
+	measure_width (graphics, mixed, font, &first);
+	measure_width (graphics, mixed, font, &second);
+	expectf (first, second);
+
+	GdipDeleteGraphics (graphics);
+	GdipDeleteFont (font);
+	GdipDeleteFont (largeFont);
+	GdipDeleteFontFamily (family);
+	GdipDisposeImage (image);
+}
+
+static void test_measure_string_hinting(void)
+{
+	GpImage *hintedImage;
+	GpImage *image;
+	GpGraphics *hintedGraphics;
+	GpGraphics *graphics;
+	GpFontFamily *family;
+	GpFont *hintedFont;
+	GpFont *font;
+	REAL hinted, unhinted, width;
+	const WCHAR latin[] = { 'W', 'i', 'd', 't', 'h', 's', ' ', 'o', 'f', ' ', 'c', 'e', 'l', 'l', 's', 0 };
+
+	// A size no other test measures, so the hinted widths are the first ones of this font.
+	GdipGetGenericFontFamilySansSerif (&family);
+	GdipCreateFont (family, 13, FontStyleRegular, UnitPixel, &hintedFont);
+	GdipCreateFont (family, 13, FontStyleRegular, UnitPixel, &font);
+	GdipCreateBitmapFromScan0 (400, 400, 0, PixelFormat32bppRGB, NULL, (GpBitmap **) &hintedImage);
+	GdipGetImageGraphicsContext (hintedImage, &hintedGraphics);
+	GdipCreateBitmapFromScan0 (400, 400, 0, PixelFormat32bppRGB, NULL, (GpBitmap **) &image);
+	GdipGetImageGraphicsContext (image, &graphics);
+
+	GdipSetTextRenderingHint (hintedGraphics, TextRenderingHintAntiAliasGridFit);
+	GdipSetTextRenderingHint (graphics, TextRenderingHintAntiAlias);
+	measure_width (hintedGraphics, latin, hintedFont, &hinted);
+	ok (hinted > 0, "Expected a width, got %f\n", hinted);
+	measure_width (graphics, latin, font, &unhinted);
+#if !defined(USE_PANGO_RENDERING)
+	// Grid fitted advances are rounded to whole pixels, the antialiased ones are not. Pango ignores the hint.
+	ok (unhinted != hinted, "Expected the hinted width %f to differ from the unhinted one\n", hinted);
+#endif
+
+	// Widths don't leak between hinting modes, whichever was measured first.
+	measure_width (hintedGraphics, latin, hintedFont, &width);
+	expectf (hinted, width);
+	measure_width (graphics, latin, font, &width);
+	expectf (unhinted, width);
+	GdipSetTextRenderingHint (graphics, TextRenderingHintAntiAliasGridFit);
+	measure_width (graphics, latin, font, &width);
+	expectf (hinted, width);
+	GdipSetTextRenderingHint (graphics, TextRenderingHintAntiAlias);
+	measure_width (graphics, latin, font, &width);
+	expectf (unhinted, width);
+
+	GdipDeleteGraphics (hintedGraphics);
+	GdipDeleteGraphics (graphics);
+	GdipDeleteFont (hintedFont);
+	GdipDeleteFont (font);
+	GdipDeleteFontFamily (family);
+	GdipDisposeImage (hintedImage);
+	GdipDisposeImage (image);
+}
+
+static void test_measure_string_cached_layout(void)
+{
+	GpImage *image;
+	GpGraphics *graphics;
+	GpFontFamily *family;
+	GpFont *font;
+	GpSolidFill *brush;
+	GpStringFormat *format;
+	RectF wide = {0, 0, 1000, 100};
+	RectF narrow = {0, 0, 40, 100};
+	RectF bounds, wideBounds;
+	int glyphs, firstGlyphs, lines;
+	int i;
+	const WCHAR latin[] = { 'W', 'i', 'd', 't', 'h', 's', ' ', 'o', 'f', ' ', 'c', 'e', 'l', 'l', 's', 0 };
+	const WCHAR hotkey[] = { '&', 'F', 'i', 'l', 'e', ' ', '&', 'E', 'd', 'i', 't', 0 };
+
+	GdipGetGenericFontFamilySansSerif (&family);
+	GdipCreateFont (family, 10, FontStyleRegular, UnitPixel, &font);
+	GdipCreateBitmapFromScan0 (400, 400, 0, PixelFormat32bppRGB, NULL, (GpBitmap **) &image);
+	GdipGetImageGraphicsContext (image, &graphics);
+	GdipCreateSolidFill (0xFF000000, &brush);
+	GdipCreateStringFormat (0, 0, &format);
+
+	// Wrapping depends on the layout rectangle.
+	GdipMeasureString (graphics, latin, -1, font, &wide, format, &wideBounds, NULL, &lines);
+	expect (1, lines);
+	GdipMeasureString (graphics, latin, -1, font, &narrow, format, &bounds, NULL, &lines);
+	ok (lines > 1, "Expected the text to wrap, got %d lines\n", lines);
+	GdipMeasureString (graphics, latin, -1, font, &wide, format, &bounds, NULL, &lines);
+	expect (1, lines);
+	expectf (wideBounds.Width, bounds.Width);
+	expectf (wideBounds.Height, bounds.Height);
+
+	// The hidden hotkey prefixes are removed the same way when the layout is reused, by drawing or measuring.
+	GdipSetStringFormatHotkeyPrefix (format, HotkeyPrefixHide);
+	GdipMeasureString (graphics, hotkey, -1, font, &wide, format, &bounds, &firstGlyphs, &lines);
+	ok (firstGlyphs > 0, "Expected fitted code points\n");
+	GdipDrawString (graphics, hotkey, -1, font, &wide, format, (GpBrush *) brush);
+	for (i = 0; i < 2; i++) {
+		GdipMeasureString (graphics, hotkey, -1, font, &wide, format, &bounds, &glyphs, &lines);
+		expect (firstGlyphs, glyphs);
+	}
+
+	GdipDeleteStringFormat (format);
+	GdipDeleteGraphics (graphics);
+	GdipDeleteFont (font);
+	GdipDeleteBrush ((GpBrush *) brush);
+	GdipDeleteFontFamily (family);
+	GdipDisposeImage (image);
+}
+
 int
 main (int argc, char**argv)
 {
@@ -315,6 +471,9 @@ main (int argc, char**argv)
 	test_measure_string ();
 #endif
 	test_measure_string_alignment ();
+	test_measure_string_repeated ();
+	test_measure_string_hinting ();
+	test_measure_string_cached_layout ();
 
 	SHUTDOWN;
 	return 0;
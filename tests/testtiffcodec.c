@@ -958,6 +958,186 @@ static void test_invalidSpecificTag ()
 	createFile (largeImageWidthAndHeight, OutOfMemory);
 }
 
+#if !defined(USE_WINDOWS_GDIPLUS)
+static GUID compressionGuid = {0xE09D739DU, 0xCCD4U, 0x44EEU, {0x8E, 0xBA, 0x3F, 0xBF, 0x8B, 0xE4, 0xFC, 0x58}};
+static GUID tileSizeGuid = {0x93EA0A28U, 0xC5B0U, 0x422DU, {0xA9, 0x05, 0x6C, 0x56, 0x91, 0x73, 0x36, 0xC1}};
+
+// The layout libtiff reads back from the file, which the encoder parameters choose.
+static void verifyTiffLayout (LONG compression, LONG tileSize, UINT height, BOOL alpha)
+{
+	TIFF *tiff;
+	uint16_t value16;
+	uint32_t value32;
+	uint16_t expectedCompression;
+
+	switch (compression) {
+	case EncoderValueCompressionLZW:
+		expectedCompression = COMPRESSION_LZW;
+		break;
+	case EncoderValueCompressionRle:
+	case 101 /* PackBits */:
+		expectedCompression = COMPRESSION_PACKBITS;
+		break;
+	case 100 /* Deflate */:
+		expectedCompression = COMPRESSION_ADOBE_DEFLATE;
+		break;
+	default:
+		expectedCompression = COMPRESSION_NONE;
+		break;
+	}
+
+	tiff = TIFFOpen (file, "r");
+	assert (tiff);
+	assertEqualInt (TIFFNumberOfDirectories (tiff), 1);
+	assert (TIFFGetField (tiff, TIFFTAG_COMPRESSION, &value16));
+	assertEqualInt (value16, expectedCompression);
+	assert (TIFFGetFieldDefaulted (tiff, TIFFTAG_SAMPLESPERPIXEL, &value16));
+	assertEqualInt (value16, alpha ? 4 : 3);
+	assert (TIFFGetFieldDefaulted (tiff, TIFFTAG_BITSPERSAMPLE, &value16));
+	assertEqualInt (value16, 8);
+
+	if (tileSize) {
+		assert (TIFFIsTiled (tiff));
+		assert (TIFFGetField (tiff, TIFFTAG_TILEWIDTH, &value32));
+		assertEqualInt (value32, tileSize);
+		assert (TIFFGetField (tiff, TIFFTAG_TILELENGTH, &value32));
+		assertEqualInt (value32, tileSize);
+	} else {
+		// Strips of about 8K, a large image has several of them.
+		assert (!TIFFIsTiled (tiff));
+		assert (TIFFGetFieldDefaulted (tiff, TIFFTAG_ROWSPERSTRIP, &value32));
+		assertEqualInt (TIFFNumberOfStrips (tiff), (height + value32 - 1) / value32);
+		if (height > 1000)
+			assert (TIFFNumberOfStrips (tiff) > 1);
+	}
+
+	TIFFClose (tiff);
+}
+
+static GpStatus saveWithOptions (PixelFormat format, INT width, INT height, LONG compression, LONG tileSize)
+{
+	GpStatus status;
+	GpBitmap *bitmap;
+	GpImage *saved;
+	BitmapData data;
+	BitmapData savedData;
+	Rect rect = {0, 0, width, height};
+	Rect region = {width / 3, height / 3, width / 3 + 1, height / 2};
+	EncoderParameters *params = (EncoderParameters *) malloc (sizeof (EncoderParameters) + sizeof (EncoderParameter));
+	INT x;
+	INT y;
+
+	GdipCreateBitmapFromScan0 (width, height, 0, format, NULL, &bitmap);
+	GdipBitmapLockBits (bitmap, &rect, ImageLockModeWrite, PixelFormat32bppARGB, &data);
+	for (y = 0; y < height; y++) {
+		ARGB *row = (ARGB *) ((BYTE *) data.Scan0 + y * data.Stride);
+		for (x = 0; x < width; x++)
+			row[x] = 0xFF000000 | ((x & 0xFF) << 16) | ((y & 0xFF) << 8) | ((x * y) & 0x3F);
+	}
+	GdipBitmapUnlockBits (bitmap, &data);
+
+	params->Count = 2;
+	params->Parameter[0].Guid = compressionGuid;
+	params->Parameter[0].NumberOfValues = 1;
+	params->Parameter[0].Type = EncoderParameterValueTypeLong;
+	params->Parameter[0].Value = &compression;
+	params->Parameter[1].Guid = tileSizeGuid;
+	params->Parameter[1].NumberOfValues = 1;
+	params->Parameter[1].Type = EncoderParameterValueTypeLong;
+	params->Parameter[1].Value = &tileSize;
+
+	status = GdipSaveImageToFile (bitmap, wFile, &tifEncoderClsid, params);
+	free (params);
+	if (status != Ok) {
+		GdipDisposeImage ((GpImage *) bitmap);
+		return status;
+	}
+
+	verifyTiffLayout (compression, tileSize, height, (format & PixelFormatAlpha) != 0);
+
+	// Only the strips or tiles under a read only lock are decoded before the pixels are used otherwise.
+	status = GdipLoadImageFromFile (wFile, &saved);
+	assertEqualInt (status, Ok);
+	GdipBitmapLockBits (bitmap, &region, ImageLockModeRead, PixelFormat32bppARGB, &data);
+	status = GdipBitmapLockBits ((GpBitmap *) saved, &region, ImageLockModeRead, PixelFormat32bppARGB, &savedData);
+	assertEqualInt (status, Ok);
+	for (y = 0; y < region.Height; y++)
+		assert (memcmp ((BYTE *) data.Scan0 + y * data.Stride, (BYTE *) savedData.Scan0 + y * savedData.Stride, region.Width * 4) == 0);
+	GdipBitmapUnlockBits ((GpBitmap *) saved, &savedData);
+	GdipBitmapUnlockBits (bitmap, &data);
+
+	GdipBitmapLockBits (bitmap, &rect, ImageLockModeRead, PixelFormat32bppARGB, &data);
+	GdipBitmapLockBits ((GpBitmap *) saved, &rect, ImageLockModeRead, PixelFormat32bppARGB, &savedData);
+	for (y = 0; y < height; y++)
+		assert (memcmp ((BYTE *) data.Scan0 + y * data.Stride, (BYTE *) savedData.Scan0 + y * savedData.Stride, width * 4) == 0);
+	GdipBitmapUnlockBits ((GpBitmap *) saved, &savedData);
+	GdipBitmapUnlockBits (bitmap, &data);
+
+	GdipDisposeImage (saved);
+	GdipDisposeImage ((GpImage *) bitmap);
+	return Ok;
+}
+
+static void test_encoderOptions ()
+{
+	// Several strips or tiles of each compression scheme.
+	assertEqualInt (saveWithOptions (PixelFormat24bppRGB, 1500, 1200, EncoderValueCompressionLZW, 0), Ok);
+	assertEqualInt (saveWithOptions (PixelFormat32bppARGB, 1500, 1200, 100 /* Deflate */, 64), Ok);
+	assertEqualInt (saveWithOptions (PixelFormat24bppRGB, 1500, 1200, EncoderValueCompressionRle, 0), Ok);
+	// Edge tiles only partly covered by the image.
+	assertEqualInt (saveWithOptions (PixelFormat24bppRGB, 100, 37, EncoderValueCompressionNone, 16), Ok);
+	assertEqualInt (saveWithOptions (PixelFormat24bppRGB, 100, 37, 101 /* PackBits */, 48), Ok);
+	// Formats not stored with 32 bits per pixel are converted before being packed.
+	assertEqualInt (saveWithOptions (PixelFormat16bppRGB555, 100, 37, EncoderValueCompressionLZW, 0), Ok);
+	assertEqualInt (saveWithOptions (PixelFormat16bppRGB565, 100, 37, EncoderValueCompressionNone, 16), Ok);
+	assertEqualInt (saveWithOptions (PixelFormat16bppARGB1555, 100, 37, EncoderValueCompressionLZW, 0), Ok);
+	assertEqualInt (saveWithOptions (PixelFormat48bppRGB, 100, 37, EncoderValueCompressionLZW, 0), Ok);
+	assertEqualInt (saveWithOptions (PixelFormat64bppARGB, 100, 37, EncoderValueCompressionNone, 16), Ok);
+	assertEqualInt (saveWithOptions (PixelFormat64bppPARGB, 100, 37, EncoderValueCompressionLZW, 0), Ok);
+
+	assertEqualInt (saveWithOptions (PixelFormat24bppRGB, 10, 10, EncoderValueCompressionNone, 20), InvalidParameter);
+	assertEqualInt (saveWithOptions (PixelFormat24bppRGB, 10, 10, 99, 0), InvalidParameter);
+}
+
+static void test_truncatedBeforeDecode ()
+{
+	GpStatus status;
+	GpBitmap *bitmap;
+	GpImage *image;
+	BitmapData data;
+	Rect rect = {0, 0, 100, 37};
+	Rect region = {10, 10, 20, 10};
+	UINT width;
+	FILE *f;
+
+	GdipCreateBitmapFromScan0 (100, 37, 0, PixelFormat24bppRGB, NULL, &bitmap);
+	status = GdipSaveImageToFile (bitmap, wFile, &tifEncoderClsid, NULL);
+	assertEqualInt (status, Ok);
+	GdipDisposeImage ((GpImage *) bitmap);
+
+	status = GdipLoadImageFromFile (wFile, &image);
+	assertEqualInt (status, Ok);
+
+	// The pixels were not decoded yet, the file is read again when they are used, in its current state.
+	f = fopen (file, "wb");
+	assert (f);
+	fclose (f);
+
+	status = GdipBitmapLockBits ((GpBitmap *) image, &region, ImageLockModeRead, PixelFormat32bppARGB, &data);
+	assert (status != Ok);
+	status = GdipBitmapLockBits ((GpBitmap *) image, &rect, ImageLockModeRead, PixelFormat32bppARGB, &data);
+	assert (status != Ok);
+
+	// A failed decode doesn't leave the bitmap locked.
+	status = GdipBitmapLockBits ((GpBitmap *) image, &rect, ImageLockModeRead, PixelFormat32bppARGB, &data);
+	assert (status != Ok && status != WrongState);
+	GdipGetImageWidth (image, &width);
+	assertEqualInt (width, 100);
+
+	GdipDisposeImage (image);
+}
+#endif
+
 int
 main (int argc, char**argv)
 {
@@ -971,6 +1151,10 @@ main (int argc, char**argv)
 	test_invalidTag ();
 	test_missingTag ();
 	test_invalidSpecificTag ();
+#if !defined(USE_WINDOWS_GDIPLUS)
+	test_encoderOptions ();
+	test_truncatedBeforeDecode ();
+#endif
 
 	deleteFile (file);
 